@@ -0,0 +1,159 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include "Bench.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "Config.h"
+#include "FakeNetwork.h"
+#include "PredictionCache.h"
+#include "WorkerGroup.h"
+
+// Middlegame and endgame positions from Stockfish's "bench" (see "benchmark.cpp"), plus the starting position.
+const std::vector<std::string> Bench::Positions =
+{
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+};
+
+// Predicts a drawn value and uniform priors (all-zero logits) for every position, like "SelfPlayWorker::PredictBatchUniform".
+class UniformNetwork : public INetwork
+{
+public:
+
+    virtual PredictionStatus PredictBatch(NetworkType, int batchSize, InputPlanes*, float* values, OutputPlanes* policies)
+    {
+        std::fill(values, values + batchSize, CHESSCOACH_VALUE_DRAW);
+
+        INetwork::PlanesPointerFlat policiesFlat = reinterpret_cast<INetwork::PlanesPointerFlat>(policies);
+        std::fill(policiesFlat, policiesFlat + (batchSize * INetwork::OutputPlanesFloatCount), 0.f);
+        return PredictionStatus_None;
+    }
+
+    virtual std::vector<std::string> PredictCommentaryBatch(int, CommentaryInputPlanes*) { return {}; }
+    virtual void Train(NetworkType, int, int) {}
+    virtual void TrainCommentary(int, int) {}
+    virtual void LogScalars(NetworkType, int, const std::vector<std::string>, float*) {}
+    virtual void SaveNetwork(NetworkType, int) {}
+    virtual void SaveSwaNetwork(NetworkType, int) {}
+    virtual void UpdateNetworkWeights(const std::string&) {}
+    virtual void GetNetworkInfo(NetworkType, int*, int*, int*, std::string*) {}
+    virtual void SaveFile(const std::string&, const std::string&) {}
+    virtual std::string LoadFile(const std::string&) { return {}; }
+    virtual bool FileExists(const std::string&) { return false; }
+    virtual void LaunchGui(const std::string&) {}
+    virtual void UpdateGui(const std::string&, const std::string&, int, const std::string&, const std::string&,
+        const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, std::vector<float>&,
+        std::vector<float>&, std::vector<float>&, std::vector<float>&, std::vector<int>&, std::vector<int>&) {}
+    virtual void DebugDecompress(int, int, float*, int64_t*, int64_t*, int64_t*, float*, int, InputPlanes*, float*, OutputPlanes*) {}
+    virtual void OptimizeParameters() {}
+    virtual void RunBot() {}
+    virtual void PlayBotMove(const std::string&, const std::string&) {}
+};
+
+// Requires the prediction cache to be allocated. The cache is cleared before and after, so any saved/warmed contents are lost.
+BenchResult Bench::Run(INetwork* network, const std::string& predictions, int nodes, int threadCount, int parallelism)
+{
+    std::unique_ptr<INetwork> benchNetwork;
+    if (predictions == "uniform")
+    {
+        benchNetwork.reset(new UniformNetwork());
+        network = benchNetwork.get();
+    }
+    else if (predictions == "fake")
+    {
+        FakeNetworkOptions options;
+        options.latencyMicroseconds = Config::Misc.Inference_FakeLatencyMicroseconds;
+        options.microsecondsPerPosition = Config::Misc.Inference_FakeMicrosecondsPerPosition;
+        benchNetwork.reset(new FakeNetwork(nullptr /* fallback */, options));
+        network = benchNetwork.get();
+    }
+    else if ((predictions != "network") || !network)
+    {
+        throw ChessCoachException("Bench predictions must be \"uniform\", \"fake\" or \"network\" (with a network): " + predictions);
+    }
+    if (nodes <= 0)
+    {
+        throw ChessCoachException("Bench requires a positive node count");
+    }
+
+    PredictionCache::Instance.Clear();
+    PredictionCache::Instance.ResetProbeMetrics();
+
+    // Use a fresh worker group so that results don't depend on earlier searches.
+    WorkerGroup workerGroup;
+    workerGroup.Initialize(network, nullptr /* storage */, Config::Network.SelfPlay.PredictionNetworkType,
+        threadCount, parallelism, &SelfPlayWorker::LoopSearch);
+    const SearchBenchmarkStatistics statistics = workerGroup.controllerWorker->BenchmarkSearch(workerGroup.workCoordinator.get(), Positions, nodes);
+    workerGroup.ShutDown();
+
+    BenchResult result;
+    result.predictions = predictions;
+    result.positionCount = static_cast<int>(Positions.size());
+    result.nodesPerPosition = nodes;
+    result.threadCount = threadCount;
+    result.parallelism = parallelism;
+    result.nodeCount = statistics.nodeCount;
+    result.failedNodeCount = statistics.failedNodeCount;
+    result.tablebaseHitCount = statistics.tablebaseHitCount;
+    result.seconds = statistics.seconds;
+    result.predictionCacheHitPermille = PredictionCache::Instance.PermilleHits();
+    result.predictionCacheEvictionPermille = PredictionCache::Instance.PermilleEvictions();
+    result.predictionCacheFullPermille = PredictionCache::Instance.PermilleFull();
+    result.maxTreeBytes = statistics.maxTreeBytes;
+
+    PredictionCache::Instance.Clear();
+    return result;
+}
+
+// Nodes are backpropagated simulations (as in UCI "nodes"), while simulations also count failed nodes,
+// i.e. selections abandoned because of collisions with other slots.
+void Bench::WriteJson(std::ostream& output, const BenchResult& result)
+{
+    const int64_t simulationCount = (result.nodeCount + result.failedNodeCount);
+    const float seconds = std::max(result.seconds, 1e-6f);
+    output << "{\"predictions\":\"" << result.predictions << "\""
+        << ",\"positions\":" << result.positionCount
+        << ",\"nodes_per_position\":" << result.nodesPerPosition
+        << ",\"threads\":" << result.threadCount
+        << ",\"parallelism\":" << result.parallelism
+        << ",\"nodes\":" << result.nodeCount
+        << ",\"failed_nodes\":" << result.failedNodeCount
+        << ",\"simulations\":" << simulationCount
+        << ",\"tbhits\":" << result.tablebaseHitCount
+        << ",\"seconds\":" << result.seconds
+        << ",\"nps\":" << static_cast<int64_t>(result.nodeCount / seconds)
+        << ",\"simulations_per_second\":" << static_cast<int64_t>(simulationCount / seconds)
+        << ",\"microseconds_per_simulation\":" << ((simulationCount > 0) ? (result.seconds * 1000000.f / simulationCount) : 0.f)
+        << ",\"failed_node_permille\":" << ((simulationCount > 0) ? (result.failedNodeCount * 1000 / simulationCount) : 0)
+        << ",\"cache_hit_permille\":" << result.predictionCacheHitPermille
+        << ",\"cache_eviction_permille\":" << result.predictionCacheEvictionPermille
+        << ",\"cache_full_permille\":" << result.predictionCacheFullPermille
+        << ",\"max_tree_bytes\":" << result.maxTreeBytes
+        << "}" << std::endl;
+}
@@ -0,0 +1,63 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Network.h"
+
+struct BenchResult
+{
+    std::string predictions;
+    int positionCount;
+    int nodesPerPosition;
+    int threadCount;
+    int parallelism;
+    int64_t nodeCount;
+    int64_t failedNodeCount;
+    int64_t tablebaseHitCount;
+    float seconds;
+    int predictionCacheHitPermille;
+    int predictionCacheEvictionPermille;
+    int predictionCacheFullPermille;
+    int64_t maxTreeBytes;
+};
+
+// A reproducible search benchmark for regression-checking performance between commits: a fixed set of positions,
+// each searched from a new tree and an empty prediction cache to a fixed node count, reported as one JSON object.
+//
+// With "uniform" predictions no network is needed and search, tree and cache code is measured alone.
+// With "fake" predictions no network is needed either, but priors and values vary by position (see "FakeNetwork"),
+// including the configured fake latency. With "network" predictions the provided network is used, e.g. to include inference cost.
+class Bench
+{
+public:
+
+    static constexpr const int DefaultNodes = 10000;
+    static const std::vector<std::string> Positions;
+
+public:
+
+    static BenchResult Run(INetwork* network, const std::string& predictions, int nodes, int threadCount, int parallelism);
+    static void WriteJson(std::ostream& output, const BenchResult& result);
+};
+
+#endif // _BENCH_H_
@@ -19,6 +19,8 @@
 #include <cstdlib>
 #include <exception>
 #include <iostream>
+#include <sstream>
+#include <iomanip>
 
 #include <Stockfish/bitboard.h>
 #include <Stockfish/position.h>
@@ -26,6 +28,9 @@
 #include <Stockfish/uci.h>
 
 #include "PythonNetwork.h"
+#include "NativeNetwork.h"
+#include "FakeNetwork.h"
+#include "InferenceServer.h"
 #include "PythonModule.h"
 #undef NO_IMPORT_ARRAY
 #define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
@@ -34,6 +39,9 @@
 #include "Game.h"
 #include "PredictionCache.h"
 #include "PoolAllocator.h"
+#include "NodeArena.h"
+#include "Instrumentation.h"
+#include "Trace.h"
 #include "Platform.h"
 
 namespace PSQT
@@ -146,11 +154,80 @@ void ChessCoach::InitializeChessCoach()
 {
     Config::Initialize();
     Game::Initialize();
+    Instrumentation::SetEnabled(Config::Misc.Instrumentation_Enabled);
+    Instrumentation::SetPerNode(Config::Misc.Instrumentation_PerNode);
+    if (Config::Misc.Instrumentation_Trace)
+    {
+        Trace::Start(Config::Misc.Instrumentation_TraceEventsPerThread);
+    }
+
+    if (Config::Misc.NodeArena_BackgroundReclaim)
+    {
+        NodeArena::StartReclaimer(Config::Misc.NodeArena_ReclaimArraysPerMillisecond);
+    }
 }
 
 void ChessCoach::InitializePredictionCache()
 {
-    PredictionCache::Instance.Allocate(Config::Misc.PredictionCache_SizeMebibytes);
+    PredictionCache::Instance.Allocate(Config::Misc.PredictionCache_SizeMebibytes,
+        Config::Misc.PredictionCache_Associativity, Config::Misc.PredictionCache_EntryBytes);
+}
+
+// Returns true if a saved cache for this network and geometry was mapped in.
+bool ChessCoach::LoadPredictionCache(INetwork* network)
+{
+    if (!Config::Misc.PredictionCache_Persistent)
+    {
+        return false;
+    }
+
+    const std::string identity = PredictionCacheIdentity(network);
+    return PredictionCache::Instance.Load(PredictionCachePath(identity), identity);
+}
+
+void ChessCoach::SavePredictionCache(INetwork* network)
+{
+    const std::string identity = PredictionCacheIdentity(network);
+    PredictionCache::Instance.Save(PredictionCachePath(identity), identity);
+}
+
+// Predictions are only reusable for the same weights and backend (numerics differ slightly between backends).
+std::string ChessCoach::PredictionCacheIdentity(INetwork* network) const
+{
+    const NetworkType networkType = Config::Network.SelfPlay.PredictionNetworkType;
+    int stepCount = 0;
+    std::string relativePath;
+    network->GetNetworkInfo(networkType, &stepCount, nullptr, nullptr, &relativePath);
+
+    std::stringstream identity;
+    identity << Config::Network.Name << "|" << networkType << "|" << relativePath << "|" << stepCount
+        << "|" << Config::Misc.Inference_Backend;
+    if (Config::Misc.Inference_Backend == "native")
+    {
+        // Native weights are exported separately, so also identify the exported file.
+        std::filesystem::path weightsPath = Config::Misc.Inference_NativeWeights;
+        if (!weightsPath.is_absolute())
+        {
+            weightsPath = (Platform::UserDataPath() / weightsPath);
+        }
+        std::error_code error;
+        identity << "|" << weightsPath.string() << "|" << std::filesystem::file_size(weightsPath, error)
+            << "|" << std::filesystem::last_write_time(weightsPath, error).time_since_epoch().count();
+    }
+    return identity.str();
+}
+
+std::filesystem::path ChessCoach::PredictionCachePath(const std::string& identity) const
+{
+    std::filesystem::path directory = Config::Misc.PredictionCache_PersistentDirectory;
+    if (!directory.is_absolute())
+    {
+        directory = (Platform::UserDataPath() / directory);
+    }
+
+    std::stringstream filename;
+    filename << std::hex << std::setfill('0') << std::setw(16) << PredictionCache::IdentityHash(identity) << ".cache";
+    return (directory / filename.str());
 }
 
 // Keep Python visibility isolated to the ChessCoach library.
@@ -175,7 +252,51 @@ void ChessCoach::FinalizeStockfish()
 
 INetwork* ChessCoach::CreateNetwork() const
 {
-    return new PythonNetwork();
+    INetwork* network = CreateBackendNetwork();
+
+    // Optionally share dynamic batches across all self-play/search threads.
+    if (Config::Misc.Inference_BatchingServer)
+    {
+        return new InferenceServer(network, Config::Misc.Inference_BatchingThreads,
+            Config::Misc.Inference_BatchingMaxBatchSize, Config::Misc.Inference_BatchingMaxLatencyMicroseconds);
+    }
+
+    return network;
+}
+
+INetwork* ChessCoach::CreateBackendNetwork() const
+{
+    const std::string& backend = Config::Misc.Inference_Backend;
+    if (backend == "python")
+    {
+        return new PythonNetwork();
+    }
+    else if (backend == "native")
+    {
+        // Root relative paths at ChessCoach's appdata directory, like local storage paths.
+        std::filesystem::path weightsPath = Config::Misc.Inference_NativeWeights;
+        if (weightsPath.empty())
+        {
+            throw ChessCoachException("The native inference backend requires \"native_weights\" to be set");
+        }
+        if (!weightsPath.is_absolute())
+        {
+            weightsPath = (Platform::UserDataPath() / weightsPath);
+        }
+
+        // Predictions run natively, for the self-play/UCI network type that the weights are expected to be
+        // exported for; training, storage, GUI, etc. still go through Python.
+        return new NativeNetwork(new PythonNetwork(), Config::Network.SelfPlay.PredictionNetworkType, NativeWeights::Load(weightsPath));
+    }
+    else if (backend == "fake")
+    {
+        FakeNetworkOptions options;
+        options.latencyMicroseconds = Config::Misc.Inference_FakeLatencyMicroseconds;
+        options.microsecondsPerPosition = Config::Misc.Inference_FakeMicrosecondsPerPosition;
+        return new FakeNetwork(Config::Misc.Inference_FakePython ? new PythonNetwork() : nullptr, options);
+    }
+
+    throw ChessCoachException("Unknown inference backend: " + backend);
 }
 
 // Keep Python visibility isolated to the ChessCoach library.
@@ -17,6 +17,9 @@
 #ifndef _CHESSCOACH_H_
 #define _CHESSCOACH_H_
 
+#include <string>
+#include <filesystem>
+
 #include "Network.h"
 #include "WorkerGroup.h"
 
@@ -35,16 +38,25 @@ public:
 
 protected:
 
+    INetwork* CreateBackendNetwork() const;
+
     void InitializePython();
     void InitializeStockfish();
     void InitializeChessCoach();
     void InitializePredictionCache();
+    bool LoadPredictionCache(INetwork* network);
+    void SavePredictionCache(INetwork* network);
     void InitializePythonModule(Storage* storage, INetwork* network, WorkerGroup* workerGroup);
 
     void FinalizePython();
     void FinalizeStockfish();
 
     void OptimizeParameters();
+
+private:
+
+    std::string PredictionCacheIdentity(INetwork* network) const;
+    std::filesystem::path PredictionCachePath(const std::string& identity) const;
 };
 
 #endif // _CHESSCOACH_H_
\ No newline at end of file
@@ -0,0 +1,416 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include "ColumnarChunk.h"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#include <zlib.h>
+
+#pragma warning(disable:4100) // Ignore unused args in generated code
+#pragma warning(disable:4127) // Ignore const-per-architecture warning
+#include <protobuf/ChessCoach.pb.h>
+#pragma warning(disable:4127) // Ignore const-per-architecture warning
+#pragma warning(default:4100) // Ignore unused args in generated code
+
+constexpr const int ImagePiecesAuxiliaryStride = (INetwork::InputPieceAndRepetitionPlanesPerPosition + INetwork::InputAuxiliaryPlaneCount);
+
+ColumnarChunkWriter::ColumnarChunkWriter()
+{
+    Clear();
+}
+
+void ColumnarChunkWriter::AddGame(Game scratchGame, const SavedGame& game)
+{
+    // MCTS deals with probabilities in [0, 1]. Network deals with tanh outputs/targets in (-1, 1)/[-1, 1].
+    _result.push_back(INetwork::MapProbability01To11(game.result));
+    const size_t valuesStart = _mctsValues.size();
+    _mctsValues.insert(_mctsValues.end(), game.mctsValues.begin(), game.mctsValues.end());
+    INetwork::MapProbabilities01To11(game.mctsValues.size(), _mctsValues.data() + valuesStart);
+
+    // Image and policy require applying moves to a scratch game, like "Storage::PopulateGame".
+    const size_t imageStart = _imagePiecesAuxiliary.size();
+    _imagePiecesAuxiliary.resize(imageStart + (static_cast<size_t>(game.moveCount) * ImagePiecesAuxiliaryStride));
+    for (int m = 0; m < game.moveCount; m++)
+    {
+        INetwork::PackedPlane* imagePiecesOut = (_imagePiecesAuxiliary.data() + imageStart + (static_cast<size_t>(m) * ImagePiecesAuxiliaryStride));
+        INetwork::PackedPlane* imageAuxiliaryOut = (imagePiecesOut + INetwork::InputPieceAndRepetitionPlanesPerPosition);
+        scratchGame.GenerateImageCompressed(imagePiecesOut, imageAuxiliaryOut);
+
+        const int movePolicyIndexCount = static_cast<int>(game.childVisits[m].size());
+        const size_t policyStart = _policyIndices.size();
+        _policyRowLengths.push_back(movePolicyIndexCount);
+        _policyIndices.resize(policyStart + movePolicyIndexCount);
+        _policyValues.resize(policyStart + movePolicyIndexCount, 0.f); // Zeroed, as required by "GeneratePolicyCompressed".
+        scratchGame.GeneratePolicyCompressed(game.childVisits[m], _policyIndices.data() + policyStart, _policyValues.data() + policyStart);
+        _policyOffsets.push_back(static_cast<int64_t>(_policyIndices.size()));
+
+        scratchGame.ApplyMove(Move(game.moves[m]));
+    }
+
+    FinishGame();
+}
+
+// Converts a game from a TFRecord chunk, which already holds mapped values and compressed images and policies.
+void ColumnarChunkWriter::AddGame(const message::Example& example)
+{
+    auto& features = example.features().feature();
+    auto& result = features.at("result").float_list().value();
+    auto& mctsValues = features.at("mcts_values").float_list().value();
+    auto& imagePiecesAuxiliary = features.at("image_pieces_auxiliary").int64_list().value();
+    auto& policyRowLengths = features.at("policy_row_lengths").int64_list().value();
+    auto& policyIndices = features.at("policy_indices").int64_list().value();
+    auto& policyValues = features.at("policy_values").float_list().value();
+
+    _result.push_back(result[0]);
+    _mctsValues.insert(_mctsValues.end(), mctsValues.begin(), mctsValues.end());
+    _imagePiecesAuxiliary.insert(_imagePiecesAuxiliary.end(), imagePiecesAuxiliary.begin(), imagePiecesAuxiliary.end());
+    _policyIndices.insert(_policyIndices.end(), policyIndices.begin(), policyIndices.end());
+    _policyValues.insert(_policyValues.end(), policyValues.begin(), policyValues.end());
+    for (const int64_t length : policyRowLengths)
+    {
+        _policyRowLengths.push_back(length);
+        _policyOffsets.push_back(_policyOffsets.back() + length);
+    }
+
+    FinishGame();
+}
+
+void ColumnarChunkWriter::FinishGame()
+{
+    _gamePositionOffsets.push_back(static_cast<int64_t>(_mctsValues.size()));
+
+    if ((_imagePiecesAuxiliary.size() != (_mctsValues.size() * ImagePiecesAuxiliaryStride))
+        || (_policyRowLengths.size() != _mctsValues.size())
+        || (_policyOffsets.back() != static_cast<int64_t>(_policyIndices.size()))
+        || (_policyValues.size() != _policyIndices.size()))
+    {
+        throw ChessCoachException("Inconsistent game for columnar chunk");
+    }
+}
+
+void ColumnarChunkWriter::Clear()
+{
+    _gamePositionOffsets.assign(1, 0);
+    _result.clear();
+    _mctsValues.clear();
+    _imagePiecesAuxiliary.clear();
+    _policyRowLengths.clear();
+    _policyOffsets.assign(1, 0);
+    _policyIndices.clear();
+    _policyValues.clear();
+}
+
+int ColumnarChunkWriter::GameCount() const
+{
+    return static_cast<int>(_result.size());
+}
+
+const int64_t* ColumnarChunkWriter::GamePositionOffsets() const
+{
+    return _gamePositionOffsets.data();
+}
+
+const float* ColumnarChunkWriter::Result() const
+{
+    return _result.data();
+}
+
+const float* ColumnarChunkWriter::MctsValues() const
+{
+    return _mctsValues.data();
+}
+
+const INetwork::PackedPlane* ColumnarChunkWriter::ImagePiecesAuxiliary() const
+{
+    return _imagePiecesAuxiliary.data();
+}
+
+const int64_t* ColumnarChunkWriter::PolicyRowLengths() const
+{
+    return _policyRowLengths.data();
+}
+
+const int64_t* ColumnarChunkWriter::PolicyOffsets() const
+{
+    return _policyOffsets.data();
+}
+
+const int64_t* ColumnarChunkWriter::PolicyIndices() const
+{
+    return _policyIndices.data();
+}
+
+const float* ColumnarChunkWriter::PolicyValues() const
+{
+    return _policyValues.data();
+}
+
+void ColumnarChunkWriter::Write(const std::filesystem::path& path, bool compress) const
+{
+    const std::array<std::pair<const void*, size_t>, ColumnarColumn_Count> raw =
+    { {
+        { _gamePositionOffsets.data(), _gamePositionOffsets.size() * sizeof(int64_t) },
+        { _result.data(), _result.size() * sizeof(float) },
+        { _mctsValues.data(), _mctsValues.size() * sizeof(float) },
+        { _imagePiecesAuxiliary.data(), _imagePiecesAuxiliary.size() * sizeof(INetwork::PackedPlane) },
+        { _policyRowLengths.data(), _policyRowLengths.size() * sizeof(int64_t) },
+        { _policyOffsets.data(), _policyOffsets.size() * sizeof(int64_t) },
+        { _policyIndices.data(), _policyIndices.size() * sizeof(int64_t) },
+        { _policyValues.data(), _policyValues.size() * sizeof(float) },
+    } };
+
+    ColumnarChunkHeader header = {};
+    header.magic = ColumnarChunkHeader::Magic;
+    header.version = ColumnarChunkHeader::Version;
+    header.columnCount = ColumnarColumn_Count;
+    header.imagePiecesAuxiliaryStride = ImagePiecesAuxiliaryStride;
+    header.gameCount = GameCount();
+    header.positionCount = static_cast<int64_t>(_mctsValues.size());
+    header.policyCount = static_cast<int64_t>(_policyIndices.size());
+
+    // Compress columns one block each, favoring speed, and keep any that don't shrink raw.
+    // The game index stays raw so that readers can always find games straight from the mapping.
+    std::array<std::vector<uint8_t>, ColumnarColumn_Count> compressed;
+    uint64_t offset = ColumnarChunkHeader::PaddedBytes;
+    for (int i = 0; i < ColumnarColumn_Count; i++)
+    {
+        ColumnarColumnInfo& info = header.columns[i];
+        info.rawBytes = raw[i].second;
+        info.storedBytes = raw[i].second;
+        info.compression = ColumnarCompression_None;
+
+        if (compress && (i != ColumnarColumn_GamePositionOffsets) && (raw[i].second > 0))
+        {
+            uLongf compressedBytes = ::compressBound(static_cast<uLong>(raw[i].second));
+            compressed[i].resize(compressedBytes);
+            if ((::compress2(compressed[i].data(), &compressedBytes, static_cast<const Bytef*>(raw[i].first),
+                static_cast<uLong>(raw[i].second), Z_BEST_SPEED) == Z_OK) && (compressedBytes < raw[i].second))
+            {
+                compressed[i].resize(compressedBytes);
+                info.storedBytes = compressedBytes;
+                info.compression = ColumnarCompression_Zlib;
+            }
+            else
+            {
+                compressed[i].clear();
+            }
+        }
+
+        info.offset = ((offset + ColumnarChunkHeader::ColumnAlignment - 1) / ColumnarChunkHeader::ColumnAlignment * ColumnarChunkHeader::ColumnAlignment);
+        offset = (info.offset + info.storedBytes);
+    }
+
+    // Write to a temporary file then rename, so that readers never see a partial chunk.
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        std::vector<char> padding(ColumnarChunkHeader::PaddedBytes);
+        std::memcpy(padding.data(), &header, sizeof(header));
+        file.write(padding.data(), padding.size());
+        uint64_t written = ColumnarChunkHeader::PaddedBytes;
+
+        std::fill(padding.begin(), padding.end(), 0);
+        for (int i = 0; i < ColumnarColumn_Count; i++)
+        {
+            const ColumnarColumnInfo& info = header.columns[i];
+            file.write(padding.data(), info.offset - written);
+            if (info.compression == ColumnarCompression_Zlib)
+            {
+                file.write(reinterpret_cast<const char*>(compressed[i].data()), info.storedBytes);
+            }
+            else
+            {
+                file.write(static_cast<const char*>(raw[i].first), info.storedBytes);
+            }
+            written = (info.offset + info.storedBytes);
+        }
+
+        if (!file)
+        {
+            throw ChessCoachException("Failed to write columnar chunk: " + temporaryPath.string());
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        std::filesystem::remove(temporaryPath, error);
+        throw ChessCoachException("Failed to replace columnar chunk: " + path.string());
+    }
+}
+
+ColumnarChunk::ColumnarChunk(const std::filesystem::path& path)
+    : _path(path)
+    , _mapping(new MemoryMappedFile(path))
+    , _header()
+    , _columns()
+{
+    const auto invalid = [&]() { return ChessCoachException("Invalid columnar chunk: " + _path.string()); };
+
+    if (_mapping->Size() < ColumnarChunkHeader::PaddedBytes)
+    {
+        throw invalid();
+    }
+    std::memcpy(&_header, _mapping->Data(), sizeof(_header));
+    if ((_header.magic != ColumnarChunkHeader::Magic)
+        || (_header.version != ColumnarChunkHeader::Version)
+        || (_header.columnCount != ColumnarColumn_Count)
+        || (_header.imagePiecesAuxiliaryStride != ImagePiecesAuxiliaryStride)
+        || (_header.gameCount < 0)
+        || (_header.positionCount < 0)
+        || (_header.policyCount < 0))
+    {
+        throw invalid();
+    }
+
+    const uint64_t gameCount = _header.gameCount;
+    const uint64_t positionCount = _header.positionCount;
+    const uint64_t policyCount = _header.policyCount;
+    const std::array<uint64_t, ColumnarColumn_Count> expectedRawBytes =
+    {
+        (gameCount + 1) * sizeof(int64_t),
+        gameCount * sizeof(float),
+        positionCount * sizeof(float),
+        positionCount * ImagePiecesAuxiliaryStride * sizeof(INetwork::PackedPlane),
+        positionCount * sizeof(int64_t),
+        (positionCount + 1) * sizeof(int64_t),
+        policyCount * sizeof(int64_t),
+        policyCount * sizeof(float),
+    };
+
+    const uint8_t* data = static_cast<const uint8_t*>(_mapping->Data());
+    for (int i = 0; i < ColumnarColumn_Count; i++)
+    {
+        const ColumnarColumnInfo& info = _header.columns[i];
+        if ((info.rawBytes != expectedRawBytes[i])
+            || ((info.offset % ColumnarChunkHeader::ColumnAlignment) != 0)
+            || (info.offset > _mapping->Size())
+            || (info.storedBytes > (_mapping->Size() - info.offset)))
+        {
+            throw invalid();
+        }
+
+        if (info.compression == ColumnarCompression_None)
+        {
+            if (info.storedBytes != info.rawBytes)
+            {
+                throw invalid();
+            }
+            _columns[i] = (data + info.offset);
+        }
+        else if (info.compression == ColumnarCompression_Zlib)
+        {
+            _inflated[i].resize(info.rawBytes);
+            uLongf inflatedBytes = static_cast<uLongf>(info.rawBytes);
+            if ((::uncompress(_inflated[i].data(), &inflatedBytes, data + info.offset, static_cast<uLong>(info.storedBytes)) != Z_OK)
+                || (inflatedBytes != info.rawBytes))
+            {
+                throw invalid();
+            }
+            _columns[i] = _inflated[i].data();
+        }
+        else
+        {
+            throw invalid();
+        }
+    }
+
+    // Check the index ends and order so that offsets can be trusted without per-game checks.
+    if ((GamePositionOffsets()[0] != 0)
+        || (GamePositionOffsets()[gameCount] != _header.positionCount)
+        || !std::is_sorted(GamePositionOffsets(), GamePositionOffsets() + gameCount + 1)
+        || (PolicyOffsets()[0] != 0)
+        || (PolicyOffsets()[positionCount] != _header.policyCount)
+        || !std::is_sorted(PolicyOffsets(), PolicyOffsets() + positionCount + 1))
+    {
+        throw invalid();
+    }
+}
+
+int ColumnarChunk::GameCount() const
+{
+    return static_cast<int>(_header.gameCount);
+}
+
+int64_t ColumnarChunk::PositionCount() const
+{
+    return _header.positionCount;
+}
+
+int64_t ColumnarChunk::PolicyCount() const
+{
+    return _header.policyCount;
+}
+
+int64_t ColumnarChunk::GamePositionStart(int gameIndex) const
+{
+    return GamePositionOffsets()[gameIndex];
+}
+
+int ColumnarChunk::GamePositionCount(int gameIndex) const
+{
+    return static_cast<int>(GamePositionOffsets()[gameIndex + 1] - GamePositionOffsets()[gameIndex]);
+}
+
+const int64_t* ColumnarChunk::GamePositionOffsets() const
+{
+    return static_cast<const int64_t*>(Column(ColumnarColumn_GamePositionOffsets));
+}
+
+const float* ColumnarChunk::Result() const
+{
+    return static_cast<const float*>(Column(ColumnarColumn_Result));
+}
+
+const float* ColumnarChunk::MctsValues() const
+{
+    return static_cast<const float*>(Column(ColumnarColumn_MctsValues));
+}
+
+const INetwork::PackedPlane* ColumnarChunk::ImagePiecesAuxiliary() const
+{
+    return static_cast<const INetwork::PackedPlane*>(Column(ColumnarColumn_ImagePiecesAuxiliary));
+}
+
+const int64_t* ColumnarChunk::PolicyRowLengths() const
+{
+    return static_cast<const int64_t*>(Column(ColumnarColumn_PolicyRowLengths));
+}
+
+const int64_t* ColumnarChunk::PolicyOffsets() const
+{
+    return static_cast<const int64_t*>(Column(ColumnarColumn_PolicyOffsets));
+}
+
+const int64_t* ColumnarChunk::PolicyIndices() const
+{
+    return static_cast<const int64_t*>(Column(ColumnarColumn_PolicyIndices));
+}
+
+const float* ColumnarChunk::PolicyValues() const
+{
+    return static_cast<const float*>(Column(ColumnarColumn_PolicyValues));
+}
+
+const void* ColumnarChunk::Column(ColumnarColumn column) const
+{
+    return _columns[column];
+}
@@ -0,0 +1,168 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _COLUMNARCHUNK_H_
+#define _COLUMNARCHUNK_H_
+
+#include <filesystem>
+#include <vector>
+#include <array>
+#include <memory>
+#include <cstdint>
+
+#include "Network.h"
+#include "Game.h"
+#include "SavedGame.h"
+#include "Platform.h"
+
+namespace message {
+    class Example;
+}
+
+// Columns hold the same features as TFRecord chunks (see "Storage::PopulateGame"), with the same types and value mapping,
+// but flattened across all games in the chunk, so that a game or position can be read without parsing anything.
+enum ColumnarColumn
+{
+    ColumnarColumn_GamePositionOffsets, // int64[gameCount + 1], into per-position columns
+    ColumnarColumn_Result, // float[gameCount]
+    ColumnarColumn_MctsValues, // float[positionCount]
+    ColumnarColumn_ImagePiecesAuxiliary, // int64[positionCount][InputPieceAndRepetitionPlanesPerPosition + InputAuxiliaryPlaneCount]
+    ColumnarColumn_PolicyRowLengths, // int64[positionCount]
+    ColumnarColumn_PolicyOffsets, // int64[positionCount + 1], into policy columns (CSR row pointers)
+    ColumnarColumn_PolicyIndices, // int64[policyCount]
+    ColumnarColumn_PolicyValues, // float[policyCount]
+
+    ColumnarColumn_Count,
+};
+constexpr const char* ColumnarColumnNames[ColumnarColumn_Count] = { "game_position_offsets", "result", "mcts_values",
+    "image_pieces_auxiliary", "policy_row_lengths", "policy_offsets", "policy_indices", "policy_values" };
+
+enum ColumnarCompression
+{
+    ColumnarCompression_None,
+    ColumnarCompression_Zlib,
+};
+
+struct ColumnarColumnInfo
+{
+    uint64_t offset;
+    uint64_t storedBytes;
+    uint64_t rawBytes;
+    uint32_t compression;
+    uint32_t reserved;
+};
+
+// Columnar chunks are this header, padded, followed by each column in "ColumnarColumn" order, each starting on a
+// "ColumnAlignment" boundary. Columns are stored raw, so that they can be used in place from a mapping, or optionally
+// zlib-compressed as a single block each, in which case readers inflate them on open. The game index is never compressed.
+struct ColumnarChunkHeader
+{
+    static constexpr const uint32_t Magic = 0x4C4F4343; // "CCOL"
+    static constexpr const uint32_t Version = 1;
+    static constexpr const int PaddedBytes = 4096;
+    static constexpr const int ColumnAlignment = 64;
+
+    uint32_t magic;
+    uint32_t version;
+    int32_t columnCount;
+    int32_t imagePiecesAuxiliaryStride;
+    int64_t gameCount;
+    int64_t positionCount;
+    int64_t policyCount;
+    ColumnarColumnInfo columns[ColumnarColumn_Count];
+};
+static_assert(sizeof(ColumnarChunkHeader) <= ColumnarChunkHeader::PaddedBytes);
+
+// Builds up columns game-by-game, then writes them out as a columnar chunk.
+class ColumnarChunkWriter
+{
+public:
+
+    ColumnarChunkWriter();
+
+    void AddGame(Game scratchGame, const SavedGame& game);
+    void AddGame(const message::Example& example);
+    void Write(const std::filesystem::path& path, bool compress) const;
+    void Clear();
+
+    int GameCount() const;
+
+    // Columns so far, named like "ColumnarChunk" so that either can be read in place.
+    const int64_t* GamePositionOffsets() const;
+    const float* Result() const;
+    const float* MctsValues() const;
+    const INetwork::PackedPlane* ImagePiecesAuxiliary() const;
+    const int64_t* PolicyRowLengths() const;
+    const int64_t* PolicyOffsets() const;
+    const int64_t* PolicyIndices() const;
+    const float* PolicyValues() const;
+
+private:
+
+    void FinishGame();
+
+private:
+
+    std::vector<int64_t> _gamePositionOffsets;
+    std::vector<float> _result;
+    std::vector<float> _mctsValues;
+    std::vector<INetwork::PackedPlane> _imagePiecesAuxiliary;
+    std::vector<int64_t> _policyRowLengths;
+    std::vector<int64_t> _policyOffsets;
+    std::vector<int64_t> _policyIndices;
+    std::vector<float> _policyValues;
+};
+
+// Maps a columnar chunk for random access to games and positions.
+class ColumnarChunk
+{
+public:
+
+    static constexpr const char Extension[] = ".colchunk";
+
+public:
+
+    ColumnarChunk(const std::filesystem::path& path);
+
+    int GameCount() const;
+    int64_t PositionCount() const;
+    int64_t PolicyCount() const;
+    int64_t GamePositionStart(int gameIndex) const;
+    int GamePositionCount(int gameIndex) const;
+
+    const int64_t* GamePositionOffsets() const;
+    const float* Result() const;
+    const float* MctsValues() const;
+    const INetwork::PackedPlane* ImagePiecesAuxiliary() const;
+    const int64_t* PolicyRowLengths() const;
+    const int64_t* PolicyOffsets() const;
+    const int64_t* PolicyIndices() const;
+    const float* PolicyValues() const;
+
+private:
+
+    const void* Column(ColumnarColumn column) const;
+
+private:
+
+    std::filesystem::path _path;
+    std::unique_ptr<MemoryMappedFile> _mapping;
+    ColumnarChunkHeader _header;
+    std::array<std::vector<uint8_t>, ColumnarColumn_Count> _inflated;
+    std::array<const uint8_t*, ColumnarColumn_Count> _columns;
+};
+
+#endif // _COLUMNARCHUNK_H_
@@ -324,6 +324,7 @@ void ParseSelfPlay(SelfPlayConfig& selfPlay, const TomlValue& config, const Poli
 
     policy.template Parse<int>(selfPlay.NumWorkers, config, "num_workers");
     policy.template Parse<int>(selfPlay.PredictionBatchSize, config, "prediction_batch_size");
+    policy.template Parse<int>(selfPlay.PredictionPipelineDepth, config, "prediction_pipeline_depth");
 
     policy.template Parse<int>(selfPlay.NumSampingMoves, config, "num_sampling_moves");
     policy.template Parse<int>(selfPlay.MaxMoves, config, "max_moves");
@@ -356,9 +357,28 @@ void ParseSelfPlay(SelfPlayConfig& selfPlay, const TomlValue& config, const Poli
 template <typename Policy>
 void ParseMisc(MiscConfig& misc, const TomlValue& config, const Policy& policy)
 {
+    const auto& inference = toml::find_or(config, "inference", {});
+    policy.template Parse<std::string>(misc.Inference_Backend, inference, "inference_backend");
+    policy.template Parse<std::string>(misc.Inference_NativeWeights, inference, "native_weights");
+    policy.template Parse<bool>(misc.Inference_BatchingServer, inference, "batching_server");
+    policy.template Parse<int>(misc.Inference_BatchingThreads, inference, "batching_threads");
+    policy.template Parse<int>(misc.Inference_BatchingMaxBatchSize, inference, "batching_max_batch_size");
+    policy.template Parse<int>(misc.Inference_BatchingMaxLatencyMicroseconds, inference, "batching_max_latency_microseconds");
+    policy.template Parse<int>(misc.Inference_FakeLatencyMicroseconds, inference, "fake_latency_microseconds");
+    policy.template Parse<int>(misc.Inference_FakeMicrosecondsPerPosition, inference, "fake_microseconds_per_position");
+    policy.template Parse<bool>(misc.Inference_FakePython, inference, "fake_python");
+
     const auto& predictionCache = toml::find_or(config, "prediction_cache", {});
     policy.template Parse<int>(misc.PredictionCache_SizeMebibytes, predictionCache, "Hash");
     policy.template Parse<int>(misc.PredictionCache_MaxPly, predictionCache, "max_ply");
+    policy.template Parse<int>(misc.PredictionCache_Associativity, predictionCache, "associativity");
+    policy.template Parse<int>(misc.PredictionCache_EntryBytes, predictionCache, "entry_bytes");
+    policy.template Parse<bool>(misc.PredictionCache_Persistent, predictionCache, "persistent");
+    policy.template Parse<std::string>(misc.PredictionCache_PersistentDirectory, predictionCache, "persistent_directory");
+
+    const auto& nodeArena = toml::find_or(config, "node_arena", {});
+    policy.template Parse<bool>(misc.NodeArena_BackgroundReclaim, nodeArena, "background_reclaim");
+    policy.template Parse<int>(misc.NodeArena_ReclaimArraysPerMillisecond, nodeArena, "reclaim_arrays_per_millisecond");
 
     const auto& timeControl = toml::find_or(config, "time_control", {});
     policy.template Parse<int>(misc.TimeControl_SafetyBufferMoveMilliseconds, timeControl, "safety_buffer_move_milliseconds");
@@ -369,10 +389,16 @@ void ParseMisc(MiscConfig& misc, const TomlValue& config, const Policy& policy)
     const auto& search = toml::find_or(config, "search", {});
     policy.template Parse<int>(misc.Search_SearchThreads, search, "search_threads");
     policy.template Parse<int>(misc.Search_SearchParallelism, search, "search_parallelism");
+    policy.template Parse<int>(misc.Search_PipelineDepth, search, "search_pipeline_depth");
     policy.template Parse<int>(misc.Search_SlowstartNodes, search, "slowstart_nodes");
     policy.template Parse<int>(misc.Search_SlowstartThreads, search, "slowstart_threads");
     policy.template Parse<int>(misc.Search_SlowstartParallelism, search, "slowstart_parallelism");
     policy.template Parse<int>(misc.Search_GuiUpdateIntervalNodes, search, "gui_update_interval_nodes");
+    policy.template Parse<int>(misc.Search_TreeBudgetMebibytes, search, "tree_budget_mebibytes");
+    policy.template Parse<bool>(misc.Search_Transpositions, search, "transpositions");
+    policy.template Parse<int>(misc.Search_MultiPv, search, "MultiPV");
+    policy.template Parse<int>(misc.Search_StrengthTestConcurrency, search, "strength_test_concurrency");
+    policy.template Parse<int>(misc.Search_StrengthTestNodes, search, "strength_test_nodes");
 
     const auto& bot = toml::find_or(config, "bot", {});
     policy.template Parse<int>(misc.Bot_CommentaryMinimumRemainingMilliseconds, bot, "commentary_minimum_remaining_milliseconds");
@@ -383,6 +409,15 @@ void ParseMisc(MiscConfig& misc, const TomlValue& config, const Policy& policy)
 
     const auto& storage = toml::find_or(config, "storage", {});
     policy.template Parse<int>(misc.Storage_GamesPerChunk, storage, "games_per_chunk");
+    policy.template Parse<int>(misc.Storage_ChunkCompressionThreads, storage, "chunk_compression_threads");
+
+    const auto& instrumentation = toml::find_or(config, "instrumentation", {});
+    policy.template Parse<bool>(misc.Instrumentation_Enabled, instrumentation, "enabled");
+    policy.template Parse<bool>(misc.Instrumentation_PerNode, instrumentation, "per_node");
+    policy.template Parse<int>(misc.Instrumentation_LogIntervalSeconds, instrumentation, "log_interval_seconds");
+    policy.template Parse<bool>(misc.Instrumentation_Trace, instrumentation, "trace");
+    policy.template Parse<int>(misc.Instrumentation_TraceEventsPerThread, instrumentation, "trace_events_per_thread");
+    policy.template Parse<std::string>(misc.Instrumentation_TracePath, instrumentation, "trace_path");
 
     const auto& paths = toml::find_or(config, "paths", {});
     policy.template Parse<std::string>(misc.Paths_Networks, paths, "networks");
@@ -99,6 +99,7 @@ struct SelfPlayConfig
 
     int NumWorkers;
     int PredictionBatchSize;
+    int PredictionPipelineDepth;
 
     int NumSampingMoves;
     int MaxMoves;
@@ -145,9 +146,28 @@ struct UciOptionConfig
 
 struct MiscConfig
 {
+    // Inference
+    std::string Inference_Backend;
+    std::string Inference_NativeWeights;
+    bool Inference_BatchingServer;
+    int Inference_BatchingThreads;
+    int Inference_BatchingMaxBatchSize;
+    int Inference_BatchingMaxLatencyMicroseconds;
+    int Inference_FakeLatencyMicroseconds;
+    int Inference_FakeMicrosecondsPerPosition;
+    bool Inference_FakePython;
+
     // Prediction cache
     int PredictionCache_SizeMebibytes;
     int PredictionCache_MaxPly;
+    int PredictionCache_Associativity;
+    int PredictionCache_EntryBytes;
+    bool PredictionCache_Persistent;
+    std::string PredictionCache_PersistentDirectory;
+
+    // Node arena
+    bool NodeArena_BackgroundReclaim;
+    int NodeArena_ReclaimArraysPerMillisecond;
 
     // Time control
     int TimeControl_SafetyBufferMoveMilliseconds;
@@ -158,10 +178,16 @@ struct MiscConfig
     // Search
     int Search_SearchThreads;
     int Search_SearchParallelism;
+    int Search_PipelineDepth;
     int Search_SlowstartNodes;
     int Search_SlowstartThreads;
     int Search_SlowstartParallelism;
     int Search_GuiUpdateIntervalNodes;
+    int Search_TreeBudgetMebibytes;
+    bool Search_Transpositions;
+    int Search_MultiPv;
+    int Search_StrengthTestConcurrency;
+    int Search_StrengthTestNodes;
 
     // Bot
     int Bot_CommentaryMinimumRemainingMilliseconds;
@@ -172,6 +198,14 @@ struct MiscConfig
 
     // Storage
     int Storage_GamesPerChunk;
+    int Storage_ChunkCompressionThreads;
+
+    bool Instrumentation_Enabled;
+    bool Instrumentation_PerNode;
+    int Instrumentation_LogIntervalSeconds;
+    bool Instrumentation_Trace;
+    int Instrumentation_TraceEventsPerThread;
+    std::string Instrumentation_TracePath;
     
     // Paths
     std::string Paths_Networks;
@@ -0,0 +1,300 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include "FakeNetwork.h"
+
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+
+#include "Platform.h"
+
+// See "splitmix64" (Vigna).
+static uint64_t SplitMix64(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = ((z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL);
+    z = ((z ^ (z >> 27)) * 0x94D049BB133111EBULL);
+    return (z ^ (z >> 31));
+}
+
+// Maps the top 24 bits to [0, 1).
+static float UnitFloat(uint64_t bits)
+{
+    return (static_cast<float>(bits >> 40) / static_cast<float>(1 << 24));
+}
+
+static std::filesystem::path LocalPath(const std::string& relativePath)
+{
+    return (Platform::UserDataPath() / relativePath);
+}
+
+// Values avoid the extremes, like a real network, and logits spread priors out without being degenerate.
+void FakeNetwork::Predict(const InputPlanes& image, float& value, OutputPlanes& policy)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const PackedPlane plane : image)
+    {
+        hash = ((hash ^ plane) * 0x100000001B3ULL);
+    }
+
+    value = (0.05f + 0.9f * UnitFloat(SplitMix64(hash)));
+
+    float* logits = reinterpret_cast<float*>(policy.data());
+    for (int i = 0; i < OutputPlanesFloatCount; i++)
+    {
+        logits[i] = (4.f * UnitFloat(SplitMix64(hash)) - 2.f);
+    }
+}
+
+FakeNetwork::FakeNetwork(INetwork* fallback, const FakeNetworkOptions& options)
+    : _fallback(fallback)
+    , _options(options)
+    , _stepCounts{}
+    , _swaStepCounts{}
+    , _trainingChunkCount(0)
+{
+    // Pick up chunks saved by earlier runs, like the Python side counting files under "games_path_training".
+    if (!_fallback)
+    {
+        const std::filesystem::path trainingPath = LocalPath(Config::Network.Training.GamesPathTraining);
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(trainingPath, error))
+        {
+            if (entry.path().extension() == ".chunk")
+            {
+                _trainingChunkCount++;
+            }
+        }
+    }
+}
+
+FakeNetwork::~FakeNetwork()
+{
+}
+
+PredictionStatus FakeNetwork::PredictBatch(NetworkType /* networkType */, int batchSize, InputPlanes* images, float* values, OutputPlanes* policies)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < batchSize; i++)
+    {
+        Predict(images[i], values[i], policies[i]);
+    }
+
+    // Stand in for accelerator time, counting the (small) time already spent predicting.
+    const int64_t costMicroseconds = (_options.latencyMicroseconds + static_cast<int64_t>(batchSize) * _options.microsecondsPerPosition);
+    if (costMicroseconds > 0)
+    {
+        std::this_thread::sleep_until(start + std::chrono::microseconds(costMicroseconds));
+    }
+
+    return PredictionStatus_None;
+}
+
+INetwork& FakeNetwork::Fallback()
+{
+    if (!_fallback)
+    {
+        throw ChessCoachException("Fake network doesn't support this without a fallback network");
+    }
+    return *_fallback;
+}
+
+std::vector<std::string> FakeNetwork::PredictCommentaryBatch(int batchSize, CommentaryInputPlanes* images)
+{
+    return Fallback().PredictCommentaryBatch(batchSize, images);
+}
+
+void FakeNetwork::Train(NetworkType networkType, int step, int checkpoint)
+{
+    if (_fallback)
+    {
+        _fallback->Train(networkType, step, checkpoint);
+    }
+}
+
+void FakeNetwork::TrainCommentary(int step, int checkpoint)
+{
+    if (_fallback)
+    {
+        _fallback->TrainCommentary(step, checkpoint);
+    }
+}
+
+void FakeNetwork::LogScalars(NetworkType networkType, int step, const std::vector<std::string> names, float* values)
+{
+    if (_fallback)
+    {
+        _fallback->LogScalars(networkType, step, names, values);
+    }
+}
+
+void FakeNetwork::SaveNetwork(NetworkType networkType, int checkpoint)
+{
+    if (_fallback)
+    {
+        _fallback->SaveNetwork(networkType, checkpoint);
+        return;
+    }
+
+    std::lock_guard lock(_mutex);
+    _stepCounts[networkType] = checkpoint;
+}
+
+void FakeNetwork::SaveSwaNetwork(NetworkType networkType, int checkpoint)
+{
+    if (_fallback)
+    {
+        _fallback->SaveSwaNetwork(networkType, checkpoint);
+        return;
+    }
+
+    std::lock_guard lock(_mutex);
+    _swaStepCounts[networkType] = checkpoint;
+}
+
+void FakeNetwork::UpdateNetworkWeights(const std::string& networkWeights)
+{
+    if (_fallback)
+    {
+        _fallback->UpdateNetworkWeights(networkWeights);
+    }
+}
+
+void FakeNetwork::GetNetworkInfo(NetworkType networkType, int* stepCountOut, int* swaStepCountOut, int* trainingChunkCountOut, std::string* relativePathOut)
+{
+    if (_fallback)
+    {
+        _fallback->GetNetworkInfo(networkType, stepCountOut, swaStepCountOut, trainingChunkCountOut, relativePathOut);
+        return;
+    }
+
+    std::lock_guard lock(_mutex);
+    if (stepCountOut)
+    {
+        *stepCountOut = _stepCounts[networkType];
+    }
+    if (swaStepCountOut)
+    {
+        *swaStepCountOut = _swaStepCounts[networkType];
+    }
+    if (trainingChunkCountOut)
+    {
+        *trainingChunkCountOut = _trainingChunkCount;
+    }
+    if (relativePathOut)
+    {
+        // Match "make_model_path" in config.py, or no path before saving.
+        relativePathOut->clear();
+        if (_stepCounts[networkType] > 0)
+        {
+            std::stringstream relativePath;
+            relativePath << Config::Misc.Paths_Networks << "/" << Config::Network.Name << "_" << std::setfill('0') << std::setw(9) << _stepCounts[networkType];
+            *relativePathOut = relativePath.str();
+        }
+    }
+}
+
+void FakeNetwork::SaveFile(const std::string& relativePath, const std::string& data)
+{
+    if (_fallback)
+    {
+        _fallback->SaveFile(relativePath, data);
+        return;
+    }
+
+    const std::filesystem::path path = LocalPath(relativePath);
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+    if (!file)
+    {
+        throw ChessCoachException("Failed to save file: " + path.string());
+    }
+
+    // Chunks only come from the chunk writer, so this counts training chunks for this run.
+    if (path.extension() == ".chunk")
+    {
+        _trainingChunkCount++;
+    }
+}
+
+std::string FakeNetwork::LoadFile(const std::string& relativePath)
+{
+    if (_fallback)
+    {
+        return _fallback->LoadFile(relativePath);
+    }
+
+    const std::filesystem::path path = LocalPath(relativePath);
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file)
+    {
+        throw ChessCoachException("Failed to load file: " + path.string());
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+bool FakeNetwork::FileExists(const std::string& relativePath)
+{
+    if (_fallback)
+    {
+        return _fallback->FileExists(relativePath);
+    }
+
+    return std::filesystem::exists(LocalPath(relativePath));
+}
+
+void FakeNetwork::LaunchGui(const std::string& mode)
+{
+    Fallback().LaunchGui(mode);
+}
+
+void FakeNetwork::UpdateGui(const std::string& fen, const std::string& line, int nodeCount, const std::string& evaluation, const std::string& principalVariation,
+    const std::vector<std::string>& sans, const std::vector<std::string>& froms, const std::vector<std::string>& tos, std::vector<float>& targets,
+    std::vector<float>& priors, std::vector<float>& values, std::vector<float>& puct, std::vector<int>& visits, std::vector<int>& weights)
+{
+    Fallback().UpdateGui(fen, line, nodeCount, evaluation, principalVariation, sans, froms, tos, targets, priors, values, puct, visits, weights);
+}
+
+void FakeNetwork::DebugDecompress(int positionCount, int policySize, float* result, int64_t* imagePiecesAuxiliary,
+    int64_t* policyRowLengths, int64_t* policyIndices, float* policyValues, int decompressPositionsModulus,
+    InputPlanes* imagesOut, float* valuesOut, OutputPlanes* policiesOut)
+{
+    Fallback().DebugDecompress(positionCount, policySize, result, imagePiecesAuxiliary, policyRowLengths, policyIndices, policyValues,
+        decompressPositionsModulus, imagesOut, valuesOut, policiesOut);
+}
+
+void FakeNetwork::OptimizeParameters()
+{
+    Fallback().OptimizeParameters();
+}
+
+void FakeNetwork::RunBot()
+{
+    Fallback().RunBot();
+}
+
+void FakeNetwork::PlayBotMove(const std::string& gameId, const std::string& move)
+{
+    Fallback().PlayBotMove(gameId, move);
+}
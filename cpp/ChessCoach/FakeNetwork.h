@@ -0,0 +1,89 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _FAKENETWORK_H_
+#define _FAKENETWORK_H_
+
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include "Network.h"
+
+struct FakeNetworkOptions
+{
+    int latencyMicroseconds;
+    int microsecondsPerPosition;
+};
+
+// Predicts deterministic pseudo-random values and policy logits from a hash of each position's image, so that
+// the whole CPU pipeline (batching, caching, tree, storage) can be profiled and tested without TensorFlow.
+// Each batch sleeps for a fixed latency plus a per-position cost, standing in for GPU/TPU time.
+//
+// Everything else is forwarded to the wrapped network if provided. Otherwise, files are local (rooted at the
+// user data directory), training and saving networks only advance step counts, chunks saved are counted as
+// training chunks, and GUI, bot, commentary and optimization aren't supported.
+class FakeNetwork : public INetwork
+{
+public:
+
+    static void Predict(const InputPlanes& image, float& value, OutputPlanes& policy);
+
+public:
+
+    FakeNetwork(INetwork* fallback, const FakeNetworkOptions& options);
+    virtual ~FakeNetwork();
+
+    virtual PredictionStatus PredictBatch(NetworkType networkType, int batchSize, InputPlanes* images, float* values, OutputPlanes* policies);
+    virtual std::vector<std::string> PredictCommentaryBatch(int batchSize, CommentaryInputPlanes* images);
+    virtual void Train(NetworkType networkType, int step, int checkpoint);
+    virtual void TrainCommentary(int step, int checkpoint);
+    virtual void LogScalars(NetworkType networkType, int step, const std::vector<std::string> names, float* values);
+    virtual void SaveNetwork(NetworkType networkType, int checkpoint);
+    virtual void SaveSwaNetwork(NetworkType networkType, int checkpoint);
+    virtual void UpdateNetworkWeights(const std::string& networkWeights);
+    virtual void GetNetworkInfo(NetworkType networkType, int* stepCountOut, int* swaStepCountOut, int* trainingChunkCountOut, std::string* relativePathOut);
+    virtual void SaveFile(const std::string& relativePath, const std::string& data);
+    virtual std::string LoadFile(const std::string& relativePath);
+    virtual bool FileExists(const std::string& relativePath);
+    virtual void LaunchGui(const std::string& mode);
+    virtual void UpdateGui(const std::string& fen, const std::string& line, int nodeCount, const std::string& evaluation, const std::string& principalVariation,
+        const std::vector<std::string>& sans, const std::vector<std::string>& froms, const std::vector<std::string>& tos, std::vector<float>& targets,
+        std::vector<float>& priors, std::vector<float>& values, std::vector<float>& puct, std::vector<int>& visits, std::vector<int>& weights);
+    virtual void DebugDecompress(int positionCount, int policySize, float* result, int64_t* imagePiecesAuxiliary,
+        int64_t* policyRowLengths, int64_t* policyIndices, float* policyValues, int decompressPositionsModulus,
+        InputPlanes* imagesOut, float* valuesOut, OutputPlanes* policiesOut);
+    virtual void OptimizeParameters();
+    virtual void RunBot();
+    virtual void PlayBotMove(const std::string& gameId, const std::string& move);
+
+private:
+
+    INetwork& Fallback();
+
+private:
+
+    std::unique_ptr<INetwork> _fallback;
+    FakeNetworkOptions _options;
+
+    // Only used without a fallback network.
+    std::mutex _mutex;
+    int _stepCounts[NetworkType_Count];
+    int _swaStepCounts[NetworkType_Count];
+    std::atomic_int _trainingChunkCount;
+};
+
+#endif // _FAKENETWORK_H_
@@ -84,16 +84,20 @@ Game::Game()
     : _parentState(nullptr)
     , _currentState(AllocateState())
     , _moves()
+    , _history{}
 {
     _position.set(StartingPosition, false /* isChess960 */, _currentState, Threads.main());
+    RecordHistoryPosition();
 }
 
 Game::Game(const std::string& fen, const std::vector<Move>& moves)
     : _parentState(nullptr)
     , _currentState(AllocateState())
     , _moves() // Built up in each ApplyMove below
+    , _history{}
 {
     _position.set(fen, false /* isChess960 */, _currentState, Threads.main());
+    RecordHistoryPosition();
 
     for (Move move : moves)
     {
@@ -106,6 +110,8 @@ Game::Game(const Game& other)
     , _parentState(other._currentState) // Don't delete the parent game's states.
     , _currentState(other._currentState)
     , _moves(other._moves)
+    , _history(other._history)
+    , _historyUndo() // Can't undo past the copy.
 {
     assert(&other != this);
 }
@@ -121,6 +127,8 @@ Game& Game::operator=(const Game& other)
     _parentState = other._currentState; // Don't delete the parent game's states.
     _currentState = other._currentState;
     _moves = other._moves;
+    _history = other._history;
+    _historyUndo.clear(); // Can't undo past the copy, but keep capacity for scratch games.
 
     return *this;
 }
@@ -130,6 +138,8 @@ Game::Game(Game&& other) noexcept
     , _parentState(other._parentState)
     , _currentState(other._currentState)
     , _moves(std::move(other._moves))
+    , _history(other._history)
+    , _historyUndo(std::move(other._historyUndo))
 {
     other._parentState = nullptr;
     other._currentState = nullptr;
@@ -148,6 +158,8 @@ Game& Game::operator=(Game&& other) noexcept
     _parentState = other._parentState;
     _currentState = other._currentState;
     _moves = std::move(other._moves);
+    _history = other._history;
+    _historyUndo = std::move(other._historyUndo);
 
     other._parentState = nullptr;
     other._currentState = nullptr;
@@ -176,6 +188,7 @@ void Game::ApplyMove(Move move)
     _moves.push_back(move);
     _currentState = AllocateState();
     _position.do_move(move, *_currentState);
+    RecordHistoryPosition();
 }
 
 void Game::ApplyMoveMaybeNull(Move move)
@@ -190,6 +203,37 @@ void Game::ApplyMoveMaybeNull(Move move)
     {
         _position.do_null_move(*_currentState);
     }
+    RecordHistoryPosition();
+}
+
+// Undoes the latest move, including null moves, so that scratch games can walk back through a search tree
+// rather than being copied again. Only moves applied since this game was copied can be undone, since earlier
+// states belong to the parent game.
+void Game::UndoMove()
+{
+    assert(_parentState);
+    assert(_currentState != _parentState);
+    assert(!_moves.empty());
+    assert(!_historyUndo.empty());
+
+    const Move move = _moves.back();
+    if (move != MOVE_NULL)
+    {
+        _position.undo_move(move);
+    }
+    else
+    {
+        _position.undo_null_move();
+    }
+
+    StateInfo* free = _currentState;
+    _currentState = _currentState->previous;
+    assert(_currentState == _position.state_info());
+    FreeState(free);
+
+    _history[_moves.size() & (HistoryPositionCount - 1)] = _historyUndo.back();
+    _historyUndo.pop_back();
+    _moves.pop_back();
 }
 
 Move Game::ApplyMoveInfer(const INetwork::PackedPlane* resultingPieces)
@@ -336,7 +380,7 @@ Key Game::GenerateImageKey(bool tryHard)
         // It's possible that it would also be better to include less or no history in self-play mode, but this would
         // require too much end-to-end testing for our current scope (i.e. from scratch with fresh data each time),
         // so err on the proven side.
-        return (_position.key() ^ ((_position.state_info()->repetition != 0) ? PredictionCache_IsRepetition : 0)) ^
+        return HistoryKey(_position) ^
             (_position.rule50_count() >= Config::Network.SelfPlay.TranspositionProgressThreshold
                 ? PredictionCache_NoProgressCount[std::min(NoProgressSaturationCount, _position.rule50_count())] : 0);
     }
@@ -352,18 +396,39 @@ Key Game::GenerateImageKey(bool tryHard)
         // Add last 7 positions + 1 current position.
         // If there are fewer, no need to synthesize/saturate, since we're just differentating
         // positions/histories, not feeding planes into a neural network, so just stop rotating/hashing.
-        const int historyPositionCount = std::min(INetwork::InputPreviousPositionCount + 0, static_cast<int>(_moves.size()));
-        HistoryWalker<INetwork::InputPreviousPositionCount> history(this, historyPositionCount);
-        int rotation = 0;
-        while (history.Next())
+        const int moveCount = static_cast<int>(_moves.size());
+        const int historyPositionCount = std::min(INetwork::InputPreviousPositionCount + 0, moveCount);
+        for (int rotation = 0; rotation <= historyPositionCount; rotation++)
         {
-            key ^= Rotate(_position.key() ^ ((_position.state_info()->repetition != 0) ? PredictionCache_IsRepetition : 0), rotation++);
+            key ^= Rotate(HistoryAt(moveCount - historyPositionCount + rotation).key, rotation);
         }
 
         return key;
     }
 }
 
+// Generates the same key as "GenerateImageKey" by undoing and redoing history moves on the Position,
+// as a reference for the recorded history.
+Key Game::GenerateImageKeyReplay(bool tryHard)
+{
+    if (tryHard)
+    {
+        return GenerateImageKey(tryHard);
+    }
+
+    Key key = PredictionCache_NoProgressCount[std::min(NoProgressSaturationCount, _position.rule50_count())];
+
+    const int historyPositionCount = std::min(INetwork::InputPreviousPositionCount + 0, static_cast<int>(_moves.size()));
+    HistoryWalker<INetwork::InputPreviousPositionCount> history(this, historyPositionCount);
+    int rotation = 0;
+    while (history.Next())
+    {
+        key ^= Rotate(HistoryKey(_position), rotation++);
+    }
+
+    return key;
+}
+
 void Game::GenerateImage(INetwork::InputPlanes& imageOut)
 {
     GenerateImage(imageOut.data());
@@ -373,8 +438,39 @@ void Game::GenerateImage(INetwork::PackedPlane* imageOut)
 {
     int nextPlane = 0;
 
-    // If it's black to play, flip the board and flip colors: always from the "current player's" perspective.
-    const Color toPlay = ToPlay();
+    // Add last 7 positions' pieces and repetitions + 1 current position's pieces and repetitions, planes 0-103.
+    // If any history positions are missing, saturate at the earliest history/current position.
+    //
+    // The perspective flips every history position, even for saturated positions, ending at the current player's perspective
+    // (see "HistoryWalker::Next"). Use the recorded history positions rather than undoing and redoing moves.
+    assert(nextPlane == 0);
+    const int moveCount = static_cast<int>(_moves.size());
+    Color perspective = ((INetwork::InputPreviousPositionCount % 2) ? ~ToPlay() : ToPlay());
+    for (int i = 0; i < HistoryPositionCount; i++)
+    {
+        const int historyMoveCount = std::max(0, moveCount - INetwork::InputPreviousPositionCount + i);
+        GeneratePieceAndRepetitionPlanes(imageOut, nextPlane, HistoryAt(historyMoveCount), perspective);
+        nextPlane += INetwork::InputPieceAndRepetitionPlanesPerPosition;
+        perspective = ~perspective;
+    }
+
+    // Castling and no-progress planes 104-108
+    assert(nextPlane == 104);
+    GenerateAuxiliaryPlanes(imageOut, nextPlane);
+    nextPlane += INetwork::InputAuxiliaryPlaneCount;
+
+    static_assert(INetwork::InputPreviousPositionCount == 7);
+    static_assert(INetwork::InputPieceAndRepetitionPlanesPerPosition == 13);
+    static_assert(INetwork::InputAuxiliaryPlaneCount == 5);
+    static_assert(INetwork::InputPlaneCount == 109);
+    assert(nextPlane == INetwork::InputPlaneCount);
+}
+
+// Generates the same image as "GenerateImage" by undoing and redoing history moves on the Position. This is needed
+// when the Position itself has been walked back (see "GenerateCommentaryImage"), and is a reference for the recorded history.
+void Game::GenerateImageReplay(INetwork::PackedPlane* imageOut)
+{
+    int nextPlane = 0;
 
     // Add last 7 positions' pieces and repetitions + 1 current position's pieces and repetitions, planes 0-103.
     // If any history positions are missing, saturate at the earliest history/current position.
@@ -386,24 +482,31 @@ void Game::GenerateImage(INetwork::PackedPlane* imageOut)
         nextPlane += INetwork::InputPieceAndRepetitionPlanesPerPosition;
     }
 
-    // Castling planes 104-107
+    // Castling and no-progress planes 104-108
     assert(nextPlane == 104);
-    FillPlane(imageOut[nextPlane++], _position.can_castle(toPlay & KING_SIDE));
-    FillPlane(imageOut[nextPlane++], _position.can_castle(toPlay & QUEEN_SIDE));
-    FillPlane(imageOut[nextPlane++], _position.can_castle(~toPlay & KING_SIDE));
-    FillPlane(imageOut[nextPlane++], _position.can_castle(~toPlay & QUEEN_SIDE));
+    GenerateAuxiliaryPlanes(imageOut, nextPlane);
+    nextPlane += INetwork::InputAuxiliaryPlaneCount;
+
+    assert(nextPlane == INetwork::InputPlaneCount);
+}
+
+void Game::GenerateAuxiliaryPlanes(INetwork::PackedPlane* imageOut, int planeOffset) const
+{
+    // If it's black to play, flip the board and flip colors: always from the "current player's" perspective.
+    const Color toPlay = ToPlay();
+
+    // Castling planes 104-107
+    FillPlane(imageOut[planeOffset + 0], _position.can_castle(toPlay & KING_SIDE));
+    FillPlane(imageOut[planeOffset + 1], _position.can_castle(toPlay & QUEEN_SIDE));
+    FillPlane(imageOut[planeOffset + 2], _position.can_castle(~toPlay & KING_SIDE));
+    FillPlane(imageOut[planeOffset + 3], _position.can_castle(~toPlay & QUEEN_SIDE));
 
     // No-progress plane 108
     // This is a special case, not to be bit-unpacked, but instead interpreted as an integer
     // to be normalized via the no-progress saturation count (99).
-    assert(nextPlane == 108);
-    imageOut[nextPlane++] = _position.rule50_count();
+    imageOut[planeOffset + 4] = _position.rule50_count();
 
-    static_assert(INetwork::InputPreviousPositionCount == 7);
-    static_assert(INetwork::InputPieceAndRepetitionPlanesPerPosition == 13);
     static_assert(INetwork::InputAuxiliaryPlaneCount == 5);
-    static_assert(INetwork::InputPlaneCount == 109);
-    assert(nextPlane == INetwork::InputPlaneCount);
 }
 
 void Game::GenerateImageCompressed(INetwork::PackedPlane* piecesOut, INetwork::PackedPlane* auxiliaryOut) const
@@ -417,17 +520,10 @@ void Game::GenerateImageCompressed(INetwork::PackedPlane* piecesOut, INetwork::P
     GeneratePieceAndRepetitionPlanes(piecesOut, nextPieces, _position, toPlay);
     nextPieces += INetwork::InputPieceAndRepetitionPlanesPerPosition;
 
-    // Castling planes 104-107
+    // Castling and no-progress planes 104-108
     int nextAuxiliary = 0;
-    FillPlane(auxiliaryOut[nextAuxiliary++], _position.can_castle(toPlay & KING_SIDE));
-    FillPlane(auxiliaryOut[nextAuxiliary++], _position.can_castle(toPlay & QUEEN_SIDE));
-    FillPlane(auxiliaryOut[nextAuxiliary++], _position.can_castle(~toPlay & KING_SIDE));
-    FillPlane(auxiliaryOut[nextAuxiliary++], _position.can_castle(~toPlay & QUEEN_SIDE));
-
-    // No-progress plane 108
-    // This is a special case, not to be bit-unpacked, but instead interpreted as an integer
-    // to be normalized via the no-progress saturation count (99).
-    auxiliaryOut[nextAuxiliary++] = _position.rule50_count();
+    GenerateAuxiliaryPlanes(auxiliaryOut, nextAuxiliary);
+    nextAuxiliary += INetwork::InputAuxiliaryPlaneCount;
 
     assert(nextPieces == INetwork::InputPieceAndRepetitionPlanesPerPosition);
     assert(nextAuxiliary == INetwork::InputAuxiliaryPlaneCount);
@@ -447,7 +543,8 @@ void Game::GenerateCommentaryImage(INetwork::PackedPlane* imageOut)
     // at the previous and current positions, but the chess-playing model only returns one value for the current position,
     // at the head of the model.
     //
-    // This is tricky: we need to nest HistoryWalker use, since "GenerateImage" uses one internally.
+    // This is tricky: we need to nest HistoryWalker use, since "GenerateImageReplay" uses one internally
+    // (the recorded history positions used by "GenerateImage" only follow the latest position).
     // - HistoryWalker refers to Game::_position->current_state() rather than Game::_currentState, which makes this work.
     // - We just need to pop the latest off Game::_moves when using the outer HistoryWalker, since the inner HistoryWalker will refer to it.
     HistoryWalker<INetwork::InputPreviousPositionCount> previousPositionOuterWalker(this, 1);
@@ -460,7 +557,7 @@ void Game::GenerateCommentaryImage(INetwork::PackedPlane* imageOut)
         latestMove = _moves.back();
         _moves.pop_back();
     }
-    GenerateImage(imageOut + 0);
+    GenerateImageReplay(imageOut + 0);
     if (latestMove != MOVE_NONE)
     {
         _moves.push_back(latestMove);
@@ -468,7 +565,7 @@ void Game::GenerateCommentaryImage(INetwork::PackedPlane* imageOut)
 
     // Write a full image for the current position.
     previousPositionOuterWalker.Next(); // Expect "true".
-    GenerateImage(imageOut + INetwork::InputPlaneCount);
+    GenerateImageReplay(imageOut + INetwork::InputPlaneCount);
     previousPositionOuterWalker.Next(); // Expect "false".
 
     // Write a plane representing the side to move. The chess-playing model doesn't need this, but the commentary decoder does
@@ -584,6 +681,39 @@ void Game::Free()
     // Nodes are freed outside of Game objects because they outlive the games through MCTS tree reuse.
 }
 
+void Game::RecordHistoryPosition()
+{
+    HistoryPosition& history = _history[_moves.size() & (HistoryPositionCount - 1)];
+
+    // Copies (e.g. scratch games) can undo moves, so keep whatever's being overwritten.
+    if (_parentState)
+    {
+        _historyUndo.push_back(history);
+    }
+
+    for (PieceType pieceType = PAWN; pieceType <= KING; ++pieceType)
+    {
+        history.byType[pieceType - PAWN] = _position.pieces(pieceType);
+    }
+    history.byColor[WHITE] = _position.pieces(WHITE);
+    history.byColor[BLACK] = _position.pieces(BLACK);
+    history.key = HistoryKey(_position);
+    history.repetition = _position.state_info()->repetition;
+}
+
+// Only valid for the latest "HistoryPositionCount" positions, up to and including the current position.
+const Game::HistoryPosition& Game::HistoryAt(int moveCount) const
+{
+    assert(moveCount <= static_cast<int>(_moves.size()));
+    assert(moveCount > (static_cast<int>(_moves.size()) - HistoryPositionCount));
+    return _history[moveCount & (HistoryPositionCount - 1)];
+}
+
+Key Game::HistoryKey(const Position& position) const
+{
+    return (position.key() ^ ((position.state_info()->repetition != 0) ? PredictionCache_IsRepetition : 0));
+}
+
 void Game::GeneratePieceAndRepetitionPlanes(INetwork::PackedPlane* imageOut, int planeOffset, const Position& position, Color perspective) const
 {
     // If it's black perspective, flip the board and flip colors.
@@ -619,6 +749,30 @@ void Game::GeneratePieceAndRepetitionPlanes(INetwork::PackedPlane* imageOut, int
     }
 }
 
+// Matches the "Position" overload above, but for a recorded history position.
+void Game::GeneratePieceAndRepetitionPlanes(INetwork::PackedPlane* imageOut, int planeOffset, const HistoryPosition& position, Color perspective) const
+{
+    for (int i = 0; i < (KING - PAWN + 1); i++)
+    {
+        imageOut[planeOffset + i] = (position.byType[i] & position.byColor[perspective]);
+        imageOut[planeOffset + (KING - PAWN + 1) + i] = (position.byType[i] & position.byColor[~perspective]);
+    }
+
+    assert(position.repetition >= 0);
+    FillPlane(imageOut[planeOffset + 12], (position.repetition != 0));
+
+    static_assert(INetwork::InputPieceAndRepetitionPlanesPerPosition == 13);
+    static_assert(INetwork::InputPiecePlanesPerPosition == (2 * (KING - PAWN + 1)));
+
+    if (perspective == BLACK)
+    {
+        for (int i = planeOffset; i < planeOffset + INetwork::InputPiecePlanesPerPosition; i++)
+        {
+            imageOut[i] = FlipBoard(imageOut[i]);
+        }
+    }
+}
+
 void Game::FillPlane(INetwork::PackedPlane& plane, bool value) const
 {
     plane = FillPlanePacked[static_cast<int>(value)];
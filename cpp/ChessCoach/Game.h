@@ -176,6 +176,7 @@ public:
     float EndgameProportion() const;
     void ApplyMove(Move move);
     void ApplyMoveMaybeNull(Move move);
+    void UndoMove();
     Move ApplyMoveInfer(const INetwork::PackedPlane* resultingPieces);
     Move ApplyMoveInfer(const std::string& resultingFen);
     Move ApplyMoveGuess(float result, const std::map<Move, float>& policy);
@@ -183,8 +184,10 @@ public:
     
     int Ply() const;
     Key GenerateImageKey(bool tryHard);
+    Key GenerateImageKeyReplay(bool tryHard);
     void GenerateImage(INetwork::InputPlanes& imageOut);
     void GenerateImage(INetwork::PackedPlane* imageOut);
+    void GenerateImageReplay(INetwork::PackedPlane* imageOut);
     void GenerateImageCompressed(INetwork::PackedPlane* piecesOut, INetwork::PackedPlane* auxiliaryOut) const;
     void GenerateCommentaryImage(INetwork::CommentaryInputPlanes& imageOut);
     void GenerateCommentaryImage(INetwork::PackedPlane* imageOut);
@@ -199,13 +202,33 @@ public:
     const std::vector<Move>& Moves() const;
     std::vector<Move>& Moves();
 
+private:
+
+    // What's needed from a position to generate its history planes and history key contribution,
+    // so that images and keys don't need to undo and redo moves on the Position ("HistoryWalker").
+    struct HistoryPosition
+    {
+        std::array<Bitboard, KING> byType; // Indexed by (PieceType - PAWN)
+        std::array<Bitboard, COLOR_NB> byColor;
+        Key key; // Includes repetition
+        int repetition;
+    };
+
+    static constexpr const int HistoryPositionCount = (INetwork::InputPreviousPositionCount + 1);
+    static_assert((HistoryPositionCount & (HistoryPositionCount - 1)) == 0);
+
 private:
 
     template <int MaxHistoryMoves>
     friend class HistoryWalker;
 
     void Free();
+    void RecordHistoryPosition();
+    const HistoryPosition& HistoryAt(int moveCount) const;
+    Key HistoryKey(const Position& position) const;
     void GeneratePieceAndRepetitionPlanes(INetwork::PackedPlane* imageOut, int planeOffset, const Position& position, Color perspective) const;
+    void GeneratePieceAndRepetitionPlanes(INetwork::PackedPlane* imageOut, int planeOffset, const HistoryPosition& position, Color perspective) const;
+    void GenerateAuxiliaryPlanes(INetwork::PackedPlane* imageOut, int planeOffset) const;
     void FillPlane(INetwork::PackedPlane& plane, bool value) const;
     Key Rotate(Key key, unsigned int distance) const;
     bool PiecesAndRepetitionsMatch(const INetwork::PackedPlane* a, const INetwork::PackedPlane* b) const;
@@ -217,6 +240,13 @@ protected:
     StateInfo* _parentState;
     StateInfo* _currentState;
     std::vector<Move> _moves;
+
+    // The last "HistoryPositionCount" positions, indexed by the number of moves played to reach them (modulo the count),
+    // recorded by "ApplyMove" and friends.
+    std::array<HistoryPosition, HistoryPositionCount> _history;
+
+    // History positions overwritten since this game was copied, so that "UndoMove" can restore them.
+    std::vector<HistoryPosition> _historyUndo;
 };
 
 template <int MaxHistoryMoves>
@@ -0,0 +1,457 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include "InferenceServer.h"
+
+#include <iostream>
+#include <algorithm>
+
+#include "Instrumentation.h"
+#include "Trace.h"
+
+InferenceQueue::InferenceQueue()
+    : _head(&_stub)
+    , _tail(&_stub)
+{
+    _stub.next.store(nullptr, std::memory_order_relaxed);
+}
+
+void InferenceQueue::Push(InferenceRequest* first, InferenceRequest* last)
+{
+    // The chain from "first" to "last" is already linked by the producer.
+    last->next.store(nullptr, std::memory_order_relaxed);
+    InferenceRequest* previous = _head.exchange(last, std::memory_order_acq_rel);
+    previous->next.store(first, std::memory_order_release);
+}
+
+InferenceRequest* InferenceQueue::Pop()
+{
+    InferenceRequest* tail = _tail;
+    InferenceRequest* next = tail->next.load(std::memory_order_acquire);
+
+    // Skip over the stub if it's at the front.
+    if (tail == &_stub)
+    {
+        if (!next)
+        {
+            return nullptr;
+        }
+        _tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next)
+    {
+        _tail = next;
+        return tail;
+    }
+
+    // A producer is partway through linking after "tail", so try again later.
+    if (tail != _head.load(std::memory_order_acquire))
+    {
+        return nullptr;
+    }
+
+    // "tail" is the last request, so re-insert the stub behind it to be able to pop it.
+    Push(&_stub, &_stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next)
+    {
+        _tail = next;
+        return tail;
+    }
+
+    return nullptr;
+}
+
+struct InferenceCompletion
+{
+    std::atomic_int remaining;
+    std::atomic_int status;
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done;
+};
+
+InferenceServer::InferenceServer(INetwork* network, int threadCount, int maxBatchSize, int maxLatencyMicroseconds)
+    : _network(network)
+    , _maxBatchSize(std::max(1, maxBatchSize))
+    , _maxLatency(std::max(0, maxLatencyMicroseconds))
+    , _shutDown(false)
+{
+    const int shardCount = std::max(1, threadCount);
+    for (int i = 0; i < shardCount; i++)
+    {
+        _shards.emplace_back(new Shard());
+    }
+    ResetStatistics();
+
+    // Start threads last, after all shards are initialized.
+    for (std::unique_ptr<Shard>& shard : _shards)
+    {
+        shard->pendingCount = 0;
+        shard->sleeping = false;
+        shard->thread = std::thread(&InferenceServer::Loop, this, std::ref(*shard));
+    }
+}
+
+InferenceServer::~InferenceServer()
+{
+    // Callers must have finished predicting by now. Server threads finish anything queued, then exit.
+    _shutDown = true;
+    for (std::unique_ptr<Shard>& shard : _shards)
+    {
+        {
+            std::lock_guard lock(shard->mutex);
+        }
+        shard->wake.notify_one();
+    }
+    for (std::unique_ptr<Shard>& shard : _shards)
+    {
+        shard->thread.join();
+    }
+}
+
+PredictionStatus InferenceServer::PredictBatch(NetworkType networkType, int batchSize, InputPlanes* images, float* values, OutputPlanes* policies)
+{
+    if (batchSize <= 0)
+    {
+        return PredictionStatus_None;
+    }
+
+    // Spread calling threads across server threads round-robin, sticking with the same one per caller.
+    static std::atomic_int NextCallerIndex(0);
+    thread_local static int CallerIndex = NextCallerIndex.fetch_add(1, std::memory_order_relaxed);
+    Shard& shard = *_shards[CallerIndex % _shards.size()];
+
+    // Requests are reused per calling thread, since this call blocks until they're all completed.
+    thread_local static std::unique_ptr<InferenceRequest[]> Requests;
+    thread_local static int RequestCapacity = 0;
+    if (RequestCapacity < batchSize)
+    {
+        Requests.reset(new InferenceRequest[batchSize]);
+        RequestCapacity = batchSize;
+    }
+
+    InferenceCompletion completion;
+    completion.remaining.store(batchSize, std::memory_order_relaxed);
+    completion.status.store(PredictionStatus_None, std::memory_order_relaxed);
+    completion.done = false;
+
+    const std::chrono::time_point<std::chrono::high_resolution_clock> now = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < batchSize; i++)
+    {
+        InferenceRequest& request = Requests[i];
+        request.next.store(((i + 1) < batchSize) ? &Requests[i + 1] : nullptr, std::memory_order_relaxed);
+        request.networkType = networkType;
+        request.image = &images[i];
+        request.value = &values[i];
+        request.policy = &policies[i];
+        request.completion = &completion;
+        request.enqueued = now;
+    }
+
+    // Publish, then wake the server thread if it's sleeping. Sequentially-consistent operations on "pendingCount"
+    // and "sleeping" guarantee that either the server sees the new requests or this thread sees it sleeping.
+    shard.queue.Push(&Requests[0], &Requests[batchSize - 1]);
+    shard.pendingCount.fetch_add(batchSize);
+    if (shard.sleeping.load())
+    {
+        std::lock_guard lock(shard.mutex);
+        shard.wake.notify_one();
+    }
+
+    std::unique_lock lock(completion.mutex);
+    while (!completion.done)
+    {
+        completion.finished.wait(lock);
+    }
+    return static_cast<PredictionStatus>(completion.status.load(std::memory_order_relaxed));
+}
+
+void InferenceServer::Loop(Shard& shard)
+{
+    Trace::SetThreadName("inference server");
+
+    std::vector<InputPlanes> images(_maxBatchSize);
+    std::vector<float> values(_maxBatchSize);
+    std::vector<OutputPlanes> policies(_maxBatchSize);
+    std::vector<InferenceRequest*> requests(_maxBatchSize);
+
+    // A request for a different network type than the batch being gathered waits for the next batch.
+    InferenceRequest* carried = nullptr;
+
+    while (true)
+    {
+        int batchSize = 0;
+        NetworkType networkType = NetworkType_Count;
+        std::chrono::time_point<std::chrono::high_resolution_clock> deadline;
+
+        // Gather a batch.
+        while (batchSize < _maxBatchSize)
+        {
+            InferenceRequest* request = carried;
+            carried = nullptr;
+            if (!request)
+            {
+                request = shard.queue.Pop();
+                if (request)
+                {
+                    shard.pendingCount.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+
+            if (request)
+            {
+                if (batchSize == 0)
+                {
+                    networkType = request->networkType;
+                    deadline = (request->enqueued + _maxLatency);
+                }
+                else if (request->networkType != networkType)
+                {
+                    carried = request;
+                    break;
+                }
+
+                images[batchSize] = *request->image;
+                requests[batchSize] = request;
+                batchSize++;
+                continue;
+            }
+
+            if ((batchSize > 0) && (std::chrono::high_resolution_clock::now() >= deadline))
+            {
+                break;
+            }
+
+            // A producer is partway through publishing, so it's worth spinning briefly.
+            if (shard.pendingCount.load() > 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (!WaitForRequests(shard, ((batchSize > 0) ? &deadline : nullptr)))
+            {
+                if (batchSize == 0)
+                {
+                    return;
+                }
+                break;
+            }
+        }
+
+        // Dispatch the batch.
+        const std::chrono::time_point<std::chrono::high_resolution_clock> dispatched = std::chrono::high_resolution_clock::now();
+        int64_t queueLatencyNanosecondsTotal = 0;
+        int64_t queueLatencyNanosecondsMax = shard.queueLatencyNanosecondsMax.load(std::memory_order_relaxed);
+        for (int i = 0; i < batchSize; i++)
+        {
+            const int64_t queueLatencyNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(dispatched - requests[i]->enqueued).count();
+            queueLatencyNanosecondsTotal += queueLatencyNanoseconds;
+            queueLatencyNanosecondsMax = std::max(queueLatencyNanosecondsMax, queueLatencyNanoseconds);
+        }
+        shard.batchCount.fetch_add(1, std::memory_order_relaxed);
+        shard.fullBatchCount.fetch_add((batchSize == _maxBatchSize) ? 1 : 0, std::memory_order_relaxed);
+        shard.predictionCount.fetch_add(batchSize, std::memory_order_relaxed);
+        shard.queueLatencyNanosecondsTotal.fetch_add(queueLatencyNanosecondsTotal, std::memory_order_relaxed);
+        shard.queueLatencyNanosecondsMax.store(queueLatencyNanosecondsMax, std::memory_order_relaxed);
+
+        const int64_t predictStart = Instrumentation::Start(InstrumentedPhase_PredictBatch);
+        const PredictionStatus status = _network->PredictBatch(networkType, batchSize, images.data(), values.data(), policies.data());
+        Instrumentation::Record(InstrumentedPhase_PredictBatch, predictStart);
+
+        for (int i = 0; i < batchSize; i++)
+        {
+            *requests[i]->value = values[i];
+            *requests[i]->policy = policies[i];
+            Complete(*requests[i], status);
+        }
+    }
+}
+
+// Returns false when shutting down with nothing left to gather.
+bool InferenceServer::WaitForRequests(Shard& shard, const std::chrono::time_point<std::chrono::high_resolution_clock>* deadline)
+{
+    std::unique_lock lock(shard.mutex);
+    shard.sleeping.store(true);
+
+    while ((shard.pendingCount.load() <= 0) && !_shutDown)
+    {
+        if (!deadline)
+        {
+            shard.wake.wait(lock);
+        }
+        else if (shard.wake.wait_until(lock, *deadline) == std::cv_status::timeout)
+        {
+            break;
+        }
+    }
+
+    shard.sleeping.store(false);
+    return (!_shutDown || (shard.pendingCount.load() > 0));
+}
+
+void InferenceServer::Complete(InferenceRequest& request, PredictionStatus status)
+{
+    // The request may be reused as soon as the caller is woken, so don't touch it after the last decrement.
+    InferenceCompletion* completion = request.completion;
+    if (status != PredictionStatus_None)
+    {
+        completion->status.fetch_or(status, std::memory_order_relaxed);
+    }
+
+    if (completion->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        // Notify while holding the lock so that the caller can't destroy the completion in between.
+        std::lock_guard lock(completion->mutex);
+        completion->done = true;
+        completion->finished.notify_one();
+    }
+}
+
+InferenceStatistics InferenceServer::Statistics() const
+{
+    InferenceStatistics statistics = {};
+    for (const std::unique_ptr<Shard>& shard : _shards)
+    {
+        statistics.batchCount += shard->batchCount.load(std::memory_order_relaxed);
+        statistics.fullBatchCount += shard->fullBatchCount.load(std::memory_order_relaxed);
+        statistics.predictionCount += shard->predictionCount.load(std::memory_order_relaxed);
+        statistics.queueLatencyNanosecondsTotal += shard->queueLatencyNanosecondsTotal.load(std::memory_order_relaxed);
+        statistics.queueLatencyNanosecondsMax = std::max(statistics.queueLatencyNanosecondsMax, shard->queueLatencyNanosecondsMax.load(std::memory_order_relaxed));
+    }
+    return statistics;
+}
+
+void InferenceServer::ResetStatistics()
+{
+    for (std::unique_ptr<Shard>& shard : _shards)
+    {
+        shard->batchCount = 0;
+        shard->fullBatchCount = 0;
+        shard->predictionCount = 0;
+        shard->queueLatencyNanosecondsTotal = 0;
+        shard->queueLatencyNanosecondsMax = 0;
+    }
+}
+
+void InferenceServer::PrintDebugInfo() const
+{
+    const InferenceStatistics statistics = Statistics();
+    const int64_t batchCount = std::max(INT64_C(1), statistics.batchCount);
+    const int64_t predictionCount = std::max(INT64_C(1), statistics.predictionCount);
+    const float averageBatchSize = (static_cast<float>(statistics.predictionCount) / batchCount);
+
+    std::cout << "Inference server batches: " << statistics.batchCount
+        << ", average batch size: " << averageBatchSize
+        << ", batch fill: " << (averageBatchSize / _maxBatchSize)
+        << ", full batches: " << (static_cast<float>(statistics.fullBatchCount) / batchCount)
+        << ", average queue latency: " << (statistics.queueLatencyNanosecondsTotal / predictionCount / 1000) << " us"
+        << ", max queue latency: " << (statistics.queueLatencyNanosecondsMax / 1000) << " us" << std::endl;
+}
+
+std::vector<std::string> InferenceServer::PredictCommentaryBatch(int batchSize, CommentaryInputPlanes* images)
+{
+    return _network->PredictCommentaryBatch(batchSize, images);
+}
+
+void InferenceServer::Train(NetworkType networkType, int step, int checkpoint)
+{
+    _network->Train(networkType, step, checkpoint);
+}
+
+void InferenceServer::TrainCommentary(int step, int checkpoint)
+{
+    _network->TrainCommentary(step, checkpoint);
+}
+
+void InferenceServer::LogScalars(NetworkType networkType, int step, const std::vector<std::string> names, float* values)
+{
+    _network->LogScalars(networkType, step, names, values);
+}
+
+void InferenceServer::SaveNetwork(NetworkType networkType, int checkpoint)
+{
+    _network->SaveNetwork(networkType, checkpoint);
+}
+
+void InferenceServer::SaveSwaNetwork(NetworkType networkType, int checkpoint)
+{
+    _network->SaveSwaNetwork(networkType, checkpoint);
+}
+
+void InferenceServer::UpdateNetworkWeights(const std::string& networkWeights)
+{
+    _network->UpdateNetworkWeights(networkWeights);
+}
+
+void InferenceServer::GetNetworkInfo(NetworkType networkType, int* stepCountOut, int* swaStepCountOut, int* trainingChunkCountOut, std::string* relativePathOut)
+{
+    _network->GetNetworkInfo(networkType, stepCountOut, swaStepCountOut, trainingChunkCountOut, relativePathOut);
+}
+
+void InferenceServer::SaveFile(const std::string& relativePath, const std::string& data)
+{
+    _network->SaveFile(relativePath, data);
+}
+
+std::string InferenceServer::LoadFile(const std::string& relativePath)
+{
+    return _network->LoadFile(relativePath);
+}
+
+bool InferenceServer::FileExists(const std::string& relativePath)
+{
+    return _network->FileExists(relativePath);
+}
+
+void InferenceServer::LaunchGui(const std::string& mode)
+{
+    _network->LaunchGui(mode);
+}
+
+void InferenceServer::UpdateGui(const std::string& fen, const std::string& line, int nodeCount, const std::string& evaluation, const std::string& principalVariation,
+    const std::vector<std::string>& sans, const std::vector<std::string>& froms, const std::vector<std::string>& tos, std::vector<float>& targets,
+    std::vector<float>& priors, std::vector<float>& values, std::vector<float>& puct, std::vector<int>& visits, std::vector<int>& weights)
+{
+    _network->UpdateGui(fen, line, nodeCount, evaluation, principalVariation, sans, froms, tos, targets, priors, values, puct, visits, weights);
+}
+
+void InferenceServer::DebugDecompress(int positionCount, int policySize, float* result, int64_t* imagePiecesAuxiliary,
+    int64_t* policyRowLengths, int64_t* policyIndices, float* policyValues, int decompressPositionsModulus,
+    InputPlanes* imagesOut, float* valuesOut, OutputPlanes* policiesOut)
+{
+    _network->DebugDecompress(positionCount, policySize, result, imagePiecesAuxiliary, policyRowLengths, policyIndices, policyValues,
+        decompressPositionsModulus, imagesOut, valuesOut, policiesOut);
+}
+
+void InferenceServer::OptimizeParameters()
+{
+    _network->OptimizeParameters();
+}
+
+void InferenceServer::RunBot()
+{
+    _network->RunBot();
+}
+
+void InferenceServer::PlayBotMove(const std::string& gameId, const std::string& move)
+{
+    _network->PlayBotMove(gameId, move);
+}
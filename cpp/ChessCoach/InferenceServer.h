@@ -0,0 +1,154 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _INFERENCESERVER_H_
+#define _INFERENCESERVER_H_
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "Network.h"
+
+struct InferenceCompletion;
+
+// A single position waiting for prediction. Requests are owned by the posting thread and linked
+// into a server queue without allocation.
+struct InferenceRequest
+{
+    std::atomic<InferenceRequest*> next;
+    NetworkType networkType;
+    INetwork::InputPlanes* image;
+    float* value;
+    INetwork::OutputPlanes* policy;
+    InferenceCompletion* completion;
+    std::chrono::time_point<std::chrono::high_resolution_clock> enqueued;
+};
+
+// Intrusive multi-producer, single-consumer queue (Vyukov-style). Producers publish a pre-linked chain
+// of requests with a single atomic exchange. "Pop" may briefly return nullptr while a producer is
+// between its exchange and link steps, so the consumer just retries.
+class InferenceQueue
+{
+public:
+
+    InferenceQueue();
+
+    InferenceQueue(const InferenceQueue& other) = delete;
+    InferenceQueue& operator=(const InferenceQueue& other) = delete;
+
+    void Push(InferenceRequest* first, InferenceRequest* last);
+    InferenceRequest* Pop();
+
+private:
+
+    alignas(64) std::atomic<InferenceRequest*> _head;
+    alignas(64) InferenceRequest* _tail;
+    InferenceRequest _stub;
+};
+
+struct InferenceStatistics
+{
+    int64_t batchCount;
+    int64_t fullBatchCount;
+    int64_t predictionCount;
+    int64_t queueLatencyNanosecondsTotal;
+    int64_t queueLatencyNanosecondsMax;
+};
+
+// Shares prediction across all self-play/search threads. Each "PredictBatch" call posts its positions
+// individually to a server thread's queue and blocks until they're all predicted. Server threads gather
+// positions from any number of callers into dynamic batches, dispatching to the wrapped network when
+// a batch fills or the oldest position reaches the latency deadline.
+//
+// Callers are spread across server threads round-robin, so with one server thread per device, each
+// device sees large batches regardless of how many callers there are or how full their batches are.
+//
+// Everything other than prediction is forwarded to the wrapped network.
+class InferenceServer : public INetwork
+{
+private:
+
+    struct alignas(64) Shard
+    {
+        InferenceQueue queue;
+        std::atomic_int pendingCount;
+        std::atomic_bool sleeping;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::thread thread;
+
+        // Written only by the server thread.
+        std::atomic<int64_t> batchCount;
+        std::atomic<int64_t> fullBatchCount;
+        std::atomic<int64_t> predictionCount;
+        std::atomic<int64_t> queueLatencyNanosecondsTotal;
+        std::atomic<int64_t> queueLatencyNanosecondsMax;
+    };
+
+public:
+
+    InferenceServer(INetwork* network, int threadCount, int maxBatchSize, int maxLatencyMicroseconds);
+    virtual ~InferenceServer();
+
+    virtual PredictionStatus PredictBatch(NetworkType networkType, int batchSize, InputPlanes* images, float* values, OutputPlanes* policies);
+    virtual std::vector<std::string> PredictCommentaryBatch(int batchSize, CommentaryInputPlanes* images);
+    virtual void Train(NetworkType networkType, int step, int checkpoint);
+    virtual void TrainCommentary(int step, int checkpoint);
+    virtual void LogScalars(NetworkType networkType, int step, const std::vector<std::string> names, float* values);
+    virtual void SaveNetwork(NetworkType networkType, int checkpoint);
+    virtual void SaveSwaNetwork(NetworkType networkType, int checkpoint);
+    virtual void UpdateNetworkWeights(const std::string& networkWeights);
+    virtual void GetNetworkInfo(NetworkType networkType, int* stepCountOut, int* swaStepCountOut, int* trainingChunkCountOut, std::string* relativePathOut);
+    virtual void SaveFile(const std::string& relativePath, const std::string& data);
+    virtual std::string LoadFile(const std::string& relativePath);
+    virtual bool FileExists(const std::string& relativePath);
+    virtual void LaunchGui(const std::string& mode);
+    virtual void UpdateGui(const std::string& fen, const std::string& line, int nodeCount, const std::string& evaluation, const std::string& principalVariation,
+        const std::vector<std::string>& sans, const std::vector<std::string>& froms, const std::vector<std::string>& tos, std::vector<float>& targets,
+        std::vector<float>& priors, std::vector<float>& values, std::vector<float>& puct, std::vector<int>& visits, std::vector<int>& weights);
+    virtual void DebugDecompress(int positionCount, int policySize, float* result, int64_t* imagePiecesAuxiliary,
+        int64_t* policyRowLengths, int64_t* policyIndices, float* policyValues, int decompressPositionsModulus,
+        InputPlanes* imagesOut, float* valuesOut, OutputPlanes* policiesOut);
+    virtual void OptimizeParameters();
+    virtual void RunBot();
+    virtual void PlayBotMove(const std::string& gameId, const std::string& move);
+
+    InferenceStatistics Statistics() const;
+    void ResetStatistics();
+    void PrintDebugInfo() const;
+
+private:
+
+    void Loop(Shard& shard);
+    bool WaitForRequests(Shard& shard, const std::chrono::time_point<std::chrono::high_resolution_clock>* deadline);
+    void Complete(InferenceRequest& request, PredictionStatus status);
+
+private:
+
+    std::unique_ptr<INetwork> _network;
+    int _maxBatchSize;
+    std::chrono::microseconds _maxLatency;
+
+    std::atomic_bool _shutDown;
+    std::vector<std::unique_ptr<Shard>> _shards;
+};
+
+#endif // _INFERENCESERVER_H_
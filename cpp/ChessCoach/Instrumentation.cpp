@@ -0,0 +1,253 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include "Instrumentation.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include <Stockfish/bitboard.h>
+
+#include "Trace.h"
+
+std::atomic_int Instrumentation::ActiveFlags(Active_Counters);
+std::array<Instrumentation::Counters, Instrumentation::StripeCount> Instrumentation::Stripes{};
+
+float PhaseStatistics::AverageMicroseconds() const
+{
+    return ((count == 0) ? 0.f : (static_cast<float>(totalNanoseconds) / count / 1000.f));
+}
+
+// Returns the upper bound of the histogram bucket holding the given percentile, so within a factor of two.
+float PhaseStatistics::PercentileMicroseconds(float percentile) const
+{
+    const int64_t target = static_cast<int64_t>(percentile * count);
+    int64_t cumulative = 0;
+    for (int b = 0; b < static_cast<int>(histogram.size()); b++)
+    {
+        cumulative += histogram[b];
+        if (cumulative > target)
+        {
+            return std::min(static_cast<float>(maxNanoseconds), static_cast<float>(int64_t(2) << b)) / 1000.f;
+        }
+    }
+    return (static_cast<float>(maxNanoseconds) / 1000.f);
+}
+
+void Instrumentation::SetEnabled(bool enabled)
+{
+    if (enabled)
+    {
+        ActiveFlags.fetch_or(Active_Counters, std::memory_order_relaxed);
+    }
+    else
+    {
+        ActiveFlags.fetch_and(~Active_Counters, std::memory_order_relaxed);
+    }
+}
+
+void Instrumentation::SetPerNode(bool perNode)
+{
+    if (perNode)
+    {
+        ActiveFlags.fetch_or(Active_PerNode, std::memory_order_relaxed);
+    }
+    else
+    {
+        ActiveFlags.fetch_and(~Active_PerNode, std::memory_order_relaxed);
+    }
+}
+
+void Instrumentation::SetTracing(bool tracing)
+{
+    if (tracing)
+    {
+        ActiveFlags.fetch_or(Active_Trace, std::memory_order_relaxed);
+    }
+    else
+    {
+        ActiveFlags.fetch_and(~Active_Trace, std::memory_order_relaxed);
+    }
+}
+
+void Instrumentation::RecordInterval(InstrumentedPhase phase, int64_t start, int64_t end)
+{
+    const int flags = ActiveFlags.load(std::memory_order_relaxed);
+    if (flags & Active_Counters)
+    {
+        RecordDuration(phase, (end - start));
+    }
+    if ((flags & Active_Trace) && Trace::Traced(phase))
+    {
+        Trace::Record(phase, start, end);
+    }
+}
+
+void Instrumentation::RecordDuration(InstrumentedPhase phase, int64_t nanoseconds)
+{
+    nanoseconds = std::max(int64_t(1), nanoseconds);
+    const int bucket = std::min(TimeBucketCount - 1, static_cast<int>(msb(static_cast<Bitboard>(nanoseconds))));
+
+    PhaseCounters& counters = LocalCounters().phases[phase];
+    counters.count.fetch_add(1, std::memory_order_relaxed);
+    counters.totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    counters.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    int64_t max = counters.maxNanoseconds.load(std::memory_order_relaxed);
+    while ((nanoseconds > max) && !counters.maxNanoseconds.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+void Instrumentation::RecordSelectionDepth(int depth)
+{
+    if (!PerNode())
+    {
+        return;
+    }
+
+    Counters& counters = LocalCounters();
+    counters.selectionDepthTotal.fetch_add(depth, std::memory_order_relaxed);
+    counters.selectionDepthHistogram[std::min(DepthBucketCount - 1, depth)].fetch_add(1, std::memory_order_relaxed);
+
+    int max = counters.maxSelectionDepth.load(std::memory_order_relaxed);
+    while ((depth > max) && !counters.maxSelectionDepth.compare_exchange_weak(max, depth, std::memory_order_relaxed))
+    {
+    }
+}
+
+Instrumentation::Counters& Instrumentation::LocalCounters()
+{
+    static std::atomic_int NextStripe(0);
+    thread_local static int Stripe = (NextStripe.fetch_add(1, std::memory_order_relaxed) % StripeCount);
+    return Stripes[Stripe];
+}
+
+InstrumentationStatistics Instrumentation::Statistics()
+{
+    InstrumentationStatistics statistics{};
+    for (const Counters& counters : Stripes)
+    {
+        for (int p = 0; p < InstrumentedPhase_Count; p++)
+        {
+            const PhaseCounters& phaseCounters = counters.phases[p];
+            PhaseStatistics& phase = statistics.phases[p];
+            phase.count += phaseCounters.count.load(std::memory_order_relaxed);
+            phase.totalNanoseconds += phaseCounters.totalNanoseconds.load(std::memory_order_relaxed);
+            phase.maxNanoseconds = std::max(phase.maxNanoseconds, phaseCounters.maxNanoseconds.load(std::memory_order_relaxed));
+            for (int b = 0; b < TimeBucketCount; b++)
+            {
+                phase.histogram[b] += phaseCounters.histogram[b].load(std::memory_order_relaxed);
+            }
+        }
+
+        statistics.selectionDepthTotal += counters.selectionDepthTotal.load(std::memory_order_relaxed);
+        statistics.maxSelectionDepth = std::max(statistics.maxSelectionDepth, counters.maxSelectionDepth.load(std::memory_order_relaxed));
+        for (int d = 0; d < DepthBucketCount; d++)
+        {
+            statistics.selectionDepthHistogram[d] += counters.selectionDepthHistogram[d].load(std::memory_order_relaxed);
+        }
+    }
+    return statistics;
+}
+
+// Racing recorders may keep a few counts from just before the reset, which is fine for diagnostics.
+void Instrumentation::ResetStatistics()
+{
+    for (Counters& counters : Stripes)
+    {
+        for (PhaseCounters& phase : counters.phases)
+        {
+            phase.count.store(0, std::memory_order_relaxed);
+            phase.totalNanoseconds.store(0, std::memory_order_relaxed);
+            phase.maxNanoseconds.store(0, std::memory_order_relaxed);
+            for (std::atomic<int64_t>& bucket : phase.histogram)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        counters.selectionDepthTotal.store(0, std::memory_order_relaxed);
+        counters.maxSelectionDepth.store(0, std::memory_order_relaxed);
+        for (std::atomic<int64_t>& bucket : counters.selectionDepthHistogram)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void Instrumentation::PrintDebugInfo()
+{
+    if (!Enabled())
+    {
+        std::cout << "Instrumentation disabled" << std::endl;
+        return;
+    }
+
+    const InstrumentationStatistics statistics = Statistics();
+
+    // One line per phase with any samples: count, total seconds, then average/p50/p99/max in microseconds.
+    const std::ios_base::fmtflags flags = std::cout.flags();
+    std::cout << std::fixed << std::setprecision(2);
+    for (int p = 0; p < InstrumentedPhase_Count; p++)
+    {
+        const PhaseStatistics& phase = statistics.phases[p];
+        if (phase.count == 0)
+        {
+            continue;
+        }
+
+        std::cout << "Instrumentation " << InstrumentedPhaseNames[p]
+            << ": count " << phase.count
+            << ", seconds " << (static_cast<double>(phase.totalNanoseconds) / 1e9)
+            << ", avg " << phase.AverageMicroseconds()
+            << " us, p50 " << phase.PercentileMicroseconds(0.5f)
+            << " us, p99 " << phase.PercentileMicroseconds(0.99f)
+            << " us, max " << (static_cast<float>(phase.maxNanoseconds) / 1000.f) << " us" << std::endl;
+    }
+
+    int64_t selectionCount = 0;
+    for (int64_t count : statistics.selectionDepthHistogram)
+    {
+        selectionCount += count;
+    }
+    if (selectionCount > 0)
+    {
+        // Also show the depth reached by the median and 99th percentile selection.
+        int p50 = -1;
+        int p99 = -1;
+        int64_t cumulative = 0;
+        for (int d = 0; d < DepthBucketCount; d++)
+        {
+            cumulative += statistics.selectionDepthHistogram[d];
+            if ((p50 < 0) && (cumulative > (selectionCount / 2)))
+            {
+                p50 = d;
+            }
+            if ((p99 < 0) && (cumulative > (selectionCount * 99 / 100)))
+            {
+                p99 = d;
+            }
+        }
+
+        std::cout << "Instrumentation selection depth: avg " << (static_cast<float>(statistics.selectionDepthTotal) / selectionCount)
+            << ", p50 " << p50
+            << ", p99 " << p99
+            << ", max " << statistics.maxSelectionDepth << std::endl;
+    }
+    std::cout.flags(flags);
+}
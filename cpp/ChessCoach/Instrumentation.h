@@ -0,0 +1,220 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _INSTRUMENTATION_H_
+#define _INSTRUMENTATION_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+enum InstrumentedPhase
+{
+    // MCTS, on self-play and search threads. Expansion includes its own sub-phases and Syzygy probes.
+    InstrumentedPhase_Selection,
+    InstrumentedPhase_ExpandAndEvaluate,
+    InstrumentedPhase_MoveGeneration,
+    InstrumentedPhase_CacheProbe,
+    InstrumentedPhase_ImageGeneration,
+    InstrumentedPhase_Softmax,
+    InstrumentedPhase_Backpropagation,
+
+    // CPU work on a group of games or searches between predictions, around the phases above.
+    InstrumentedPhase_Mcts,
+
+    // Time that self-play and search threads spend waiting on "PredictBatch" (or the prediction pipeline),
+    // and the batches themselves wherever they run (the prediction pipeline or inference server threads).
+    InstrumentedPhase_PredictBatchWait,
+    InstrumentedPhase_PredictBatch,
+    InstrumentedPhase_GilAcquire,
+
+    InstrumentedPhase_SyzygyProbe,
+
+    // Saving games on self-play threads, and assembling and uploading chunks on the background chunk writer.
+    InstrumentedPhase_StorageWrite,
+    InstrumentedPhase_StorageChunk,
+    InstrumentedPhase_StorageUpload,
+
+    // Releasing discarded subtrees when games advance or finish, and evicting to stay within a tree budget.
+    InstrumentedPhase_Pruning,
+
+    InstrumentedPhase_Count,
+};
+constexpr const char* InstrumentedPhaseNames[InstrumentedPhase_Count] = { "selection", "expand", "movegen", "cache",
+    "image", "softmax", "backprop", "mcts", "predict_wait", "predict", "gil", "syzygy", "storage_write", "storage_chunk",
+    "storage_upload", "pruning" };
+
+struct PhaseStatistics
+{
+    int64_t count;
+    int64_t totalNanoseconds;
+    int64_t maxNanoseconds;
+
+    // Bucket "b" counts durations in [2^b, 2^(b+1)) nanoseconds, with the last bucket open-ended.
+    std::array<int64_t, 32> histogram;
+
+    float AverageMicroseconds() const;
+    float PercentileMicroseconds(float percentile) const;
+};
+
+struct InstrumentationStatistics
+{
+    std::array<PhaseStatistics, InstrumentedPhase_Count> phases;
+
+    // Plies below the search root that each selection reached, with the last bucket open-ended.
+    int64_t selectionDepthTotal;
+    int maxSelectionDepth;
+    std::array<int64_t, 64> selectionDepthHistogram;
+};
+
+// Timing counters and histograms for hot paths, aggregated on demand for "PrintDebugInfo"
+// (the UCI "console instrumentation" command, and periodically during self-play in ChessCoachTrain).
+//
+// Counters are striped across cache lines by thread, like "PredictionCache" metrics, so that recording is
+// a few uncontended relaxed atomic adds plus a steady clock read at either end. Counters can be switched off
+// ("SetEnabled", via the "[instrumentation]" config), leaving just a relaxed load per call site unless tracing (see "Trace").
+//
+// Coarse phases (per batch, probe or chunk) are cheap enough to leave on, but per-node phases (selection through
+// backpropagation, and selection depth) cost several clock reads per simulation, so they also need "SetPerNode".
+class Instrumentation
+{
+public:
+
+    static constexpr const int StripeCount = 64;
+    static constexpr const int TimeBucketCount = std::tuple_size_v<decltype(PhaseStatistics::histogram)>;
+    static constexpr const int DepthBucketCount = std::tuple_size_v<decltype(InstrumentationStatistics::selectionDepthHistogram)>;
+
+public:
+
+    static void SetEnabled(bool enabled);
+    static void SetPerNode(bool perNode);
+    static void SetTracing(bool tracing);
+
+    static bool Enabled()
+    {
+        return (ActiveFlags.load(std::memory_order_relaxed) & Active_Counters);
+    }
+
+    static bool PerNode()
+    {
+        return ((ActiveFlags.load(std::memory_order_relaxed) & Active_PerNodeCounters) == Active_PerNodeCounters);
+    }
+
+    static bool Tracing()
+    {
+        return (ActiveFlags.load(std::memory_order_relaxed) & Active_Trace);
+    }
+
+    static constexpr bool IsPerNode(InstrumentedPhase phase)
+    {
+        return (phase < InstrumentedPhase_Mcts);
+    }
+
+    // Returns a start timestamp for "Record", or zero when the phase is neither counted nor traced.
+    // Per-node phases are only ever counted, not traced.
+    static int64_t Start(InstrumentedPhase phase)
+    {
+        const int flags = ActiveFlags.load(std::memory_order_relaxed);
+        const bool active = (IsPerNode(phase) ? ((flags & Active_PerNodeCounters) == Active_PerNodeCounters) : (flags & (Active_Counters | Active_Trace)));
+        return (active ? Now() : 0);
+    }
+
+    static int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Records the time since "start" (from "Start"), unless zero.
+    static void Record(InstrumentedPhase phase, int64_t start)
+    {
+        if (start)
+        {
+            RecordInterval(phase, start, Now());
+        }
+    }
+
+    static void RecordInterval(InstrumentedPhase phase, int64_t start, int64_t end);
+
+    // Records into counters only, regardless of "Enabled".
+    static void RecordDuration(InstrumentedPhase phase, int64_t nanoseconds);
+    static void RecordSelectionDepth(int depth);
+
+    static InstrumentationStatistics Statistics();
+    static void ResetStatistics();
+    static void PrintDebugInfo();
+
+private:
+
+    enum ActiveFlag
+    {
+        Active_Counters = (1 << 0),
+        Active_Trace = (1 << 1),
+        Active_PerNode = (1 << 2),
+
+        Active_PerNodeCounters = (Active_Counters | Active_PerNode),
+    };
+
+    struct PhaseCounters
+    {
+        std::atomic<int64_t> count;
+        std::atomic<int64_t> totalNanoseconds;
+        std::atomic<int64_t> maxNanoseconds;
+        std::array<std::atomic<int64_t>, TimeBucketCount> histogram;
+    };
+
+    struct alignas(64) Counters
+    {
+        std::array<PhaseCounters, InstrumentedPhase_Count> phases;
+        std::atomic<int64_t> selectionDepthTotal;
+        std::atomic<int> maxSelectionDepth;
+        std::array<std::atomic<int64_t>, DepthBucketCount> selectionDepthHistogram;
+    };
+
+    static Counters& LocalCounters();
+
+private:
+
+    static std::atomic_int ActiveFlags;
+    static std::array<Counters, StripeCount> Stripes;
+};
+
+// Records the lifetime of the scope as the given phase, covering early returns.
+class InstrumentedScope
+{
+public:
+
+    InstrumentedScope(InstrumentedPhase phase)
+        : _phase(phase)
+        , _start(Instrumentation::Start(phase))
+    {
+    }
+
+    ~InstrumentedScope()
+    {
+        Instrumentation::Record(_phase, _start);
+    }
+
+    InstrumentedScope(const InstrumentedScope&) = delete;
+    InstrumentedScope& operator=(const InstrumentedScope&) = delete;
+
+private:
+
+    InstrumentedPhase _phase;
+    int64_t _start;
+};
+
+#endif // _INSTRUMENTATION_H_
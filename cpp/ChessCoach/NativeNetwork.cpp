@@ -0,0 +1,632 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include "NativeNetwork.h"
+
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "Platform.h"
+
+// Mirrors "ModelBuilder.no_progress_saturation_count" in "model.py".
+constexpr const float NoProgressSaturationCount = 99.f;
+
+// Each 3x3 convolution input channel is expanded to three horizontally-shifted copies (file - 1, file, file + 1)
+// with a zero rank above and below, so that every tap becomes an aligned 8-wide row load with implicit padding.
+constexpr const int ShiftedRowCount = (INetwork::BoardSide + 2);
+constexpr const int ShiftedPlaneFloatCount = (ShiftedRowCount * INetwork::BoardSide);
+constexpr const int ShiftedChannelFloatCount = (3 * ShiftedPlaneFloatCount);
+
+namespace
+{
+    class WeightsReader
+    {
+    public:
+
+        WeightsReader(const std::filesystem::path& path)
+            : _path(path)
+            , _stream(path, std::ios::in | std::ios::binary)
+        {
+            if (!_stream)
+            {
+                throw ChessCoachException("Failed to open native weights: " + _path.string());
+            }
+        }
+
+        template <typename T>
+        T Read()
+        {
+            T value;
+            _stream.read(reinterpret_cast<char*>(&value), sizeof(value));
+            Check();
+            return value;
+        }
+
+        std::vector<float> ReadFloats(size_t count)
+        {
+            std::vector<float> values(count);
+            _stream.read(reinterpret_cast<char*>(values.data()), count * sizeof(float));
+            Check();
+            return values;
+        }
+
+        NativeWeights::BatchNorm ReadBatchNorm(int channels)
+        {
+            NativeWeights::BatchNorm batchNorm;
+            batchNorm.scale = ReadFloats(channels);
+            batchNorm.shift = ReadFloats(channels);
+            return batchNorm;
+        }
+
+        void ExpectEnd()
+        {
+            if (_stream.peek() != std::char_traits<char>::eof())
+            {
+                throw ChessCoachException("Unexpected trailing data in native weights: " + _path.string());
+            }
+        }
+
+    private:
+
+        void Check()
+        {
+            if (!_stream)
+            {
+                throw ChessCoachException("Truncated native weights: " + _path.string());
+            }
+        }
+
+    private:
+
+        std::filesystem::path _path;
+        std::ifstream _stream;
+    };
+
+    class WeightsWriter
+    {
+    public:
+
+        WeightsWriter(const std::filesystem::path& path)
+            : _stream(path, std::ios::out | std::ios::binary | std::ios::trunc)
+        {
+            if (!_stream)
+            {
+                throw ChessCoachException("Failed to create native weights: " + path.string());
+            }
+        }
+
+        template <typename T>
+        void Write(T value)
+        {
+            _stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        void WriteFloats(const std::vector<float>& values)
+        {
+            _stream.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+        }
+
+        void WriteBatchNorm(const NativeWeights::BatchNorm& batchNorm)
+        {
+            WriteFloats(batchNorm.scale);
+            WriteFloats(batchNorm.shift);
+        }
+
+    private:
+
+        std::ofstream _stream;
+    };
+
+#ifdef __AVX2__
+    inline __m256 MultiplyAdd(__m256 a, __m256 b, __m256 c)
+    {
+#ifdef __FMA__
+        return _mm256_fmadd_ps(a, b, c);
+#else
+        return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+    }
+#endif
+}
+
+// The file layout is a small header (magic, version, residual/filter/dense counts) followed by raw little-endian
+// float32 tensors in forward-pass order. It must stay in sync with "network.export_native_weights".
+std::unique_ptr<NativeWeights> NativeWeights::Load(const std::filesystem::path& path)
+{
+    WeightsReader reader(path);
+
+    if ((reader.Read<uint32_t>() != Magic) || (reader.Read<uint32_t>() != Version))
+    {
+        throw ChessCoachException("Unsupported native weights format: " + path.string());
+    }
+
+    std::unique_ptr<NativeWeights> weights(new NativeWeights());
+    weights->residualCount = reader.Read<int32_t>();
+    weights->filterCount = reader.Read<int32_t>();
+    weights->denseCount = reader.Read<int32_t>();
+    if ((weights->residualCount < 0) || (weights->filterCount <= 0) || (weights->denseCount <= 0))
+    {
+        throw ChessCoachException("Invalid native weights dimensions: " + path.string());
+    }
+
+    const int filters = weights->filterCount;
+    const size_t towerConvCount = (static_cast<size_t>(filters) * filters * 9);
+
+    weights->stemConv = reader.ReadFloats(static_cast<size_t>(filters) * INetwork::InputPlaneCount * 9);
+    weights->stemBatchNorm = reader.ReadBatchNorm(filters);
+
+    weights->residualBlocks.resize(weights->residualCount);
+    for (int i = 0; i < weights->residualCount; i++)
+    {
+        // The first block's first piece relies on the stem BN/ReLU instead.
+        ResidualBlock& block = weights->residualBlocks[i];
+        block.hasBatchNorm0 = (i != 0);
+        if (block.hasBatchNorm0)
+        {
+            block.batchNorm0 = reader.ReadBatchNorm(filters);
+        }
+        block.conv0 = reader.ReadFloats(towerConvCount);
+        block.batchNorm1 = reader.ReadBatchNorm(filters);
+        block.conv1 = reader.ReadFloats(towerConvCount);
+    }
+    weights->towerBatchNorm = reader.ReadBatchNorm(filters);
+
+    weights->valueConv = reader.ReadFloats(filters);
+    weights->valueBatchNorm = reader.ReadBatchNorm(1);
+    weights->valueDense = reader.ReadFloats(static_cast<size_t>(weights->denseCount) * INetwork::PlaneFloatCount);
+    weights->valueDenseBias = reader.ReadFloats(weights->denseCount);
+    weights->valueOutput = reader.ReadFloats(weights->denseCount);
+    weights->valueOutputBias = reader.Read<float>();
+
+    weights->policyConv = reader.ReadFloats(towerConvCount);
+    weights->policyBatchNorm = reader.ReadBatchNorm(filters);
+    weights->policyOutput = reader.ReadFloats(static_cast<size_t>(INetwork::OutputPlaneCount) * filters);
+    weights->policyOutputBias = reader.ReadFloats(INetwork::OutputPlaneCount);
+
+    reader.ExpectEnd();
+    return weights;
+}
+
+void NativeWeights::Save(const std::filesystem::path& path) const
+{
+    WeightsWriter writer(path);
+
+    writer.Write<uint32_t>(Magic);
+    writer.Write<uint32_t>(Version);
+    writer.Write<int32_t>(residualCount);
+    writer.Write<int32_t>(filterCount);
+    writer.Write<int32_t>(denseCount);
+
+    writer.WriteFloats(stemConv);
+    writer.WriteBatchNorm(stemBatchNorm);
+    for (const ResidualBlock& block : residualBlocks)
+    {
+        if (block.hasBatchNorm0)
+        {
+            writer.WriteBatchNorm(block.batchNorm0);
+        }
+        writer.WriteFloats(block.conv0);
+        writer.WriteBatchNorm(block.batchNorm1);
+        writer.WriteFloats(block.conv1);
+    }
+    writer.WriteBatchNorm(towerBatchNorm);
+
+    writer.WriteFloats(valueConv);
+    writer.WriteBatchNorm(valueBatchNorm);
+    writer.WriteFloats(valueDense);
+    writer.WriteFloats(valueDenseBias);
+    writer.WriteFloats(valueOutput);
+    writer.Write<float>(valueOutputBias);
+
+    writer.WriteFloats(policyConv);
+    writer.WriteBatchNorm(policyBatchNorm);
+    writer.WriteFloats(policyOutput);
+    writer.WriteFloats(policyOutputBias);
+}
+
+// Weights are [output][input][3][3]. Scratch needs (inputChannels * ShiftedChannelFloatCount) floats.
+void NativeNetwork::Convolve3x3(int inputChannels, int outputChannels, const float* weights, const float* input, float* output, float* scratch)
+{
+#ifdef __AVX2__
+    // Build the shifted copies once per input channel, shared across all output channels.
+    for (int i = 0; i < inputChannels; i++)
+    {
+        const float* plane = (input + (i * PlaneFloatCount));
+        for (int shift = 0; shift < 3; shift++)
+        {
+            float* shifted = (scratch + (i * ShiftedChannelFloatCount) + (shift * ShiftedPlaneFloatCount));
+            std::fill(shifted, shifted + BoardSide, 0.f);
+            std::fill(shifted + ((ShiftedRowCount - 1) * BoardSide), shifted + ShiftedPlaneFloatCount, 0.f);
+            for (int rank = 0; rank < BoardSide; rank++)
+            {
+                float* row = (shifted + ((rank + 1) * BoardSide));
+                for (int file = 0; file < BoardSide; file++)
+                {
+                    const int sourceFile = (file + shift - 1);
+                    row[file] = (((sourceFile >= 0) && (sourceFile < BoardSide)) ? plane[(rank * BoardSide) + sourceFile] : 0.f);
+                }
+            }
+        }
+    }
+
+    // Keep one output channel (8 ranks of 8 files) in registers while accumulating over inputs and taps.
+    for (int o = 0; o < outputChannels; o++)
+    {
+        __m256 accumulators[BoardSide];
+        for (int rank = 0; rank < BoardSide; rank++)
+        {
+            accumulators[rank] = _mm256_setzero_ps();
+        }
+
+        const float* outputWeights = (weights + (static_cast<size_t>(o) * inputChannels * 9));
+        for (int i = 0; i < inputChannels; i++)
+        {
+            const float* tapWeights = (outputWeights + (i * 9));
+            const float* shiftedChannel = (scratch + (i * ShiftedChannelFloatCount));
+            for (int tapRank = 0; tapRank < 3; tapRank++)
+            {
+                for (int tapFile = 0; tapFile < 3; tapFile++)
+                {
+                    const __m256 weight = _mm256_broadcast_ss(tapWeights + (tapRank * 3) + tapFile);
+                    const float* source = (shiftedChannel + (tapFile * ShiftedPlaneFloatCount) + (tapRank * BoardSide));
+                    for (int rank = 0; rank < BoardSide; rank++)
+                    {
+                        accumulators[rank] = MultiplyAdd(weight, _mm256_loadu_ps(source + (rank * BoardSide)), accumulators[rank]);
+                    }
+                }
+            }
+        }
+
+        float* outputPlane = (output + (o * PlaneFloatCount));
+        for (int rank = 0; rank < BoardSide; rank++)
+        {
+            _mm256_storeu_ps(outputPlane + (rank * BoardSide), accumulators[rank]);
+        }
+    }
+#else
+    (void)scratch;
+    Convolve3x3Scalar(inputChannels, outputChannels, weights, input, output);
+#endif
+}
+
+void NativeNetwork::Convolve3x3Scalar(int inputChannels, int outputChannels, const float* weights, const float* input, float* output)
+{
+    for (int o = 0; o < outputChannels; o++)
+    {
+        float* outputPlane = (output + (o * PlaneFloatCount));
+        std::fill(outputPlane, outputPlane + PlaneFloatCount, 0.f);
+
+        for (int i = 0; i < inputChannels; i++)
+        {
+            const float* inputPlane = (input + (i * PlaneFloatCount));
+            const float* tapWeights = (weights + (((static_cast<size_t>(o) * inputChannels) + i) * 9));
+            for (int rank = 0; rank < BoardSide; rank++)
+            {
+                for (int file = 0; file < BoardSide; file++)
+                {
+                    float sum = 0.f;
+                    for (int tapRank = 0; tapRank < 3; tapRank++)
+                    {
+                        const int sourceRank = (rank + tapRank - 1);
+                        if ((sourceRank < 0) || (sourceRank >= BoardSide))
+                        {
+                            continue;
+                        }
+                        for (int tapFile = 0; tapFile < 3; tapFile++)
+                        {
+                            const int sourceFile = (file + tapFile - 1);
+                            if ((sourceFile < 0) || (sourceFile >= BoardSide))
+                            {
+                                continue;
+                            }
+                            sum += (tapWeights[(tapRank * 3) + tapFile] * inputPlane[(sourceRank * BoardSide) + sourceFile]);
+                        }
+                    }
+                    outputPlane[(rank * BoardSide) + file] += sum;
+                }
+            }
+        }
+    }
+}
+
+// Weights are [output][input]. Bias is optional.
+void NativeNetwork::Convolve1x1(int inputChannels, int outputChannels, const float* weights, const float* bias, const float* input, float* output)
+{
+    for (int o = 0; o < outputChannels; o++)
+    {
+        const float* outputWeights = (weights + (static_cast<size_t>(o) * inputChannels));
+        const float initial = (bias ? bias[o] : 0.f);
+        float* outputPlane = (output + (o * PlaneFloatCount));
+
+#ifdef __AVX2__
+        __m256 accumulators[BoardSide];
+        for (int rank = 0; rank < BoardSide; rank++)
+        {
+            accumulators[rank] = _mm256_set1_ps(initial);
+        }
+        for (int i = 0; i < inputChannels; i++)
+        {
+            const __m256 weight = _mm256_broadcast_ss(outputWeights + i);
+            const float* inputPlane = (input + (i * PlaneFloatCount));
+            for (int rank = 0; rank < BoardSide; rank++)
+            {
+                accumulators[rank] = MultiplyAdd(weight, _mm256_loadu_ps(inputPlane + (rank * BoardSide)), accumulators[rank]);
+            }
+        }
+        for (int rank = 0; rank < BoardSide; rank++)
+        {
+            _mm256_storeu_ps(outputPlane + (rank * BoardSide), accumulators[rank]);
+        }
+#else
+        std::fill(outputPlane, outputPlane + PlaneFloatCount, initial);
+        for (int i = 0; i < inputChannels; i++)
+        {
+            const float weight = outputWeights[i];
+            const float* inputPlane = (input + (i * PlaneFloatCount));
+            for (int square = 0; square < PlaneFloatCount; square++)
+            {
+                outputPlane[square] += (weight * inputPlane[square]);
+            }
+        }
+#endif
+    }
+}
+
+// Input and output may alias.
+void NativeNetwork::BatchNormRelu(int channels, const NativeWeights::BatchNorm& batchNorm, const float* input, float* output)
+{
+    for (int c = 0; c < channels; c++)
+    {
+        const float scale = batchNorm.scale[c];
+        const float shift = batchNorm.shift[c];
+        for (int square = 0; square < PlaneFloatCount; square++)
+        {
+            const int index = ((c * PlaneFloatCount) + square);
+            output[index] = std::max(0.f, (input[index] * scale) + shift);
+        }
+    }
+}
+
+void NativeNetwork::Add(int count, const float* input, float* output)
+{
+    for (int i = 0; i < count; i++)
+    {
+        output[i] += input[i];
+    }
+}
+
+NativeNetwork::NativeNetwork(INetwork* fallback, NetworkType networkType, std::unique_ptr<NativeWeights> weights)
+    : _fallback(fallback)
+    , _networkType(networkType)
+    , _weights(std::move(weights))
+    , _firstPrediction(true)
+{
+}
+
+NativeNetwork::~NativeNetwork()
+{
+}
+
+PredictionStatus NativeNetwork::PredictBatch(NetworkType networkType, int batchSize, InputPlanes* images, float* values, OutputPlanes* policies)
+{
+    if (networkType != _networkType)
+    {
+        throw ChessCoachException("Native weights were exported for a different network type than requested: "
+            "export them for this type with \"network.export_native_weights\"");
+    }
+
+    // Match PythonNetwork in reporting an update on first prediction, so that any prediction cache contents are cleared.
+    const PredictionStatus status = (_firstPrediction.exchange(false) ? PredictionStatus_UpdatedNetwork : PredictionStatus_None);
+
+    for (int i = 0; i < batchSize; i++)
+    {
+        Predict(images[i], values[i], policies[i]);
+    }
+
+    return status;
+}
+
+void NativeNetwork::Predict(const InputPlanes& image, float& value, OutputPlanes& policy)
+{
+    const NativeWeights& weights = *_weights;
+    const int filters = weights.filterCount;
+    const int towerFloatCount = (filters * PlaneFloatCount);
+
+    // Scratch space is per-thread so that search threads can predict concurrently.
+    thread_local std::vector<float> planes;
+    thread_local std::vector<float> residual;
+    thread_local std::vector<float> activated;
+    thread_local std::vector<float> intermediate;
+    thread_local std::vector<float> shifted;
+    thread_local std::vector<float> dense;
+    planes.resize(InputPlaneCount * PlaneFloatCount);
+    residual.resize(towerFloatCount);
+    activated.resize(towerFloatCount);
+    intermediate.resize(towerFloatCount);
+    shifted.resize(std::max(InputPlaneCount, filters) * ShiftedChannelFloatCount);
+    dense.resize(weights.denseCount);
+
+    // Unpack bit-planes, except for the final no-progress plane, which is a normalized integer.
+    for (int p = 0; p < (InputPlaneCount - 1); p++)
+    {
+        const PackedPlane packed = image[p];
+        float* plane = (planes.data() + (p * PlaneFloatCount));
+        for (int square = 0; square < PlaneFloatCount; square++)
+        {
+            plane[square] = static_cast<float>((packed >> square) & 1);
+        }
+    }
+    std::fill(planes.data() + ((InputPlaneCount - 1) * PlaneFloatCount), planes.data() + (InputPlaneCount * PlaneFloatCount),
+        static_cast<float>(image[InputPlaneCount - 1]) / NoProgressSaturationCount);
+
+    // Stem
+    Convolve3x3(InputPlaneCount, filters, weights.stemConv.data(), planes.data(), residual.data(), shifted.data());
+    BatchNormRelu(filters, weights.stemBatchNorm, residual.data(), residual.data());
+
+    // Residual tower (pre-activation, v2)
+    for (const NativeWeights::ResidualBlock& block : weights.residualBlocks)
+    {
+        const float* blockInput = residual.data();
+        if (block.hasBatchNorm0)
+        {
+            BatchNormRelu(filters, block.batchNorm0, residual.data(), activated.data());
+            blockInput = activated.data();
+        }
+        Convolve3x3(filters, filters, block.conv0.data(), blockInput, intermediate.data(), shifted.data());
+        BatchNormRelu(filters, block.batchNorm1, intermediate.data(), intermediate.data());
+        Convolve3x3(filters, filters, block.conv1.data(), intermediate.data(), activated.data(), shifted.data());
+        Add(towerFloatCount, activated.data(), residual.data());
+    }
+
+    // Tower BN/ReLU
+    BatchNormRelu(filters, weights.towerBatchNorm, residual.data(), activated.data());
+
+    // Value head
+    float valuePlane[PlaneFloatCount];
+    Convolve1x1(filters, 1, weights.valueConv.data(), nullptr, activated.data(), valuePlane);
+    BatchNormRelu(1, weights.valueBatchNorm, valuePlane, valuePlane);
+    for (int d = 0; d < weights.denseCount; d++)
+    {
+        const float* denseWeights = (weights.valueDense.data() + (d * PlaneFloatCount));
+        float sum = weights.valueDenseBias[d];
+        for (int square = 0; square < PlaneFloatCount; square++)
+        {
+            sum += (denseWeights[square] * valuePlane[square]);
+        }
+        dense[d] = std::max(0.f, sum);
+    }
+    float valueSum = weights.valueOutputBias;
+    for (int d = 0; d < weights.denseCount; d++)
+    {
+        valueSum += (weights.valueOutput[d] * dense[d]);
+    }
+
+    // Network deals with tanh outputs/targets in (-1, 1)/[-1, 1]. MCTS deals with probabilities in [0, 1].
+    value = MapProbability11To01(std::tanh(valueSum));
+
+    // Policy head (logits, softmax happens during expansion)
+    Convolve3x3(filters, filters, weights.policyConv.data(), activated.data(), intermediate.data(), shifted.data());
+    BatchNormRelu(filters, weights.policyBatchNorm, intermediate.data(), intermediate.data());
+    Convolve1x1(filters, OutputPlaneCount, weights.policyOutput.data(), weights.policyOutputBias.data(), intermediate.data(),
+        reinterpret_cast<PlanesPointerFlat>(policy.data()));
+}
+
+INetwork& NativeNetwork::Fallback()
+{
+    if (!_fallback)
+    {
+        throw ChessCoachException("Native network only supports prediction without a fallback network");
+    }
+    return *_fallback;
+}
+
+std::vector<std::string> NativeNetwork::PredictCommentaryBatch(int batchSize, CommentaryInputPlanes* images)
+{
+    return Fallback().PredictCommentaryBatch(batchSize, images);
+}
+
+void NativeNetwork::Train(NetworkType networkType, int step, int checkpoint)
+{
+    Fallback().Train(networkType, step, checkpoint);
+}
+
+void NativeNetwork::TrainCommentary(int step, int checkpoint)
+{
+    Fallback().TrainCommentary(step, checkpoint);
+}
+
+void NativeNetwork::LogScalars(NetworkType networkType, int step, const std::vector<std::string> names, float* values)
+{
+    Fallback().LogScalars(networkType, step, names, values);
+}
+
+void NativeNetwork::SaveNetwork(NetworkType networkType, int checkpoint)
+{
+    Fallback().SaveNetwork(networkType, checkpoint);
+}
+
+void NativeNetwork::SaveSwaNetwork(NetworkType networkType, int checkpoint)
+{
+    Fallback().SaveSwaNetwork(networkType, checkpoint);
+}
+
+void NativeNetwork::UpdateNetworkWeights(const std::string& /*networkWeights*/)
+{
+    // Predictions never see the fallback's weights, so switching them would silently keep serving the
+    // exported weights. Require a fresh export via "native_weights" instead.
+    throw ChessCoachException("The native inference backend can't update network weights: export them with "
+        "\"network.export_native_weights\" and set \"native_weights\" instead");
+}
+
+void NativeNetwork::GetNetworkInfo(NetworkType networkType, int* stepCountOut, int* swaStepCountOut, int* trainingChunkCountOut, std::string* relativePathOut)
+{
+    Fallback().GetNetworkInfo(networkType, stepCountOut, swaStepCountOut, trainingChunkCountOut, relativePathOut);
+}
+
+void NativeNetwork::SaveFile(const std::string& relativePath, const std::string& data)
+{
+    Fallback().SaveFile(relativePath, data);
+}
+
+std::string NativeNetwork::LoadFile(const std::string& relativePath)
+{
+    return Fallback().LoadFile(relativePath);
+}
+
+bool NativeNetwork::FileExists(const std::string& relativePath)
+{
+    return Fallback().FileExists(relativePath);
+}
+
+void NativeNetwork::LaunchGui(const std::string& mode)
+{
+    Fallback().LaunchGui(mode);
+}
+
+void NativeNetwork::UpdateGui(const std::string& fen, const std::string& line, int nodeCount, const std::string& evaluation, const std::string& principalVariation,
+    const std::vector<std::string>& sans, const std::vector<std::string>& froms, const std::vector<std::string>& tos, std::vector<float>& targets,
+    std::vector<float>& priors, std::vector<float>& values, std::vector<float>& puct, std::vector<int>& visits, std::vector<int>& weights)
+{
+    Fallback().UpdateGui(fen, line, nodeCount, evaluation, principalVariation, sans, froms, tos, targets, priors, values, puct, visits, weights);
+}
+
+void NativeNetwork::DebugDecompress(int positionCount, int policySize, float* result, int64_t* imagePiecesAuxiliary,
+    int64_t* policyRowLengths, int64_t* policyIndices, float* policyValues, int decompressPositionsModulus,
+    InputPlanes* imagesOut, float* valuesOut, OutputPlanes* policiesOut)
+{
+    Fallback().DebugDecompress(positionCount, policySize, result, imagePiecesAuxiliary, policyRowLengths, policyIndices, policyValues,
+        decompressPositionsModulus, imagesOut, valuesOut, policiesOut);
+}
+
+void NativeNetwork::OptimizeParameters()
+{
+    Fallback().OptimizeParameters();
+}
+
+void NativeNetwork::RunBot()
+{
+    Fallback().RunBot();
+}
+
+void NativeNetwork::PlayBotMove(const std::string& gameId, const std::string& move)
+{
+    Fallback().PlayBotMove(gameId, move);
+}
@@ -0,0 +1,132 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _NATIVENETWORK_H_
+#define _NATIVENETWORK_H_
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <filesystem>
+
+#include "Network.h"
+
+// Weights exported from "model.py" via "network.export_native_weights", with batchnorms
+// folded to per-channel scale/shift. Only the prediction subset is kept (value, policy).
+struct NativeWeights
+{
+    static constexpr const uint32_t Magic = 0x574E4343; // "CCNW"
+    static constexpr const uint32_t Version = 1;
+
+    struct BatchNorm
+    {
+        std::vector<float> scale;
+        std::vector<float> shift;
+    };
+
+    struct ResidualBlock
+    {
+        bool hasBatchNorm0;
+        BatchNorm batchNorm0;
+        std::vector<float> conv0; // [filter][filter][3][3]
+        BatchNorm batchNorm1;
+        std::vector<float> conv1; // [filter][filter][3][3]
+    };
+
+    int residualCount;
+    int filterCount;
+    int denseCount;
+
+    std::vector<float> stemConv; // [filter][InputPlaneCount][3][3]
+    BatchNorm stemBatchNorm;
+    std::vector<ResidualBlock> residualBlocks;
+    BatchNorm towerBatchNorm;
+
+    std::vector<float> valueConv; // [1][filter]
+    BatchNorm valueBatchNorm;
+    std::vector<float> valueDense; // [dense][64]
+    std::vector<float> valueDenseBias; // [dense]
+    std::vector<float> valueOutput; // [dense]
+    float valueOutputBias;
+
+    std::vector<float> policyConv; // [filter][filter][3][3]
+    BatchNorm policyBatchNorm;
+    std::vector<float> policyOutput; // [OutputPlaneCount][filter]
+    std::vector<float> policyOutputBias; // [OutputPlaneCount]
+
+    static std::unique_ptr<NativeWeights> Load(const std::filesystem::path& path);
+    void Save(const std::filesystem::path& path) const;
+};
+
+// Runs the forward pass for prediction in C++ on the calling thread, so that multiple
+// search threads can predict in parallel without the GIL or any Python work per batch.
+//
+// The weights were exported for one network type (see "network.export_native_weights"), so predicting
+// for any other type throws rather than silently using them. Everything else (training, storage, GUI, etc.)
+// is forwarded to the wrapped network.
+class NativeNetwork : public INetwork
+{
+public:
+
+    // Activations are channels-first, [channel][rank][file], matching "model.py".
+    static void Convolve3x3(int inputChannels, int outputChannels, const float* weights, const float* input, float* output, float* scratch);
+    static void Convolve3x3Scalar(int inputChannels, int outputChannels, const float* weights, const float* input, float* output);
+    static void Convolve1x1(int inputChannels, int outputChannels, const float* weights, const float* bias, const float* input, float* output);
+    static void BatchNormRelu(int channels, const NativeWeights::BatchNorm& batchNorm, const float* input, float* output);
+    static void Add(int count, const float* input, float* output);
+
+public:
+
+    NativeNetwork(INetwork* fallback, NetworkType networkType, std::unique_ptr<NativeWeights> weights);
+    virtual ~NativeNetwork();
+
+    virtual PredictionStatus PredictBatch(NetworkType networkType, int batchSize, InputPlanes* images, float* values, OutputPlanes* policies);
+    virtual std::vector<std::string> PredictCommentaryBatch(int batchSize, CommentaryInputPlanes* images);
+    virtual void Train(NetworkType networkType, int step, int checkpoint);
+    virtual void TrainCommentary(int step, int checkpoint);
+    virtual void LogScalars(NetworkType networkType, int step, const std::vector<std::string> names, float* values);
+    virtual void SaveNetwork(NetworkType networkType, int checkpoint);
+    virtual void SaveSwaNetwork(NetworkType networkType, int checkpoint);
+    virtual void UpdateNetworkWeights(const std::string& networkWeights);
+    virtual void GetNetworkInfo(NetworkType networkType, int* stepCountOut, int* swaStepCountOut, int* trainingChunkCountOut, std::string* relativePathOut);
+    virtual void SaveFile(const std::string& relativePath, const std::string& data);
+    virtual std::string LoadFile(const std::string& relativePath);
+    virtual bool FileExists(const std::string& relativePath);
+    virtual void LaunchGui(const std::string& mode);
+    virtual void UpdateGui(const std::string& fen, const std::string& line, int nodeCount, const std::string& evaluation, const std::string& principalVariation,
+        const std::vector<std::string>& sans, const std::vector<std::string>& froms, const std::vector<std::string>& tos, std::vector<float>& targets,
+        std::vector<float>& priors, std::vector<float>& values, std::vector<float>& puct, std::vector<int>& visits, std::vector<int>& weights);
+    virtual void DebugDecompress(int positionCount, int policySize, float* result, int64_t* imagePiecesAuxiliary,
+        int64_t* policyRowLengths, int64_t* policyIndices, float* policyValues, int decompressPositionsModulus,
+        InputPlanes* imagesOut, float* valuesOut, OutputPlanes* policiesOut);
+    virtual void OptimizeParameters();
+    virtual void RunBot();
+    virtual void PlayBotMove(const std::string& gameId, const std::string& move);
+
+private:
+
+    INetwork& Fallback();
+    void Predict(const InputPlanes& image, float& value, OutputPlanes& policy);
+
+private:
+
+    std::unique_ptr<INetwork> _fallback;
+    NetworkType _networkType;
+    std::unique_ptr<NativeWeights> _weights;
+    std::atomic_bool _firstPrediction;
+};
+
+#endif // _NATIVENETWORK_H_
@@ -0,0 +1,525 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include "NodeArena.h"
+
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <chrono>
+#include <algorithm>
+
+#include "SelfPlay.h"
+#include "PoolAllocator.h"
+
+static_assert(NodeArena::BlockSizeBytes % alignof(Node) == 0);
+
+std::mutex NodeArena::PendingMutex;
+std::vector<NodeArena::PendingArray> NodeArena::Pending;
+std::atomic<int64_t> NodeArena::ReleaseCount(0);
+std::atomic<int64_t> NodeArena::ReclaimCount(0);
+std::thread NodeArena::Reclaimer;
+std::condition_variable NodeArena::ReclaimerSignal;
+bool NodeArena::ReclaimerRunning = false;
+std::mutex NodeArena::ArenasMutex;
+std::vector<NodeArena*> NodeArena::Arenas;
+int64_t NodeArena::RetiredAllocationCount = 0;
+int64_t NodeArena::RetiredFreeCount = 0;
+
+// Join the background reclaimer before statics go away, in case the process didn't stop it.
+static struct NodeArenaReclaimerStopper
+{
+    ~NodeArenaReclaimerStopper()
+    {
+        NodeArena::StopReclaimer();
+    }
+} ReclaimerStopper;
+
+// Gives each thread its own arena, freeing its blocks on thread exit if none of its nodes are still in use.
+// Otherwise the arena is orphaned (e.g. trees left behind by finished workers) and its blocks are freed
+// by the last remote free, whether from another thread or the reclaimer.
+struct NodeArenaHolder
+{
+    NodeArena* arena;
+
+    NodeArenaHolder()
+        : arena(new NodeArena())
+    {
+        std::lock_guard lock(NodeArena::ArenasMutex);
+        NodeArena::Arenas.push_back(arena);
+    }
+
+    ~NodeArenaHolder()
+    {
+        arena->Orphan();
+    }
+};
+
+NodeArena& NodeArena::Local()
+{
+    thread_local static NodeArenaHolder Holder;
+    return *Holder.arena;
+}
+
+int NodeArena::SizeClass(int count)
+{
+    assert(count > 0);
+    assert(count <= MAX_MOVES);
+    return ((count + SizeClassNodes - 1) / SizeClassNodes);
+}
+
+NodeArena* NodeArena::Owner(const Node* nodes)
+{
+    const uintptr_t block = (reinterpret_cast<uintptr_t>(nodes) & ~static_cast<uintptr_t>(BlockSizeBytes - 1));
+    return reinterpret_cast<const BlockHeader*>(block)->owner;
+}
+
+// Counters are only written by the owning thread, so avoid the locked read-modify-write.
+void NodeArena::Increment(std::atomic<int64_t>& counter, int64_t amount)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+Node* NodeArena::AllocateRoot()
+{
+    return Local().Allocate(1);
+}
+
+Node* NodeArena::AllocateRoot(const Node& copy)
+{
+    Node* root = Local().Allocate(1);
+    new (root) Node(copy);
+    return root;
+}
+
+// Children are value-initialized, like "new Node[count]{}".
+Node* NodeArena::AllocateChildren(int count)
+{
+    return Local().Allocate(count);
+}
+
+void NodeArena::Free(Node* nodes, int count)
+{
+    if (!nodes)
+    {
+        return;
+    }
+
+    NodeArena* owner = Owner(nodes);
+    NodeArena& local = Local();
+    if (owner == &local)
+    {
+        local.FreeLocal(nodes, SizeClass(count));
+    }
+    else
+    {
+        owner->FreeRemote(nodes, SizeClass(count));
+    }
+}
+
+void NodeArena::Release(Node* root)
+{
+    if (!root)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lock(PendingMutex);
+        Pending.push_back({ root, 1 });
+    }
+    ReleaseCount.fetch_add(1, std::memory_order_relaxed);
+    ReclaimerSignal.notify_one();
+}
+
+// Releases an array of children (and their subtrees) while the parent stays in the tree.
+// The caller detaches the array from its parent.
+void NodeArena::ReleaseChildren(Node* children, int count)
+{
+    if (!children)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lock(PendingMutex);
+        Pending.push_back({ children, count });
+    }
+    ReleaseCount.fetch_add(1, std::memory_order_relaxed);
+    ReclaimerSignal.notify_one();
+}
+
+// Bytes used by an array of "count" nodes, after rounding up to its size class.
+size_t NodeArena::ArrayBytes(int count)
+{
+    return (static_cast<size_t>(SizeClass(count)) * SizeClassNodes * sizeof(Node));
+}
+
+// Bytes in arrays allocated and not yet freed, across all arenas. Released arrays are still live until reclaimed.
+int64_t NodeArena::LiveBytes()
+{
+    int64_t liveBytes = 0;
+    std::lock_guard lock(ArenasMutex);
+    for (const NodeArena* arena : Arenas)
+    {
+        liveBytes += arena->LiveBytesLocal();
+    }
+    return liveBytes;
+}
+
+int64_t NodeArena::PendingCount()
+{
+    std::lock_guard lock(PendingMutex);
+    return static_cast<int64_t>(Pending.size());
+}
+
+// Reclaims released trees on a background thread at up to "arraysPerMillisecond", so that
+// searching and self-play threads never pay for it, without taking more than a sliver of a core.
+void NodeArena::StartReclaimer(int arraysPerMillisecond)
+{
+    std::lock_guard lock(PendingMutex);
+    if (ReclaimerRunning)
+    {
+        return;
+    }
+
+    ReclaimerRunning = true;
+    Reclaimer = std::thread(&NodeArena::ReclaimerLoop, std::max(1, arraysPerMillisecond));
+}
+
+void NodeArena::StopReclaimer()
+{
+    {
+        std::lock_guard lock(PendingMutex);
+        ReclaimerRunning = false;
+    }
+    ReclaimerSignal.notify_all();
+
+    if (Reclaimer.joinable())
+    {
+        Reclaimer.join();
+    }
+}
+
+void NodeArena::ReclaimerLoop(int arraysPerMillisecond)
+{
+    std::unique_lock lock(PendingMutex);
+    while (ReclaimerRunning)
+    {
+        if (Pending.empty())
+        {
+            ReclaimerSignal.wait(lock);
+            continue;
+        }
+
+        ReclaimPending(arraysPerMillisecond);
+
+        // Throttle, letting allocating threads at the mutex in the meantime.
+        lock.unlock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        lock.lock();
+    }
+}
+
+NodeArenaStatistics NodeArena::Statistics()
+{
+    NodeArenaStatistics statistics = {};
+    {
+        std::lock_guard lock(ArenasMutex);
+        statistics.allocationCount = RetiredAllocationCount;
+        statistics.freeCount = RetiredFreeCount;
+        statistics.arenaCount = static_cast<int64_t>(Arenas.size());
+        for (const NodeArena* arena : Arenas)
+        {
+            statistics.allocationCount += arena->_counters.allocationCount.load(std::memory_order_relaxed);
+            statistics.freeCount += arena->FreeCount();
+            statistics.blockCount += arena->_counters.blockCount.load(std::memory_order_relaxed);
+            statistics.liveBytes += arena->LiveBytesLocal();
+        }
+    }
+    {
+        std::lock_guard lock(PendingMutex);
+        statistics.pendingReclaimCount = static_cast<int64_t>(Pending.size());
+    }
+    statistics.releaseCount = ReleaseCount.load(std::memory_order_relaxed);
+    statistics.reclaimCount = ReclaimCount.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+void NodeArena::PrintDebugInfo()
+{
+    const NodeArenaStatistics statistics = Statistics();
+    std::cout << "Node arena allocations: " << statistics.allocationCount
+        << ", frees: " << statistics.freeCount
+        << ", live: " << (statistics.allocationCount - statistics.freeCount)
+        << " (" << (statistics.liveBytes / (1024 * 1024)) << " MiB)"
+        << ", released trees: " << statistics.releaseCount
+        << ", reclaimed arrays: " << statistics.reclaimCount
+        << ", pending arrays: " << statistics.pendingReclaimCount
+        << ", blocks: " << statistics.blockCount
+        << " (" << (statistics.blockCount * BlockSizeBytes / (1024 * 1024)) << " MiB)"
+        << ", arenas: " << statistics.arenaCount << std::endl;
+}
+
+NodeArena::NodeArena()
+    : _free{}
+    , _remoteFree(nullptr)
+    , _bump(nullptr)
+    , _bumpEnd(nullptr)
+    , _counters{}
+    , _orphaned(false)
+    , _orphanFreed(false)
+{
+}
+
+NodeArena::~NodeArena()
+{
+    FreeBlocks();
+}
+
+void NodeArena::FreeBlocks()
+{
+    for (void* block : _blocks)
+    {
+        LargePageAllocator::Free(block);
+    }
+    for (void* block : _fallbackBlocks)
+    {
+#ifdef CHESSCOACH_WINDOWS
+        ::_aligned_free(block);
+#else
+        std::free(block);
+#endif
+    }
+    _blocks.clear();
+    _fallbackBlocks.clear();
+    _free.fill(nullptr);
+    _bump = nullptr;
+    _bumpEnd = nullptr;
+    _counters.blockCount.store(0, std::memory_order_relaxed);
+}
+
+Node* NodeArena::Allocate(int count)
+{
+    const int sizeClass = SizeClass(count);
+
+    // Prefer reuse: local frees, then frees from other threads, then a batch of released trees.
+    if (!_free[sizeClass])
+    {
+        DrainRemoteFrees();
+        if (!_free[sizeClass])
+        {
+            ReclaimReleased();
+        }
+    }
+
+    Node* nodes;
+    FreeChunk* chunk = _free[sizeClass];
+    if (chunk)
+    {
+        _free[sizeClass] = chunk->next;
+        nodes = reinterpret_cast<Node*>(chunk);
+    }
+    else
+    {
+        const size_t byteCount = ArrayBytes(count);
+        if (static_cast<size_t>(_bumpEnd - _bump) < byteCount)
+        {
+            AllocateBlock();
+        }
+        nodes = reinterpret_cast<Node*>(_bump);
+        _bump += byteCount;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        new (&nodes[i]) Node();
+    }
+
+    Increment(_counters.allocationCount);
+    Increment(_counters.allocatedBytes, static_cast<int64_t>(SizeClassNodes * sizeof(Node)) * sizeClass);
+    return nodes;
+}
+
+void NodeArena::FreeLocal(Node* nodes, int sizeClass)
+{
+    PushFree(nodes, sizeClass);
+
+    Increment(_counters.freeCount);
+    Increment(_counters.freedBytes, static_cast<int64_t>(SizeClassNodes * sizeof(Node)) * sizeClass);
+}
+
+void NodeArena::PushFree(Node* nodes, int sizeClass)
+{
+    FreeChunk* chunk = reinterpret_cast<FreeChunk*>(nodes);
+    chunk->next = _free[sizeClass];
+    chunk->sizeClass = sizeClass;
+    _free[sizeClass] = chunk;
+}
+
+void NodeArena::FreeRemote(Node* nodes, int sizeClass)
+{
+    FreeChunk* chunk = reinterpret_cast<FreeChunk*>(nodes);
+    chunk->sizeClass = sizeClass;
+    chunk->next = _remoteFree.load(std::memory_order_relaxed);
+    while (!_remoteFree.compare_exchange_weak(chunk->next, chunk, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+
+    // The count is sequentially consistent so that either this free sees the arena orphaned,
+    // or the exiting owner sees this free (see "Orphan").
+    _counters.remoteFreedBytes.fetch_add(static_cast<int64_t>(SizeClassNodes * sizeof(Node)) * sizeClass, std::memory_order_relaxed);
+    _counters.remoteFreeCount.fetch_add(1);
+    if (_orphaned.load())
+    {
+        FreeBlocksIfOrphanedAndEmpty();
+    }
+}
+
+void NodeArena::DrainRemoteFrees()
+{
+    // Taking the whole list at once avoids ABA problems with concurrent pushes.
+    FreeChunk* chunk = _remoteFree.exchange(nullptr, std::memory_order_acquire);
+    while (chunk)
+    {
+        FreeChunk* next = chunk->next;
+        PushFree(reinterpret_cast<Node*>(chunk), chunk->sizeClass);
+        chunk = next;
+    }
+}
+
+// Called by the owning thread on exit. Remote frees from then on are never drained, but they're
+// still counted, which is all that's needed to know when the blocks can go.
+void NodeArena::Orphan()
+{
+    _orphaned.store(true);
+    FreeBlocksIfOrphanedAndEmpty();
+}
+
+// Once orphaned, no more nodes are allocated or freed locally, so the live count only falls, and
+// several threads may see it reach zero together: only the first frees the blocks and unregisters the arena.
+// The arena itself is never deleted because the others may still be reading its counters.
+void NodeArena::FreeBlocksIfOrphanedAndEmpty()
+{
+    if ((LiveCount() == 0) && !_orphanFreed.exchange(true))
+    {
+        FreeBlocks();
+        Unregister();
+    }
+}
+
+void NodeArena::Unregister()
+{
+    std::lock_guard lock(ArenasMutex);
+    RetiredAllocationCount += _counters.allocationCount.load(std::memory_order_relaxed);
+    RetiredFreeCount += FreeCount();
+    Arenas.erase(std::find(Arenas.begin(), Arenas.end(), this));
+}
+
+// Frees a batch of arrays from released trees, queueing their children's arrays in turn, so that each
+// release is paid off a little at a time. Requires "PendingMutex" to be held.
+int NodeArena::ReclaimPending(int maxCount)
+{
+    int reclaimed = 0;
+    while (!Pending.empty() && (reclaimed < maxCount))
+    {
+        const PendingArray array = Pending.back();
+        Pending.pop_back();
+
+        for (int i = 0; i < array.count; i++)
+        {
+            const Node& node = array.nodes[i];
+            if (node.children)
+            {
+                Pending.push_back({ node.children, node.childCount });
+            }
+        }
+
+        Free(array.nodes, array.count);
+        reclaimed++;
+    }
+
+    ReclaimCount.fetch_add(reclaimed, std::memory_order_relaxed);
+    return reclaimed;
+}
+
+// Without a background reclaimer, help out with a batch when running out of a size class.
+// Skip if another thread is already reclaiming; it'll help soon enough.
+void NodeArena::ReclaimReleased()
+{
+    std::unique_lock lock(PendingMutex, std::try_to_lock);
+    if (!lock.owns_lock() || ReclaimerRunning)
+    {
+        return;
+    }
+
+    ReclaimPending(ReclaimBatchSize);
+}
+
+void NodeArena::AllocateBlock()
+{
+    // Blocks are aligned to their size so that any node can find its block header (and owner).
+    void* block = LargePageAllocator::Allocate(BlockSizeBytes);
+    if (block && ((reinterpret_cast<uintptr_t>(block) & (BlockSizeBytes - 1)) == 0))
+    {
+        _blocks.push_back(block);
+    }
+    else
+    {
+        if (block)
+        {
+            LargePageAllocator::Free(block);
+        }
+#ifdef CHESSCOACH_WINDOWS
+        block = ::_aligned_malloc(BlockSizeBytes, BlockSizeBytes);
+#else
+        block = std::aligned_alloc(BlockSizeBytes, BlockSizeBytes);
+#endif
+        if (!block)
+        {
+            throw std::bad_alloc();
+        }
+        _fallbackBlocks.push_back(block);
+    }
+
+    // Nodes start after the header, keeping cache-line alignment.
+    constexpr const size_t headerBytes = 64;
+    static_assert(sizeof(BlockHeader) <= headerBytes);
+    static_assert(headerBytes % alignof(Node) == 0);
+    reinterpret_cast<BlockHeader*>(block)->owner = this;
+    _bump = (reinterpret_cast<uint8_t*>(block) + headerBytes);
+    _bumpEnd = (reinterpret_cast<uint8_t*>(block) + BlockSizeBytes);
+
+    Increment(_counters.blockCount);
+}
+
+int64_t NodeArena::LiveCount() const
+{
+    return (_counters.allocationCount.load(std::memory_order_relaxed) - FreeCount());
+}
+
+int64_t NodeArena::FreeCount() const
+{
+    return (_counters.freeCount.load(std::memory_order_relaxed) + _counters.remoteFreeCount.load());
+}
+
+int64_t NodeArena::LiveBytesLocal() const
+{
+    return (_counters.allocatedBytes.load(std::memory_order_relaxed)
+        - _counters.freedBytes.load(std::memory_order_relaxed)
+        - _counters.remoteFreedBytes.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,178 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _NODEARENA_H_
+#define _NODEARENA_H_
+
+#include <vector>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+
+#include <Stockfish/types.h>
+
+struct Node;
+
+struct NodeArenaStatistics
+{
+    int64_t allocationCount;
+    int64_t freeCount;
+    int64_t releaseCount;
+    int64_t reclaimCount;
+    int64_t pendingReclaimCount;
+    int64_t blockCount;
+    int64_t liveBytes;
+    int64_t arenaCount;
+};
+
+// Allocates MCTS node arrays (children, plus single roots) from large-page blocks, one arena per thread,
+// like "Game::StateAllocator". Arrays are rounded up to size classes of "SizeClassNodes" nodes and freed
+// onto per-class free lists. Arrays freed by another thread go back to the owning arena's lock-free remote list.
+//
+// Whole trees are released in constant time by queueing the root ("Release"), e.g. discarded siblings when
+// the root advances, or the whole tree for a new game/position. Queued trees are reclaimed a batch at a time
+// by a throttled background thread when started ("StartReclaimer"), otherwise by whichever thread next runs
+// out of a size class, so move transitions don't walk the tree.
+//
+// Subtrees can also be released in place ("ReleaseChildren"), e.g. when collapsing cold subtrees to stay within a memory budget.
+//
+// Releasing requires that no thread can still reach the tree (the same requirement as deleting it).
+class NodeArena
+{
+public:
+
+    static constexpr const size_t BlockSizeBytes = (2 * 1024 * 1024);
+    static constexpr const int SizeClassNodes = 4;
+    static constexpr const int SizeClassCount = ((MAX_MOVES + SizeClassNodes - 1) / SizeClassNodes + 1);
+    static constexpr const int ReclaimBatchSize = 64;
+
+public:
+
+    static Node* AllocateRoot();
+    static Node* AllocateRoot(const Node& copy);
+    static Node* AllocateChildren(int count);
+    static void Free(Node* nodes, int count);
+    static void Release(Node* root);
+    static void ReleaseChildren(Node* children, int count);
+    static size_t ArrayBytes(int count);
+    static int64_t LiveBytes();
+    static int64_t PendingCount();
+
+    static void StartReclaimer(int arraysPerMillisecond);
+    static void StopReclaimer();
+
+    static NodeArenaStatistics Statistics();
+    static void PrintDebugInfo();
+
+private:
+
+    struct BlockHeader
+    {
+        NodeArena* owner;
+    };
+
+    struct FreeChunk
+    {
+        FreeChunk* next;
+        int sizeClass;
+    };
+
+    struct PendingArray
+    {
+        Node* nodes;
+        int count;
+    };
+
+    struct Counters
+    {
+        std::atomic<int64_t> allocationCount;
+        std::atomic<int64_t> freeCount;
+        std::atomic<int64_t> blockCount;
+        std::atomic<int64_t> allocatedBytes;
+        std::atomic<int64_t> freedBytes;
+
+        // Remote frees are counted when pushed, not drained, so that they show up in statistics straight away.
+        std::atomic<int64_t> remoteFreeCount;
+        std::atomic<int64_t> remoteFreedBytes;
+    };
+
+    static NodeArena& Local();
+    static int SizeClass(int count);
+    static NodeArena* Owner(const Node* nodes);
+    static void Increment(std::atomic<int64_t>& counter, int64_t amount = 1);
+    static int ReclaimPending(int maxCount);
+    static void ReclaimerLoop(int arraysPerMillisecond);
+
+private:
+
+    NodeArena();
+    ~NodeArena();
+
+    Node* Allocate(int count);
+    void FreeLocal(Node* nodes, int sizeClass);
+    void PushFree(Node* nodes, int sizeClass);
+    void FreeRemote(Node* nodes, int sizeClass);
+    void DrainRemoteFrees();
+    void Orphan();
+    void FreeBlocksIfOrphanedAndEmpty();
+    void Unregister();
+    void ReclaimReleased();
+    void AllocateBlock();
+    void FreeBlocks();
+    int64_t FreeCount() const;
+    int64_t LiveCount() const;
+    int64_t LiveBytesLocal() const;
+
+private:
+
+    // Released trees, shared by all arenas and reclaimed in batches (see "ReclaimPending").
+    static std::mutex PendingMutex;
+    static std::vector<PendingArray> Pending;
+    static std::atomic<int64_t> ReleaseCount;
+    static std::atomic<int64_t> ReclaimCount;
+
+    // The optional background reclaimer, guarded by "PendingMutex".
+    static std::thread Reclaimer;
+    static std::condition_variable ReclaimerSignal;
+    static bool ReclaimerRunning;
+
+    // Arenas outlive their threads while any of their nodes are still in use (see "Orphan"). Once empty they leave
+    // "Arenas", so that it only grows with live threads, and their counts are kept in the retired totals for statistics.
+    static std::mutex ArenasMutex;
+    static std::vector<NodeArena*> Arenas;
+    static int64_t RetiredAllocationCount;
+    static int64_t RetiredFreeCount;
+
+    std::array<FreeChunk*, SizeClassCount> _free;
+    std::atomic<FreeChunk*> _remoteFree;
+    uint8_t* _bump;
+    uint8_t* _bumpEnd;
+    std::vector<void*> _blocks;
+    std::vector<void*> _fallbackBlocks;
+    Counters _counters;
+
+    // Set when the owning thread exits with nodes still live. Whichever free brings the arena
+    // to zero live nodes then frees its blocks, exactly once ("_orphanFreed").
+    std::atomic_bool _orphaned;
+    std::atomic_bool _orphanFreed;
+
+    friend struct NodeArenaHolder;
+};
+
+#endif // _NODEARENA_H_
@@ -99,6 +99,43 @@ std::tuple<int, int, int, int> Pgn::ParsePgn(std::istream& content, bool allowNo
     return { gamesSeen, fenGameCount, badMovesCount, badResultCount };
 }
 
+SpanStreamBuffer::SpanStreamBuffer(std::string_view span)
+{
+    // The get area is only ever read, and "unget" just steps back within it.
+    char* begin = const_cast<char*>(span.data());
+    setg(begin, begin, begin + span.size());
+}
+
+std::tuple<int, int, int, int> Pgn::ParsePgn(std::string_view content, bool allowNoResult, std::function<void(SavedGame&&, SavedCommentary&&)> gameHandler)
+{
+    SpanStreamBuffer buffer(content);
+    std::istream stream(&buffer);
+    return ParsePgn(stream, allowNoResult, gameHandler);
+}
+
+// Splits PGN content into segments of roughly "targetBytes" that can be parsed independently, by cutting just before
+// the "[Event" header that starts a game. Content without headers to cut at stays in one segment.
+std::vector<std::string_view> Pgn::SplitPgn(std::string_view content, size_t targetBytes)
+{
+    std::vector<std::string_view> segments;
+    size_t begin = 0;
+    while (begin < content.size())
+    {
+        size_t end = content.size();
+        if ((end - begin) > targetBytes)
+        {
+            const size_t boundary = content.find(GameBoundary, begin + targetBytes);
+            if (boundary != std::string_view::npos)
+            {
+                end = (boundary + 1);
+            }
+        }
+        segments.push_back(content.substr(begin, end - begin));
+        begin = end;
+    }
+    return segments;
+}
+
 std::vector<float> Pgn::GenerateMctsValues(const std::vector<uint16_t>& moves, float result)
 {
     std::vector<float> mctsValues(moves.size());
@@ -508,22 +545,23 @@ std::string Pgn::ParseCommentInner(std::istream& content)
 
 void Pgn::ParseMoveGlyph(std::istream& content, std::string& target)
 {
-    // Stop at the first whitespace or punctuation, leaving them unconsumed.
+    // Stop at the first whitespace or punctuation, leaving them unconsumed. Peek at the buffer directly
+    // rather than extracting and ungetting: this runs for every move in bulk conversions.
     target.clear();
-    char c;
+    std::streambuf* buffer = content.rdbuf();
 
-    content >> std::noskipws;
-    while (content >> c)
+    int c;
+    while ((c = buffer->sgetc()) != std::char_traits<char>::eof())
     {
         if (::isspace(static_cast<unsigned char>(c)) ||
             (c == '(') || (c == ')') || (c == '{') || (c == '}'))
         {
-            content.unget();
-            break;
+            return;
         }
-        target += c;
+        target += static_cast<char>(c);
+        buffer->sbumpc();
     }
-    content >> std::skipws;
+    content.setstate(std::ios::eofbit);
 }
 
 bool Pgn::ParseVariation(std::istream& content, const Position& parent, const std::vector<uint16_t>& parentMoves, SavedCommentary& commentary, float& resultInOut)
@@ -700,9 +738,9 @@ void Pgn::SkipGame(std::istream& content)
 }
 
 // Returns MOVE_NONE for failure.
-Move Pgn::ParseSan(const Position& position, const std::string& san)
+Move Pgn::ParseSan(const Position& position, std::string_view san)
 {
-    const std::string queenside = "O-O-O";
+    const std::string_view queenside = "O-O-O";
     
     const Color toPlay = position.side_to_move();
 
@@ -715,6 +753,13 @@ Move Pgn::ParseSan(const Position& position, const std::string& san)
         return MOVE_NULL;
     }
 
+    // Almost all SAN in bulk PGNs is well-formed, so try decoding directly before the forgiving path.
+    const Move fastMove = ParseSanFast(position, san);
+    if (fastMove != MOVE_NONE)
+    {
+        return fastMove;
+    }
+
     const PieceType fromPieceType = ParsePieceType(san, 0);
     CHECK_FAIL_MOVE(fromPieceType != NO_PIECE_TYPE);
     switch (fromPieceType)
@@ -741,6 +786,151 @@ Move Pgn::ParseSan(const Position& position, const std::string& san)
     }
 }
 
+// Decodes well-formed SAN directly with bitboard masks, e.g. "e4", "exd5", "e8=Q", "Nf3", "Nbxd7", "Qh4e1", "O-O-O+",
+// without allocating or trying legality move-by-move. Returns MOVE_NONE for anything unusual (missing captures,
+// zeros for castling, NAGs, words, etc.) so that "ParseSan" can fall back to the forgiving path.
+Move Pgn::ParseSanFast(const Position& position, std::string_view san)
+{
+    // Ignore check/checkmate suffixes and abutting move assessments.
+    while (!san.empty() && ((san.back() == '+') || (san.back() == '#') || (san.back() == '!') || (san.back() == '?')))
+    {
+        san.remove_suffix(1);
+    }
+    if (san.size() < 2)
+    {
+        return MOVE_NONE;
+    }
+
+    const Color toPlay = position.side_to_move();
+    const Square kingSquare = position.square<KING>(toPlay);
+
+    if (san == "O-O")
+    {
+        return make<CASTLING>(kingSquare, position.castling_rook_square(toPlay & KING_SIDE));
+    }
+    if (san == "O-O-O")
+    {
+        return make<CASTLING>(kingSquare, position.castling_rook_square(toPlay & QUEEN_SIDE));
+    }
+
+    // Pawn moves: "e4", "exd5", with optional "=Q".
+    if (IsFileSymbol(san[0]))
+    {
+        PieceType promotionType = NO_PIECE_TYPE;
+        if ((san.size() >= 4) && (san[san.size() - 2] == '='))
+        {
+            promotionType = ParsePieceType(san, static_cast<int>(san.size()) - 1);
+            if ((promotionType < KNIGHT) || (promotionType > QUEEN))
+            {
+                return MOVE_NONE;
+            }
+            san.remove_suffix(2);
+        }
+
+        const bool capture = ((san.size() == 4) && (san[1] == 'x') && IsFileSymbol(san[2]) && IsRankSymbol(san[3]));
+        const bool push = ((san.size() == 2) && IsRankSymbol(san[1]));
+        if (!capture && !push)
+        {
+            return MOVE_NONE;
+        }
+
+        // Pawns never reach their first rank, or their second by capturing, so don't look for one behind it.
+        const Square targetSquare = ParseSquare(san, capture ? 2 : 0);
+        const Rank targetRank = relative_rank(toPlay, targetSquare);
+        if ((targetRank == RANK_1) || (capture && (targetRank == RANK_2)) ||
+            ((targetRank == RANK_8) != (promotionType != NO_PIECE_TYPE)))
+        {
+            return MOVE_NONE;
+        }
+
+        const Piece pawn = make_piece(toPlay, PAWN);
+        const Direction advance = pawn_push(toPlay);
+        Square fromSquare = (targetSquare - advance);
+        if (capture)
+        {
+            fromSquare = make_square(ParseFile(san, 0), rank_of(fromSquare));
+            if (distance<File>(fromSquare, targetSquare) != 1)
+            {
+                return MOVE_NONE;
+            }
+        }
+        else if ((position.piece_on(fromSquare) == NO_PIECE) && (relative_rank(toPlay, targetSquare) == RANK_4))
+        {
+            fromSquare -= advance;
+        }
+        if (position.piece_on(fromSquare) != pawn)
+        {
+            return MOVE_NONE;
+        }
+
+        if (promotionType != NO_PIECE_TYPE)
+        {
+            return make<PROMOTION>(fromSquare, targetSquare, promotionType);
+        }
+        if (capture && (targetSquare == position.ep_square()))
+        {
+            return make<ENPASSANT>(fromSquare, targetSquare);
+        }
+        return make_move(fromSquare, targetSquare);
+    }
+
+    // Piece moves: "Nf3", "Nxf3", "Nbd7", "R1e2", "Qh4e1", "Qh4xe1".
+    const PieceType pieceType = ParsePieceType(san, 0);
+    if ((pieceType < KNIGHT) || (pieceType > KING) || (san[0] == 'O') ||
+        (san.size() < 3) || !IsFileSymbol(san[san.size() - 2]) || !IsRankSymbol(san[san.size() - 1]))
+    {
+        return MOVE_NONE;
+    }
+    const Square targetSquare = ParseSquare(san, static_cast<int>(san.size()) - 2);
+    std::string_view disambiguation = san.substr(1, san.size() - 3);
+    if (!disambiguation.empty() && (disambiguation.back() == 'x'))
+    {
+        disambiguation.remove_suffix(1);
+    }
+
+    Bitboard mask = AllSquares;
+    if (disambiguation.size() == 1)
+    {
+        if (IsFileSymbol(disambiguation[0]))
+        {
+            mask = file_bb(ParseFile(disambiguation, 0));
+        }
+        else if (IsRankSymbol(disambiguation[0]))
+        {
+            mask = rank_bb(ParseRank(disambiguation, 0));
+        }
+        else
+        {
+            return MOVE_NONE;
+        }
+    }
+    else if (disambiguation.size() == 2)
+    {
+        if (!IsFileSymbol(disambiguation[0]) || !IsRankSymbol(disambiguation[1]))
+        {
+            return MOVE_NONE;
+        }
+        mask = square_bb(ParseSquare(disambiguation, 0));
+    }
+    else if (disambiguation.size() > 2)
+    {
+        return MOVE_NONE;
+    }
+
+    // Only pinned pieces need a legality check; they may still move along the pin.
+    Bitboard fromPieces = (Attacks(position, pieceType, targetSquare) & mask);
+    if (more_than_one(fromPieces))
+    {
+        fromPieces = Unpinned(position, fromPieces, targetSquare);
+    }
+    if (!fromPieces || more_than_one(fromPieces))
+    {
+        return MOVE_NONE;
+    }
+
+    return make_move(lsb(fromPieces), targetSquare);
+}
+
 // Always writes 1/2-1/2 rather than * in the context of ChessCoach, where games are technically
 // adjudicated as drawn at 512 moves rather than undetermined.
 void Pgn::GeneratePgn(std::ostream& content, const SavedGame& game)
@@ -976,7 +1166,7 @@ void Pgn::UndoMoveInVariation(Position& position, Move move)
 }
 
 #pragma warning(disable:4706) // Intentionally assigning, not comparing
-Move Pgn::ParsePieceSan(const Position& position, const std::string& san, PieceType fromPieceType)
+Move Pgn::ParsePieceSan(const Position& position, std::string_view san, PieceType fromPieceType)
 {
     CHECK_FAIL_MOVE(san.size() >= 3);
     const size_t capture = san.find('x', 1);
@@ -984,7 +1174,7 @@ Move Pgn::ParsePieceSan(const Position& position, const std::string& san, PieceT
     bool hasPartialDisambiguation = false;
     bool hasFullDisambiguation = false;
 
-    if (capture != std::string::npos)
+    if (capture != std::string_view::npos)
     {
         targetSquare = ParseSquare(san, static_cast<int>(capture) + 1);
         hasFullDisambiguation = (capture >= 3);
@@ -1072,12 +1262,12 @@ Move Pgn::ParsePieceSan(const Position& position, const std::string& san, PieceT
 #pragma warning(default:4706) // Intentionally assigning, not comparing
 
 #pragma warning(disable:4706) // Intentionally assigning, not comparing
-Move Pgn::ParsePawnSan(const Position& position, const std::string& san)
+Move Pgn::ParsePawnSan(const Position& position, std::string_view san)
 {
     const Color toPlay = position.side_to_move();
 
     // Handle "e.p." only as a Numeric Annotation Glyph (NAG).
-    const std::string enPassantSan = "e.p.";
+    const std::string_view enPassantSan = "e.p.";
     if (san.compare(0, enPassantSan.size(), enPassantSan) == 0)
     {
         return MOVE_NONE;
@@ -1086,7 +1276,7 @@ Move Pgn::ParsePawnSan(const Position& position, const std::string& san)
     // Handle e.g. "gf6<...>" or "g5f6<...>" as "gxf6<...>".
     CHECK_FAIL_MOVE(san.size() >= 2);
     size_t capture = san.find('x', 1);
-    if (capture == std::string::npos)
+    if (capture == std::string_view::npos)
     {
         File maybeFile;
 
@@ -1107,7 +1297,7 @@ Move Pgn::ParsePawnSan(const Position& position, const std::string& san)
     }
 
     // If someone over-closes a comment then a written word may reach here. Handle cases like "do" or "due".
-    const int target = ((capture != std::string::npos) ? (static_cast<int>(capture) + 1) : 0);
+    const int target = ((capture != std::string_view::npos) ? (static_cast<int>(capture) + 1) : 0);
     CHECK_FAIL_MOVE(san.size() >= (target + 2));
     const Square targetSquare = ParseSquare(san, target);
     CHECK_FAIL_MOVE(is_ok(targetSquare));
@@ -1115,7 +1305,13 @@ Move Pgn::ParsePawnSan(const Position& position, const std::string& san)
     Square fromSquare = (targetSquare - advance);
     const size_t promotion = san.find('=', 2);
 
-    if (capture != std::string::npos)
+    // Not a pawn move if there's no square behind the target, e.g. "e1" for white.
+    if (!is_ok(fromSquare))
+    {
+        return MOVE_NONE;
+    }
+
+    if (capture != std::string_view::npos)
     {
         fromSquare = make_square(ParseFile(san, 0), rank_of(fromSquare));
     }
@@ -1124,14 +1320,14 @@ Move Pgn::ParsePawnSan(const Position& position, const std::string& san)
         fromSquare -= advance;
     }
 
-    if (promotion != std::string::npos)
+    if (promotion != std::string_view::npos)
     {
         PieceType promotionType = ParsePieceType(san, static_cast<int>(promotion) + 1);
         CHECK_FAIL_MOVE((promotionType >= KNIGHT) && (promotionType <= QUEEN));
 
         return make<PROMOTION>(fromSquare, targetSquare, promotionType);
     }
-    else if ((capture != std::string::npos) && (position.piece_on(targetSquare) == NO_PIECE))
+    else if ((capture != std::string_view::npos) && (position.piece_on(targetSquare) == NO_PIECE))
     {
         return make<ENPASSANT>(fromSquare, targetSquare);
     }
@@ -1140,23 +1336,23 @@ Move Pgn::ParsePawnSan(const Position& position, const std::string& san)
 }
 #pragma warning(default:4706) // Intentionally assigning, not comparing
 
-Square Pgn::ParseSquare(const std::string& text, int offset)
+Square Pgn::ParseSquare(std::string_view text, int offset)
 {
     return make_square(ParseFile(text, offset), ParseRank(text, offset + 1));
 }
 
-File Pgn::ParseFile(const std::string& text, int offset)
+File Pgn::ParseFile(std::string_view text, int offset)
 {
     return File(text[offset] - 'a');
 }
 
-Rank Pgn::ParseRank(const std::string& text, int offset)
+Rank Pgn::ParseRank(std::string_view text, int offset)
 {
     return Rank(text[offset] - '1');
 }
 
 // Returns KING for castling.
-PieceType Pgn::ParsePieceType(const std::string& text, int offset)
+PieceType Pgn::ParsePieceType(std::string_view text, int offset)
 {
     switch (text[offset])
     {
@@ -1186,6 +1382,22 @@ Bitboard Pgn::Attacks(const Position& position, PieceType pieceType, Square targ
     return fromPieces;
 }
 
+// Filters out pieces that are pinned to their king, unless moving along the pin. Only valid for non-king moves.
+Bitboard Pgn::Unpinned(const Position& position, Bitboard fromPieces, Square targetSquare)
+{
+    const Square kingSquare = position.square<KING>(position.side_to_move());
+    Bitboard pinned = (fromPieces & position.blockers_for_king(position.side_to_move()));
+    while (pinned)
+    {
+        const Square from = pop_lsb(&pinned);
+        if (!aligned(from, targetSquare, kingSquare))
+        {
+            fromPieces ^= square_bb(from);
+        }
+    }
+    return fromPieces;
+}
+
 Bitboard Pgn::Legal(const Position& position, Bitboard fromPieces, Square targetSquare)
 {
     Bitboard legal = fromPieces;
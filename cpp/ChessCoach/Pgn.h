@@ -18,19 +18,32 @@
 #define _PGN_H_
 
 #include <iostream>
+#include <streambuf>
 #include <functional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <Stockfish/position.h>
 
 #include "SavedGame.h"
 
+// Reads a character span in place as a stream; e.g., part of a memory-mapped PGN file, so that it can be parsed without copying.
+class SpanStreamBuffer : public std::streambuf
+{
+public:
+
+    SpanStreamBuffer(std::string_view span);
+};
+
 class Pgn
 {
 public:
 
     static std::tuple<int, int, int, int> ParsePgn(std::istream& content, bool allowNoResult, std::function<void(SavedGame&&, SavedCommentary&&)> gameHandler);
-    static Move ParseSan(const Position& position, const std::string& san);
+    static std::tuple<int, int, int, int> ParsePgn(std::string_view content, bool allowNoResult, std::function<void(SavedGame&&, SavedCommentary&&)> gameHandler);
+    static std::vector<std::string_view> SplitPgn(std::string_view content, size_t targetBytes);
+    static Move ParseSan(const Position& position, std::string_view san);
 
     static void GeneratePgn(std::ostream& content, const SavedGame& game);
     static std::string San(const std::string& fen, Move move, bool showCheckmate);
@@ -39,6 +52,7 @@ public:
 private:
 
     static constexpr const char PieceSymbol[PIECE_TYPE_NB] = { '-', '-', 'N', 'B', 'R', 'Q', 'K', '-' };
+    static constexpr const char GameBoundary[] = "\n[Event ";
 
 private:
 
@@ -60,21 +74,25 @@ private:
 
     static bool ApplyMove(StateListPtr& positionStates, Position& position, Move move);
     static void UndoMoveInVariation(Position& position, Move move);
-    static Move ParsePieceSan(const Position& position, const std::string& san, PieceType fromPieceType);
-    static Move ParsePawnSan(const Position& position, const std::string& san);
-    static Square ParseSquare(const std::string& text, int offset);
-    static File ParseFile(const std::string& text, int offset);
-    static Rank ParseRank(const std::string& text, int offset);
-    static PieceType ParsePieceType(const std::string& text, int offset);
+    static Move ParseSanFast(const Position& position, std::string_view san);
+    static Move ParsePieceSan(const Position& position, std::string_view san, PieceType fromPieceType);
+    static Move ParsePawnSan(const Position& position, std::string_view san);
+    static Square ParseSquare(std::string_view text, int offset);
+    static File ParseFile(std::string_view text, int offset);
+    static Rank ParseRank(std::string_view text, int offset);
+    static PieceType ParsePieceType(std::string_view text, int offset);
 
     static std::string SanPawn(const Position& position, Move move);
     static std::string SanPiece(const Position& position, Move move, Piece piece);
 
     static Bitboard Attacks(const Position& position, PieceType pieceType, Square targetSquare);
     static Bitboard Legal(const Position& position, Bitboard fromPieces, Square targetSquare);
+    static Bitboard Unpinned(const Position& position, Bitboard fromPieces, Square targetSquare);
 
     static inline char FileSymbol(File file) { return static_cast<char>('a' + file); }
     static inline char RankSymbol(Rank rank) { return static_cast<char>('1' + rank); }
+    static inline bool IsFileSymbol(char c) { return ((c >= 'a') && (c <= 'h')); }
+    static inline bool IsRankSymbol(char c) { return ((c >= '1') && (c <= '8')); }
 };
 
 #endif // _PGN_H_
\ No newline at end of file
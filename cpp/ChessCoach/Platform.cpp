@@ -28,6 +28,7 @@
 #else
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #define O_BINARY 0
 #endif
@@ -117,4 +118,81 @@ PosixFile::~PosixFile()
 int PosixFile::FileDescriptor() const
 {
     return _fileDescriptor;
-}
\ No newline at end of file
+}
+
+MemoryMappedFile::MemoryMappedFile(const std::filesystem::path& path)
+    : _data(nullptr)
+    , _size(0)
+#ifdef CHESSCOACH_WINDOWS
+    , _fileHandle(INVALID_HANDLE_VALUE)
+    , _mappingHandle(nullptr)
+#endif
+{
+    std::error_code error;
+    const uintmax_t size = std::filesystem::file_size(path, error);
+    if (error || (size == 0))
+    {
+        throw ChessCoachException("Failed to map file: " + path.string());
+    }
+    _size = static_cast<size_t>(size);
+
+#ifdef CHESSCOACH_WINDOWS
+    _fileHandle = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (_fileHandle != INVALID_HANDLE_VALUE)
+    {
+        _mappingHandle = ::CreateFileMappingW(_fileHandle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if (_mappingHandle)
+        {
+            _data = ::MapViewOfFile(_mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+        }
+    }
+    if (!_data)
+    {
+        if (_mappingHandle)
+        {
+            ::CloseHandle(_mappingHandle);
+        }
+        if (_fileHandle != INVALID_HANDLE_VALUE)
+        {
+            ::CloseHandle(_fileHandle);
+        }
+        throw ChessCoachException("Failed to map file: " + path.string());
+    }
+#else
+    const int fileDescriptor = ::open(path.string().c_str(), O_RDONLY);
+    if (fileDescriptor == -1)
+    {
+        throw ChessCoachException("Failed to map file: " + path.string());
+    }
+
+    // The mapping keeps its own reference to the file.
+    void* data = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+    ::close(fileDescriptor);
+    if (data == MAP_FAILED)
+    {
+        throw ChessCoachException("Failed to map file: " + path.string());
+    }
+    _data = data;
+#endif
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+#ifdef CHESSCOACH_WINDOWS
+    ::UnmapViewOfFile(_data);
+    ::CloseHandle(_mappingHandle);
+    ::CloseHandle(_fileHandle);
+#else
+    ::munmap(_data, _size);
+#endif
+}
+
+void* MemoryMappedFile::Data() const
+{
+    return _data;
+}
+
+size_t MemoryMappedFile::Size() const
+{
+    return _size;
+}
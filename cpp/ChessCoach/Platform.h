@@ -65,4 +65,28 @@ private:
     int _fileDescriptor;
 };
 
+// Maps a whole file copy-on-write: writes through "Data()" are private to this process and never reach the file.
+class MemoryMappedFile
+{
+public:
+
+    MemoryMappedFile(const std::filesystem::path& path);
+    ~MemoryMappedFile();
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+    void* Data() const;
+    size_t Size() const;
+
+private:
+
+    void* _data;
+    size_t _size;
+#ifdef CHESSCOACH_WINDOWS
+    void* _fileHandle;
+    void* _mappingHandle;
+#endif
+};
+
 #endif // _PLATFORM_H_
\ No newline at end of file
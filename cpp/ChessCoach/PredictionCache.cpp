@@ -17,6 +17,8 @@
 #include "PredictionCache.h"
 
 #include <iostream>
+#include <fstream>
+#include <cstring>
 #include <cassert>
 
 #include <google/protobuf/stubs/port.h>
@@ -25,139 +27,384 @@
 
 PredictionCache PredictionCache::Instance;
 
-void PredictionCacheChunk::Clear()
+PredictionCacheTable::PredictionCacheTable(void* memory, int bucketCount, int associativity, int entryBytes)
+    : _memory(reinterpret_cast<uint8_t*>(memory))
+    , _bucketCount(bucketCount)
+    , _associativity(associativity)
+    , _entryBytes(entryBytes)
 {
-    for (int i = 0; i < EntryCount; i++)
+    assert((bucketCount & (bucketCount - 1)) == 0);
+}
+
+PredictionCacheEntry& PredictionCacheTable::Entry(uint8_t* bucket, int index) const
+{
+    return *reinterpret_cast<PredictionCacheEntry*>(bucket + (static_cast<size_t>(index) * _entryBytes));
+}
+
+const PredictionCacheEntry& PredictionCacheTable::Entry(const uint8_t* bucket, int index) const
+{
+    return *reinterpret_cast<const PredictionCacheEntry*>(bucket + (static_cast<size_t>(index) * _entryBytes));
+}
+
+uint8_t* PredictionCacheTable::Bucket(Key key) const
+{
+    // Use up to 48 low bits to choose the bucket (e.g. lowest 23 of the 48 for a 1-GiB table with 128-byte buckets).
+    // Xor lowest 48 bits down to 24 bits (covers the most buckets possible per table, checked in "PredictionCache::Allocate").
+    const uint64_t bucketKey = (key & 0xFFFFFFFFFFFF);
+    const uint64_t bucketKeyXor = ((bucketKey & 0xFFFFFF) ^ (bucketKey >> 24));
+    const size_t bucketBytes = (static_cast<size_t>(_associativity) * _entryBytes);
+    return (_memory + ((bucketKeyXor & (_bucketCount - 1)) * bucketBytes));
+}
+
+void PredictionCacheTable::Clear()
+{
+    for (int b = 0; b < _bucketCount; b++)
     {
-        _entries[i].key = 0;
-        _entries[i].age = 0;
+        uint8_t* bucket = (_memory + (static_cast<size_t>(b) * _associativity * _entryBytes));
+        for (int i = 0; i < _associativity; i++)
+        {
+            PredictionCacheEntry& entry = Entry(bucket, i);
+            entry.sequence.store(0, std::memory_order_relaxed);
+            entry.generation = 0;
+            entry.key = 0;
+        }
     }
 }
 
-bool PredictionCacheChunk::TryGet(Key key, int moveCount, float* valueOut, uint16_t* priorsOut)
+int PredictionCacheTable::EntryMoveCount() const
+{
+    return PredictionCacheEntry::MaxMoveCountForEntryBytes(_entryBytes);
+}
+
+int PredictionCacheTable::MaxMoveCount() const
+{
+    return std::min(MAX_MOVES, (EntryMoveCount() * std::min(MaxSpan, _associativity)));
+}
+
+int PredictionCacheTable::EntryCount() const
+{
+    return (_bucketCount * _associativity);
+}
+
+uint8_t* PredictionCacheTable::Memory() const
+{
+    return _memory;
+}
+
+size_t PredictionCacheTable::SizeBytes() const
+{
+    return (static_cast<size_t>(_bucketCount) * _associativity * _entryBytes);
+}
+
+int PredictionCacheTable::Span(int moveCount) const
+{
+    const int entryMoveCount = EntryMoveCount();
+    return std::max(1, (moveCount + entryMoveCount - 1) / entryMoveCount);
+}
+
+// Continuation entries are found by their own key, derived from the position's key and the
+// continuation index, so they can sit anywhere in the bucket.
+Key PredictionCacheTable::SpanKey(Key key, int spanIndex)
+{
+    return (key ^ (static_cast<Key>(spanIndex) * 0x9E3779B97F4A7C15ULL));
+}
+
+// Continuation entries carry their first entry's generation and final sequence
+// so that a continuation left over from an older write of the same key doesn't match.
+uint32_t PredictionCacheTable::SpanTag(uint16_t generation, uint16_t sequence)
+{
+    return ((static_cast<uint32_t>(generation) << 16) | sequence);
+}
+
+const PredictionCacheEntry* PredictionCacheTable::Find(const uint8_t* bucket, Key key) const
 {
-    for (PredictionCacheEntry& entry : _entries)
+    for (int i = 0; i < _associativity; i++)
     {
-        entry.age++;
+        const PredictionCacheEntry& entry = Entry(bucket, i);
+        if (entry.key == key)
+        {
+            return &entry;
+        }
     }
+    return nullptr;
+}
 
-    for (PredictionCacheEntry& entry : _entries)
+bool PredictionCacheTable::TryGet(const uint8_t* bucket, Key key, int moveCount, float* valueOut, uint16_t* priorsOut) const
+{
+    // Probing doesn't write anything, so hits from many threads don't bounce cache lines around.
+    //
+    // Various types of collisions and race conditions across threads are possible:
+    //
+    // - Key collisions (type-1 errors):
+    //      - Can mitigate by increasing key size, table size, or e.g. for Stockfish,
+    //        validating the stored information, a Move, against the probing position.
+    //        Note that validating using key/input information rather than stored/output
+    //        is equivalent to increasing key size. We can mitigate by summing policy for
+    //        the probing legal move count and ensuring that it's nearly 1.0.
+    // - Index collisions (type-2 errors):
+    //      - Results from the bit shrinkage from the full key size down to the addressable
+    //        space of the table. Can be mitigated by storing the the full key, or more of
+    //        the key than the addressable space, and validating when probing. We store the
+    //        full key.
+    // - Torn reads from parallel thread writes:
+    //      - A writer owns entries via the seqlock "sequence" (odd while writing), so writers
+    //        can't splice each other. Readers check that the sequence was even and unchanged
+    //        across the whole read, so a read overlapping a write is detected directly.
+    //        Positions with too many moves for one entry span multiple entries, and each
+    //        continuation must also carry the first entry's tag.
+    //
+    // Use the provided "priorsOut" as writable scratch space even if we return false.
+    //
+    // Most real probabilities will have canceling bias from quantization errors,
+    // but uniform policy will give cases like 1/245 * 245, 1.0 vs. ~0.9982, 65535 vs. 65415,
+    // and we may get unlucky on certain batches (don't actually need to cache pure uniform).
+    //
+    // Allow for 120 quanta error, ~0.18% (used to be much higher with 8-bit quantization, ~3.5% for 9).
+    // This allows for the largest uniform error for legal move count in [1, 256].
+    //
+    // Sum in dequantized quanta (each stored prior "q" represents "q + 1"), so that the expected total doesn't
+    // drift by one quantum per move, which would otherwise exceed the allowance for large move counts.
+    const int entryMoveCount = EntryMoveCount();
+    const int span = Span(moveCount);
+    std::array<const PredictionCacheEntry*, MaxSpan> entries;
+    std::array<uint16_t, MaxSpan> sequences;
+    for (int s = 0; s < span; s++)
     {
-        if (entry.key == key)
+        entries[s] = Find(bucket, SpanKey(key, s));
+        if (!entries[s])
         {
-            // Various types of collisions and race conditions across threads are possible:
-            //
-            // - Key collisions (type-1 errors):
-            //      - Can mitigate by increasing key size, table size, or e.g. for Stockfish,
-            //        validating the stored information, a Move, against the probing position.
-            //        Note that validating using key/input information rather than stored/output
-            //        is equivalent to increasing key size. We can mitigate by summing policy for
-            //        the probing legal move count and ensuring that it's nearly 1.0.
-            // - Index collisions (type-2 errors):
-            //      - Results from the bit shrinkage from the full key size down to the addressable
-            //        space of the table. Can be mitigated by storing the the full key, or more of
-            //        the key than the addressable space, and validating when probing. We store the
-            //        full key.
-            // - Spliced values from parallel thread writes:
-            //      - Multiple threads may race to write to a single chunk and/or entry, splicing
-            //        values - either intra-field (e.g. writing to different parts of the policy)
-            //        or inter-field (e.g. one thread writing key/value and the other writing policy).
-            //        We have to accept seeing an incorrect value, but intra and inter-policy splicing
-            //        can potentially be detected by again summing policy for the probing legal move count
-            //        and ensuring that it's nearly 1.0.
-            //
-            // Use the provided "priorsOut" as writable scratch space even if we return false.
-            //
-            // Most real probabilities will have canceling bias from quantization errors,
-            // but uniform policy will give cases like 1/245 * 245, 1.0 vs. ~0.9982, 65535 vs. 65415,
-            // and we may get unlucky on certain batches (don't actually need to cache pure uniform).
-            //
-            // Allow for 120 quanta error, ~0.18% (used to be much higher with 8-bit quantization, ~3.5% for 9).
-            // This allows for the largest uniform error for legal move count in [1, 256].
-
-            int priorSum = 0;
-            for (int m = 0; m < moveCount; m++)
+            return false;
+        }
+        sequences[s] = entries[s]->sequence.load(std::memory_order_acquire);
+        if (sequences[s] & 1)
+        {
+            return false;
+        }
+    }
+
+    const float value = entries[0]->value;
+    const uint32_t tag = SpanTag(entries[0]->generation, sequences[0]);
+    int priorSum = 0;
+    for (int s = 0; s < span; s++)
+    {
+        if ((s > 0) && (entries[s]->tag != tag))
+        {
+            return false;
+        }
+
+        const uint16_t* policyPriors = entries[s]->PolicyPriors();
+        const int offset = (s * entryMoveCount);
+        const int count = std::min(entryMoveCount, (moveCount - offset));
+        for (int m = 0; m < count; m++)
+        {
+            const uint16_t quantizedPrior = policyPriors[m];
+            priorSum += (quantizedPrior + 1);
+            priorsOut[offset + m] = quantizedPrior;
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    for (int s = 0; s < span; s++)
+    {
+        if ((entries[s]->sequence.load(std::memory_order_relaxed) != sequences[s]) || (entries[s]->key != SpanKey(key, s)))
+        {
+            return false;
+        }
+    }
+
+    // Check for type-1 errors and return false. Since entries aren't freshened on hits, they will
+    // naturally be overwritten if the network prediction is put.
+    constexpr int expected = (INetwork::QuantizeProbabilityNoZero(1.f) + 1);
+    static_assert(INetwork::DequantizeProbabilityNoZero(expected - 1) == 1.f);
+    const int allowance = 120;
+    if ((priorSum < (expected - allowance)) || (priorSum > (expected + allowance)))
+    {
+        return false;
+    }
+
+    *valueOut = value;
+    return true;
+}
+
+void PredictionCacheTable::Put(uint8_t* bucket, Key key, float value, int moveCount, const uint16_t* priors, int* filledCountOut, int* evictedCountOut) const
+{
+    assert(moveCount <= MaxMoveCount());
+
+    *filledCountOut = 0;
+    *evictedCountOut = 0;
+
+    // For each entry in the span: if the same full key is found then that entry needs to be replaced so that
+    // TryGet finds it. Otherwise, fill an empty entry, or replace the oldest by generation (allowing for wraparound).
+    const int entryMoveCount = EntryMoveCount();
+    const int span = Span(moveCount);
+    uint16_t newestGeneration = Entry(bucket, 0).generation;
+    for (int i = 1; i < _associativity; i++)
+    {
+        if (static_cast<int16_t>(Entry(bucket, i).generation - newestGeneration) > 0)
+        {
+            newestGeneration = Entry(bucket, i).generation;
+        }
+    }
+
+    uint64_t chosenMask = 0;
+    std::array<int, MaxSpan> indices;
+    for (int s = 0; s < span; s++)
+    {
+        const Key spanKey = SpanKey(key, s);
+        int replaceIndex = -1;
+        int emptyIndex = -1;
+        int oldestIndex = -1;
+        for (int i = 0; i < _associativity; i++)
+        {
+            if (chosenMask & (1ULL << i))
             {
-                const uint16_t quantizedPrior = entry.policyPriors[m];
-                priorSum += quantizedPrior;
-                priorsOut[m] = quantizedPrior;
+                continue;
             }
 
-            // Check for type-1 errors and splices and return false. It's important not to
-            // freshen the age in these cases so that splices can be overwritten with good data.
-            constexpr int expected = INetwork::QuantizeProbabilityNoZero(1.f);
-            static_assert(INetwork::DequantizeProbabilityNoZero(expected) == 1.f);
-            const int allowance = 120;
-            if ((priorSum < (expected - allowance)) || (priorSum > (expected + allowance)))
+            const PredictionCacheEntry& entry = Entry(bucket, i);
+            if (entry.key == spanKey)
+            {
+                replaceIndex = i;
+                break;
+            }
+            else if (!entry.key && (emptyIndex < 0))
+            {
+                emptyIndex = i;
+            }
+            if ((oldestIndex < 0) || (static_cast<int16_t>(entry.generation - Entry(bucket, oldestIndex).generation) < 0))
             {
-                return false;
+                oldestIndex = i;
             }
+        }
+        indices[s] = ((replaceIndex >= 0) ? replaceIndex : (emptyIndex >= 0) ? emptyIndex : oldestIndex);
+        chosenMask |= (1ULL << indices[s]);
+    }
 
-            // The entry is valid, as far as we can tell, so freshen its age and return it.
-            entry.age = std::numeric_limits<int>::min();
-            *valueOut = entry.value;
-            return true;
+    // Take ownership of the entries. If another thread is writing any of them, just drop this prediction: it's only a cache.
+    // Entries claimed so far haven't been modified, so restoring their original sequences is safe for readers.
+    std::array<uint16_t, MaxSpan> sequences;
+    for (int s = 0; s < span; s++)
+    {
+        PredictionCacheEntry& entry = Entry(bucket, indices[s]);
+        sequences[s] = entry.sequence.load(std::memory_order_relaxed);
+        if ((sequences[s] & 1) || !entry.sequence.compare_exchange_strong(sequences[s], static_cast<uint16_t>(sequences[s] + 1), std::memory_order_acquire))
+        {
+            for (int r = 0; r < s; r++)
+            {
+                Entry(bucket, indices[r]).sequence.store(sequences[r], std::memory_order_release);
+            }
+            return;
         }
     }
 
-    return false;
-}
+    // The acquire on each claim doesn't stop the data writes below becoming visible before the odd sequence,
+    // so order them explicitly (see "Can Seqlocks Get Along With Programming Language Memory Models?", Boehm).
+    std::atomic_thread_fence(std::memory_order_release);
 
-void PredictionCacheChunk::Put(Key key, float value, int moveCount, const uint16_t* priors)
-{
-    // If the same full key is found then that entry needs to be replaced so that
-    // TryGet finds it. Otherwise, replace the oldest entry.
-    int oldestIndex = 0;
-    for (int i = 0; i < EntryCount; i++)
+    const uint16_t generation = static_cast<uint16_t>(newestGeneration + 1);
+    const uint32_t tag = SpanTag(generation, static_cast<uint16_t>(sequences[0] + 2));
+    for (int s = 0; s < span; s++)
     {
-        if (_entries[i].key == key)
+        PredictionCacheEntry& entry = Entry(bucket, indices[s]);
+        const Key spanKey = SpanKey(key, s);
+        if (!entry.key)
         {
-            oldestIndex = i;
-            break;
+            (*filledCountOut)++;
         }
-        if (_entries[i].age > _entries[oldestIndex].age)
+        else if (entry.key != spanKey)
         {
-            oldestIndex = i;
+            (*evictedCountOut)++;
+        }
+
+        entry.key = spanKey;
+        entry.generation = generation;
+        if (s == 0)
+        {
+            entry.value = value;
+        }
+        else
+        {
+            entry.tag = tag;
+        }
+
+        const int offset = (s * entryMoveCount);
+        const int count = std::min(entryMoveCount, (moveCount - offset));
+        uint16_t* policyPriors = entry.PolicyPriors();
+        std::copy(priors + offset, priors + offset + count, policyPriors);
+
+        // Place a "guard" probability of 1.0 immediately after the N legal moves' probabilities
+        // so that "TryGet" can more often detect incorrect probability sums (rather than potentially
+        // seeing only trailing zeros and still summing to 1.0).
+        //
+        // This unfortunately won't help with all trailing zeros - e.g. placing 5 priors, {0.1, 0.2, 0.3, 0.4, 0.0},
+        // and reading back 4 - but we shouldn't be placing actual quantized zeros (rounded up to one quantum) - just
+        // have to worry about small values not triggering the quantization error allowance check.
+        if (count < entryMoveCount)
+        {
+            policyPriors[count] = INetwork::QuantizeProbabilityNoZero(1.f);
         }
     }
 
-    // Hackily reach into the singleton PredictionCache to update metrics.
-    if (_entries[oldestIndex].key)
+    for (int s = 0; s < span; s++)
     {
-        PredictionCache::Instance._evictionCount++;
+        Entry(bucket, indices[s]).sequence.store(static_cast<uint16_t>(sequences[s] + 2), std::memory_order_release);
     }
-    else
+}
+
+PredictionCacheChunk::PredictionCacheChunk()
+    : _cache(nullptr)
+    , _table(nullptr)
+    , _bucket(nullptr)
+{
+}
+
+PredictionCacheChunk::operator bool() const
+{
+    return (_bucket != nullptr);
+}
+
+void PredictionCacheChunk::Put(Key key, float value, int moveCount, const uint16_t* priors)
+{
+    assert(_bucket);
+
+    int filledCount;
+    int evictedCount;
+    _table->Put(_bucket, key, value, moveCount, priors, &filledCount, &evictedCount);
+
+    PredictionCache::Metrics& metrics = _cache->LocalMetrics();
+    if (filledCount)
     {
-        PredictionCache::Instance._entryCount++;
+        metrics.entryCount.fetch_add(filledCount, std::memory_order_relaxed);
     }
+    if (evictedCount)
+    {
+        metrics.evictionCount.fetch_add(evictedCount, std::memory_order_relaxed);
+    }
+}
 
-    _entries[oldestIndex].key = key;
-    _entries[oldestIndex].value = value;
-    _entries[oldestIndex].age = std::numeric_limits<int>::min();
-    std::copy(priors, priors + moveCount, _entries[oldestIndex].policyPriors.data());
-
-    // Place a "guard" probability of 1.0 immediately after the N legal moves' probabilities
-    // so that "TryGet" can more often detect incorrect probability sums (rather than potentially
-    // seeing only trailing zeros and still summing to 1.0).
-    //
-    // This unfortunately won't help with all trailing zeros - e.g. placing 5 priors, {0.1, 0.2, 0.3, 0.4, 0.0},
-    // and reading back 4 - but we shouldn't be placing actual quantized zeros (rounded up to one quantum) - just
-    // have to worry about small values not triggering the quantization error allowance check.
-    if (moveCount < _entries[oldestIndex].policyPriors.size())
+// 64-bit FNV-1a, stable across platforms and runs (unlike "std::hash").
+uint64_t PredictionCache::IdentityHash(const std::string& identity)
+{
+    uint64_t hash = 0xCBF29CE484222325;
+    for (const char c : identity)
     {
-        _entries[oldestIndex].policyPriors[moveCount] = INetwork::QuantizeProbabilityNoZero(1.f);
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001B3;
     }
+    return hash;
 }
 
 PredictionCache::PredictionCache()
     : _allocatedSizeMebibytes(0)
-    , _chunksPerTable(0)
-    , _hitCount(0)
-    , _evictionCount(0)
-    , _probeCount(0)
-    , _entryCount(0)
+    , _associativity(0)
+    , _entryBytes(0)
     , _entryCapacity(0)
 {
+    ResetProbeMetrics();
+    for (Metrics& metrics : _metrics)
+    {
+        metrics.entryCount.store(0, std::memory_order_relaxed);
+    }
 }
 
 PredictionCache::~PredictionCache()
@@ -165,7 +412,7 @@ PredictionCache::~PredictionCache()
     Free();
 }
 
-void PredictionCache::Allocate(int sizeMebibytes)
+void PredictionCache::Allocate(int sizeMebibytes, int associativity, int entryBytes)
 {
     // Require non-negative.
     if (sizeMebibytes < 0)
@@ -173,19 +420,29 @@ void PredictionCache::Allocate(int sizeMebibytes)
         throw ChessCoachException("Negative size");
     }
 
+    // Buckets need to be a power-of-two size for tables to divide evenly.
+    if ((associativity < 1) || (associativity > MaxAssociativity) || (associativity & (associativity - 1)))
+    {
+        throw ChessCoachException("Prediction cache associativity must be a power of two, at most " + std::to_string(MaxAssociativity));
+    }
+    if ((entryBytes < PredictionCacheEntry::MinEntryBytes) || (entryBytes > PredictionCacheEntry::MaxEntryBytes) || (entryBytes & (entryBytes - 1)))
+    {
+        throw ChessCoachException("Prediction cache entry size must be a power of two from "
+            + std::to_string(PredictionCacheEntry::MinEntryBytes) + " to " + std::to_string(PredictionCacheEntry::MaxEntryBytes));
+    }
+
     // Round down to a power of two or zero, and at most 256 GiB.
     constexpr const int bytesPerMebibyte = (1024 * 1024);
-    constexpr const int chunksPerMebibyte = (bytesPerMebibyte / static_cast<int>(sizeof(PredictionCacheChunk)));
-    constexpr const int maxMebibytes = (MaxTableCount * MaxChunksPerTable / chunksPerMebibyte);
-    static_assert((bytesPerMebibyte % static_cast<int>(sizeof(PredictionCacheChunk))) == 0);
+    constexpr const int maxMebibytes = (MaxTableCount * (MaxTableBytes / bytesPerMebibyte));
     static_assert(maxMebibytes == 256 * 1024);
+    static_assert((MaxTableBytes / PredictionCacheEntry::MinEntryBytes) <= (1 << 24)); // Covered by "PredictionCacheTable::Bucket".
     if (sizeMebibytes > 0)
     {
         sizeMebibytes = (1 << static_cast<int>(google::protobuf::Bits::Log2FloorNonZero(static_cast<google::protobuf::uint32>(std::min(maxMebibytes, sizeMebibytes)))));
     }
 
     // Do nothing if already identically allocated.
-    if (sizeMebibytes == _allocatedSizeMebibytes)
+    if ((sizeMebibytes == _allocatedSizeMebibytes) && (associativity == _associativity) && (entryBytes == _entryBytes))
     {
         return;
     }
@@ -194,15 +451,15 @@ void PredictionCache::Allocate(int sizeMebibytes)
     Free();
 
     // Use 1 table until reaching the max table size, then scale out to the max table count.
-    const int chunksTotal = (sizeMebibytes * chunksPerMebibyte);
-    const int chunksPerTable = std::clamp(chunksTotal, 1, MaxChunksPerTable); // Handle ("sizeMebibytes" == 0).
-    const int tableCount = (chunksTotal / chunksPerTable);
-    assert((chunksTotal % chunksPerTable) == 0);
+    // Handle ("sizeMebibytes" == 0) with a single bucket.
+    const int bucketBytes = (associativity * entryBytes);
+    const int64_t bytesTotal = (static_cast<int64_t>(sizeMebibytes) * bytesPerMebibyte);
+    const int tableSizeBytes = static_cast<int>(std::clamp(bytesTotal, static_cast<int64_t>(bucketBytes), static_cast<int64_t>(MaxTableBytes)));
+    const int tableCount = static_cast<int>(std::max(INT64_C(1), bytesTotal / tableSizeBytes));
+    const int bucketsPerTable = (tableSizeBytes / bucketBytes);
     assert(tableCount <= MaxTableCount);
-    assert((tableCount > 1) ? (chunksPerTable == MaxChunksPerTable) : (chunksPerTable <= MaxChunksPerTable));
 
     // For each table, try allocate with large page support then fall back to a regular allocation.
-    const int tableSizeBytes = (chunksPerTable * sizeof(PredictionCacheChunk));
     _tables.reserve(tableCount);
     for (int i = 0; i < tableCount; i++)
     {
@@ -227,21 +484,24 @@ void PredictionCache::Allocate(int sizeMebibytes)
             _fallbackAllocations.push_back(memory);
         }
 
-        _tables.push_back(reinterpret_cast<PredictionCacheChunk*>(memory));
+        _tables.emplace_back(memory, bucketsPerTable, associativity, entryBytes);
     }
 
-    _chunksPerTable = chunksPerTable;
-    _entryCapacity = (static_cast<uint64_t>(tableCount) * chunksPerTable * PredictionCacheChunk::EntryCount);
+    _associativity = associativity;
+    _entryBytes = entryBytes;
+    _entryCapacity = (static_cast<uint64_t>(tableCount) * bucketsPerTable * associativity);
     _allocatedSizeMebibytes = sizeMebibytes;
 
     // Technically we don't need to clear on Windows in the case of no fallback allocations,
     // because VirtualAlloc zero-fills memory, but prefer consistency/simplicity in this case.
-    Clear(); // Depends on "_chunksPerTable" and "_entryCapacity".
+    Clear();
 }
 
 void PredictionCache::Free()
 {
     _allocatedSizeMebibytes = 0;
+    _associativity = 0;
+    _entryBytes = 0;
 
     for (void* memory : _allocations)
     {
@@ -258,27 +518,145 @@ void PredictionCache::Free()
     _allocations.clear();
     _fallbackAllocations.clear();
     _tables.clear();
-
-    _chunksPerTable = 0;
+    _mapping.reset();
 
     ResetProbeMetrics();
 
-    _entryCount = 0;
+    for (Metrics& metrics : _metrics)
+    {
+        metrics.entryCount.store(0, std::memory_order_relaxed);
+    }
     _entryCapacity = 0;
 }
 
+// Call only while no threads are searching, so that every entry is consistent.
+void PredictionCache::Save(const std::filesystem::path& path, const std::string& identity)
+{
+    if (_tables.empty())
+    {
+        throw ChessCoachException("Prediction cache not allocated");
+    }
+
+    PredictionCacheFileHeader header = {};
+    header.magic = PredictionCacheFileHeader::Magic;
+    header.version = PredictionCacheFileHeader::Version;
+    header.identityHash = IdentityHash(identity);
+    header.sizeMebibytes = _allocatedSizeMebibytes;
+    header.associativity = _associativity;
+    header.entryBytes = _entryBytes;
+    header.tableCount = static_cast<int32_t>(_tables.size());
+    header.bucketsPerTable = static_cast<int32_t>(_tables.front().SizeBytes() / (static_cast<size_t>(_associativity) * _entryBytes));
+    header.entryCount = SumMetric(&Metrics::entryCount);
+
+    std::vector<char> padded(PredictionCacheFileHeader::PaddedBytes);
+    std::memcpy(padded.data(), &header, sizeof(header));
+
+    // Write to a temporary file then rename, so that a crash never leaves a truncated cache behind,
+    // and so that a mapping of the previous file (if loaded from it) stays intact.
+    std::filesystem::create_directories(path.parent_path());
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(padded.data(), padded.size());
+        for (const PredictionCacheTable& table : _tables)
+        {
+            file.write(reinterpret_cast<const char*>(table.Memory()), table.SizeBytes());
+        }
+        if (!file)
+        {
+            throw ChessCoachException("Failed to write prediction cache: " + temporaryPath.string());
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        std::filesystem::remove(temporaryPath, error);
+        throw ChessCoachException("Failed to replace prediction cache: " + path.string());
+    }
+}
+
+// Replaces the current allocation with a copy-on-write mapping of the file, so that only touched pages are read in.
+// Returns false, leaving the current allocation alone, if the file is missing or doesn't match the current geometry and identity.
+bool PredictionCache::Load(const std::filesystem::path& path, const std::string& identity)
+{
+    if (_tables.empty() || !std::filesystem::exists(path))
+    {
+        return false;
+    }
+
+    std::unique_ptr<MemoryMappedFile> mapping(new MemoryMappedFile(path));
+    if (mapping->Size() < PredictionCacheFileHeader::PaddedBytes)
+    {
+        return false;
+    }
+
+    PredictionCacheFileHeader header;
+    std::memcpy(&header, mapping->Data(), sizeof(header));
+    const int tableCount = static_cast<int>(_tables.size());
+    const size_t tableSizeBytes = _tables.front().SizeBytes();
+    const int bucketsPerTable = static_cast<int>(tableSizeBytes / (static_cast<size_t>(_associativity) * _entryBytes));
+    if ((header.magic != PredictionCacheFileHeader::Magic)
+        || (header.version != PredictionCacheFileHeader::Version)
+        || (header.identityHash != IdentityHash(identity))
+        || (header.sizeMebibytes != _allocatedSizeMebibytes)
+        || (header.associativity != _associativity)
+        || (header.entryBytes != _entryBytes)
+        || (header.tableCount != tableCount)
+        || (header.bucketsPerTable != bucketsPerTable)
+        || (mapping->Size() != (PredictionCacheFileHeader::PaddedBytes + (tableCount * tableSizeBytes))))
+    {
+        return false;
+    }
+
+    // Release the current memory but keep the geometry.
+    const int sizeMebibytes = _allocatedSizeMebibytes;
+    const int associativity = _associativity;
+    const int entryBytes = _entryBytes;
+    Free();
+
+    uint8_t* memory = (reinterpret_cast<uint8_t*>(mapping->Data()) + PredictionCacheFileHeader::PaddedBytes);
+    _tables.reserve(tableCount);
+    for (int i = 0; i < tableCount; i++)
+    {
+        _tables.emplace_back(memory + (i * tableSizeBytes), bucketsPerTable, associativity, entryBytes);
+    }
+    _mapping = std::move(mapping);
+
+    _associativity = associativity;
+    _entryBytes = entryBytes;
+    _entryCapacity = (static_cast<uint64_t>(tableCount) * bucketsPerTable * associativity);
+    _allocatedSizeMebibytes = sizeMebibytes;
+    _metrics.front().entryCount.store(header.entryCount, std::memory_order_relaxed);
+    return true;
+}
+
+int PredictionCache::MaxMoveCount() const
+{
+    return (_tables.empty() ? 0 : _tables.front().MaxMoveCount());
+}
+
 // If returning true, valueOut and priorsOut are populated; chunkOut is not populated.
 // If returning false, valueOut is not populated; priorsOut may be clobbered; chunkOut is populated only if the value/policy should be stored when available.
-bool PredictionCache::TryGetPrediction(Key key, int moveCount, PredictionCacheChunk** chunkOut, float* valueOut, uint16_t* priorsOut)
+bool PredictionCache::TryGetPrediction(Key key, int moveCount, PredictionCacheChunk* chunkOut, float* valueOut, uint16_t* priorsOut)
 {
-    if (_tables.empty())
+    if (_tables.empty() || (moveCount > MaxMoveCount()))
     {
         return false;
     }
 
-    _probeCount++;
+    // Track positions that need more than one entry separately, to see the evaluations that multi-entry spans recover.
+    Metrics& metrics = LocalMetrics();
+    const bool large = (moveCount > _tables.front().EntryMoveCount());
+    metrics.probeCount.fetch_add(1, std::memory_order_relaxed);
+    if (large)
+    {
+        metrics.largeProbeCount.fetch_add(1, std::memory_order_relaxed);
+    }
 
-    // We're not using very many bits of the key for our tables: currently 26 bits of entries, 23 bits of 64 used to index, 3 bits decided via age/linear scan.
+    // We're not using very many bits of the key for our tables: e.g. 26 bits of entries, 23 bits of 64 used to index, 3 bits decided via associativity.
     // Since hashes are Zobrist we can assume distribution is pretty even across different bit positions. However, since our modulos should be powers of two
     // we don't need to worry about bias and can cheaply xor to combine entropy (between 1x and 2x per combination, depending), with no discards necessary.
 
@@ -287,67 +665,102 @@ bool PredictionCache::TryGetPrediction(Key key, int moveCount, PredictionCacheCh
     // Xor down to 8 bits (covers MaxTableCount, checked in "Allocate").
     static_assert(MaxTableCount == (1 << 8));
     const uint16_t tableKeyXor = ((tableKey & 0xFF) ^ (tableKey >> 8));
-    PredictionCacheChunk* table = _tables[tableKeyXor % _tables.size()];
+    const PredictionCacheTable& table = _tables[tableKeyXor % _tables.size()];
 
-    // Use up to 48 low bits to choose the chunk (e.g. lowest 20 of the 48 for 1-GiB table with 1-MiB chunks).
-    const uint64_t chunkKey = (key & 0xFFFFFFFFFFFF);
-    // Xor lowest 40 bits down to 20 bits (covers MaxChunksPerTable, checked in "Allocate"); don't worry about bits dangling above.
-    static_assert(MaxChunksPerTable == (1 << 20));
-    const uint64_t chunkKeyXor = ((chunkKey & 0xFFFFF) ^ (chunkKey >> 20));
-    PredictionCacheChunk& chunk = table[chunkKeyXor % _chunksPerTable];
-
-    // Age-based differentiation among entries in the chunk covers another 3 bits' worth.
-    if (chunk.TryGet(key, moveCount, valueOut, priorsOut))
+    // The table uses the low 48 bits to choose the bucket. Associativity covers a few more bits' worth.
+    uint8_t* bucket = table.Bucket(key);
+    if (table.TryGet(bucket, key, moveCount, valueOut, priorsOut))
     {
-        _hitCount++;
+        metrics.hitCount.fetch_add(1, std::memory_order_relaxed);
+        if (large)
+        {
+            metrics.largeHitCount.fetch_add(1, std::memory_order_relaxed);
+        }
         return true;
     }
 
-    *chunkOut = &chunk;
+    chunkOut->_cache = this;
+    chunkOut->_table = &table;
+    chunkOut->_bucket = bucket;
     return false;
 }
 
 void PredictionCache::Clear()
 {
-    for (PredictionCacheChunk* table : _tables)
+    for (PredictionCacheTable& table : _tables)
     {
-        assert(_chunksPerTable > 0); // If there are _tables then _chunksPerTable shouldn't be zero.
-        for (int i = 0; i < _chunksPerTable; i++)
-        {
-            table[i].Clear();
-        }
+        table.Clear();
     }
 
     ResetProbeMetrics();
 
-    _entryCount = 0;
+    for (Metrics& metrics : _metrics)
+    {
+        metrics.entryCount.store(0, std::memory_order_relaxed);
+    }
 }
 
 void PredictionCache::ResetProbeMetrics()
 {
-    _hitCount = 0;
-    _evictionCount = 0;
-    _probeCount = 0;
+    for (Metrics& metrics : _metrics)
+    {
+        metrics.hitCount.store(0, std::memory_order_relaxed);
+        metrics.evictionCount.store(0, std::memory_order_relaxed);
+        metrics.probeCount.store(0, std::memory_order_relaxed);
+        metrics.largeHitCount.store(0, std::memory_order_relaxed);
+        metrics.largeProbeCount.store(0, std::memory_order_relaxed);
+    }
+}
+
+PredictionCache::Metrics& PredictionCache::LocalMetrics()
+{
+    static std::atomic_int NextStripe(0);
+    thread_local static int Stripe = (NextStripe.fetch_add(1, std::memory_order_relaxed) % MetricsStripeCount);
+    return _metrics[Stripe];
+}
+
+uint64_t PredictionCache::SumMetric(std::atomic<uint64_t> Metrics::* metric) const
+{
+    uint64_t sum = 0;
+    for (const Metrics& metrics : _metrics)
+    {
+        sum += (metrics.*metric).load(std::memory_order_relaxed);
+    }
+    return sum;
 }
 
 void PredictionCache::PrintDebugInfo()
 {
-    std::cout << "Prediction cache full: " << (static_cast<float>(_entryCount) / _entryCapacity)
-        << ", hit rate: " << (static_cast<float>(_hitCount) / _probeCount) 
-        << ", eviction rate: " << (static_cast<float>(_evictionCount) / _probeCount) << std::endl;
+    const uint64_t entryCount = SumMetric(&Metrics::entryCount);
+    const uint64_t hitCount = SumMetric(&Metrics::hitCount);
+    const uint64_t evictionCount = SumMetric(&Metrics::evictionCount);
+    const uint64_t probeCount = SumMetric(&Metrics::probeCount);
+    const uint64_t largeHitCount = SumMetric(&Metrics::largeHitCount);
+    const uint64_t largeProbeCount = SumMetric(&Metrics::largeProbeCount);
+    const int entryMoveCount = (_tables.empty() ? 0 : _tables.front().EntryMoveCount());
+
+    std::cout << "Prediction cache full: " << (static_cast<float>(entryCount) / _entryCapacity)
+        << ", hit rate: " << (static_cast<float>(hitCount) / probeCount) 
+        << ", eviction rate: " << (static_cast<float>(evictionCount) / probeCount)
+        << ", hit rate (<= " << entryMoveCount << " moves): " << (static_cast<float>(hitCount - largeHitCount) / (probeCount - largeProbeCount))
+        << ", hit rate (> " << entryMoveCount << " moves): " << (static_cast<float>(largeHitCount) / largeProbeCount)
+        << ", large probes: " << (static_cast<float>(largeProbeCount) / probeCount) << std::endl;
 }
 
 int PredictionCache::PermilleFull()
 {
-    return ((_entryCapacity == 0) ? 0 : static_cast<int>(_entryCount * 1000 / _entryCapacity));
+    const uint64_t entryCount = SumMetric(&Metrics::entryCount);
+    return ((_entryCapacity == 0) ? 0 : static_cast<int>(entryCount * 1000 / _entryCapacity));
 }
 
 int PredictionCache::PermilleHits()
 {
-    return ((_probeCount == 0) ? 0 : static_cast<int>(_hitCount * 1000 / _probeCount));
+    const uint64_t probeCount = SumMetric(&Metrics::probeCount);
+    return ((probeCount == 0) ? 0 : static_cast<int>(SumMetric(&Metrics::hitCount) * 1000 / probeCount));
 }
 
 int PredictionCache::PermilleEvictions()
 {
-    return ((_probeCount == 0) ? 0 : static_cast<int>(_evictionCount * 1000 / _probeCount));
-}
\ No newline at end of file
+    const uint64_t probeCount = SumMetric(&Metrics::probeCount);
+    return ((probeCount == 0) ? 0 : static_cast<int>(SumMetric(&Metrics::evictionCount) * 1000 / probeCount));
+}
@@ -18,66 +18,175 @@
 #define _PREDICTIONCACHE_H_
 
 #include <vector>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <filesystem>
 
 #include <Stockfish/types.h>
 
 #include "Network.h"
 #include "Platform.h"
 
-struct alignas(128) PredictionCacheEntry
+// Entries are this 16-byte header followed immediately by quantized priors, filling out a fixed
+// entry size per table (the "entry format"). E.g. 128-byte entries fit 56 priors, 256-byte fit 120.
+struct PredictionCacheEntry
 {
-    // Positions with more moves don't fit in the cache and so shouldn't be probed/stored.
-    static const int MaxMoveCount = 56;
-
+    static constexpr const int MinEntryBytes = 128;
+    static constexpr const int MaxEntryBytes = 512;
+
+    static constexpr int MaxMoveCountForEntryBytes(int entryBytes)
+    {
+        return ((entryBytes - static_cast<int>(sizeof(PredictionCacheEntry))) / static_cast<int>(sizeof(uint16_t)));
+    }
+
+    uint16_t* PolicyPriors() { return reinterpret_cast<uint16_t*>(this + 1); }
+    const uint16_t* PolicyPriors() const { return reinterpret_cast<const uint16_t*>(this + 1); }
+
+    // Seqlock: odd while a writer owns the entry. Readers never wait: a read that overlaps
+    // a write sees a changed sequence and is treated as a miss.
+    std::atomic<uint16_t> sequence;                     // 2 bytes
+    // Insertion order among entries in the same bucket, for replacement. Hits don't touch it.
+    uint16_t generation;                                // 2 bytes
+    union
+    {
+        float value;                                    // 4 bytes (first entry in a span)
+        uint32_t tag;                                   // 4 bytes (continuation entries)
+    };
     Key key;                                            // 8 bytes
-    float value;                                        // 4 bytes
-    int age;                                            // 4 bytes
-    std::array<uint16_t, MaxMoveCount> policyPriors;    // 112 bytes
 };
-static_assert(sizeof(PredictionCacheEntry) == 128);
+static_assert(sizeof(PredictionCacheEntry) == 16);
+static_assert(PredictionCacheEntry::MaxMoveCountForEntryBytes(128) == 56);
+static_assert(std::atomic<uint16_t>::is_always_lock_free);
+
+class PredictionCache;
+
+// Saved caches are this header, padded to a page, followed by each table's memory in order.
+// Loading requires the same geometry and network identity, so that tables can map the file directly.
+struct PredictionCacheFileHeader
+{
+    static constexpr const uint32_t Magic = 0x50434343; // "CCCP"
+    static constexpr const uint32_t Version = 1;
+    static constexpr const int PaddedBytes = 4096;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t identityHash;
+    int32_t sizeMebibytes;
+    int32_t associativity;
+    int32_t entryBytes;
+    int32_t tableCount;
+    int32_t bucketsPerTable;
+    int32_t reserved;
+    uint64_t entryCount;
+};
+static_assert(sizeof(PredictionCacheFileHeader) <= PredictionCacheFileHeader::PaddedBytes);
 
-struct alignas(1024) PredictionCacheChunk
+// A power-of-two array of buckets, each holding "associativity" entries of "entryBytes" each.
+//
+// Positions with more moves than fit in one entry span up to "MaxSpan" entries in the same bucket:
+// the first holds the value and first priors, and continuations hold the rest.
+class PredictionCacheTable
 {
 public:
 
-    void Put(Key key, float value, int moveCount, const uint16_t* priors);
+    static constexpr const int MaxSpan = 4;
 
-private:
+    PredictionCacheTable(void* memory, int bucketCount, int associativity, int entryBytes);
 
+    uint8_t* Bucket(Key key) const;
+    bool TryGet(const uint8_t* bucket, Key key, int moveCount, float* valueOut, uint16_t* priorsOut) const;
+    void Put(uint8_t* bucket, Key key, float value, int moveCount, const uint16_t* priors, int* filledCountOut, int* evictedCountOut) const;
     void Clear();
-    bool TryGet(Key key, int moveCount, float* valueOut, uint16_t* priorsOut);
+
+    int EntryMoveCount() const;
+    int MaxMoveCount() const;
+    int EntryCount() const;
+    uint8_t* Memory() const;
+    size_t SizeBytes() const;
 
 private:
 
-    static const int EntryCount = 8;
+    static Key SpanKey(Key key, int spanIndex);
+    static uint32_t SpanTag(uint16_t generation, uint16_t sequence);
 
-    std::array<PredictionCacheEntry, EntryCount> _entries;  // 1024 bytes
+    int Span(int moveCount) const;
+    const PredictionCacheEntry* Find(const uint8_t* bucket, Key key) const;
+    PredictionCacheEntry& Entry(uint8_t* bucket, int index) const;
+    const PredictionCacheEntry& Entry(const uint8_t* bucket, int index) const;
 
-    friend class PredictionCache;
+private:
+
+    uint8_t* _memory;
+    int _bucketCount;
+    int _associativity;
+    int _entryBytes;
 };
 
-static_assert(sizeof(PredictionCacheChunk) == 1024);
+// Returned on a cache miss: where to store the prediction once it's available.
+class PredictionCacheChunk
+{
+public:
+
+    PredictionCacheChunk();
 
+    explicit operator bool() const;
+    void Put(Key key, float value, int moveCount, const uint16_t* priors);
+
+private:
+
+    PredictionCache* _cache;
+    const PredictionCacheTable* _table;
+    uint8_t* _bucket;
+
+    friend class PredictionCache;
+};
+
+// Each table carries its own associativity and entry format, but "Allocate" deliberately gives every table the same
+// ones: keys are spread across tables by hash, so mixed formats would make whether a position can be cached at all
+// ("MaxMoveCount") depend on its hash, and saved caches map tables directly using one geometry in the file header.
 class PredictionCache
 {
 public:
 
     static PredictionCache Instance;
 
+    static uint64_t IdentityHash(const std::string& identity);
+
 private:
 
     constexpr static const int MaxTableCount = (1 << 8);
-    constexpr static const int MaxChunksPerTable = (1 << 20);
+    constexpr static const int MaxTableBytes = (1 << 30);
+    constexpr static const int MaxAssociativity = 64;
+
+    // Metrics are striped across cache lines by thread so that probes from many threads don't
+    // all write to the same line.
+    constexpr static const int MetricsStripeCount = 64;
+
+    struct alignas(64) Metrics
+    {
+        std::atomic<uint64_t> hitCount;
+        std::atomic<uint64_t> evictionCount;
+        std::atomic<uint64_t> probeCount;
+        std::atomic<uint64_t> entryCount;
+        std::atomic<uint64_t> largeHitCount;
+        std::atomic<uint64_t> largeProbeCount;
+    };
 
 public:
 
     PredictionCache();
     ~PredictionCache();
 
-    void Allocate(int sizeMebibytes);
+    void Allocate(int sizeMebibytes, int associativity, int entryBytes);
     void Free();
 
-    bool TryGetPrediction(Key key, int moveCount, PredictionCacheChunk** chunkOut, float* valueOut, uint16_t* priorsOut);
+    void Save(const std::filesystem::path& path, const std::string& identity);
+    bool Load(const std::filesystem::path& path, const std::string& identity);
+
+    int MaxMoveCount() const;
+
+    bool TryGetPrediction(Key key, int moveCount, PredictionCacheChunk* chunkOut, float* valueOut, uint16_t* priorsOut);
     void Clear();
     void ResetProbeMetrics();
 
@@ -86,22 +195,25 @@ public:
     int PermilleHits();
     int PermilleEvictions();
 
+private:
+
+    Metrics& LocalMetrics();
+    uint64_t SumMetric(std::atomic<uint64_t> Metrics::* metric) const;
+
 private:
 
     int _allocatedSizeMebibytes;
-    std::vector<PredictionCacheChunk*> _tables;
+    int _associativity;
+    int _entryBytes;
+    std::vector<PredictionCacheTable> _tables;
     std::vector<void*> _allocations;
     std::vector<void*> _fallbackAllocations;
-    int _chunksPerTable;
-
-    uint64_t _hitCount;
-    uint64_t _evictionCount;
-    uint64_t _probeCount;
+    std::unique_ptr<MemoryMappedFile> _mapping;
 
-    uint64_t _entryCount;
+    std::array<Metrics, MetricsStripeCount> _metrics;
     uint64_t _entryCapacity;
 
-    friend struct PredictionCacheChunk;
+    friend class PredictionCacheChunk;
 };
 
-#endif // _PREDICTIONCACHE_H_
\ No newline at end of file
+#endif // _PREDICTIONCACHE_H_
@@ -0,0 +1,115 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include "PredictionPipeline.h"
+
+#include <cassert>
+
+#include "Instrumentation.h"
+#include "Trace.h"
+
+PredictionPipeline::PredictionPipeline(INetwork* network, NetworkType networkType)
+    : _network(network)
+    , _networkType(networkType)
+    , _inFlight(false)
+    , _pending(false)
+    , _shutDown(false)
+    , _batchSize(0)
+    , _images(nullptr)
+    , _values(nullptr)
+    , _policies(nullptr)
+    , _status(PredictionStatus_None)
+{
+    // Start the thread last, after all fields are initialized.
+    _thread = std::thread(&PredictionPipeline::Loop, this);
+}
+
+PredictionPipeline::~PredictionPipeline()
+{
+    // Let any batch in flight finish so that its memory is no longer in use.
+    Wait();
+
+    {
+        std::lock_guard lock(_mutex);
+        _shutDown = true;
+    }
+    _submitted.notify_one();
+    _thread.join();
+}
+
+void PredictionPipeline::Submit(int batchSize, INetwork::InputPlanes* images, float* values, INetwork::OutputPlanes* policies)
+{
+    {
+        std::lock_guard lock(_mutex);
+        assert(!_inFlight);
+
+        _batchSize = batchSize;
+        _images = images;
+        _values = values;
+        _policies = policies;
+        _inFlight = true;
+        _pending = true;
+    }
+    _submitted.notify_one();
+}
+
+PredictionStatus PredictionPipeline::Wait()
+{
+    std::unique_lock lock(_mutex);
+
+    if (!_inFlight)
+    {
+        return PredictionStatus_None;
+    }
+
+    while (_pending)
+    {
+        _completed.wait(lock);
+    }
+
+    _inFlight = false;
+    return _status;
+}
+
+void PredictionPipeline::Loop()
+{
+    Trace::SetThreadName("prediction pipeline");
+
+    std::unique_lock lock(_mutex);
+
+    while (true)
+    {
+        while (!_pending && !_shutDown)
+        {
+            _submitted.wait(lock);
+        }
+        if (_shutDown)
+        {
+            break;
+        }
+
+        // Predict outside of the lock. The submitting thread won't touch the batch or fields until "Wait" sees completion.
+        lock.unlock();
+        const int64_t predictStart = Instrumentation::Start(InstrumentedPhase_PredictBatch);
+        const PredictionStatus status = _network->PredictBatch(_networkType, _batchSize, _images, _values, _policies);
+        Instrumentation::Record(InstrumentedPhase_PredictBatch, predictStart);
+        lock.lock();
+
+        _status = status;
+        _pending = false;
+        _completed.notify_one();
+    }
+}
@@ -0,0 +1,71 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _PREDICTIONPIPELINE_H_
+#define _PREDICTIONPIPELINE_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Network.h"
+
+// Runs network predictions on a dedicated thread so that a worker can keep doing CPU work (MCTS selection,
+// expansion, backpropagation) on one batch of slots while the accelerator works on another batch.
+//
+// Only one batch is ever in flight: "Submit" must be paired with "Wait" before the next "Submit".
+// The images/values/policies memory must not be touched between "Submit" and "Wait".
+class PredictionPipeline
+{
+public:
+
+    PredictionPipeline(INetwork* network, NetworkType networkType);
+    ~PredictionPipeline();
+
+    PredictionPipeline(const PredictionPipeline& other) = delete;
+    PredictionPipeline& operator=(const PredictionPipeline& other) = delete;
+
+    void Submit(int batchSize, INetwork::InputPlanes* images, float* values, INetwork::OutputPlanes* policies);
+
+    // Returns the status of the batch in flight once it's finished, or "PredictionStatus_None" if nothing is in flight.
+    PredictionStatus Wait();
+
+private:
+
+    void Loop();
+
+private:
+
+    INetwork* _network;
+    NetworkType _networkType;
+
+    std::mutex _mutex;
+    std::condition_variable _submitted;
+    std::condition_variable _completed;
+    bool _inFlight;
+    bool _pending;
+    bool _shutDown;
+
+    int _batchSize;
+    INetwork::InputPlanes* _images;
+    float* _values;
+    INetwork::OutputPlanes* _policies;
+    PredictionStatus _status;
+
+    std::thread _thread;
+};
+
+#endif // _PREDICTIONPIPELINE_H_
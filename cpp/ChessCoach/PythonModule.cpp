@@ -26,6 +26,7 @@
 #include <Stockfish/uci.h>
 
 #include "Pgn.h"
+#include "TrainingDataLoader.h"
 
 PyMethodDef PythonModule::ChessCoachMethods[] = {
     { "load_chunk",  PythonModule::LoadChunk, METH_VARARGS, nullptr },
@@ -36,6 +37,8 @@ PyMethodDef PythonModule::ChessCoachMethods[] = {
     { "generate_commentary_image_for_fens",  PythonModule::GenerateCommentaryImageForFens, METH_VARARGS, nullptr },
     { "generate_commentary_image_for_position",  PythonModule::GenerateCommentaryImageForPosition, METH_VARARGS, nullptr },
     { "bot_search",  PythonModule::BotSearch, METH_VARARGS, nullptr },
+    { "create_training_loader",  PythonModule::CreateTrainingLoader, METH_VARARGS, nullptr },
+    { "next_training_batch",  PythonModule::NextTrainingBatch, METH_VARARGS, nullptr },
     { nullptr, nullptr, 0, nullptr }
 };
 
@@ -260,7 +263,8 @@ PyObject* PythonModule::EvaluateParameters(PyObject*/* self*/, PyObject* args)
         const std::filesystem::path epdPath = (Platform::InstallationDataPath() / "StrengthTests" / Config::Misc.Optimization_Epd);
         auto [score, total, positions, totalNodesRequired] = workerGroup.controllerWorker->StrengthTestEpd(
             workerGroup.workCoordinator.get(), epdPath, Config::Misc.Optimization_EpdMovetimeMilliseconds, Config::Misc.Optimization_EpdNodes,
-            Config::Misc.Optimization_EpdFailureNodes, Config::Misc.Optimization_EpdPositionLimit, nullptr /* progress */);
+            Config::Misc.Optimization_EpdFailureNodes, Config::Misc.Optimization_EpdPositionLimit, Config::Misc.Search_StrengthTestConcurrency,
+            nullptr /* progress */);
 
         evaluationScore = totalNodesRequired;
         workerGroup.ShutDown();
@@ -581,4 +585,167 @@ PyObject* PythonModule::BotSearch(PyObject*/* self*/, PyObject* args)
     Py_DECREF(pythonSan);
     Py_DECREF(pythonComment);
     return pythonTuple;
-}
\ No newline at end of file
+}
+
+// Loaders are owned by capsules in Python, shared with the capsules behind each batch's arrays,
+// so that batches can be recycled even after the loader has gone away in Python.
+constexpr const char TrainingLoaderCapsuleName[] = "chesscoach.TrainingDataLoader";
+constexpr const char TrainingBatchCapsuleName[] = "chesscoach.TrainingBatch";
+
+struct TrainingBatchHolder
+{
+    std::shared_ptr<TrainingDataLoader> loader;
+    std::unique_ptr<TrainingBatch> batch;
+};
+
+PyObject* PythonModule::CreateTrainingLoader(PyObject*/* self*/, PyObject* args)
+{
+    PyObject* pythonSources;
+    PyObject* pythonBatchSize;
+    PyObject* pythonShuffleSize;
+    PyObject* pythonKeepGameProportion;
+    PyObject* pythonKeepPositionProportion;
+    PyObject* pythonThreadCount;
+
+    if (!PyArg_UnpackTuple(args, "create_training_loader", 6, 6, &pythonSources, &pythonBatchSize, &pythonShuffleSize,
+        &pythonKeepGameProportion, &pythonKeepPositionProportion, &pythonThreadCount) ||
+        !pythonSources || !pythonBatchSize || !pythonShuffleSize || !pythonKeepGameProportion || !pythonKeepPositionProportion || !pythonThreadCount ||
+        !PyList_Check(pythonSources) || !PyLong_Check(pythonBatchSize) || !PyLong_Check(pythonShuffleSize) ||
+        !PyFloat_Check(pythonKeepGameProportion) || !PyFloat_Check(pythonKeepPositionProportion) || !PyLong_Check(pythonThreadCount))
+    {
+        PyErr_SetString(PyExc_TypeError, "Expected 6 args: sources, batch_size, shuffle_size, keep_game_proportion, keep_position_proportion, thread_count");
+        return nullptr;
+    }
+
+    std::vector<std::vector<std::filesystem::path>> sources;
+    const Py_ssize_t sourceCount = PyList_Size(pythonSources);
+    for (int i = 0; i < sourceCount; i++)
+    {
+        PyObject* pythonChunks = PyList_GetItem(pythonSources, i);
+        if (!PyList_Check(pythonChunks))
+        {
+            PyErr_SetString(PyExc_TypeError, "Expected sources to be a list of lists of bytes paths");
+            return nullptr;
+        }
+
+        std::vector<std::filesystem::path>& chunks = sources.emplace_back();
+        const Py_ssize_t chunkCount = PyList_Size(pythonChunks);
+        for (int j = 0; j < chunkCount; j++)
+        {
+            PyObject* pythonChunk = PyList_GetItem(pythonChunks, j);
+            if (!PyBytes_Check(pythonChunk))
+            {
+                PyErr_SetString(PyExc_TypeError, "Expected sources to be a list of lists of bytes paths");
+                return nullptr;
+            }
+            chunks.emplace_back(std::string(PyBytes_AS_STRING(pythonChunk), PyBytes_GET_SIZE(pythonChunk)));
+        }
+    }
+
+    TrainingDataLoaderOptions options;
+    options.batchSize = PyLong_AsLong(pythonBatchSize);
+    options.shuffleSize = PyLong_AsLong(pythonShuffleSize);
+    options.keepGameProportion = static_cast<float>(PyFloat_AsDouble(pythonKeepGameProportion));
+    options.keepPositionProportion = static_cast<float>(PyFloat_AsDouble(pythonKeepPositionProportion));
+    options.threadCount = PyLong_AsLong(pythonThreadCount);
+
+    std::shared_ptr<TrainingDataLoader>* loader;
+    try
+    {
+        // Storage is only needed for TFRecord chunks.
+        loader = new std::shared_ptr<TrainingDataLoader>(new TrainingDataLoader(Instance().storage, std::move(sources), options));
+    }
+    catch (const ChessCoachException& e)
+    {
+        PyErr_SetString(PyExc_ValueError, e.what());
+        return nullptr;
+    }
+    catch (const std::exception& e)
+    {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+        return nullptr;
+    }
+
+    PyObject* pythonLoader = PyCapsule_New(loader, TrainingLoaderCapsuleName, [](PyObject* capsule)
+        {
+            delete static_cast<std::shared_ptr<TrainingDataLoader>*>(PyCapsule_GetPointer(capsule, TrainingLoaderCapsuleName));
+        });
+    PythonNetwork::PyAssert(pythonLoader);
+    return pythonLoader;
+}
+
+// Returns (images, values, mcts_values, policies) as numpy arrays over the loader's batch buffers, without copying.
+PyObject* PythonModule::NextTrainingBatch(PyObject*/* self*/, PyObject* args)
+{
+    PyObject* pythonLoader;
+
+    if (!PyArg_UnpackTuple(args, "next_training_batch", 1, 1, &pythonLoader) ||
+        !pythonLoader ||
+        !PyCapsule_IsValid(pythonLoader, TrainingLoaderCapsuleName))
+    {
+        PyErr_SetString(PyExc_TypeError, "Expected 1 arg: loader");
+        return nullptr;
+    }
+
+    std::unique_ptr<TrainingBatchHolder> holder(new TrainingBatchHolder());
+    holder->loader = *static_cast<std::shared_ptr<TrainingDataLoader>*>(PyCapsule_GetPointer(pythonLoader, TrainingLoaderCapsuleName));
+
+    std::string error;
+    {
+        NonPythonContext context;
+
+        // Reader threads can fail with anything (e.g. std::bad_alloc or filesystem errors), not just ChessCoachException,
+        // and nothing may propagate through the Python C API.
+        try
+        {
+            holder->batch = holder->loader->NextBatch();
+        }
+        catch (const std::exception& e)
+        {
+            error = e.what();
+        }
+    }
+    if (!error.empty())
+    {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return nullptr;
+    }
+
+    TrainingBatch& batch = *holder->batch;
+    const int batchSize = holder->loader->BatchSize();
+    PyObject* pythonBatch = PyCapsule_New(holder.release(), TrainingBatchCapsuleName, [](PyObject* capsule)
+        {
+            TrainingBatchHolder* holder = static_cast<TrainingBatchHolder*>(PyCapsule_GetPointer(capsule, TrainingBatchCapsuleName));
+            holder->loader->RecycleBatch(std::move(holder->batch));
+            delete holder;
+        });
+    PythonNetwork::PyAssert(pythonBatch);
+
+    // Each array holds a reference to the batch capsule, which recycles the batch once the last array is gone.
+    auto wrap = [&](int dimCount, npy_intp* dims, int type, void* data)
+    {
+        PyObject* pythonArray = PyArray_SimpleNewFromData(dimCount, dims, type, data);
+        PythonNetwork::PyAssert(pythonArray);
+        Py_INCREF(pythonBatch);
+        PyArray_SetBaseObject(reinterpret_cast<PyArrayObject*>(pythonArray), pythonBatch);
+        return pythonArray;
+    };
+
+    npy_intp imageDims[2]{ batchSize, INetwork::InputPlaneCount };
+    npy_intp valueDims[1]{ batchSize };
+    npy_intp policyDims[4]{ batchSize, INetwork::OutputPlaneCount, INetwork::BoardSide, INetwork::BoardSide };
+    PyObject* pythonImages = wrap(Py_ARRAY_LENGTH(imageDims), imageDims, NPY_INT64, batch.images.data());
+    PyObject* pythonValues = wrap(Py_ARRAY_LENGTH(valueDims), valueDims, NPY_FLOAT32, batch.values.data());
+    PyObject* pythonMctsValues = wrap(Py_ARRAY_LENGTH(valueDims), valueDims, NPY_FLOAT32, batch.mctsValues.data());
+    PyObject* pythonPolicies = wrap(Py_ARRAY_LENGTH(policyDims), policyDims, NPY_FLOAT32, batch.policies.data());
+    Py_DECREF(pythonBatch);
+
+    // Pack and return a 4-tuple.
+    PyObject* pythonTuple = PyTuple_Pack(4, pythonImages, pythonValues, pythonMctsValues, pythonPolicies);
+    PythonNetwork::PyAssert(pythonTuple);
+    Py_DECREF(pythonImages);
+    Py_DECREF(pythonValues);
+    Py_DECREF(pythonMctsValues);
+    Py_DECREF(pythonPolicies);
+    return pythonTuple;
+}
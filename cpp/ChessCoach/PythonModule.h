@@ -43,6 +43,8 @@ private:
     static PyObject* GenerateCommentaryImageForFens(PyObject* self, PyObject* args);
     static PyObject* GenerateCommentaryImageForPosition(PyObject* self, PyObject* args);
     static PyObject* BotSearch(PyObject* self, PyObject* args);
+    static PyObject* CreateTrainingLoader(PyObject* self, PyObject* args);
+    static PyObject* NextTrainingBatch(PyObject* self, PyObject* args);
 
 public:
 
@@ -22,6 +22,7 @@
 #include <numpy/arrayobject.h>
 
 #include "Platform.h"
+#include "Instrumentation.h"
 
 thread_local PyGILState_STATE PythonContext::GilState;
 thread_local PyThreadState* PythonContext::ThreadState = nullptr;
@@ -29,6 +30,7 @@ thread_local PyThreadState* PythonContext::ThreadState = nullptr;
 PythonContext::PythonContext()
 {
     // Re-acquire the GIL.
+    InstrumentedScope scope(InstrumentedPhase_GilAcquire);
     if (!ThreadState)
     {
         GilState = PyGILState_Ensure();
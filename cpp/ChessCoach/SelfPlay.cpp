@@ -24,14 +24,25 @@
 #include <numeric>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #include <Stockfish/thread.h>
 #include <Stockfish/uci.h>
 
 #include "Config.h"
+#include "NodeArena.h"
+#include "TranspositionGraph.h"
 #include "Pgn.h"
 #include "Random.h"
 #include "Syzygy.h"
+#include "Instrumentation.h"
+#include "Trace.h"
 
 int8_t TerminalValue::Draw()
 {
@@ -419,6 +430,7 @@ Node* Node::Child(Move match)
 SelfPlayGame::SelfPlayGame()
     : _root(nullptr)
     , _tryHard(false)
+    , _transpositions(false)
     , _image(nullptr)
     , _value(nullptr)
     , _policy(nullptr)
@@ -430,8 +442,9 @@ SelfPlayGame::SelfPlayGame()
 
 SelfPlayGame::SelfPlayGame(INetwork::InputPlanes* image, float* value, INetwork::OutputPlanes* policy, int* tablebaseCardinality)
     : Game()
-    , _root(new Node())
+    , _root(NodeArena::AllocateRoot())
     , _tryHard(false)
+    , _transpositions(false)
     , _image(image)
     , _value(value)
     , _policy(policy)
@@ -444,8 +457,9 @@ SelfPlayGame::SelfPlayGame(INetwork::InputPlanes* image, float* value, INetwork:
 SelfPlayGame::SelfPlayGame(const std::string& fen, const std::vector<Move>& moves, bool tryHard,
     INetwork::InputPlanes* image, float* value, INetwork::OutputPlanes* policy, int* tablebaseCardinality)
     : Game(fen, moves)
-    , _root(new Node())
+    , _root(NodeArena::AllocateRoot())
     , _tryHard(tryHard)
+    , _transpositions(false)
     , _image(image)
     , _value(value)
     , _policy(policy)
@@ -459,6 +473,7 @@ SelfPlayGame::SelfPlayGame(const SelfPlayGame& other)
     : Game(other)
     , _root(other._root)
     , _tryHard(other._tryHard)
+    , _transpositions(other._transpositions)
     , _image(other._image)
     , _value(other._value)
     , _policy(other._policy)
@@ -477,6 +492,7 @@ SelfPlayGame& SelfPlayGame::operator=(const SelfPlayGame& other)
 
     _root = other._root;
     _tryHard = other._tryHard;
+    _transpositions = other._transpositions;
     _image = other._image;
     _value = other._value;
     _policy = other._policy;
@@ -491,6 +507,7 @@ SelfPlayGame::SelfPlayGame(SelfPlayGame&& other) noexcept
     : Game(other)
     , _root(other._root)
     , _tryHard(other._tryHard)
+    , _transpositions(other._transpositions)
     , _image(other._image)
     , _value(other._value)
     , _policy(other._policy)
@@ -513,6 +530,7 @@ SelfPlayGame& SelfPlayGame::operator=(SelfPlayGame&& other) noexcept
 
     _root = other._root;
     _tryHard = other._tryHard;
+    _transpositions = other._transpositions;
     _image = other._image;
     _value = other._value;
     _policy = other._policy;
@@ -559,6 +577,18 @@ bool SelfPlayGame::TryHard() const
     return _tryHard;
 }
 
+bool SelfPlayGame::Transpositions() const
+{
+    return _transpositions;
+}
+
+// Only set for a fresh search tree, since transpositions change how the tree is released (see "TranspositionGraph").
+void SelfPlayGame::SetTranspositions(bool transpositions)
+{
+    assert(_root && !_root->IsExpanded());
+    _transpositions = transpositions;
+}
+
 void SelfPlayGame::ApplyMoveWithRoot(Move move, Node* newRoot)
 {
     ApplyMove(move);
@@ -567,6 +597,12 @@ void SelfPlayGame::ApplyMoveWithRoot(Move move, Node* newRoot)
     // Don't prepare an expanded root here because this is a common path; e.g. for scratch games also.
 }
 
+void SelfPlayGame::UndoMoveWithRoot(Node* newRoot)
+{
+    UndoMove();
+    _root = newRoot;
+}
+
 void SelfPlayGame::ApplyMoveWithRootAndExpansion(Move move, Node* newRoot, SelfPlayWorker& selfPlayWorker)
 {
     ApplyMoveWithRoot(move, newRoot);
@@ -587,9 +623,10 @@ bool SelfPlayGame::TakeExpansionOwnership(Node* node)
     return node->expansion.compare_exchange_strong(expected, Expansion::Expanding, std::memory_order_relaxed);
 }
 
-float SelfPlayGame::ExpandAndEvaluate(SelfPlayState& state, PredictionCacheChunk*& cacheStore, SearchState* searchState,
+float SelfPlayGame::ExpandAndEvaluate(SelfPlayState& state, PredictionCacheChunk& cacheStore, SearchState* searchState,
     bool isSearchRoot, bool generateUniformPredictions)
 {
+    InstrumentedScope scope(InstrumentedPhase_ExpandAndEvaluate);
     Node* root = _root;
 
     // A known-terminal leaf will remain a leaf, so be prepared to
@@ -628,7 +665,9 @@ float SelfPlayGame::ExpandAndEvaluate(SelfPlayState& state, PredictionCacheChunk
     if (state == SelfPlayState::Working)
     {
         // Generate legal moves.
+        const int64_t moveGenerationStart = Instrumentation::Start(InstrumentedPhase_MoveGeneration);
         _expandAndEvaluate_endMoves = generate<LEGAL>(_position, _expandAndEvaluate_moves);
+        Instrumentation::Record(InstrumentedPhase_MoveGeneration, moveGenerationStart);
 
         // Check for checkmate and stalemate.
         const int workingMoveCount = static_cast<int>(_expandAndEvaluate_endMoves - _expandAndEvaluate_moves);
@@ -681,8 +720,8 @@ float SelfPlayGame::ExpandAndEvaluate(SelfPlayState& state, PredictionCacheChunk
         }
 
         // The node isn't terminal, so it's time to take expansion ownership. This protects against cases like:
-        // (a) another thread is racing us to expand and will definitely allocate a new Node[] for children
-        // (b) another thread just expanded and already allocated a new Node[] for children
+        // (a) another thread is racing us to expand and will definitely allocate a new children array
+        // (b) another thread just expanded and already allocated a new children array
         //
         // After successfully taking ownership, either (i) we get a cache hit and immediately expand,
         // or (ii) we set state to WaitingForPrediction, which can imply expansion ownership in future.
@@ -694,20 +733,35 @@ float SelfPlayGame::ExpandAndEvaluate(SelfPlayState& state, PredictionCacheChunk
             return std::numeric_limits<float>::quiet_NaN();
         }
 
+        // In graph mode, link to the children of an already-expanded transposition rather than expanding again.
+        // The search root is always expanded afresh, since it's special (e.g. "searchmoves", first-play urgency).
+        if (_transpositions && !isSearchRoot)
+        {
+            _imageKey = GenerateImageKey(TryHard());
+            float linkedValue;
+            if (TranspositionGraph::Instance.TryLink(_imageKey, root, linkedValue))
+            {
+                searchState->transpositionCount.fetch_add(1, std::memory_order_relaxed);
+                return linkedValue;
+            }
+        }
+
         // Try get a cached prediction. Only hit the cache up to a max ply for self-play since we
         // see enough unique positions/paths to fill the cache no matter what, and it saves on time
         // to evict less. However, in search (TryHard) it's better to keep everything recent.
-        cacheStore = nullptr;
+        cacheStore = PredictionCacheChunk();
         float cachedValue = std::numeric_limits<float>::quiet_NaN();
         bool hitCached = false;
         if (!generateUniformPredictions &&
-            (workingMoveCount <= PredictionCacheEntry::MaxMoveCount) &&
+            (workingMoveCount <= PredictionCache::Instance.MaxMoveCount()) &&
             (TryHard() || (Ply() <= Config::Misc.PredictionCache_MaxPly)))
         {
             // Note that "_imageKey" may be stale whenever "cacheStore" is null.
+            const int64_t cacheProbeStart = Instrumentation::Start(InstrumentedPhase_CacheProbe);
             _imageKey = GenerateImageKey(TryHard());
             hitCached = PredictionCache::Instance.TryGetPrediction(_imageKey, workingMoveCount,
                 &cacheStore, &cachedValue, _quantizedPriors.data());
+            Instrumentation::Record(InstrumentedPhase_CacheProbe, cacheProbeStart);
         }
         if (hitCached)
         {
@@ -723,7 +777,9 @@ float SelfPlayGame::ExpandAndEvaluate(SelfPlayState& state, PredictionCacheChunk
         state = SelfPlayState::WaitingForPrediction;
         if (!generateUniformPredictions)
         {
+            const int64_t imageGenerationStart = Instrumentation::Start(InstrumentedPhase_ImageGeneration);
             GenerateImage(*_image);
+            Instrumentation::Record(InstrumentedPhase_ImageGeneration, imageGenerationStart);
             return std::numeric_limits<float>::quiet_NaN();
         }
     }
@@ -736,6 +792,7 @@ float SelfPlayGame::ExpandAndEvaluate(SelfPlayState& state, PredictionCacheChunk
 
     // Index legal moves into the policy output planes to get logits,
     // then calculate softmax over them to get normalized probabilities for priors.
+    const int64_t softmaxStart = Instrumentation::Start(InstrumentedPhase_Softmax);
     int moveCount = 0;
     for (ExtMove* cur = _expandAndEvaluate_moves; cur != _expandAndEvaluate_endMoves; cur++)
     {
@@ -747,17 +804,17 @@ float SelfPlayGame::ExpandAndEvaluate(SelfPlayState& state, PredictionCacheChunk
     {
         _quantizedPriors[i] = INetwork::QuantizeProbabilityNoZero(_priors[i]);
     }
+    Instrumentation::Record(InstrumentedPhase_Softmax, softmaxStart);
 
     return FinishExpanding(state, cacheStore, searchState, isSearchRoot, moveCount, value);
 }
 
-float SelfPlayGame::FinishExpanding(SelfPlayState& state, PredictionCacheChunk*& cacheStore, SearchState* searchState, bool isSearchRoot, int moveCount, float value)
+float SelfPlayGame::FinishExpanding(SelfPlayState& state, PredictionCacheChunk& cacheStore, SearchState* searchState, bool isSearchRoot, int moveCount, float value)
 {
     // Store evaluated value/priors in the cache if appropriate, before any filtering.
     if (cacheStore)
     {
-        assert(moveCount <= PredictionCacheEntry::MaxMoveCount);
-        cacheStore->Put(_imageKey, value, moveCount, _quantizedPriors.data());
+        cacheStore.Put(_imageKey, value, moveCount, _quantizedPriors.data());
     }
 
     // Handle the UCI "searchmoves" filter at the search root.
@@ -793,6 +850,26 @@ float SelfPlayGame::FinishExpanding(SelfPlayState& state, PredictionCacheChunk*&
     const float firstPlayUrgency = (isSearchRoot ? CHESSCOACH_FIRST_PLAY_URGENCY_ROOT : CHESSCOACH_FIRST_PLAY_URGENCY_DEFAULT);
     Expand(moveCount, firstPlayUrgency);
 
+    // In graph mode, register the new children for transpositions to link to. If another thread just registered
+    // the same position, free these children and link to theirs instead (see "ExpandAndEvaluate").
+    if (_transpositions && !isSearchRoot)
+    {
+        if (!TranspositionGraph::Instance.Register(_imageKey, _root, value))
+        {
+            NodeArena::Free(_root->children, _root->childCount);
+            _root->children = nullptr;
+            _root->childCount = 0;
+
+            float linkedValue;
+            const bool linked = TranspositionGraph::Instance.TryLink(_imageKey, _root, linkedValue);
+            assert(linked);
+            (void)linked;
+            searchState->transpositionCount.fetch_add(1, std::memory_order_relaxed);
+            state = SelfPlayState::Working;
+            return value;
+        }
+    }
+
     // Probe endgame tablebases for a WDL score for the parent.
     // No need to update "value" here for a successful probe: handled generally in Backpropagate().
     if (Syzygy::ProbeWdl(*this, isSearchRoot))
@@ -811,7 +888,7 @@ void SelfPlayGame::Expand(int moveCount, float firstPlayUrgency)
     assert(moveCount > 0);
     assert(moveCount <= std::numeric_limits<uint8_t>::max());
 
-    root->children = new Node[moveCount]{};
+    root->children = NodeArena::AllocateChildren(moveCount);
     root->childCount = static_cast<uint8_t>(moveCount);
     for (int i = 0; i < moveCount; i++)
     {
@@ -842,6 +919,13 @@ void SelfPlayGame::DebugExpandCanonicalOrdering()
     Expand(moveCount, CHESSCOACH_FIRST_PLAY_URGENCY_DEFAULT);
 }
 
+// Whether the position is a draw by repetition or no-progress along this game's path, the same as "ExpandAndEvaluate"
+// would find for a leaf, but also for already-expanded nodes (see "SelfPlayWorker::RunMcts" in graph mode).
+bool SelfPlayGame::IsDrawOnPath()
+{
+    return (IsDrawByNoProgressOrThreefoldRepetition() || IsDrawByTwofoldRepetition(Ply() - _searchRootPly));
+}
+
 // Avoid Position::is_draw because it regenerates legal moves.
 // If we've already just checked for checkmate and stalemate then this works fine.
 bool SelfPlayGame::IsDrawByTwofoldRepetition(int plyToSearchRoot)
@@ -922,20 +1006,29 @@ void SelfPlayGame::PruneExcept(Node* root, Node*& except)
         return;
     }
 
+    InstrumentedScope scope(InstrumentedPhase_Pruning);
+
     // Rely on caller to already have updated the _root to the preserved subtree.
     assert(_root != root);
     assert(_root == except);
 
     // Hoist "except" from an array member to its own root allocation.
-    _root = new Node(*except);
+    _root = NodeArena::AllocateRoot(*except);
 
-    // Don't let "except"'s descendants get pruned when the original is deleted.
+    // Don't let "except"'s descendants get pruned when the original is released.
     except->children = nullptr;
     except->childCount = 0;
 
-    // Prune, then update the caller's "except" pointer (now deleted) to the clone.
-    PruneAllInternal(root);
-    delete root;
+    // Release the rest of the tree (reclaimed later, see "NodeArena"), then update the caller's "except" pointer to the clone.
+    // Graphs need to keep anything still reachable from the new root (see "TranspositionGraph").
+    if (_transpositions)
+    {
+        TranspositionGraph::Instance.ReleaseUnreachable(root, _root);
+    }
+    else
+    {
+        NodeArena::Release(root);
+    }
     root = nullptr;
     except = _root;
 }
@@ -947,23 +1040,16 @@ void SelfPlayGame::PruneAll()
         return;
     }
 
-    PruneAllInternal(_root);
-    delete _root;
-    _root = nullptr;
-}
-
-void SelfPlayGame::PruneAllInternal(Node* node)
-{
-    for (Node& child : *node)
+    InstrumentedScope scope(InstrumentedPhase_Pruning);
+    if (_transpositions)
     {
-        if (child.IsExpanded())
-        {
-            PruneAllInternal(&child);
-        }
+        TranspositionGraph::Instance.ReleaseAll(_root);
     }
-    delete[] node->children;
-    node->children = nullptr;
-    node->childCount = 0;
+    else
+    {
+        NodeArena::Release(_root);
+    }
+    _root = nullptr;
 }
 
 void SelfPlayGame::AddExplorationNoise()
@@ -1025,16 +1111,20 @@ void SearchState::Reset(const TimeControl& setTimeControl, std::chrono::time_poi
     previousNodeCount = 0;
     guiLine.clear();
     guiLineMoves.clear();
+    lastTreeBudgetCheck = setSearchStart;
+    treeEvictedBytes = 0;
 
     nodeCount = 0;
     failedNodeCount = 0;
     tablebaseHitCount = 0;
+    transpositionCount = 0;
     principalVariationChanged = false;
 }
 
 SelfPlayWorker::SelfPlayWorker(Storage* storage, SearchState* searchState, int gameCount)
     : _storage(storage)
     , _generateUniformPredictions(false)
+    , _reuseScratchGames(true)
     , _states(gameCount)
     , _images(gameCount)
     , _values(gameCount)
@@ -1042,13 +1132,16 @@ SelfPlayWorker::SelfPlayWorker(Storage* storage, SearchState* searchState, int g
     , _tablebaseCardinalities(gameCount)
     , _games(0) // Allocate pooled StateInfos on the worker thread.
     , _scratchGames(0) // Allocate pooled StateInfos on the worker thread.
+    , _scratchPaths(gameCount)
     , _gameStarts(gameCount)
     , _mctsSimulations(gameCount, 0)
     , _mctsSimulationLimits(gameCount, 0)
     , _searchPaths(gameCount)
     , _cacheStores(gameCount)
     , _searchState(searchState)
-    , _currentParallelism(0)
+    , _pipelineDepth(1)
+    , _pipelineBatchSizes(1, 0)
+    , _treeVisitsRoot(nullptr)
 {
 }
 
@@ -1063,6 +1156,11 @@ void SelfPlayWorker::Initialize()
 
 void SelfPlayWorker::Finalize()
 {
+    // Let any prediction in flight finish and stop the pipeline thread before slot memory goes away.
+    _predictionPipeline.reset();
+    _pipelineDepth = 1;
+    _pipelineBatchSizes.assign(1, 0);
+
     // Deallocate pooled StateInfos on the allocating worker thread.
     _scratchGames.clear();
     _games.clear();
@@ -1070,7 +1168,9 @@ void SelfPlayWorker::Finalize()
 
 void SelfPlayWorker::LoopSelfPlay(WorkCoordinator* workCoordinator, INetwork* network, NetworkType networkType, int /* threadIndex */)
 {
+    Trace::SetThreadName("self-play");
     Initialize();
+    InitializePipeline(network, networkType, Config::Network.SelfPlay.PredictionPipelineDepth);
 
     // Wait until games are required.
     while (workCoordinator->WaitForWorkItems())
@@ -1088,12 +1188,7 @@ void SelfPlayWorker::LoopSelfPlay(WorkCoordinator* workCoordinator, INetwork* ne
         if (!_generateUniformPredictions)
         {
             const PredictionStatus warmupStatus = WarmUpPredictions(network, networkType, static_cast<int>(_images.size()));
-            if ((warmupStatus & PredictionStatus_UpdatedNetwork) && PredictionCacheResetThrottle.TryFire())
-            {
-                // This thread has permission to clear the prediction cache after seeing an updated network.
-                std::cout << "Clearing the prediction cache" << std::endl;
-                PredictionCache::Instance.Clear();
-            }
+            CheckClearPredictionCache(warmupStatus);
         }
 
         // Set up any uninitialized games. It's important to do this here so that "_gameStarts" is accurate for MCTS timing.
@@ -1107,11 +1202,15 @@ void SelfPlayWorker::LoopSelfPlay(WorkCoordinator* workCoordinator, INetwork* ne
             }
         }
 
-        // Play games until required.
+        // Play games until required. With a prediction pipeline, work through one group of slots at a time
+        // so that CPU work on this group overlaps with GPU work on the previous group.
+        int pipelineGroup = 0;
         while (!workCoordinator->AllWorkItemsCompleted())
         {
             // CPU work
-            for (int i = 0; i < _games.size(); i++)
+            const auto [slotBegin, slotEnd] = PipelineSlots(pipelineGroup);
+            const int64_t mctsStart = Instrumentation::Start(InstrumentedPhase_Mcts);
+            for (int i = slotBegin; i < slotEnd; i++)
             {
                 Play(i);
 
@@ -1126,18 +1225,21 @@ void SelfPlayWorker::LoopSelfPlay(WorkCoordinator* workCoordinator, INetwork* ne
                     Play(i);
                 }
             }
+            Instrumentation::Record(InstrumentedPhase_Mcts, mctsStart);
 
             // GPU work
             if (!_generateUniformPredictions)
             {
-                const PredictionStatus status = network->PredictBatch(networkType, static_cast<int>(_images.size()), _images.data(), _values.data(), _policies.data());
-                if ((status & PredictionStatus_UpdatedNetwork) && PredictionCacheResetThrottle.TryFire())
-                {
-                    // This thread has permission to clear the prediction cache after seeing an updated network.
-                    std::cout << "Clearing the prediction cache" << std::endl;
-                    PredictionCache::Instance.Clear();
-                }
+                const PredictionStatus status = PredictPipelined(network, networkType, slotBegin, (slotEnd - slotBegin));
+                CheckClearPredictionCache(status);
             }
+            pipelineGroup = ((pipelineGroup + 1) % _pipelineDepth);
+        }
+
+        // Finish any prediction in flight so that every slot is ready to continue from group 0 next time.
+        if (!_generateUniformPredictions)
+        {
+            CheckClearPredictionCache(DrainPipeline());
         }
 
         // Don't free nodes here. Let the games and MCTS trees be continued using the next network
@@ -1159,7 +1261,8 @@ void SelfPlayWorker::ClearGame(int index, const std::chrono::time_point<std::chr
     _mctsSimulations[index] = 0;
     _mctsSimulationLimits[index] = ChooseSimulationLimit();
     _searchPaths[index].clear();
-    _cacheStores[index] = nullptr;
+    _scratchPaths[index].clear();
+    _cacheStores[index] = PredictionCacheChunk();
 }
 
 void SelfPlayWorker::SetUpGame(int index, const std::chrono::time_point<std::chrono::high_resolution_clock>& now)
@@ -1208,7 +1311,7 @@ void SelfPlayWorker::SetUpGameExisting(int index, const std::chrono::time_point<
         }
         else
         {
-            newRoot = ((i == (moves.size() - 1)) ? new Node() : nullptr);
+            newRoot = ((i == (moves.size() - 1)) ? NodeArena::AllocateRoot() : nullptr);
             game.PruneAll();
             game.ApplyMoveWithRoot(move, newRoot);
         }
@@ -1259,13 +1362,14 @@ void SelfPlayWorker::StrengthTestNetwork(WorkCoordinator* workCoordinator, INetw
 {
     std::cout << "Running strength tests..." << std::endl;
 
-    // Only run STS in the interest of time.
+    // Only run STS in the interest of time. With a node budget, search positions concurrently.
     const std::string stsName = "STS";
-    const int moveTimeMs = 200;
+    const int nodes = Config::Misc.Search_StrengthTestNodes;
+    const int moveTimeMs = ((nodes > 0) ? 0 : 200);
     const std::filesystem::path epdPath = (Platform::InstallationDataPath() / "StrengthTests" / "STS.epd");
     std::cout << "Testing " << epdPath.filename() << "..." << std::endl;
     const auto [score, total, positions, totalNodesRequired] = StrengthTestEpd(workCoordinator, epdPath,
-        moveTimeMs, 0 /* nodes */, 0 /* failureNodes */, 0 /* positionLimit */, nullptr /* progress */);
+        moveTimeMs, nodes, 0 /* failureNodes */, 0 /* positionLimit */, Config::Misc.Search_StrengthTestConcurrency, nullptr /* progress */);
 
     // Estimate an Elo rating using logic here: https://github.com/fsmosca/STS-Rating/blob/master/sts_rating.py
     const float slope = 445.23f;
@@ -1287,8 +1391,11 @@ void SelfPlayWorker::StrengthTestNetwork(WorkCoordinator* workCoordinator, INetw
 }
 
 // Returns (score, total, positions, totalNodesRequired).
+//
+// With a node budget and "concurrency" above 1, searches that many positions at a time (see "StrengthTestPositions").
+// Time limits still apply, but to each group as a whole, so time-only tests always run one position at a time.
 std::tuple<int, int, int, int> SelfPlayWorker::StrengthTestEpd(WorkCoordinator* workCoordinator, const std::filesystem::path& epdPath,
-    int moveTimeMs, int nodes, int failureNodes, int positionLimit,
+    int moveTimeMs, int nodes, int failureNodes, int positionLimit, int concurrency,
     std::function<void(const std::string&, const std::string&, const std::string&, int, int, int)> progress)
 {
     int score = 0;
@@ -1307,10 +1414,20 @@ std::tuple<int, int, int, int> SelfPlayWorker::StrengthTestEpd(WorkCoordinator*
         positions = std::min(positions, positionLimit);
     }
 
+    const int groupSize = ((nodes > 0) ? std::max(1, concurrency) : 1);
+    std::vector<std::tuple<Move, int, int>> results;
     for (int i = 0; i < positions; i++)
     {
         const StrengthTestSpec& spec = specs[i];
-        const auto [move, points, nodesRequired] = StrengthTestPosition(workCoordinator, spec, moveTimeMs, nodes, failureNodes);
+        if (groupSize == 1)
+        {
+            results.assign(1, StrengthTestPosition(workCoordinator, spec, moveTimeMs, nodes, failureNodes));
+        }
+        else if ((i % groupSize) == 0)
+        {
+            results = StrengthTestPositions(workCoordinator, &spec, std::min(groupSize, positions - i), moveTimeMs, nodes, failureNodes);
+        }
+        const auto [move, points, nodesRequired] = results[i % groupSize];
         const int available = (spec.points.empty() ? 1 : *std::max_element(spec.points.begin(), spec.points.end()));
         score += points;
         total += available;
@@ -1359,7 +1476,7 @@ std::tuple<Move, int, int> SelfPlayWorker::StrengthTestPosition(WorkCoordinator*
     // Pick a best move and judge points.
     const Node* best = SelectMove(_games[0], false /* allowDiversity */);
     const Move bestMove = Move(best->move);
-    const auto [points, nodesRequired] = JudgeStrengthTestPosition(spec, bestMove, _searchState->lastBestNodes, failureNodes);
+    const auto [points, nodesRequired] = JudgeStrengthTestPosition(spec, _games[0].GetPosition(), bestMove, _searchState->lastBestNodes, failureNodes);
 
     // Free nodes after strength testing (especially for the final position, for which there's no following PruneAll/SetUpGame).
     _games[0].PruneAll();
@@ -1367,14 +1484,41 @@ std::tuple<Move, int, int> SelfPlayWorker::StrengthTestPosition(WorkCoordinator*
     return { bestMove, points, nodesRequired };
 }
 
-std::pair<int, int> SelfPlayWorker::JudgeStrengthTestPosition(const StrengthTestSpec& spec, Move move, int lastBestNodes, int failureNodes)
+// Searches "count" positions at once as search requests, sharing prediction batches, then judges each exactly like
+// "StrengthTestPosition", using root visits rather than whole-search nodes when the best move last changed.
+std::vector<std::tuple<Move, int, int>> SelfPlayWorker::StrengthTestPositions(WorkCoordinator* workCoordinator, const StrengthTestSpec* specs, int count,
+    int moveTimeMs, int nodes, int failureNodes)
+{
+    std::vector<SearchResult> searchResults(count);
+    std::vector<SearchRequest> requests(count);
+    for (int i = 0; i < count; i++)
+    {
+        requests[i].fen = specs[i].fen;
+        requests[i].timeControl.moveTimeMs = moveTimeMs;
+        requests[i].timeControl.nodes = nodes;
+        requests[i].callback = [&, i](const SearchResult& result) { searchResults[i] = result; };
+    }
+    SearchRequests(workCoordinator, requests);
+
+    std::vector<std::tuple<Move, int, int>> results;
+    for (int i = 0; i < count; i++)
+    {
+        const Game position(specs[i].fen, {});
+        const auto [points, nodesRequired] = JudgeStrengthTestPosition(specs[i], position.GetPosition(), searchResults[i].bestMove,
+            searchResults[i].lastBestNodes, failureNodes);
+        results.emplace_back(searchResults[i].bestMove, points, nodesRequired);
+    }
+    return results;
+}
+
+std::pair<int, int> SelfPlayWorker::JudgeStrengthTestPosition(const StrengthTestSpec& spec, const Position& position, Move move, int lastBestNodes, int failureNodes)
 {
     assert(spec.pointSans.empty() ^ spec.avoidSans.empty());
     assert(spec.pointSans.size() == spec.points.size());
 
     for (const std::string& avoidSan : spec.avoidSans)
     {
-        const Move avoid = _games[0].ParseSan(avoidSan);
+        const Move avoid = Pgn::ParseSan(position, avoidSan);
         assert(avoid != MOVE_NONE);
         if (avoid == move)
         {
@@ -1385,7 +1529,7 @@ std::pair<int, int> SelfPlayWorker::JudgeStrengthTestPosition(const StrengthTest
     const auto bestPoints = std::max_element(spec.points.begin(), spec.points.end());
     for (int i = 0; i < spec.pointSans.size(); i++)
     {
-        const Move bestOrAlternative = _games[0].ParseSan(spec.pointSans[i]);
+        const Move bestOrAlternative = Pgn::ParseSan(position, spec.pointSans[i]);
         assert(bestOrAlternative != MOVE_NONE);
         if (bestOrAlternative == move)
         {
@@ -1411,7 +1555,7 @@ void SelfPlayWorker::Play(int index)
     while (!IsTerminal(game))
     {
         Node* root = game.Root();
-        const bool mctsFinished = RunMcts(game, _scratchGames[index], _states[index], _mctsSimulations[index],
+        const bool mctsFinished = RunMcts(game, _scratchGames[index], _scratchPaths[index], _states[index], _mctsSimulations[index],
             _mctsSimulationLimits[index], _searchPaths[index], _cacheStores[index], false /* finishOnly */);
         if (state == SelfPlayState::WaitingForPrediction)
         {
@@ -1464,8 +1608,8 @@ void SelfPlayWorker::PredictBatchUniform(int batchSize, INetwork::InputPlanes* /
     std::fill(policiesFlat, policiesFlat + policyCount, 0.f);
 }
 
-bool SelfPlayWorker::RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, SelfPlayState& state, int& mctsSimulation, int& mctsSimulationLimit,
-    std::vector<WeightedNode>& searchPath, PredictionCacheChunk*& cacheStore, bool finishOnly)
+bool SelfPlayWorker::RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, std::vector<Node*>& scratchPath, SelfPlayState& state, int& mctsSimulation,
+    int& mctsSimulationLimit, std::vector<WeightedNode>& searchPath, PredictionCacheChunk& cacheStore, bool finishOnly)
 {
     // Don't get stuck in here forever during search (TryHard) looping on cache hits or terminal nodes.
     // We need to break out and check for PV changes, search stopping, etc. However, need to keep number
@@ -1477,6 +1621,7 @@ bool SelfPlayWorker::RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, Self
     }
     for (; mctsSimulation < mctsSimulationLimit; mctsSimulation++)
     {
+        bool drawOnPath = false;
         if (state == SelfPlayState::Working)
         {
             // When parallel games are used to search a position during UCI or strength testing, it's best to
@@ -1485,6 +1630,7 @@ bool SelfPlayWorker::RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, Self
             {
                 return false;
             }
+            InstrumentedScope selectionScope(InstrumentedPhase_Selection);
 
             // MCTS tree parallelism - enabled when searching, not when training - needs some guidance
             // to avoid repeating the same deterministic child selections:
@@ -1493,19 +1639,28 @@ bool SelfPlayWorker::RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, Self
             // - However, let searches override this when it's important enough; e.g. going down the
             //   same deep line to explore sibling leaves, or revisiting a checkmate.
 
-            scratchGame = game;
+            //
+            // The scratch game is left at the previous simulation's leaf, so only copy the real game when it has moved on.
+            // Otherwise, undo moves back to the deepest node shared with this simulation's path (often just the search root),
+            // which is much cheaper than copying moves, history and the Position for every simulation.
+            if (!_reuseScratchGames || !IsScratchGameReusable(game, scratchGame, scratchPath))
+            {
+                scratchGame = game;
+                scratchPath.assign(1, game.Root());
+            }
             assert(searchPath.empty());
             searchPath.clear();
-            searchPath.push_back({ scratchGame.Root(), 1 });
-            scratchGame.Root()->visitingCount.fetch_add(1, std::memory_order_relaxed);
+            Node* node = game.Root();
+            searchPath.push_back({ node, 1 });
+            node->visitingCount.fetch_add(1, std::memory_order_relaxed);
 
             // We need this acquire-load to synchronize with the release-store of the expanding thread
             // so that the side-effects - children - are visible here.
-            while (scratchGame.Root()->expansion.load(std::memory_order_acquire) == Expansion::Expanded)
+            while (node->expansion.load(std::memory_order_acquire) == Expansion::Expanded)
             {
                 // If we can't select a child it's because parallel MCTS is already expanding all
                 // children. Give up on this one until next iteration.
-                WeightedNode selected = PuctContext(_searchState, scratchGame.Root()).SelectChild();
+                WeightedNode selected = PuctContext(_searchState, node).SelectChild();
                 if (!selected.node)
                 {
                     assert(game.TryHard());
@@ -1513,10 +1668,30 @@ bool SelfPlayWorker::RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, Self
                     return false;
                 }
 
-                scratchGame.ApplyMoveWithRoot(Move(selected.node->move), selected.node);
-                searchPath.push_back(selected /* == scratchGame.Root() */);
+                // The scratch game may already be on this path from the previous simulation.
+                const int depth = static_cast<int>(searchPath.size());
+                if ((depth >= scratchPath.size()) || (scratchPath[depth] != selected.node))
+                {
+                    UnwindScratchGame(scratchGame, scratchPath, depth);
+                    scratchGame.ApplyMoveWithRoot(Move(selected.node->move), selected.node);
+                    scratchPath.push_back(selected.node);
+                }
+                searchPath.push_back(selected);
                 selected.node->visitingCount.fetch_add(1, std::memory_order_relaxed);
+                node = selected.node;
+
+                // In graph mode, nodes can be expanded via a different path, so stop at repetitions on this path
+                // rather than descending into children, which also stops any cycles (see "TranspositionGraph").
+                // Unexpanded nodes are left to "ExpandAndEvaluate", which caches proper draws as terminal.
+                if (game.Transpositions() && node->IsExpanded() && scratchGame.IsDrawOnPath())
+                {
+                    drawOnPath = true;
+                    break;
+                }
             }
+            UnwindScratchGame(scratchGame, scratchPath, static_cast<int>(searchPath.size()));
+            assert(scratchGame.Root() == node);
+            Instrumentation::RecordSelectionDepth(static_cast<int>(searchPath.size()) - 1);
         }
 
         // Call in to ExpandAndEvaluate straight away, since we want to allow multiple threads/games in to visit terminal nodes
@@ -1530,7 +1705,8 @@ bool SelfPlayWorker::RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, Self
         // because beyond trivially cached terminal evaluations, both depend on move generation.
         const bool wasImmediateMate = (scratchGame.Root()->terminalValue.load(std::memory_order_relaxed) == TerminalValue::MateIn<1>());
         const bool isSearchRoot = (game.Root() == scratchGame.Root());
-        float value = scratchGame.ExpandAndEvaluate(state, cacheStore, _searchState, isSearchRoot, _generateUniformPredictions);
+        float value = (drawOnPath ? CHESSCOACH_VALUE_DRAW
+            : scratchGame.ExpandAndEvaluate(state, cacheStore, _searchState, isSearchRoot, _generateUniformPredictions));
         if (state == SelfPlayState::WaitingForPrediction)
         {
             // Wait for network evaluation/priors to come back.
@@ -1560,11 +1736,14 @@ bool SelfPlayWorker::RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, Self
             value += ((CHESSCOACH_VALUE_DRAW - value) * scratchGame.EndgameProportion() * scratchGame.GetPosition().rule50_count() / Config::Network.SelfPlay.ProgressDecayDivisor);
         }
         
+        const int64_t backpropagationStart = Instrumentation::Start(InstrumentedPhase_Backpropagation);
         Backpropagate(searchPath, value, rootValue);
         _searchState->nodeCount.fetch_add(1, std::memory_order_relaxed);
 
         // If we *just found out* that this leaf is a checkmate, prove it backwards as far as possible.
-        if (!wasImmediateMate && scratchGame.Root()->terminalValue.load(std::memory_order_relaxed).IsMateInN())
+        // In graph mode, this path may not know yet, since the leaf may have been proven via another path.
+        if (!drawOnPath && (!wasImmediateMate || game.Transpositions()) &&
+            scratchGame.Root()->terminalValue.load(std::memory_order_relaxed).IsMateInN())
         {
             BackpropagateMate(searchPath);
         }
@@ -1572,6 +1751,7 @@ bool SelfPlayWorker::RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, Self
         // Adjust best-child pointers (principal variation) now that visits and mates have propagated.
         UpdatePrincipalVariation(searchPath);
         ValidatePrincipalVariation(game.Root());
+        Instrumentation::Record(InstrumentedPhase_Backpropagation, backpropagationStart);
 
         // Expanding the search root is a special case. It happens at the very start of a game,
         // and then whenever a previously-unexpanded node is reached as a root (like a 2-repetition,
@@ -1608,6 +1788,27 @@ bool SelfPlayWorker::RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, Self
     return true;
 }
 
+// The scratch game can be reused while the real game is still at the position it was copied from: same search root and ply.
+// Whenever the real game is set up again "ClearGame" forgets the path, and when it plays a move the root and ply change,
+// so nodes on the path are still alive (nodes are only pruned or evicted after moves are played or games are set up again).
+bool SelfPlayWorker::IsScratchGameReusable(const SelfPlayGame& game, const SelfPlayGame& scratchGame, const std::vector<Node*>& scratchPath) const
+{
+    return (!scratchPath.empty() &&
+        (scratchPath.front() == game.Root()) &&
+        ((scratchGame.Ply() - static_cast<int>(scratchPath.size()) + 1) == game.Ply()));
+}
+
+// Undoes moves on the scratch game until the path is "pathSize" nodes long, including the search root.
+void SelfPlayWorker::UnwindScratchGame(SelfPlayGame& scratchGame, std::vector<Node*>& scratchPath, int pathSize)
+{
+    assert(pathSize >= 1);
+    while (scratchPath.size() > pathSize)
+    {
+        scratchPath.pop_back();
+        scratchGame.UndoMoveWithRoot(scratchPath.back());
+    }
+}
+
 void SelfPlayWorker::FailNode(std::vector<WeightedNode>& searchPath)
 {
     for (auto [node, weight] : searchPath)
@@ -1819,6 +2020,18 @@ Node* SelfPlayWorker::SelectMove(const SelfPlayGame& game, bool allowDiversity)
 }
 
 thread_local std::vector<ScoredNode> PuctContext::ScoredNodes;
+thread_local PuctLanes PuctContext::Lanes;
+
+// SIMD scoring gathers these 32-bit words from each child.
+static_assert(std::is_standard_layout_v<Node>);
+static_assert(offsetof(Node, quantizedPrior) == 12);
+static_assert(offsetof(Node, tablebaseRankBound) == 14);
+static_assert(offsetof(Node, visitCount) == 16);
+static_assert(offsetof(Node, visitingCount) == 20);
+static_assert(offsetof(Node, terminalValue) == 22);
+static_assert(offsetof(Node, expansion) == 23);
+static_assert(offsetof(Node, valueAverage) == 24);
+static_assert(offsetof(Node, valueWeight) == 28);
 
 PuctContext::PuctContext(const SearchState* searchState, Node* parent)
     : _parent(parent)
@@ -1851,11 +2064,152 @@ PuctContext::PuctContext(const SearchState* searchState, Node* parent)
     // Localize repeatedly-used config.
     _linearExplorationRate = Config::Network.SelfPlay.LinearExplorationRate;
     _linearExplorationDelay = Config::Network.SelfPlay.LinearExplorationDelay;
+    _virtualLossCoefficient = Config::Network.SelfPlay.VirtualLossCoefficient;
 }
 
 // It's possible because of nodes marked off-limits via "expanding"
 // that this method cannot select a child, instead returning NONE/nullptr.
+//
+// Children are scored 8 at a time into "Lanes" (see "ScoreChildren"), then the top "_eliminationTopCount"
+// by AZ-PUCT get the SBLE-PUCT linear term, as in "SelectChildScalar". Scores match the scalar version exactly,
+// but ties may break differently: the scalar version depends on the order left behind by "std::nth_element".
 WeightedNode PuctContext::SelectChild() const
+{
+#ifdef __AVX2__
+    const int childCount = _parent->childCount;
+    ScoreChildren();
+
+    // Find the AZ-PUCT score of the last child to receive the linear term. Children scoring higher get it,
+    // and enough children scoring the same to make up "_eliminationTopCount", in child order.
+    float threshold = -std::numeric_limits<float>::infinity();
+    int thresholdTiesRemaining = childCount;
+    if (_eliminationTopCount < childCount)
+    {
+        std::copy(Lanes.azPuct.begin(), Lanes.azPuct.begin() + childCount, Lanes.sorted.begin());
+        std::nth_element(Lanes.sorted.begin(), Lanes.sorted.begin() + (_eliminationTopCount - 1), Lanes.sorted.begin() + childCount, std::greater<float>());
+        threshold = Lanes.sorted[_eliminationTopCount - 1];
+        thresholdTiesRemaining = _eliminationTopCount;
+        for (int i = 0; i < childCount; i++)
+        {
+            thresholdTiesRemaining -= (Lanes.azPuct[i] > threshold);
+        }
+    }
+
+    float maxAzPuct = -std::numeric_limits<float>::infinity();
+    float maxSblePuct = -std::numeric_limits<float>::infinity();
+    float azOfMaxSble = -std::numeric_limits<float>::infinity();
+    float maxSblePuctIncludingBlocked = -std::numeric_limits<float>::infinity();
+    Node* maxSble = nullptr;
+    bool bestWasBlocked = false;
+
+    for (int i = 0; i < childCount; i++)
+    {
+        const float azPuct = Lanes.azPuct[i];
+        maxAzPuct = std::max(maxAzPuct, azPuct);
+
+        const bool linear = ((azPuct > threshold) || ((azPuct == threshold) && (thresholdTiesRemaining-- > 0)));
+        const float sblePuct = (linear ? (azPuct + Lanes.linear[i]) : azPuct);
+        if (sblePuct > maxSblePuct)
+        {
+            // Can also include other gates here, like flood protection in small sub-trees.
+            const bool blocked = (static_cast<Expansion>(Lanes.visitingFlags[i] >> 24) == Expansion::Expanding);
+            if (!blocked)
+            {
+                maxSblePuct = sblePuct;
+                azOfMaxSble = azPuct;
+                maxSble = &_parent->children[i];
+            }
+            if (sblePuct > maxSblePuctIncludingBlocked)
+            {
+                maxSblePuctIncludingBlocked = sblePuct;
+                bestWasBlocked = blocked;
+            }
+        }
+    }
+
+    // Select child using max(SBLE-PUCT), but only backpropagate value if its AZ-PUCT is within range of max(AZ-PUCT).
+    const int weight = (!bestWasBlocked) & ((maxAzPuct - azOfMaxSble) <= Config::Network.SelfPlay.BackpropagationPuctThreshold);
+    return { maxSble, weight };
+#else
+    return SelectChildScalar();
+#endif
+}
+
+// Fills "Lanes" with AZ-PUCT scores, SBLE-PUCT linear terms and expansion flags for all children.
+//
+// Node fields are gathered with vector loads rather than individual relaxed atomic loads. Each 32-bit word is
+// naturally aligned and can't tear on x86, and selection already tolerates values that are slightly stale.
+// Children with terminal values or tablebase bounds are rare and re-scored individually.
+void PuctContext::ScoreChildren() const
+{
+#ifdef __AVX2__
+    const int childCount = _parent->childCount;
+    const __m256i strides = _mm256_setr_epi32(0, 32, 64, 96, 128, 160, 192, 224);
+    const __m256i laneIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i lowMask = _mm256_set1_epi32(0xFFFF);
+    const __m256i boundMask = _mm256_set1_epi32(0x3 << 16);
+    const __m256i terminalMask = _mm256_set1_epi32(0xFF << 16);
+    const __m256i nonTerminal = _mm256_set1_epi32(static_cast<uint8_t>(std::numeric_limits<int8_t>::min()) << 16);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256 oneFloat = _mm256_set1_ps(1.f);
+    const __m256 dequantize = _mm256_set1_ps(1.f / 65536.f);
+    const __m256 explorationNumerator = _mm256_set1_ps(_explorationNumerator);
+    const __m256 virtualLossCoefficient = _mm256_set1_ps(_virtualLossCoefficient);
+    const __m256 parentVirtualExploration = _mm256_set1_ps(_parentVirtualExploration);
+    const __m256 linearExplorationRate = _mm256_set1_ps(_linearExplorationRate);
+    const __m256 linearExplorationDelay = _mm256_set1_ps(_linearExplorationDelay);
+
+    for (int i = 0; i < childCount; i += PuctLanes::Width)
+    {
+        // Only gather from children that exist, leaving zeros in the rest of the lanes.
+        const __m256i lanes = _mm256_cmpgt_epi32(_mm256_set1_epi32(childCount - i), laneIndices);
+        const char* base = reinterpret_cast<const char*>(&_parent->children[i]);
+        const __m256i priorBound = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(base + offsetof(Node, quantizedPrior)), strides, lanes, 1);
+        const __m256i visitCount = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(base + offsetof(Node, visitCount)), strides, lanes, 1);
+        const __m256i visitingFlags = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(base + offsetof(Node, visitingCount)), strides, lanes, 1);
+        const __m256 valueAverage = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), reinterpret_cast<const float*>(base + offsetof(Node, valueAverage)), strides, _mm256_castsi256_ps(lanes), 1);
+        const __m256i valueWeight = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(base + offsetof(Node, valueWeight)), strides, lanes, 1);
+
+        // See "Node::Prior" and "VirtualExploration".
+        const __m256 prior = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_and_si256(priorBound, lowMask), one)), dequantize);
+        const __m256i visitingCount = _mm256_and_si256(visitingFlags, lowMask);
+        const __m256 childVirtualExploration = _mm256_cvtepi32_ps(_mm256_add_epi32(visitCount, visitingCount));
+
+        // See "Node::ValueWithVirtualLoss", without bounds.
+        const __m256 virtualLossCount = _mm256_mul_ps(_mm256_cvtepi32_ps(visitingCount), virtualLossCoefficient);
+        const __m256 safeWeight = _mm256_max_ps(oneFloat, _mm256_cvtepi32_ps(valueWeight));
+        const __m256 valueWithVirtualLoss = _mm256_div_ps(_mm256_mul_ps(valueAverage, safeWeight), _mm256_add_ps(safeWeight, virtualLossCount));
+
+        // See "CalculateAzPuctScore", without mate terms, and "CalculateSblePuctScore".
+        const __m256 explorationRate = _mm256_div_ps(explorationNumerator, _mm256_add_ps(childVirtualExploration, oneFloat));
+        const __m256 azPuct = _mm256_add_ps(valueWithVirtualLoss, _mm256_mul_ps(explorationRate, prior));
+        const __m256 linear = _mm256_div_ps(parentVirtualExploration,
+            _mm256_add_ps(_mm256_mul_ps(linearExplorationRate, childVirtualExploration), linearExplorationDelay));
+
+        _mm256_store_ps(&Lanes.azPuct[i], azPuct);
+        _mm256_store_ps(&Lanes.linear[i], linear);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(&Lanes.visitingFlags[i]), visitingFlags);
+
+        // Fall back for children with bounds or terminal values.
+        const __m256i bounded = _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_and_si256(priorBound, boundMask), _mm256_setzero_si256()), _mm256_set1_epi32(-1));
+        const __m256i terminal = _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_and_si256(visitingFlags, terminalMask), nonTerminal), _mm256_set1_epi32(-1));
+        const int special = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(_mm256_or_si256(bounded, terminal), lanes)));
+        if (special)
+        {
+            for (int lane = 0; lane < PuctLanes::Width; lane++)
+            {
+                if (special & (1 << lane))
+                {
+                    const Node* child = &_parent->children[i + lane];
+                    Lanes.azPuct[i + lane] = CalculateAzPuctScore(child, VirtualExploration(child));
+                }
+            }
+        }
+    }
+#endif
+}
+
+WeightedNode PuctContext::SelectChildScalar() const
 {
     float maxAzPuct = -std::numeric_limits<float>::infinity();
     float maxSblePuct = -std::numeric_limits<float>::infinity();
@@ -2246,12 +2600,21 @@ void SelfPlayWorker::DebugResetGame(int index)
 {
     _games[index] = SelfPlayGame();
     _scratchGames[index] = SelfPlayGame();
+    _scratchPaths[index].clear();
+}
+
+// Copies the real game into the scratch game for every simulation instead of undoing back to a shared node, for comparison.
+void SelfPlayWorker::DebugReuseScratchGames(bool reuse)
+{
+    _reuseScratchGames = reuse;
 }
 
 void SelfPlayWorker::LoopSearch(WorkCoordinator* workCoordinator, INetwork* network, NetworkType networkType, int threadIndex)
 {
+    Trace::SetThreadName("search");
     const bool primary = (threadIndex == 0);
     Initialize();
+    InitializePipeline(network, networkType, Config::Misc.Search_PipelineDepth);
 
     // Warm up the GIL and predictions.
     // It's important to hit TPUs with each possible batch size to avoid 2+ second latency later
@@ -2265,36 +2628,68 @@ void SelfPlayWorker::LoopSearch(WorkCoordinator* workCoordinator, INetwork* netw
         // Initialize the search. Multiple threads will race to make shadows of the reference position,
         // which is safe because the shallow fields don't mutate. Care just needs to be taken with the
         // shared Node tree.
-        SearchInitialize(_searchState->position);
+        OnSearchActive(true);
+        const bool searchingRequests = !_searchState->requests.empty();
+        if (searchingRequests)
+        {
+            SearchInitializeRequests(threadIndex);
+        }
+        else
+        {
+            SearchInitialize(_searchState->position);
+        }
 
         // Search until stopped.
+        int pipelineGroup = 0;
         while (!workCoordinator->AllWorkItemsCompleted())
         {
+            // Let the primary worker modify the tree if it needs to (see "CheckTreeBudget").
+            if (!primary && _searchState->pauseRequested.load(std::memory_order_acquire))
+            {
+                CheckPause();
+                pipelineGroup = 0;
+                continue;
+            }
+
             // CPU work
-            if (!SearchPlay(threadIndex))
+            if (!SearchPlay(threadIndex, pipelineGroup))
             {
                 continue;
             }
 
-            // Only the primary worker does housekeeping.
-            if (primary)
+            // Only the primary worker does housekeeping. Requests have their own limits and results instead.
+            if (primary && searchingRequests)
+            {
+                CheckSearchRequests(workCoordinator);
+            }
+            else if (primary)
             {
                 CheckPrincipalVariation();
 
                 CheckUpdateGui(network, false /* forceUpdate */);
 
                 CheckTimeControl(workCoordinator);
+
+                // Evicting restarts this worker's games, so skip predicting for them.
+                if (CheckTreeBudget())
+                {
+                    pipelineGroup = 0;
+                    continue;
+                }
             }
 
             // GPU work
-            network->PredictBatch(networkType, _currentParallelism, _images.data(), _values.data(), _policies.data());
+            PredictPipelined(network, networkType, PipelineSlots(pipelineGroup).first, _pipelineBatchSizes[pipelineGroup]);
+            pipelineGroup = ((pipelineGroup + 1) % _pipelineDepth);
         }
 
         // Let the original position owner free nodes via SearchUpdatePosition(), but fix up node visits/expansions in flight.
+        DrainPipeline();
         FinalizeMcts();
+        OnSearchActive(false);
 
         // Only the primary worker does housekeeping.
-        if (primary)
+        if (primary && !searchingRequests)
         {
             CheckUpdateGui(network, true /* forceUpdate */);
             const Move bestMove = OnSearchFinished();
@@ -2313,8 +2708,10 @@ void SelfPlayWorker::LoopSearch(WorkCoordinator* workCoordinator, INetwork* netw
 
 void SelfPlayWorker::LoopStrengthTest(WorkCoordinator* workCoordinator, INetwork* network, NetworkType networkType, int threadIndex)
 {
+    Trace::SetThreadName("strength test");
     const bool primary = (threadIndex == 0);
     Initialize();
+    InitializePipeline(network, networkType, Config::Misc.Search_PipelineDepth);
 
     // Warm up the GIL and predictions.
     // It's important to hit TPUs with each possible batch size to avoid 2+ second latency later
@@ -2328,19 +2725,32 @@ void SelfPlayWorker::LoopStrengthTest(WorkCoordinator* workCoordinator, INetwork
         // Initialize the search. Multiple threads will race to make shadows of the reference position,
         // which is safe because the shallow fields don't mutate. Care just needs to be taken with the
         // shared Node tree.
-        SearchInitialize(_searchState->position);
+        const bool searchingRequests = !_searchState->requests.empty();
+        if (searchingRequests)
+        {
+            SearchInitializeRequests(threadIndex);
+        }
+        else
+        {
+            SearchInitialize(_searchState->position);
+        }
 
         // Search until stopped.
+        int pipelineGroup = 0;
         while (!workCoordinator->AllWorkItemsCompleted())
         {
             // CPU work
-            if (!SearchPlay(threadIndex))
+            if (!SearchPlay(threadIndex, pipelineGroup))
             {
                 continue;
             }
 
-            // Only the primary worker does housekeeping.
-            if (primary)
+            // Only the primary worker does housekeeping. Requests track their own best moves and limits.
+            if (primary && searchingRequests)
+            {
+                CheckSearchRequests(workCoordinator);
+            }
+            else if (primary)
             {
                 // Update "lastBestNodes" for strength tests.
                 const bool principalVariationChanged = _searchState->principalVariationChanged.exchange(false, std::memory_order_acquire);
@@ -2358,31 +2768,39 @@ void SelfPlayWorker::LoopStrengthTest(WorkCoordinator* workCoordinator, INetwork
             }
 
             // GPU work
-            network->PredictBatch(networkType, _currentParallelism, _images.data(), _values.data(), _policies.data());
+            PredictPipelined(network, networkType, PipelineSlots(pipelineGroup).first, _pipelineBatchSizes[pipelineGroup]);
+            pipelineGroup = ((pipelineGroup + 1) % _pipelineDepth);
         }
 
         // Let the original position owner free nodes via SearchUpdatePosition(), but fix up node visits/expansions in flight.
+        DrainPipeline();
         FinalizeMcts();
     }
 
     Finalize();
 }
 
-bool SelfPlayWorker::SearchPlay(int threadIndex)
+bool SelfPlayWorker::SearchPlay(int threadIndex, int pipelineGroup)
 {
+    InstrumentedScope scope(InstrumentedPhase_Mcts);
+
     // Finish off MCTS for any nodes that were waiting on a network prediction by expanding, backpropagating, etc.,
-    // across all parallel games. This gives us maximum knowledge for the selection of new nodes.
-    for (int i = 0; i < _currentParallelism; i++)
+    // across all parallel games in this pipeline group. This gives us maximum knowledge for the selection of new nodes.
+    // With a pipeline depth of 1 the group covers all games.
+    const auto [slotBegin, slotEnd] = PipelineSlots(pipelineGroup);
+    for (int i = slotBegin; i < (slotBegin + _pipelineBatchSizes[pipelineGroup]); i++)
     {
-        RunMcts(_games[i], _scratchGames[i], _states[i], _mctsSimulations[i], _mctsSimulationLimits[i], _searchPaths[i], _cacheStores[i], true /* finishOnly */);
+        RunMcts(_games[i], _scratchGames[i], _scratchPaths[i], _states[i], _mctsSimulations[i], _mctsSimulationLimits[i], _searchPaths[i], _cacheStores[i], true /* finishOnly */);
     }
 
     // Get maximum throughput in tiny time controls and avoid misshapen MCTS trees by limiting parallelism
     // early on and not flooding nodes into a small tree ("slowstart" feature). This could also be implemented
     // throughout the tree (see in "PuctContext::SelectChild"), but it doesn't seem to help so far.
+    //
+    // Requests usually have small node budgets and rely on full batches across many roots, so skip slowstart for them.
     const int nodeCount = _games[0].Root()->visitCount.load(std::memory_order_relaxed); // Requires "RunMcts" with "finishOnly" to have just run.
     int parallelism = static_cast<int>(_games.size());
-    if (nodeCount < Config::Misc.Search_SlowstartNodes)
+    if (_slotRequests.empty() && (nodeCount < Config::Misc.Search_SlowstartNodes))
     {
         // This thread may not be needed yet.
         if (threadIndex >= Config::Misc.Search_SlowstartThreads)
@@ -2396,12 +2814,26 @@ bool SelfPlayWorker::SearchPlay(int threadIndex)
     }
 
     // Now we can select new nodes based on latest knowledge and chosen parallelism. Cache hits and terminals can still be finished and keep looping.
-    _currentParallelism = parallelism;
-    for (int i = 0; i < parallelism; i++)
+    // Parallelism counts from the first slot overall, so slowstart may leave later pipeline groups idle.
+    int selectEnd = std::clamp(parallelism, slotBegin, slotEnd);
+    for (int i = slotBegin; i < selectEnd; i++)
     {
-        RunMcts(_games[i], _scratchGames[i], _states[i], _mctsSimulations[i], _mctsSimulationLimits[i], _searchPaths[i], _cacheStores[i], false /* finishOnly */);
+        // Slots move on from finished requests, with simulations already finished above. Once every request
+        // has finished, so has every later slot's, so stop the batch here rather than predicting stale images.
+        if (!_slotRequests.empty() && _slotRequests[i]->finished.load(std::memory_order_relaxed))
+        {
+            SearchRequestState* request = ClaimSearchRequest(threadIndex * static_cast<int>(_games.size()) + i);
+            if (!request)
+            {
+                selectEnd = i;
+                break;
+            }
+            AssignSearchRequest(i, request, std::chrono::high_resolution_clock::now());
+        }
+        RunMcts(_games[i], _scratchGames[i], _scratchPaths[i], _states[i], _mctsSimulations[i], _mctsSimulationLimits[i], _searchPaths[i], _cacheStores[i], false /* finishOnly */);
     }
-    
+    _pipelineBatchSizes[pipelineGroup] = (selectEnd - slotBegin);
+
     return true;
 }
 
@@ -2411,15 +2843,85 @@ bool SelfPlayWorker::SearchPlay(int threadIndex)
 // - tracing tf.functions on this thread's assigned TPU/GPU device
 PredictionStatus SelfPlayWorker::WarmUpPredictions(INetwork* network, NetworkType networkType, int batchSize)
 {
+    // Small workers (e.g. fewer games than the slowstart parallelism) can only predict as many positions as they have images.
+    batchSize = std::min(batchSize, static_cast<int>(_images.size()));
+
+    // When pipelining, predictions happen on the pipeline thread, so warm that up instead.
+    if (_predictionPipeline)
+    {
+        _predictionPipeline->Submit(batchSize, _images.data(), _values.data(), _policies.data());
+        return _predictionPipeline->Wait();
+    }
+
     return network->PredictBatch(networkType, batchSize, _images.data(), _values.data(), _policies.data());
 }
 
+void SelfPlayWorker::CheckClearPredictionCache(PredictionStatus status)
+{
+    if ((status & PredictionStatus_UpdatedNetwork) && PredictionCacheResetThrottle.TryFire())
+    {
+        // This thread has permission to clear the prediction cache after seeing an updated network.
+        std::cout << "Clearing the prediction cache" << std::endl;
+        PredictionCache::Instance.Clear();
+    }
+}
+
+void SelfPlayWorker::InitializePipeline(INetwork* network, NetworkType networkType, int pipelineDepth)
+{
+    // Each group needs at least one slot. A depth of 1 predicts synchronously on this thread, as before.
+    _pipelineDepth = std::clamp(pipelineDepth, 1, std::max(1, static_cast<int>(_games.size())));
+    _pipelineBatchSizes.assign(_pipelineDepth, 0);
+    _predictionPipeline.reset();
+    if (_pipelineDepth > 1)
+    {
+        _predictionPipeline.reset(new PredictionPipeline(network, networkType));
+    }
+}
+
+std::pair<int, int> SelfPlayWorker::PipelineSlots(int pipelineGroup) const
+{
+    const int slotCount = static_cast<int>(_states.size());
+    return { (pipelineGroup * slotCount / _pipelineDepth), ((pipelineGroup + 1) * slotCount / _pipelineDepth) };
+}
+
+// Predicts "slotCount" slots starting at "slotBegin". Without a pipeline this happens synchronously.
+// With a pipeline, the previous group's prediction is waited on first and its status is returned,
+// so callers see "PredictionStatus_UpdatedNetwork" one group late, which is fine for cache clearing.
+PredictionStatus SelfPlayWorker::PredictPipelined(INetwork* network, NetworkType networkType, int slotBegin, int slotCount)
+{
+    if (!_predictionPipeline)
+    {
+        if (slotCount <= 0)
+        {
+            return PredictionStatus_None;
+        }
+        InstrumentedScope scope(InstrumentedPhase_PredictBatchWait);
+        return network->PredictBatch(networkType, slotCount, &_images[slotBegin], &_values[slotBegin], &_policies[slotBegin]);
+    }
+
+    const int64_t waitStart = Instrumentation::Start(InstrumentedPhase_PredictBatchWait);
+    const PredictionStatus status = _predictionPipeline->Wait();
+    Instrumentation::Record(InstrumentedPhase_PredictBatchWait, waitStart);
+    if (slotCount > 0)
+    {
+        _predictionPipeline->Submit(slotCount, &_images[slotBegin], &_values[slotBegin], &_policies[slotBegin]);
+    }
+    return status;
+}
+
+PredictionStatus SelfPlayWorker::DrainPipeline()
+{
+    InstrumentedScope scope(InstrumentedPhase_PredictBatchWait);
+    return (_predictionPipeline ? _predictionPipeline->Wait() : PredictionStatus_None);
+}
+
 void SelfPlayWorker::SearchUpdatePosition(const std::string& fen, const std::vector<Move>& moves, bool forceNewPosition)
 {
     // If the new position is the previous position plus some number of moves,
     // just play out the moves rather than throwing away search results.
     if (!forceNewPosition &&
         _games[0].TryHard() &&
+        (_games[0].Transpositions() == Config::Misc.Search_Transpositions) &&
         (fen == _searchState->positionFen) &&
         (moves.size() >= _searchState->positionMoves.size()) &&
         (std::equal(_searchState->positionMoves.begin(), _searchState->positionMoves.end(), moves.begin())))
@@ -2439,6 +2941,7 @@ void SelfPlayWorker::SearchUpdatePosition(const std::string& fen, const std::vec
         }
         _games[0].PruneAll();
         SetUpGame(0, std::chrono::high_resolution_clock::now(), fen, moves, true /* tryHard */);
+        _games[0].SetTranspositions(Config::Misc.Search_Transpositions);
     }
 
     _searchState->position = &_games[0];
@@ -2462,6 +2965,245 @@ void SelfPlayWorker::FinalizeMcts()
     }
 }
 
+// Tracks which workers are searching the shared tree, so that the primary worker knows whom to wait for when pausing.
+// Workers must be finished touching the tree (e.g. "FinalizeMcts") before going inactive.
+void SelfPlayWorker::OnSearchActive(bool active)
+{
+    {
+        std::lock_guard lock(_searchState->pauseMutex);
+        _searchState->activeWorkerCount += (active ? 1 : -1);
+    }
+    _searchState->pauseSignal.notify_all();
+}
+
+// Stops touching the tree until the primary worker is finished with it, then restarts this worker's games
+// from the search root, like resuming a stopped search.
+void SelfPlayWorker::CheckPause()
+{
+    DrainPipeline();
+    FinalizeMcts();
+
+    {
+        std::unique_lock lock(_searchState->pauseMutex);
+        _searchState->pausedWorkerCount++;
+        _searchState->pauseSignal.notify_all();
+        _searchState->pauseSignal.wait(lock, [&]() { return !_searchState->pauseRequested.load(std::memory_order_relaxed); });
+        _searchState->pausedWorkerCount--;
+    }
+
+    SearchInitialize(_searchState->position);
+}
+
+// Keeps the search tree within "tree_budget_mebibytes" during long analysis by collapsing cold, low-visit subtrees
+// back to leaves once the budget is reached. Collapsed nodes keep their visits and values, and just re-expand
+// (usually via the prediction cache) if search comes back to them.
+//
+// Evicting needs the other workers to stop touching the tree, so it's a stop-the-world pause, but takes the tree
+// down to 75% of the budget to keep pauses rare. Returns true if this worker's games were restarted.
+bool SelfPlayWorker::CheckTreeBudget()
+{
+    // Collapsing a subtree in graph mode could free children that transpositions still link to, so budgets only apply to trees.
+    const int budgetMebibytes = Config::Misc.Search_TreeBudgetMebibytes;
+    if ((budgetMebibytes <= 0) || _games[0].Transpositions())
+    {
+        return false;
+    }
+
+    // Throttle checks, and wait for previous evictions/releases to be reclaimed before measuring again.
+    const auto now = std::chrono::high_resolution_clock::now();
+    if ((now - _searchState->lastTreeBudgetCheck) < std::chrono::milliseconds(100))
+    {
+        return false;
+    }
+    _searchState->lastTreeBudgetCheck = now;
+
+    const int64_t budgetBytes = (static_cast<int64_t>(budgetMebibytes) * 1024 * 1024);
+    const int64_t liveBytes = NodeArena::LiveBytes();
+    if ((liveBytes < budgetBytes) || (NodeArena::PendingCount() > 0))
+    {
+        return false;
+    }
+
+    // Pause the other workers.
+    DrainPipeline();
+    FinalizeMcts();
+    {
+        std::unique_lock lock(_searchState->pauseMutex);
+        _searchState->pauseRequested.store(true, std::memory_order_release);
+        _searchState->pauseSignal.wait(lock, [&]() { return (_searchState->pausedWorkerCount >= (_searchState->activeWorkerCount - 1)); });
+    }
+
+    const auto evictStart = std::chrono::high_resolution_clock::now();
+    const int64_t evictedBytes = EvictTree(_games[0].Root(), (liveBytes - (budgetBytes * 3 / 4)));
+    _searchState->treeEvictedBytes += evictedBytes;
+
+    if (_searchState->debug.load(std::memory_order_relaxed))
+    {
+        const float evictMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - evictStart).count();
+        std::cout << "info string [tree] Evicted " << (evictedBytes / (1024 * 1024)) << " MiB of "
+            << (liveBytes / (1024 * 1024)) << " MiB in " << evictMs << " ms" << std::endl;
+    }
+
+    // Resume the other workers.
+    {
+        std::lock_guard lock(_searchState->pauseMutex);
+        _searchState->pauseRequested.store(false, std::memory_order_release);
+    }
+    _searchState->pauseSignal.notify_all();
+
+    SearchInitialize(_searchState->position);
+    return true;
+}
+
+// Collapses subtrees under "root" to free at least "targetBytes" where possible, preferring subtrees
+// least recently visited (fewest visits since the previous eviction), then with fewest visits. The root
+// and principal variation are kept, as are proven mates. Requires that no other thread is touching the tree.
+//
+// Keys are clamped to only decrease going down the tree, so collapsing every top-most subtree with a key at or below
+// some threshold frees memory in key order; binary-search for the smallest threshold that frees enough.
+// Returns the number of bytes released.
+int64_t SelfPlayWorker::EvictTree(Node* root, int64_t targetBytes)
+{
+    if (!root->IsExpanded() || (targetBytes <= 0))
+    {
+        return 0;
+    }
+
+    InstrumentedScope scope(InstrumentedPhase_Pruning);
+
+    if (root != _treeVisitsRoot)
+    {
+        _treeVisits.clear();
+    }
+
+    std::vector<TreeEvictionCandidate> candidates;
+    CollectEvictionCandidates(root, true /* protect */, std::numeric_limits<uint64_t>::max(), candidates);
+
+    std::vector<uint64_t> keys;
+    for (const TreeEvictionCandidate& candidate : candidates)
+    {
+        if (candidate.key != std::numeric_limits<uint64_t>::max())
+        {
+            keys.push_back(candidate.key);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    const auto topMostBytes = [&](uint64_t threshold)
+    {
+        int64_t bytes = 0;
+        for (int i = 0; i < candidates.size();)
+        {
+            if (candidates[i].key <= threshold)
+            {
+                bytes += candidates[i].subtreeBytes;
+                i = candidates[i].subtreeEnd;
+            }
+            else
+            {
+                i++;
+            }
+        }
+        return bytes;
+    };
+
+    int low = 0;
+    int high = (static_cast<int>(keys.size()) - 1);
+    while (low < high)
+    {
+        const int middle = ((low + high) / 2);
+        if (topMostBytes(keys[middle]) >= targetBytes)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+
+    int64_t evictedBytes = 0;
+    if (!keys.empty())
+    {
+        const uint64_t threshold = keys[low];
+        for (int i = 0; i < candidates.size();)
+        {
+            if (candidates[i].key <= threshold)
+            {
+                Node* node = candidates[i].node;
+                NodeArena::ReleaseChildren(node->children, node->childCount);
+                node->children = nullptr;
+                node->childCount = 0;
+                node->bestIndex.store(Node::NoBest, std::memory_order_relaxed);
+                node->expansion.store(Expansion::None, std::memory_order_relaxed);
+
+                evictedBytes += candidates[i].subtreeBytes;
+                i = candidates[i].subtreeEnd;
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    // Remember visits for the surviving tree, to find cold subtrees next time.
+    _treeVisits.clear();
+    SnapshotTreeVisits(root);
+    std::sort(_treeVisits.begin(), _treeVisits.end());
+    _treeVisitsRoot = root;
+
+    return evictedBytes;
+}
+
+// Adds expanded "node" and its expanded descendants in pre-order, recording where each subtree ends.
+// Returns the bytes in the subtree's child arrays.
+int64_t SelfPlayWorker::CollectEvictionCandidates(Node* node, bool protect, uint64_t parentKey, std::vector<TreeEvictionCandidate>& candidates) const
+{
+    uint64_t key = std::numeric_limits<uint64_t>::max();
+    if (!protect && (node->terminalValue.load(std::memory_order_relaxed).EitherMateN() == 0))
+    {
+        const int visits = node->visitCount.load(std::memory_order_relaxed);
+        int recentVisits = visits;
+        const auto previous = std::lower_bound(_treeVisits.begin(), _treeVisits.end(), std::pair<const Node*, int>(node, std::numeric_limits<int>::min()));
+        if ((previous != _treeVisits.end()) && (previous->first == node))
+        {
+            recentVisits = std::max(0, visits - previous->second);
+        }
+        key = std::min(parentKey, ((static_cast<uint64_t>(recentVisits) << 32) | static_cast<uint32_t>(visits)));
+    }
+
+    const int index = static_cast<int>(candidates.size());
+    candidates.push_back({ node, key, 0, 0 });
+
+    int64_t bytes = static_cast<int64_t>(NodeArena::ArrayBytes(node->childCount));
+    const Node* bestChild = (protect ? node->BestChild() : nullptr);
+    for (Node& child : *node)
+    {
+        if (child.IsExpanded())
+        {
+            bytes += CollectEvictionCandidates(&child, (&child == bestChild), key, candidates);
+        }
+    }
+
+    candidates[index].subtreeBytes = bytes;
+    candidates[index].subtreeEnd = static_cast<int>(candidates.size());
+    return bytes;
+}
+
+void SelfPlayWorker::SnapshotTreeVisits(Node* node)
+{
+    _treeVisits.emplace_back(node, node->visitCount.load(std::memory_order_relaxed));
+    for (Node& child : *node)
+    {
+        if (child.IsExpanded())
+        {
+            SnapshotTreeVisits(&child);
+        }
+    }
+}
+
 Move SelfPlayWorker::OnSearchFinished()
 {
     // Print the final PV info and bestmove.
@@ -2741,10 +3483,8 @@ void SelfPlayWorker::CheckTimeControl(WorkCoordinator* workCoordinator)
 void SelfPlayWorker::PrintPrincipalVariation(bool searchFinished)
 {
     const Node* root = _games[0].Root();
-    std::vector<Move> principalVariation;
-
-    const Node* bestChild = root->BestChild();
-    if (!bestChild)
+    const std::vector<PrincipalVariationLine> lines = CollectPrincipalVariations(root, Config::Misc.Search_MultiPv);
+    if (lines.empty())
     {
         // No best move was found, so this is either a terminal node (mate or draw-on-the-board)
         // or not enough nodes have been explored, in which case we take max prior if explored,
@@ -2758,22 +3498,11 @@ void SelfPlayWorker::PrintPrincipalVariation(bool searchFinished)
         return;
     }
 
-    const Node* pvBestChild = bestChild;
-    while (pvBestChild)
-    {
-        principalVariation.push_back(Move(pvBestChild->move));
-        pvBestChild = pvBestChild->BestChild();
-    }
-
     const bool debug = _searchState->debug.load(std::memory_order_relaxed);
     auto now = std::chrono::high_resolution_clock::now();
     const std::chrono::duration sinceSearchStart = (now - _searchState->searchStart);
     _searchState->lastPrincipalVariationPrint = now;
 
-    // Value is from the parent's perspective, so that's already correct for the root perspective
-    const int eitherMateN = bestChild->terminalValue.load(std::memory_order_relaxed).EitherMateN();
-    const float value = bestChild->Value();
-    const int depth = static_cast<int>(principalVariation.size());
     const int64_t searchTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(sinceSearchStart).count();
     const int nodeCount = _searchState->nodeCount.load(std::memory_order_relaxed);
     const int tablebaseHitCount = _searchState->tablebaseHitCount.load(std::memory_order_relaxed);
@@ -2781,42 +3510,125 @@ void SelfPlayWorker::PrintPrincipalVariation(bool searchFinished)
     const int nodesPerSecond = static_cast<int>(nodeCount / searchTimeSeconds);
     const int hashfullPermille = PredictionCache::Instance.PermilleFull();
 
-    std::cout << "info depth " << depth;
-
-    if (eitherMateN != 0)
+    // Search statistics are shared by all lines, so build them once.
+    std::stringstream statistics;
+    statistics << " nodes " << nodeCount << " nps " << nodesPerSecond;
+    if (debug)
     {
-        std::cout << " score mate " << eitherMateN;
+        const int failedNodesPerSecond = static_cast<int>(_searchState->failedNodeCount.load(std::memory_order_relaxed) / searchTimeSeconds);
+        statistics << " fnps " << failedNodesPerSecond;
     }
-    else
+    statistics << " tbhits " << tablebaseHitCount << " time " << searchTimeMs << " hashfull " << hashfullPermille;
+    if (debug)
     {
-        const int score = static_cast<int>(Game::ProbabilityToCentipawns(value));
-        std::cout << " score cp " << score;
+        statistics << " hashhit " << PredictionCache::Instance.PermilleHits()
+            << " hashevict " << PredictionCache::Instance.PermilleEvictions();
     }
 
-    std::cout << " nodes " << nodeCount << " nps " << nodesPerSecond;
-    if (debug)
+    // Report tree memory against any budget like "hashfull", non-standard so after the standard fields.
+    const int treeBudgetMebibytes = Config::Misc.Search_TreeBudgetMebibytes;
+    if (treeBudgetMebibytes > 0)
     {
-        const int failedNodesPerSecond = static_cast<int>(_searchState->failedNodeCount.load(std::memory_order_relaxed) / searchTimeSeconds);
-        std::cout << " fnps " << failedNodesPerSecond;
+        const int64_t treeBudgetBytes = (static_cast<int64_t>(treeBudgetMebibytes) * 1024 * 1024);
+        const int treefullPermille = static_cast<int>(std::min<int64_t>(1000, NodeArena::LiveBytes() * 1000 / treeBudgetBytes));
+        statistics << " treefull " << treefullPermille;
     }
-    std::cout << " tbhits " << tablebaseHitCount << " time " << searchTimeMs << " hashfull " << hashfullPermille;
     if (debug)
     {
-        std::cout << " hashhit " << PredictionCache::Instance.PermilleHits()
-            << " hashevict " << PredictionCache::Instance.PermilleEvictions();
+        statistics << " treemib " << (NodeArena::LiveBytes() / (1024 * 1024))
+            << " treeevictmib " << (_searchState->treeEvictedBytes / (1024 * 1024));
+    }
+    if (debug && _games[0].Transpositions())
+    {
+        const TranspositionGraphStatistics transpositionStatistics = TranspositionGraph::Instance.Statistics();
+        statistics << " transpositions " << _searchState->transpositionCount.load(std::memory_order_relaxed)
+            << " ttentries " << transpositionStatistics.entryCount
+            << " ttmib " << (transpositionStatistics.tableBytes / (1024 * 1024));
+    }
+
+    // Only number lines when asked for more than one, to keep single-PV output unchanged.
+    for (int i = 0; i < lines.size(); i++)
+    {
+        const PrincipalVariationLine& line = lines[i];
+        std::cout << "info depth " << line.moves.size();
+        if (Config::Misc.Search_MultiPv > 1)
+        {
+            std::cout << " multipv " << (i + 1);
+        }
+
+        if (line.eitherMateN != 0)
+        {
+            std::cout << " score mate " << line.eitherMateN;
+        }
+        else
+        {
+            const int score = static_cast<int>(Game::ProbabilityToCentipawns(line.value));
+            std::cout << " score cp " << score;
+        }
+
+        std::cout << statistics.str() << " pv";
+        for (Move move : line.moves)
+        {
+            std::cout << " " << UCI::move(move, false /* chess960 */);
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Collects up to "lineCount" root moves with their own principal variations, best first. The first line always
+// follows the root's best child, matching "bestmove", and further lines rank the other visited children the same way.
+std::vector<PrincipalVariationLine> SelfPlayWorker::CollectPrincipalVariations(const Node* root, int lineCount) const
+{
+    std::vector<PrincipalVariationLine> lines;
+    const Node* bestChild = root->BestChild();
+    if (!bestChild)
+    {
+        return lines;
+    }
+
+    // Select by repeated scans rather than sorting, since visits may still be changing on other threads.
+    std::vector<const Node*> selected{ bestChild };
+    while (selected.size() < lineCount)
+    {
+        const Node* next = nullptr;
+        for (const Node& child : *root)
+        {
+            if ((child.visitCount.load(std::memory_order_relaxed) > 0) &&
+                (std::find(selected.begin(), selected.end(), &child) == selected.end()) &&
+                WorseThan(next, &child))
+            {
+                next = &child;
+            }
+        }
+        if (!next)
+        {
+            break;
+        }
+        selected.push_back(next);
     }
-    std::cout << " pv";
-    for (Move move : principalVariation)
+
+    for (const Node* first : selected)
     {
-        std::cout << " " << UCI::move(move, false /* chess960 */);
+        PrincipalVariationLine& line = lines.emplace_back();
+
+        // Value is from the parent's perspective, so that's already correct for the root perspective
+        line.value = first->Value();
+        line.eitherMateN = first->terminalValue.load(std::memory_order_relaxed).EitherMateN();
+        line.visitCount = first->visitCount.load(std::memory_order_relaxed);
+        for (const Node* node = first; node; node = node->BestChild())
+        {
+            line.moves.push_back(Move(node->move));
+        }
     }
-    std::cout << std::endl;
+    return lines;
 }
 
 void SelfPlayWorker::SearchInitialize(const SelfPlayGame* position)
 {
+    _slotRequests.clear();
+
     // Set up parallelism. Make N games share a tree but have their own image/value/policy slots.
-    _currentParallelism = 0;
+    std::fill(_pipelineBatchSizes.begin(), _pipelineBatchSizes.end(), 0);
     const std::chrono::time_point<std::chrono::high_resolution_clock> now = std::chrono::high_resolution_clock::now();
     for (int i = 0; i < _games.size(); i++)
     {
@@ -2827,6 +3639,361 @@ void SelfPlayWorker::SearchInitialize(const SelfPlayGame* position)
     }
 }
 
+// Like "SearchInitialize", but spreads slots across all search requests so that every worker's
+// batches (and pipeline groups) mix leaves from many roots.
+void SelfPlayWorker::SearchInitializeRequests(int threadIndex)
+{
+    _slotRequests.resize(_games.size());
+
+    std::fill(_pipelineBatchSizes.begin(), _pipelineBatchSizes.end(), 0);
+    const std::chrono::time_point<std::chrono::high_resolution_clock> now = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < _games.size(); i++)
+    {
+        // Nothing has finished yet, so there's always a request to claim.
+        AssignSearchRequest(i, ClaimSearchRequest(threadIndex * static_cast<int>(_games.size()) + i), now);
+    }
+}
+
+// Hands out each request to a slot once, in order, then has any further slots help out unfinished requests
+// (starting from "slotKey" to spread them out). There may be more requests than slots, so slots claim again
+// whenever their request finishes (see "SearchPlay"). Returns null once every request has finished.
+SearchRequestState* SelfPlayWorker::ClaimSearchRequest(int slotKey)
+{
+    const std::vector<std::unique_ptr<SearchRequestState>>& requests = _searchState->requests;
+    const int requestCount = static_cast<int>(requests.size());
+    if (_searchState->nextRequest.load(std::memory_order_relaxed) < requestCount)
+    {
+        const int next = _searchState->nextRequest.fetch_add(1, std::memory_order_relaxed);
+        if (next < requestCount)
+        {
+            return requests[next].get();
+        }
+    }
+
+    for (int i = 0; i < requestCount; i++)
+    {
+        SearchRequestState* request = requests[(slotKey + i) % requestCount].get();
+        if (!request->finished.load(std::memory_order_relaxed))
+        {
+            return request;
+        }
+    }
+    return nullptr;
+}
+
+// The slot must not have a simulation in flight.
+void SelfPlayWorker::AssignSearchRequest(int index, SearchRequestState* request, const std::chrono::time_point<std::chrono::high_resolution_clock>& now)
+{
+    _slotRequests[index] = request;
+    ClearGame(index, now);
+    _games[index] = request->position.SpawnShadow(&_images[index], &_values[index], &_policies[index]);
+}
+
+// Finishes search requests that have reached their own limit, calling back with results straight away, and completes
+// the work item once all have finished. Like "CheckTimeControl", always try to find a best move first.
+void SelfPlayWorker::CheckSearchRequests(WorkCoordinator* workCoordinator)
+{
+    const std::chrono::duration<float> elapsed = (std::chrono::high_resolution_clock::now() - _searchState->searchStart);
+    const int64_t elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    bool allFinished = true;
+    for (const std::unique_ptr<SearchRequestState>& request : _searchState->requests)
+    {
+        if (request->finished.load(std::memory_order_relaxed))
+        {
+            continue;
+        }
+
+        // Track "lastBestNodes" per request, like "LoopStrengthTest" does for a single position.
+        const Node* root = request->position.Root();
+        const Node* bestChild = root->BestChild();
+        if (bestChild && (bestChild->move != request->lastBestMove))
+        {
+            request->lastBestMove = bestChild->move;
+            request->lastBestNodes = root->visitCount.load(std::memory_order_relaxed);
+        }
+
+        const TimeControl& timeControl = request->request.timeControl;
+        const bool terminal = root->terminalValue.load(std::memory_order_relaxed).IsImmediate();
+        // Time limits only need the root expanded, not a best child (e.g. with many more requests than slots),
+        // falling back to the highest prior (see "SelectMove").
+        const bool limitReached = (
+            ((timeControl.nodes > 0) && root->BestChild() && (root->visitCount.load(std::memory_order_relaxed) >= timeControl.nodes)) ||
+            ((timeControl.moveTimeMs > 0) && (elapsedMs >= timeControl.moveTimeMs) && (root->expansion.load(std::memory_order_acquire) == Expansion::Expanded)));
+        if (!terminal && !limitReached)
+        {
+            allFinished = false;
+            continue;
+        }
+
+        // Other slots may still be finishing simulations for this request, but results are good to report now.
+        request->finished.store(true, std::memory_order_relaxed);
+        if (request->request.callback)
+        {
+            request->request.callback(CollectSearchResult(request->position, elapsed.count(), request->lastBestNodes));
+        }
+    }
+
+    if (allFinished)
+    {
+        workCoordinator->OnWorkItemCompleted();
+    }
+}
+
+SearchResult SelfPlayWorker::CollectSearchResult(const SelfPlayGame& position, float seconds, int lastBestNodes) const
+{
+    SearchResult result;
+    result.bestMove = Move(SelectMove(position, false /* allowDiversity */)->move);
+    result.lines = CollectPrincipalVariations(position.Root(), Config::Misc.Search_MultiPv);
+    result.nodeCount = position.Root()->visitCount.load(std::memory_order_relaxed);
+    result.seconds = seconds;
+    result.lastBestNodes = lastBestNodes;
+    return result;
+}
+
+// Searches several independent positions at once on the search workers (looping in "LoopSearch"), so that their leaves
+// share prediction batches, and returns once all have finished. Each request gets its own tree, limit and callback.
+// Requests always search as trees, since graph mode's transposition table is shared (see "TranspositionGraph").
+// The current UCI position is left alone.
+void SelfPlayWorker::SearchRequests(WorkCoordinator* workCoordinator, const std::vector<SearchRequest>& requests)
+{
+    // Make sure that the workers are ready.
+    workCoordinator->WaitForWorkers();
+    if (requests.empty())
+    {
+        return;
+    }
+
+    for (const SearchRequest& request : requests)
+    {
+        if ((request.timeControl.nodes <= 0) && (request.timeControl.moveTimeMs <= 0))
+        {
+            throw ChessCoachException("Search requests need a node or time limit: " + request.fen);
+        }
+    }
+
+    // Set up the positions.
+    assert(_searchState->requests.empty());
+    for (const SearchRequest& request : requests)
+    {
+        std::unique_ptr<SearchRequestState>& state = _searchState->requests.emplace_back(new SearchRequestState());
+        state->request = request;
+        state->tablebaseCardinality = 0;
+        state->position = SelfPlayGame(request.fen, request.moves, true /* tryHard */,
+            nullptr /* image */, nullptr /* value */, nullptr /* policy */, &state->tablebaseCardinality);
+        state->finished = false;
+        state->lastBestMove = MOVE_NONE;
+        state->lastBestNodes = 0;
+    }
+    _searchState->nextRequest = 0;
+    _searchState->Reset(TimeControl{}, std::chrono::high_resolution_clock::now());
+    _searchState->searchMoves.clear();
+
+    // Run the search.
+    workCoordinator->ResetWorkItemsRemaining(1);
+    workCoordinator->WaitForWorkers();
+
+    // Report any requests cut short by a stop, then free their trees now that no worker can reach them.
+    const std::chrono::duration<float> elapsed = (std::chrono::high_resolution_clock::now() - _searchState->searchStart);
+    for (std::unique_ptr<SearchRequestState>& state : _searchState->requests)
+    {
+        if (!state->finished.load(std::memory_order_relaxed) && state->request.callback)
+        {
+            state->request.callback(CollectSearchResult(state->position, elapsed.count(), state->lastBestNodes));
+        }
+        state->position.PruneAll();
+    }
+    _searchState->requests.clear();
+}
+
+// Warms up the prediction cache offline by predicting each position, plus successors up to "plies" deep,
+// in batches of this worker's slot count. Runs on the calling thread, so the worker must not be looping.
+// Returns the number of positions predicted (cache hits and terminal positions aren't counted).
+int SelfPlayWorker::PopulatePredictionCache(INetwork* network, NetworkType networkType, const std::vector<std::string>& fens, int plies)
+{
+    // Positions are a FEN index plus moves from that FEN, so that successors can reuse SelfPlayGame setup.
+    std::vector<std::pair<int, std::vector<Move>>> positions;
+    for (int i = 0; i < fens.size(); i++)
+    {
+        positions.emplace_back(i, std::vector<Move>());
+    }
+
+    Initialize();
+
+    const int batchSize = static_cast<int>(_states.size());
+    std::vector<std::pair<int, std::vector<Move>>> slotPositions(batchSize);
+    int predictionCount = 0;
+    size_t next = 0;
+    while (next < positions.size())
+    {
+        // Set up a batch and take each position as far as needing a prediction.
+        const auto now = std::chrono::high_resolution_clock::now();
+        int slotCount = 0;
+        while ((slotCount < batchSize) && (next < positions.size()))
+        {
+            slotPositions[slotCount] = positions[next++];
+            SetUpGame(slotCount, now, fens[slotPositions[slotCount].first], slotPositions[slotCount].second, true /* tryHard */);
+            _games[slotCount].ExpandAndEvaluate(_states[slotCount], _cacheStores[slotCount], _searchState, false /* isSearchRoot */, false /* generateUniformPredictions */);
+            slotCount++;
+        }
+
+        // Predict the whole batch, since slots not waiting are cheap to carry along, then finish expanding, storing in the cache.
+        const int waitingCount = static_cast<int>(std::count(_states.begin(), _states.begin() + slotCount, SelfPlayState::WaitingForPrediction));
+        if (waitingCount > 0)
+        {
+            network->PredictBatch(networkType, slotCount, _images.data(), _values.data(), _policies.data());
+            predictionCount += waitingCount;
+        }
+        for (int i = 0; i < slotCount; i++)
+        {
+            if (_states[i] == SelfPlayState::WaitingForPrediction)
+            {
+                _games[i].ExpandAndEvaluate(_states[i], _cacheStores[i], _searchState, false /* isSearchRoot */, false /* generateUniformPredictions */);
+            }
+
+            // Queue successors from the freshly expanded root.
+            const auto& [fenIndex, moves] = slotPositions[i];
+            if (moves.size() < plies)
+            {
+                for (const Node& child : *_games[i].Root())
+                {
+                    positions.emplace_back(fenIndex, moves);
+                    positions.back().second.push_back(Move(child.move));
+                }
+            }
+
+            _games[i].PruneAll();
+        }
+    }
+
+    Finalize();
+
+    return predictionCount;
+}
+
+// Writes one analysed position as a single line of JSON.
+void SelfPlayWorker::WriteAnalysis(std::ostream& output, const std::string& fen, const SearchResult& result)
+{
+    output << "{\"fen\":\"" << fen << "\""
+        << ",\"nodes\":" << result.nodeCount
+        << ",\"seconds\":" << result.seconds
+        << ",\"bestmove\":\"" << UCI::move(result.bestMove, false /* chess960 */) << "\""
+        << ",\"lines\":[";
+    for (int i = 0; i < result.lines.size(); i++)
+    {
+        const PrincipalVariationLine& line = result.lines[i];
+        output << ((i > 0) ? "," : "") << "{\"multipv\":" << (i + 1);
+        if (line.eitherMateN != 0)
+        {
+            output << ",\"mate\":" << line.eitherMateN;
+        }
+        else
+        {
+            output << ",\"cp\":" << static_cast<int>(Game::ProbabilityToCentipawns(line.value));
+        }
+        output << ",\"value\":" << line.value
+            << ",\"visits\":" << line.visitCount
+            << ",\"pv\":[";
+        for (int j = 0; j < line.moves.size(); j++)
+        {
+            output << ((j > 0) ? "," : "") << "\"" << UCI::move(line.moves[j], false /* chess960 */) << "\"";
+        }
+        output << "]}";
+    }
+    output << "]}" << std::endl;
+}
+
+// Searches each position for "nodes" using the already-running search workers, writing one JSON object per line
+// with the best move and up to "MultiPV" lines. The prediction cache is kept across positions, unlike strength tests,
+// since analysis sets often share openings and structures. With "concurrency" above 1, that many positions are searched
+// at once as search requests (see "SearchRequests"), and lines are written in order of finishing.
+// Returns the number of positions analysed.
+int SelfPlayWorker::AnalysePositions(WorkCoordinator* workCoordinator, const std::vector<std::string>& fens, int nodes, int concurrency, std::ostream& output)
+{
+    int analysedCount = 0;
+    if (concurrency > 1)
+    {
+        for (int i = 0; i < fens.size(); i += concurrency)
+        {
+            std::vector<SearchRequest> requests;
+            for (int j = i; j < std::min(static_cast<int>(fens.size()), i + concurrency); j++)
+            {
+                SearchRequest& request = requests.emplace_back();
+                request.fen = fens[j];
+                request.timeControl.nodes = nodes;
+                request.callback = [&, j](const SearchResult& result)
+                {
+                    WriteAnalysis(output, fens[j], result);
+                    analysedCount++;
+                };
+            }
+            SearchRequests(workCoordinator, requests);
+        }
+        return analysedCount;
+    }
+
+    for (const std::string& fen : fens)
+    {
+        // Make sure that the workers are ready.
+        workCoordinator->WaitForWorkers();
+
+        // Set up the position, search and node limit.
+        SearchUpdatePosition(fen, {}, true /* forceNewPosition */);
+        TimeControl timeControl = {};
+        timeControl.nodes = nodes;
+        _searchState->Reset(timeControl, std::chrono::high_resolution_clock::now());
+        _searchState->searchMoves.clear();
+
+        // Run the search.
+        workCoordinator->ResetWorkItemsRemaining(1);
+        workCoordinator->WaitForWorkers();
+
+        const std::chrono::duration<float> elapsed = (std::chrono::high_resolution_clock::now() - _searchState->searchStart);
+        WriteAnalysis(output, fen, CollectSearchResult(_games[0], elapsed.count(), _searchState->lastBestNodes));
+        analysedCount++;
+    }
+
+    // Free nodes after analysing (especially for the final position, for which there's no following SearchUpdatePosition).
+    _games[0].PruneAll();
+
+    return analysedCount;
+}
+
+// Searches each position from a new tree for "nodes" using the already-running search workers, for "Bench".
+// Tree bytes are node arena growth during each search, so they don't include transposition table overhead.
+SearchBenchmarkStatistics SelfPlayWorker::BenchmarkSearch(WorkCoordinator* workCoordinator, const std::vector<std::string>& fens, int nodes)
+{
+    SearchBenchmarkStatistics statistics = {};
+    for (const std::string& fen : fens)
+    {
+        // Make sure that the workers are ready.
+        workCoordinator->WaitForWorkers();
+
+        // Set up the position, search and node limit.
+        SearchUpdatePosition(fen, {}, true /* forceNewPosition */);
+        const int64_t baselineTreeBytes = NodeArena::LiveBytes();
+        TimeControl timeControl = {};
+        timeControl.nodes = nodes;
+        _searchState->Reset(timeControl, std::chrono::high_resolution_clock::now());
+        _searchState->searchMoves.clear();
+
+        // Run the search.
+        workCoordinator->ResetWorkItemsRemaining(1);
+        workCoordinator->WaitForWorkers();
+
+        const std::chrono::duration<float> elapsed = (std::chrono::high_resolution_clock::now() - _searchState->searchStart);
+        statistics.nodeCount += _searchState->nodeCount.load(std::memory_order_relaxed);
+        statistics.failedNodeCount += _searchState->failedNodeCount.load(std::memory_order_relaxed);
+        statistics.tablebaseHitCount += _searchState->tablebaseHitCount.load(std::memory_order_relaxed);
+        statistics.maxTreeBytes = std::max(statistics.maxTreeBytes, NodeArena::LiveBytes() - baselineTreeBytes);
+        statistics.seconds += elapsed.count();
+    }
+
+    // Free nodes after benchmarking (especially for the final position, for which there's no following SearchUpdatePosition).
+    _games[0].PruneAll();
+
+    return statistics;
+}
+
 void SelfPlayWorker::CommentOnPosition(INetwork* network)
 {
     std::unique_ptr<INetwork::CommentaryInputPlanes> image(std::make_unique<INetwork::CommentaryInputPlanes>());
@@ -19,9 +19,14 @@
 
 #include <map>
 #include <vector>
+#include <array>
 #include <atomic>
 #include <functional>
 #include <optional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
 
 #include <Stockfish/position.h>
 #include <Stockfish/movegen.h>
@@ -32,6 +37,7 @@
 #include "SavedGame.h"
 #include "Threading.h"
 #include "PredictionCache.h"
+#include "PredictionPipeline.h"
 #include "Epd.h"
 
 class TerminalValue
@@ -187,23 +193,39 @@ struct ScoredNode
 class SelfPlayWorker;
 struct SearchState;
 
+// Scores for all children of a node, laid out as parallel arrays (structure-of-arrays) for SIMD,
+// padded to a multiple of the vector width.
+struct PuctLanes
+{
+    static constexpr const int Width = 8;
+    static constexpr const int Capacity = ((MAX_MOVES + Width - 1) / Width * Width);
+
+    alignas(32) std::array<float, Capacity> azPuct;
+    alignas(32) std::array<float, Capacity> linear;
+    alignas(32) std::array<float, Capacity> sorted;
+    alignas(32) std::array<uint32_t, Capacity> visitingFlags; // Packed "visitingCount", "terminalValue", "expansion"
+};
+
 class PuctContext
 {
 public:
 
     PuctContext(const SearchState* searchState, Node* parent);
     WeightedNode SelectChild() const;
+    WeightedNode SelectChildScalar() const;
     float CalculatePuctScoreAdHoc(const Node* child) const;
 
 private:
 
     thread_local static std::vector<ScoredNode> ScoredNodes;
+    thread_local static PuctLanes Lanes;
 
 private:
 
     float CalculateAzPuctScore(const Node* child, float childVirtualExploration) const;
     float CalculateSblePuctScore(float azPuctScore, float childVirtualExploration) const;
     float VirtualExploration(const Node* node) const;
+    void ScoreChildren() const;
 
 private:
 
@@ -213,6 +235,7 @@ private:
     int _eliminationTopCount;
     float _linearExplorationRate;
     float _linearExplorationDelay;
+    float _virtualLossCoefficient;
 };
 
 enum class SelfPlayState
@@ -238,6 +261,15 @@ struct TimeControl
     int eliminationRootVisitCount;
 };
 
+// One line of a multi-PV report: a root move, its own principal variation, and its value from the root's perspective.
+struct PrincipalVariationLine
+{
+    std::vector<Move> moves;
+    float value;
+    int eitherMateN;
+    int visitCount;
+};
+
 class SelfPlayGame : public Game
 {
 public:
@@ -259,10 +291,14 @@ public:
     float Result() const;
 
     bool TryHard() const;
+    bool Transpositions() const;
+    void SetTranspositions(bool transpositions);
     void ApplyMoveWithRoot(Move move, Node* newRoot);
+    void UndoMoveWithRoot(Node* newRoot);
     void ApplyMoveWithRootAndExpansion(Move move, Node* newRoot, SelfPlayWorker& selfPlayWorker);
-    float ExpandAndEvaluate(SelfPlayState& state, PredictionCacheChunk*& cacheStore, SearchState* searchState,
+    float ExpandAndEvaluate(SelfPlayState& state, PredictionCacheChunk& cacheStore, SearchState* searchState,
         bool isSearchRoot, bool generateUniformPredictions);
+    bool IsDrawOnPath();
 
     void PruneExcept(Node* root, Node*& except);
     void PruneAll();
@@ -281,8 +317,7 @@ public:
 private:
 
     bool TakeExpansionOwnership(Node* node);
-    void PruneAllInternal(Node* root);
-    float FinishExpanding(SelfPlayState& state, PredictionCacheChunk*& cacheStore, SearchState* searchState, bool isSearchRoot, int moveCount, float value);
+    float FinishExpanding(SelfPlayState& state, PredictionCacheChunk& cacheStore, SearchState* searchState, bool isSearchRoot, int moveCount, float value);
     void Expand(int moveCount, float firstPlayUrgency);
 
     bool IsDrawByTwofoldRepetition(int plyToSearchRoot);
@@ -294,6 +329,7 @@ private:
     // Used for both real and scratch games.
     Node* _root;
     bool _tryHard;
+    bool _transpositions;
     INetwork::InputPlanes* _image;
     float* _value;
     INetwork::OutputPlanes* _policy;
@@ -315,6 +351,46 @@ private:
     std::array<uint16_t, MAX_MOVES> _quantizedPriors;
 };
 
+struct SearchResult
+{
+    Move bestMove;
+    std::vector<PrincipalVariationLine> lines;
+    int nodeCount;
+    float seconds;
+    int lastBestNodes; // Root visits when the best move last changed, for the "nodes required" strength test metric.
+};
+
+// An independent position to search alongside others in one worker group (see "SelfPlayWorker::SearchRequests").
+// Only "nodes" and "moveTimeMs" limits apply, and at least one is required. The callback is called on the primary
+// search thread as soon as the request's own limit is reached, so it should be quick.
+struct SearchRequest
+{
+    std::string fen;
+    std::vector<Move> moves;
+    TimeControl timeControl;
+    std::function<void(const SearchResult&)> callback;
+};
+
+// Totals over a fixed-node benchmark search of several positions (see "SelfPlayWorker::BenchmarkSearch").
+struct SearchBenchmarkStatistics
+{
+    int64_t nodeCount;
+    int64_t failedNodeCount;
+    int64_t tablebaseHitCount;
+    int64_t maxTreeBytes;
+    float seconds;
+};
+
+struct SearchRequestState
+{
+    SearchRequest request;
+    SelfPlayGame position;
+    int tablebaseCardinality;
+    std::atomic_bool finished;
+    uint16_t lastBestMove;
+    int lastBestNodes;
+};
+
 struct SearchState
 {
     void Reset(const TimeControl& setTimeControl, std::chrono::time_point<std::chrono::high_resolution_clock> setSearchStart);
@@ -333,14 +409,34 @@ struct SearchState
     int previousNodeCount;
     std::string guiLine;
     std::vector<Move> guiLineMoves;
+    std::chrono::time_point<std::chrono::high_resolution_clock> lastTreeBudgetCheck;
+    int64_t treeEvictedBytes;
 
     // All workers
     SelfPlayGame* position;
+    std::vector<std::unique_ptr<SearchRequestState>> requests; // Searched instead of "position" when not empty.
+    std::atomic_int nextRequest; // The next request not yet handed to any slot (see "SelfPlayWorker::ClaimSearchRequest").
     std::atomic_bool debug;
     std::atomic_int nodeCount;
     std::atomic_int failedNodeCount;
     std::atomic_int tablebaseHitCount;
+    std::atomic_int transpositionCount;
     std::atomic_bool principalVariationChanged;
+
+    // Stop-the-world pauses for the primary worker to modify the tree (see "SelfPlayWorker::CheckTreeBudget").
+    std::mutex pauseMutex;
+    std::condition_variable pauseSignal;
+    std::atomic_bool pauseRequested;
+    int activeWorkerCount;
+    int pausedWorkerCount;
+};
+
+struct TreeEvictionCandidate
+{
+    Node* node;
+    uint64_t key;
+    int64_t subtreeBytes;
+    int subtreeEnd;
 };
 
 class SelfPlayWorker
@@ -376,16 +472,23 @@ public:
     bool WorseThan(const Node* lhs, const Node* rhs) const;
     void SearchUpdatePosition(const std::string& fen, const std::vector<Move>& moves, bool forceNewPosition);
     void CommentOnPosition(INetwork* network);
+    int PopulatePredictionCache(INetwork* network, NetworkType networkType, const std::vector<std::string>& fens, int plies);
+    int AnalysePositions(WorkCoordinator* workCoordinator, const std::vector<std::string>& fens, int nodes, int concurrency, std::ostream& output);
+    void SearchRequests(WorkCoordinator* workCoordinator, const std::vector<SearchRequest>& requests);
+    SearchBenchmarkStatistics BenchmarkSearch(WorkCoordinator* workCoordinator, const std::vector<std::string>& fens, int nodes);
+    std::vector<PrincipalVariationLine> CollectPrincipalVariations(const Node* root, int lineCount) const;
     void GuiShowLine(INetwork* network, const std::string& line);
     void Play(int index);
     Node* SelectMove(const SelfPlayGame& game, bool allowDiversity) const;
     void PrepareExpandedRoot(SelfPlayGame& game);
+    int64_t EvictTree(Node* root, int64_t targetBytes);
     std::tuple<int, int, int, int> StrengthTestEpd(WorkCoordinator* workCoordinator, const std::filesystem::path& epdPath,
-        int moveTimeMs, int nodes, int failureNodes, int positionLimit,
+        int moveTimeMs, int nodes, int failureNodes, int positionLimit, int concurrency,
         std::function<void(const std::string&, const std::string&, const std::string&, int, int, int)> progress);
 
     void DebugGame(int index, SelfPlayGame** gameOut, SelfPlayState** stateOut, float** valuesOut, INetwork::OutputPlanes** policiesOut);
     void DebugResetGame(int index);
+    void DebugReuseScratchGames(bool reuse);
 
 private:
 
@@ -399,18 +502,31 @@ private:
     void CheckTimeControl(WorkCoordinator* workCoordinator);
     void PrintPrincipalVariation(bool searchFinished);
     void SearchInitialize(const SelfPlayGame* position);
-    bool SearchPlay(int threadIndex);
+    void SearchInitializeRequests(int threadIndex);
+    SearchRequestState* ClaimSearchRequest(int slotKey);
+    void AssignSearchRequest(int index, SearchRequestState* request, const std::chrono::time_point<std::chrono::high_resolution_clock>& now);
+    void CheckSearchRequests(WorkCoordinator* workCoordinator);
+    SearchResult CollectSearchResult(const SelfPlayGame& position, float seconds, int lastBestNodes) const;
+    static void WriteAnalysis(std::ostream& output, const std::string& fen, const SearchResult& result);
+    bool SearchPlay(int threadIndex, int pipelineGroup);
+    void OnSearchActive(bool active);
+    void CheckPause();
+    bool CheckTreeBudget();
 
     std::tuple<Move, int, int> StrengthTestPosition(WorkCoordinator* workCoordinator, const StrengthTestSpec& spec, int moveTimeMs, int nodes, int failureNodes);
-    std::pair<int, int> JudgeStrengthTestPosition(const StrengthTestSpec& spec, Move move, int lastBestNodes, int failureNodes);
+    std::vector<std::tuple<Move, int, int>> StrengthTestPositions(WorkCoordinator* workCoordinator, const StrengthTestSpec* specs, int count,
+        int moveTimeMs, int nodes, int failureNodes);
+    std::pair<int, int> JudgeStrengthTestPosition(const StrengthTestSpec& spec, const Position& position, Move move, int lastBestNodes, int failureNodes);
 
     int ChooseSimulationLimit();
     void ClearGame(int index, const std::chrono::time_point<std::chrono::high_resolution_clock>& now);
     bool IsTerminal(const SelfPlayGame& game) const;
     void SaveToStorageAndLog(INetwork* network, int index);
     void PredictBatchUniform(int batchSize, INetwork::InputPlanes* images, float* values, INetwork::OutputPlanes* policies);
-    bool RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, SelfPlayState& state, int& mctsSimulation, int& mctsSimulationLimit,
-        std::vector<WeightedNode>& searchPath, PredictionCacheChunk*& cacheStore, bool finishOnly);
+    bool RunMcts(SelfPlayGame& game, SelfPlayGame& scratchGame, std::vector<Node*>& scratchPath, SelfPlayState& state, int& mctsSimulation,
+        int& mctsSimulationLimit, std::vector<WeightedNode>& searchPath, PredictionCacheChunk& cacheStore, bool finishOnly);
+    bool IsScratchGameReusable(const SelfPlayGame& game, const SelfPlayGame& scratchGame, const std::vector<Node*>& scratchPath) const;
+    void UnwindScratchGame(SelfPlayGame& scratchGame, std::vector<Node*>& scratchPath, int pathSize);
     void Backpropagate(std::vector<WeightedNode>& searchPath, float value, float rootValue);
     void BackpropagateVisitsOnly(std::vector<WeightedNode>& searchPath, int index);
     void FixPrincipalVariation(const std::vector<WeightedNode>& searchPath, Node* node);
@@ -421,14 +537,24 @@ private:
     Node* MinimaxRoot(Node* parent) const;
     float Minimax(Node* parent, int grandparentVisitCount) const;
 
+    int64_t CollectEvictionCandidates(Node* node, bool protect, uint64_t parentKey, std::vector<TreeEvictionCandidate>& candidates) const;
+    void SnapshotTreeVisits(Node* node);
+
     void UpdateGameForNewSearchRoot(SelfPlayGame& game);
     PredictionStatus WarmUpPredictions(INetwork* network, NetworkType networkType, int batchSize);
+    void CheckClearPredictionCache(PredictionStatus status);
+
+    void InitializePipeline(INetwork* network, NetworkType networkType, int pipelineDepth);
+    std::pair<int, int> PipelineSlots(int pipelineGroup) const;
+    PredictionStatus PredictPipelined(INetwork* network, NetworkType networkType, int slotBegin, int slotCount);
+    PredictionStatus DrainPipeline();
 
 private:
 
     Storage* _storage;
 
     bool _generateUniformPredictions;
+    bool _reuseScratchGames;
     std::vector<SelfPlayState> _states;
     std::vector<INetwork::InputPlanes> _images;
     std::vector<float> _values;
@@ -437,15 +563,26 @@ private:
 
     std::vector<SelfPlayGame> _games;
     std::vector<SelfPlayGame> _scratchGames;
+    std::vector<std::vector<Node*>> _scratchPaths; // The search root followed by nodes applied to each scratch game
     std::vector<std::chrono::time_point<std::chrono::high_resolution_clock>> _gameStarts;
     std::vector<int> _mctsSimulations;
     std::vector<int> _mctsSimulationLimits;
     std::vector<std::vector<WeightedNode>> _searchPaths;
-    std::vector<PredictionCacheChunk*> _cacheStores;
+    std::vector<PredictionCacheChunk> _cacheStores;
+    std::vector<SearchRequestState*> _slotRequests; // Empty unless searching requests (see "SearchInitializeRequests")
 
     SearchState* _searchState;
 
-    int _currentParallelism;
+    // Slots are split into "_pipelineDepth" contiguous groups, with one group's prediction in flight
+    // on "_predictionPipeline" while MCTS runs on the next group. There's no pipeline thread for depth 1.
+    int _pipelineDepth;
+    std::unique_ptr<PredictionPipeline> _predictionPipeline;
+    std::vector<int> _pipelineBatchSizes;
+
+    // Visit counts of expanded nodes as of the last tree eviction, sorted by node, to tell which
+    // subtrees have gone cold since. Only valid for "_treeVisitsRoot" (primary worker only).
+    std::vector<std::pair<const Node*, int>> _treeVisits;
+    const Node* _treeVisitsRoot;
 };
 
 #endif // _SELFPLAY_H_
\ No newline at end of file
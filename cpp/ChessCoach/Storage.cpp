@@ -25,6 +25,8 @@
 #include <set>
 #include <ctime>
 
+#include <zlib.h>
+
 #include <google/protobuf/io/gzip_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #pragma warning(disable:4100) // Ignore unused args in generated code
@@ -41,6 +43,8 @@
 #include "Platform.h"
 #include "Preprocessing.h"
 #include "Random.h"
+#include "Instrumentation.h"
+#include "Trace.h"
 
 Storage::Storage()
     : _trainingGameCount(0)
@@ -49,12 +53,25 @@ Storage::Storage()
     , _sessionNonce("UNINITIALIZED")
     , _sessionGameCount(0)
     , _sessionChunkCount(0)
+    , _chunkCompressionThreads(std::max(1, Config::Misc.Storage_ChunkCompressionThreads))
+    , _chunkNetwork(nullptr)
+    , _chunkStopping(false)
+    , _chunksInFlight(0)
+    , _chunkFailureStreak(0)
+    , _chunkStatistics{}
 {
     _relativeTrainingGamePath = Config::Network.Training.GamesPathTraining;
     _localTrainingGamePath = MakeLocalPath(_relativeTrainingGamePath);
     _relativePgnsPath = Config::Misc.Paths_Pgns;
 }
 
+// Finishes assembling and uploading any full chunks before returning. Leftover games, and any still
+// waiting to retry after a failure, stay on disk for next time.
+Storage::~Storage()
+{
+    StopChunkWriter();
+}
+
 void Storage::InitializeLocalGamesChunks(INetwork* network)
 {
     // Use a 32-bit session nonce to help differentiate this run from others. Still secondary to timestamp in ordering.
@@ -66,27 +83,33 @@ void Storage::InitializeLocalGamesChunks(INetwork* network)
         c = alphabet[distribution(Random::Engine)];
     }
 
-    // Count training games previously played and saved locally without yet being chunked.
+    // Queue training games previously played and saved locally without yet being chunked,
+    // in case we already have enough games (so zero would be played) but they failed to chunk previously.
+    StopChunkWriter();
     _trainingGameCount = 0;
+    _pendingGamePaths.clear();
+    _chunkFailureStreak = 0;
     for (const auto& entry : std::filesystem::directory_iterator(_localTrainingGamePath))
     {
         if (entry.path().extension().string() == ".game")
         {
+            _pendingGamePaths.emplace_back(entry.path());
             _trainingGameCount++;
         }
     }
 
-    // Try to chunk now in case we already have enough games (so zero would be played)
-    // but they failed to chunk previously.
-    if (_trainingGameCount >= _gamesPerChunk)
-    {
-        TryChunkMultiple(network);
-    }
+    // Start the background chunk writer.
+    _chunkNetwork = network;
+    _chunkStopping = false;
+    _chunkThread = std::thread(&Storage::ChunkLoop, this);
+    _uploadThread = std::thread(&Storage::UploadLoop, this);
 }
 
 // AddTrainingGame can be called from multiple self-play worker threads.
 int Storage::AddTrainingGame(INetwork* network, SavedGame&& game)
 {
+    InstrumentedScope scope(InstrumentedPhase_StorageWrite);
+
     // Give this game a number and filename.
     const int gameNumber = ++_sessionGameCount;
     const std::string filenameStem = GenerateFilename(gameNumber);
@@ -106,91 +129,321 @@ int Storage::AddTrainingGame(INetwork* network, SavedGame&& game)
         network->SaveFile(relativePgnPath.string(), buffer.str());
     }
 
-    // When enough individual games have been saved, chunk and store centrally.
-    // Use the atomic_int to ensure that only one caller attempts to chunk, and
-    // assume that _gamesPerChunk is large enough that the chunking will finish
-    // well before it is time for the next one.
-    const int newTrainingGameCount = ++_trainingGameCount;
-    if ((newTrainingGameCount % _gamesPerChunk) == 0)
+    // Hand the saved game to the background chunk writer, which chunks and stores centrally
+    // whenever enough individual games are pending, so self-play never waits on chunking.
+    const auto start = std::chrono::high_resolution_clock::now();
+    ++_trainingGameCount;
     {
-        TryChunkMultiple(network);
+        std::lock_guard lock(_chunkMutex);
+        _pendingGamePaths.emplace_back(localGamePath);
+
+        const float queueMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        _chunkStatistics.maxQueueGameMilliseconds = std::max(_chunkStatistics.maxQueueGameMilliseconds, queueMilliseconds);
     }
+    _chunkSignal.notify_one();
 
     return gameNumber;
 }
 
-// Just in case anything went wrong with file I/O, etc. previously, attempt to
-// create as many chunks as we can here. This is still safe with the outer atomic_int
-// check as long as we finish before the next _gamesPerChunk cycle.
-void Storage::TryChunkMultiple(INetwork* network)
+// Waits until all full chunks have been assembled and uploaded, e.g. before training on them.
+// Gives up early if chunking is failing, leaving the games queued to retry in the background.
+void Storage::FlushChunks()
+{
+    std::unique_lock lock(_chunkMutex);
+    _chunkIdle.wait(lock, [&] { return (((_pendingGamePaths.size() < _gamesPerChunk) || (_chunkFailureStreak > 0)) && (_chunksInFlight == 0)); });
+}
+
+ChunkWriterStatistics Storage::ChunkStatistics()
+{
+    std::lock_guard lock(_chunkMutex);
+    ChunkWriterStatistics statistics = _chunkStatistics;
+    statistics.pendingGameCount = static_cast<int64_t>(_pendingGamePaths.size());
+    return statistics;
+}
+
+void Storage::StopChunkWriter()
 {
-    std::vector<std::filesystem::path> gamePaths;
-    for (const auto& entry : std::filesystem::directory_iterator(_localTrainingGamePath))
     {
-        if (entry.path().extension().string() == ".game")
+        std::lock_guard lock(_chunkMutex);
+        _chunkStopping = true;
+    }
+    _chunkSignal.notify_all();
+    _uploadSignal.notify_all();
+
+    if (_chunkThread.joinable())
+    {
+        _chunkThread.join();
+    }
+    if (_uploadThread.joinable())
+    {
+        _uploadThread.join();
+    }
+}
+
+// Assembles a chunk from each full set of pending games, even when stopping, unless retrying after a failure.
+void Storage::ChunkLoop()
+{
+    Trace::SetThreadName("chunk writer");
+
+    while (true)
+    {
+        std::vector<std::filesystem::path> gamePaths;
         {
-            gamePaths.emplace_back(entry.path());
+            std::unique_lock lock(_chunkMutex);
+            _chunkSignal.wait(lock, [&] { return (_chunkStopping || (_pendingGamePaths.size() >= _gamesPerChunk)); });
+            while (!_chunkStopping && (_chunkFailureStreak > 0) && (std::chrono::steady_clock::now() < _chunkRetryTime))
+            {
+                _chunkSignal.wait_until(lock, _chunkRetryTime);
+            }
+            if ((_pendingGamePaths.size() < _gamesPerChunk) || (_chunkStopping && (_chunkFailureStreak > 0)))
+            {
+                break;
+            }
+
+            gamePaths.assign(_pendingGamePaths.begin(), _pendingGamePaths.begin() + _gamesPerChunk);
+            _pendingGamePaths.erase(_pendingGamePaths.begin(), _pendingGamePaths.begin() + _gamesPerChunk);
+            _chunksInFlight++;
         }
-        if (gamePaths.size() == _gamesPerChunk)
+
+        // If anything goes wrong, queue the games again to retry later (see "RetryChunkLater").
+        const auto start = std::chrono::high_resolution_clock::now();
+        PendingUpload upload;
+        try
         {
-            ChunkGames(network, gamePaths);
-            gamePaths.clear();
+            InstrumentedScope scope(InstrumentedPhase_StorageChunk);
+            upload.contents = AssembleChunk(gamePaths);
         }
+        catch (const std::exception& e)
+        {
+            std::cout << "Failed to assemble chunk from " << gamePaths.size() << " games: " << e.what() << std::endl;
+            {
+                std::lock_guard lock(_chunkMutex);
+                _chunkStatistics.failedChunkCount++;
+                _chunksInFlight--;
+                RetryChunkLater(gamePaths);
+            }
+            _chunkIdle.notify_all();
+            continue;
+        }
+        upload.assembleSeconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+        upload.filename = (GenerateFilename(++_sessionChunkCount) + ".chunk");
+        upload.gamePaths = std::move(gamePaths);
+
+        // Keep at most one assembled chunk waiting behind the one uploading, to bound memory.
+        {
+            std::unique_lock lock(_chunkMutex);
+            _uploadSignal.wait(lock, [&] { return _pendingUploads.empty(); });
+            _pendingUploads.emplace_back(std::move(upload));
+        }
+        _uploadSignal.notify_all();
     }
+
+    {
+        std::lock_guard lock(_chunkMutex);
+        _pendingUploads.emplace_back(); // Empty sentinel: no more chunks.
+    }
+    _uploadSignal.notify_all();
 }
 
-void Storage::ChunkGames(INetwork* network, std::vector<std::filesystem::path>& gamePaths)
+void Storage::UploadLoop()
 {
-    // Set up a buffer for the TFRecord file contents, compressing with zlib.
-    // Reserve 128 MB in advance, roughly enough to hold any chunk.
-    std::string buffer;
+    Trace::SetThreadName("chunk upload");
+
+    while (true)
     {
-        buffer.reserve(128 * 1024 * 1024);
-        google::protobuf::io::StringOutputStream chunkWrapped(&buffer);
-        google::protobuf::io::GzipOutputStream::Options zipOptions{};
-        zipOptions.format = google::protobuf::io::GzipOutputStream::ZLIB;
-        google::protobuf::io::GzipOutputStream chunkZip(&chunkWrapped, zipOptions);
+        PendingUpload upload;
+        {
+            std::unique_lock lock(_chunkMutex);
+            _uploadSignal.wait(lock, [&] { return !_pendingUploads.empty(); });
+            upload = std::move(_pendingUploads.front());
+            _pendingUploads.pop_front();
+        }
+        _uploadSignal.notify_all();
+        if (upload.gamePaths.empty())
+        {
+            break;
+        }
 
-        // Just decompress each individual game chunk with zlib and append to the chunk.
-        for (auto& path : gamePaths)
+        // Write the chunk to central storage, then delete the individual games.
+        const auto start = std::chrono::high_resolution_clock::now();
+        const int64_t uploadStart = Instrumentation::Start(InstrumentedPhase_StorageUpload);
+        bool uploaded = false;
+        try
         {
-            PosixFile gameFile(path, false /* write */);
-            google::protobuf::io::FileInputStream gameWrapped(gameFile.FileDescriptor());
-            google::protobuf::io::GzipInputStream gameZip(&gameWrapped, google::protobuf::io::GzipInputStream::ZLIB);
-
-            void* chunkBuffer;
-            const void* gameBuffer;
-            int chunkSize;
-            int gameSize;
-
-            // Ordering is important here: check short-lived "gameZip" first (is there data to read)
-            // then long-lived "chunkZip" (can we write it) so that "BackUp" is never missed.
-            while (gameZip.Next(&gameBuffer, &gameSize) && chunkZip.Next(&chunkBuffer, &chunkSize))
+            _chunkNetwork->SaveFile((_relativeTrainingGamePath / upload.filename).string(), upload.contents);
+            for (auto& path : upload.gamePaths)
             {
-                const int copySize = std::min(gameSize, chunkSize);
-                std::memcpy(chunkBuffer, gameBuffer, copySize);
+                std::filesystem::remove(path);
+            }
+            uploaded = true;
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Failed to chunk " << upload.gamePaths.size() << " games to " << upload.filename << ": " << e.what() << std::endl;
+        }
+        const float uploadSeconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+        Instrumentation::Record(InstrumentedPhase_StorageUpload, uploadStart);
+
+        // Update stats.
+        if (uploaded)
+        {
+            _trainingGameCount -= _gamesPerChunk;
+            std::cout << "Chunked " << _gamesPerChunk << " games to " << upload.filename << " (assemble " << std::fixed << std::setprecision(2)
+                << upload.assembleSeconds << "s, upload " << uploadSeconds << "s)" << std::defaultfloat << std::endl;
+        }
+        {
+            std::lock_guard lock(_chunkMutex);
+            (uploaded ? _chunkStatistics.chunkCount : _chunkStatistics.failedChunkCount)++;
+            _chunkStatistics.lastAssembleSeconds = upload.assembleSeconds;
+            _chunkStatistics.lastUploadSeconds = uploadSeconds;
+            _chunkStatistics.maxAssembleSeconds = std::max(_chunkStatistics.maxAssembleSeconds, upload.assembleSeconds);
+            _chunkStatistics.maxUploadSeconds = std::max(_chunkStatistics.maxUploadSeconds, uploadSeconds);
+            _chunksInFlight--;
+            if (uploaded)
+            {
+                _chunkFailureStreak = 0;
+            }
+            else
+            {
+                RetryChunkLater(upload.gamePaths);
+            }
+        }
+        _chunkIdle.notify_all();
+        _chunkSignal.notify_all();
+    }
+}
+
+// Queues a failed chunk's games again, behind any others, and backs off before chunking again. The games still
+// count towards "_trainingGameCount", so they must be chunked eventually, or self-play would stop short of the
+// games needed. Games that are already gone (e.g. deleted after a successful upload) are skipped.
+// Requires "_chunkMutex" to be held.
+void Storage::RetryChunkLater(const std::vector<std::filesystem::path>& gamePaths)
+{
+    for (const std::filesystem::path& path : gamePaths)
+    {
+        std::error_code error;
+        if (std::filesystem::exists(path, error))
+        {
+            _pendingGamePaths.push_back(path);
+        }
+    }
 
-                chunkZip.BackUp(chunkSize - copySize);
-                gameZip.BackUp(gameSize - copySize);
+    const int delayMilliseconds = std::min(ChunkRetryMaxMilliseconds, ChunkRetryInitialMilliseconds << std::min(_chunkFailureStreak, 16));
+    _chunkFailureStreak++;
+    _chunkRetryTime = (std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMilliseconds));
+}
+
+// Individual games are zlib-compressed TFRecords, so chunks are just their concatenated payloads, recompressed.
+//
+// Blocks of "ChunkBlockGames" games are inflated and deflated in parallel, then joined into a single zlib stream,
+// like pigz: each block but the last ends with a sync flush, on a byte boundary, so raw deflate blocks concatenate,
+// and the zlib header and Adler-32 trailer are written around them. Readers (including tf.data) see an ordinary zlib stream.
+std::string Storage::AssembleChunk(const std::vector<std::filesystem::path>& gamePaths) const
+{
+    const int gameCount = static_cast<int>(gamePaths.size());
+    const int blockCount = ((gameCount + ChunkBlockGames - 1) / ChunkBlockGames);
+    std::vector<std::string> blocks(blockCount);
+    std::vector<uLong> blockAdlers(blockCount);
+    std::vector<size_t> blockRawBytes(blockCount);
+
+    std::atomic_int nextBlock(0);
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    auto compressBlocks = [&]()
+    {
+        std::string raw;
+        int block;
+        while ((block = nextBlock++) < blockCount)
+        {
+            try
+            {
+                const int firstGame = (block * ChunkBlockGames);
+                raw.clear();
+                InflateGames(gamePaths.data() + firstGame, std::min(ChunkBlockGames, gameCount - firstGame), raw);
+                DeflateBlock(raw, (block == (blockCount - 1)), blocks[block]);
+                blockAdlers[block] = ::adler32(::adler32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(raw.data()), static_cast<uInt>(raw.size()));
+                blockRawBytes[block] = raw.size();
+            }
+            catch (...)
+            {
+                std::lock_guard lock(errorMutex);
+                error = std::current_exception();
+                nextBlock = blockCount;
             }
         }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < std::min(_chunkCompressionThreads, blockCount); i++)
+    {
+        threads.emplace_back(compressBlocks);
+    }
+    compressBlocks();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    // Header for deflate with a 32 KiB window and default compression level, matching GzipOutputStream.
+    std::string chunk = { '\x78', '\x9C' };
+    uLong adler = ::adler32(0L, Z_NULL, 0);
+    for (int i = 0; i < blockCount; i++)
+    {
+        chunk += blocks[i];
+        adler = ::adler32_combine(adler, blockAdlers[i], static_cast<z_off_t>(blockRawBytes[i]));
     }
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        chunk.push_back(static_cast<char>((adler >> shift) & 0xFF));
+    }
+    return chunk;
+}
 
-    // Write the chunk to central storage.
-    const int chunkNumber = ++_sessionChunkCount;
-    const std::string& filename = GenerateFilename(chunkNumber) + ".chunk";
-    const auto& relativePath = (_relativeTrainingGamePath / filename);
-    std::cout << "Chunking " << _gamesPerChunk << " games to " << filename << std::endl;
-    network->SaveFile(relativePath.string(), buffer);
+void Storage::InflateGames(const std::filesystem::path* gamePaths, int gameCount, std::string& rawOut) const
+{
+    for (int i = 0; i < gameCount; i++)
+    {
+        PosixFile gameFile(gamePaths[i], false /* write */);
+        google::protobuf::io::FileInputStream gameWrapped(gameFile.FileDescriptor());
+        google::protobuf::io::GzipInputStream gameZip(&gameWrapped, google::protobuf::io::GzipInputStream::ZLIB);
+
+        const void* gameBuffer;
+        int gameSize;
+        while (gameZip.Next(&gameBuffer, &gameSize))
+        {
+            rawOut.append(static_cast<const char*>(gameBuffer), gameSize);
+        }
+    }
+}
 
-    // Delete the individual games.
-    for (auto& path : gamePaths)
+void Storage::DeflateBlock(const std::string& raw, bool last, std::string& compressedOut) const
+{
+    z_stream stream{};
+    if (::deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS /* raw */, 8 /* default memLevel */, Z_DEFAULT_STRATEGY) != Z_OK)
     {
-        std::filesystem::remove(path);
+        throw ChessCoachException("Failed to initialize zlib");
     }
 
-    // Update stats.
-    _trainingGameCount -= _gamesPerChunk;
+    // Leave room for the sync flush's empty stored block on top of the bound.
+    compressedOut.resize(::deflateBound(&stream, static_cast<uLong>(raw.size())) + 16);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(raw.data()));
+    stream.avail_in = static_cast<uInt>(raw.size());
+    stream.next_out = reinterpret_cast<Bytef*>(compressedOut.data());
+    stream.avail_out = static_cast<uInt>(compressedOut.size());
+
+    const int result = ::deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    const bool finished = (last ? (result == Z_STREAM_END) : ((result == Z_OK) && (stream.avail_in == 0) && (stream.avail_out > 0)));
+    compressedOut.resize(stream.total_out);
+    ::deflateEnd(&stream);
+
+    if (!finished)
+    {
+        throw ChessCoachException("Failed to compress chunk");
+    }
 }
 
 // Training is only done on chunks, not individual games, so round the target up to the nearest chunk.
@@ -246,9 +499,58 @@ void Storage::SaveChunk(const std::filesystem::path& path, const std::vector<Sav
     }
 }
 
+void Storage::SaveColumnarChunk(const std::filesystem::path& path, const std::vector<SavedGame>& games, bool compress) const
+{
+    ColumnarChunkWriter writer;
+    for (const SavedGame& game : games)
+    {
+        writer.AddGame(_startingPosition, game);
+    }
+    writer.Write(path, compress);
+}
+
+// Converts a whole TFRecord chunk (zlib-compressed file contents) to a columnar chunk, returning the game count.
+// Features are copied across as-is, so no games need to be played out.
+int Storage::ConvertChunkToColumnar(const std::string& chunkContents, const std::filesystem::path& path, bool compress) const
+{
+    ColumnarChunkWriter writer;
+    const int gameCount = ReadChunkColumns(chunkContents, &writer);
+    writer.Write(path, compress);
+    return gameCount;
+}
+
+// Appends all games in the TFRecord chunk to the writer's columns, which can then be written out,
+// or used in place (e.g. by "TrainingDataLoader").
+int Storage::ReadChunkColumns(std::string_view chunkContents, ColumnarChunkWriter* writerOut) const
+{
+    google::protobuf::io::ArrayInputStream wrapped(chunkContents.data(), static_cast<int>(chunkContents.size()));
+    google::protobuf::io::GzipInputStream zip(&wrapped, google::protobuf::io::GzipInputStream::ZLIB);
+
+    message::Example game;
+    uint64_t payloadLength;
+    int gameCount = 0;
+    while (Read(zip, payloadLength))
+    {
+        // Skip the length's crc32c, parse the payload, then skip the payload's crc32c.
+        game.Clear();
+        if (!zip.Skip(sizeof(uint32_t))
+            || !game.MergePartialFromBoundedZeroCopyStream(&zip, static_cast<int>(payloadLength))
+            || !zip.Skip(sizeof(uint32_t)))
+        {
+            throw ChessCoachException("Failed to parse chunk");
+        }
+        writerOut->AddGame(game);
+        gameCount++;
+    }
+
+    return gameCount;
+}
+
 // This is only used to drive the ChessCoachGui tool. TFRecords are normally loaded
 // using the tf.data pipeline in dataset.py but that's 100x-1000x too slow for
 // random access to games and positions.
+//
+// Columnar chunks don't have this problem (see "LoadGameFromColumnarChunk").
 void Storage::LoadGameFromChunk(const std::string& chunkContents, int gameIndex, SavedGame* gameOut)
 {
     google::protobuf::io::ArrayInputStream wrapped(chunkContents.data(), static_cast<int>(chunkContents.size()));
@@ -277,22 +579,47 @@ void Storage::LoadGameFromChunk(const std::string& chunkContents, int gameIndex,
         throw ChessCoachException("Failed to parse game");
     }
 
-    // The first 12 planes of "image_pieces_auxiliary" contain the pieces for each position in the game.
     auto& features = compressedGame.features().feature();
     auto& result = features.at("result").float_list().value();
     auto& mctsValues = features.at("mcts_values").float_list().value();
     auto& imagePiecesAuxiliary = features.at("image_pieces_auxiliary").int64_list().value();
-    const int imagePiecesAuxiliaryStride = (INetwork::InputPieceAndRepetitionPlanesPerPosition + INetwork::InputAuxiliaryPlaneCount);
     auto& policyRowLengths = features.at("policy_row_lengths").int64_list().value();
     auto& policyIndices = features.at("policy_indices").int64_list().value();
     auto& policyValues = features.at("policy_values").float_list().value();
 
+    ReconstructGame(result[0], mctsValues.size(), mctsValues.data(), reinterpret_cast<const INetwork::PackedPlane*>(imagePiecesAuxiliary.data()),
+        policyRowLengths.data(), policyIndices.data(), policyValues.data(), gameOut);
+}
+
+// Columnar chunks can be read in place, so there's nothing to skip over.
+void Storage::LoadGameFromColumnarChunk(const ColumnarChunk& chunk, int gameIndex, SavedGame* gameOut) const
+{
+    if ((gameIndex < 0) || (gameIndex >= chunk.GameCount()))
+    {
+        throw ChessCoachException("Game index out of range for chunk");
+    }
+
+    const int64_t positionStart = chunk.GamePositionStart(gameIndex);
+    const int64_t policyStart = chunk.PolicyOffsets()[positionStart];
+    const int imagePiecesAuxiliaryStride = (INetwork::InputPieceAndRepetitionPlanesPerPosition + INetwork::InputAuxiliaryPlaneCount);
+    ReconstructGame(chunk.Result()[gameIndex], chunk.GamePositionCount(gameIndex), chunk.MctsValues() + positionStart,
+        chunk.ImagePiecesAuxiliary() + (positionStart * imagePiecesAuxiliaryStride), chunk.PolicyRowLengths() + positionStart,
+        chunk.PolicyIndices() + policyStart, chunk.PolicyValues() + policyStart, gameOut);
+}
+
+// Rebuilds a saved game from training features (result, MCTS values and image/policy columns for each position).
+void Storage::ReconstructGame(float result, int moveCount, const float* mctsValues, const INetwork::PackedPlane* imagePiecesAuxiliary,
+    const int64_t* policyRowLengths, const int64_t* policyIndices, const float* policyValues, SavedGame* gameOut) const
+{
+    // The first 12 planes of "image_pieces_auxiliary" contain the pieces for each position in the game.
+    const int imagePiecesAuxiliaryStride = (INetwork::InputPieceAndRepetitionPlanesPerPosition + INetwork::InputAuxiliaryPlaneCount);
+
     // Set up result and MCTS values directly.
     // MCTS deals with probabilities in [0, 1]. Network deals with tanh outputs/targets in (-1, 1)/[-1, 1].
     *gameOut = SavedGame();
-    gameOut->result = INetwork::MapProbability11To01(result[0]);
-    gameOut->moveCount = mctsValues.size();
-    gameOut->mctsValues.insert(gameOut->mctsValues.begin(), mctsValues.begin(), mctsValues.end());
+    gameOut->result = INetwork::MapProbability11To01(result);
+    gameOut->moveCount = moveCount;
+    gameOut->mctsValues.insert(gameOut->mctsValues.begin(), mctsValues, mctsValues + moveCount);
     INetwork::MapProbabilities11To01(gameOut->mctsValues.size(), gameOut->mctsValues.data());
 
     // Play out the game and match the resulting pieces after each legal move.
@@ -302,8 +629,8 @@ void Storage::LoadGameFromChunk(const std::string& chunkContents, int gameIndex,
     {
         // Reconstruct the policy by walking over legal moves.
         const int policyLength = static_cast<int>(policyRowLengths[m]);
-        const int64_t* positionPolicyIndices = (policyIndices.data() + policyStart);
-        const float* positionPolicyValues = (policyValues.data() + policyStart);
+        const int64_t* positionPolicyIndices = (policyIndices + policyStart);
+        const float* positionPolicyValues = (policyValues + policyStart);
         policyStart += policyLength;
 
         std::unique_ptr<INetwork::OutputPlanes> policy = std::make_unique<INetwork::OutputPlanes>(); // Zero for "GeneratePolicyDecompress"
@@ -321,8 +648,7 @@ void Storage::LoadGameFromChunk(const std::string& chunkContents, int gameIndex,
         const int resultingPosition = (m + 1);
         if (resultingPosition < gameOut->moveCount)
         {
-            const Move move = game.ApplyMoveInfer(reinterpret_cast<const INetwork::PackedPlane*>(
-                imagePiecesAuxiliary.data()) + (resultingPosition * imagePiecesAuxiliaryStride));
+            const Move move = game.ApplyMoveInfer(imagePiecesAuxiliary + (resultingPosition * imagePiecesAuxiliaryStride));
             gameOut->moves.push_back(static_cast<uint16_t>(move));
         }
         else
@@ -18,13 +18,19 @@
 #define _STORAGE_H_
 
 #include <filesystem>
+#include <string_view>
 #include <vector>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <chrono>
 
 #include "Network.h"
 #include "Game.h"
 #include "SavedGame.h"
+#include "ColumnarChunk.h"
 
 namespace google {
     namespace protobuf {
@@ -64,35 +70,75 @@ public:
     std::vector<float> recordWeights;
 };
 
+struct ChunkWriterStatistics
+{
+    int64_t chunkCount;
+    int64_t failedChunkCount;
+    int64_t pendingGameCount;
+    float lastAssembleSeconds;
+    float lastUploadSeconds;
+    float maxAssembleSeconds;
+    float maxUploadSeconds;
+
+    // The longest that any self-play thread has spent handing a game over to the chunk writer.
+    float maxQueueGameMilliseconds;
+};
+
 class Storage
 {
 public:
 
     static std::filesystem::path MakeLocalPath(const std::filesystem::path& path);
 
+public:
+
+    static constexpr const int ChunkBlockGames = 64;
+
+    // Failed chunks are retried after a delay, doubling per consecutive failure.
+    static constexpr const int ChunkRetryInitialMilliseconds = 1000;
+    static constexpr const int ChunkRetryMaxMilliseconds = (5 * 60 * 1000);
+
 public:
 
     Storage();
+    ~Storage();
+
+    Storage(const Storage&) = delete;
+    Storage& operator=(const Storage&) = delete;
+
     void InitializeLocalGamesChunks(INetwork* network);
     int AddTrainingGame(INetwork* network, SavedGame&& game);
+    void FlushChunks();
+    ChunkWriterStatistics ChunkStatistics();
     int TrainingGamesToPlay(int trainingChunkCount, int targetGameCount, bool ignoreLocalGames) const;
 
     void SaveChunk(const std::filesystem::path& path, const std::vector<SavedGame>& games) const;
+    void SaveColumnarChunk(const std::filesystem::path& path, const std::vector<SavedGame>& games, bool compress) const;
+    int ConvertChunkToColumnar(const std::string& chunkContents, const std::filesystem::path& path, bool compress) const;
+    int ReadChunkColumns(std::string_view chunkContents, ColumnarChunkWriter* writerOut) const;
     void SaveCommentary(CommentarySaveContext& saveContext, const std::vector<SavedGame>& games,
         std::vector<SavedCommentary>& gameCommentary, Vocabulary& vocabulary) const;
     void WriteRemainingCommentary(CommentarySaveContext& saveContext) const;
     std::string GenerateSimpleChunkFilename(int chunkNumber) const;
 
     void LoadGameFromChunk(const std::string& chunkContents, int gameIndex, SavedGame* gameOut);
+    void LoadGameFromColumnarChunk(const ColumnarChunk& chunk, int gameIndex, SavedGame* gameOut) const;
 
     message::Example DebugPopulateGame(const SavedGame& game) const;
         
 private:
 
     std::string GenerateFilename(int number);
-    void TryChunkMultiple(INetwork* network);
-    void ChunkGames(INetwork* network, std::vector<std::filesystem::path>& gamePaths);
+    void ChunkLoop();
+    void UploadLoop();
+    void StopChunkWriter();
+    void RetryChunkLater(const std::vector<std::filesystem::path>& gamePaths);
+    std::string AssembleChunk(const std::vector<std::filesystem::path>& gamePaths) const;
+    void InflateGames(const std::filesystem::path* gamePaths, int gameCount, std::string& rawOut) const;
+    void DeflateBlock(const std::string& raw, bool last, std::string& compressedOut) const;
     void PopulateGame(Game scratchGame, const SavedGame& game, message::Example& gameOut) const;
+    void ReconstructGame(float result, int moveCount, const float* mctsValues, const INetwork::PackedPlane* imagePiecesAuxiliary,
+        const int64_t* policyRowLengths, const int64_t* policyIndices, const float* policyValues, SavedGame* gameOut) const;
     void WriteTfRecord(google::protobuf::io::ZeroCopyOutputStream& stream, std::string& buffer, const google::protobuf::Message& message) const;
     uint32_t MaskCrc32cForTfRecord(uint32_t crc32c) const;
     bool SkipTfRecord(google::protobuf::io::ZeroCopyInputStream& stream) const;
@@ -116,6 +162,32 @@ private:
     std::filesystem::path _relativeTrainingGamePath;
     std::filesystem::path _localTrainingGamePath;
     std::filesystem::path _relativePgnsPath;
+
+    // The background chunk writer: "ChunkLoop" assembles chunks from full sets of pending games,
+    // handing them to "UploadLoop", so that the next chunk can be assembled during upload.
+    struct PendingUpload
+    {
+        std::string filename;
+        std::string contents;
+        std::vector<std::filesystem::path> gamePaths;
+        float assembleSeconds;
+    };
+
+    int _chunkCompressionThreads;
+    INetwork* _chunkNetwork;
+    std::mutex _chunkMutex;
+    std::condition_variable _chunkSignal;
+    std::condition_variable _uploadSignal;
+    std::condition_variable _chunkIdle;
+    bool _chunkStopping;
+    int _chunksInFlight;
+    int _chunkFailureStreak;
+    std::chrono::steady_clock::time_point _chunkRetryTime;
+    std::deque<std::filesystem::path> _pendingGamePaths;
+    std::deque<PendingUpload> _pendingUploads;
+    ChunkWriterStatistics _chunkStatistics;
+    std::thread _chunkThread;
+    std::thread _uploadThread;
 };
 
 #endif // _STORAGE_H_
\ No newline at end of file
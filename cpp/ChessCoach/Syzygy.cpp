@@ -37,6 +37,7 @@
 
 #include "SelfPlay.h"
 #include "Storage.h"
+#include "Instrumentation.h"
 
 void Syzygy::Reload()
 {
@@ -63,6 +64,8 @@ bool Syzygy::ProbeTablebasesAtRoot(SelfPlayGame& game)
         (game.TablebaseCardinality() >= position.count<ALL_PIECES>()) &&
         !position.can_castle(ANY_CASTLING))
     {
+        InstrumentedScope scope(InstrumentedPhase_SyzygyProbe);
+
         // Rank moves using DTZ tables
         attemptedProbe = true;
         RootInTB = ProbeDtzAtRoot(game);
@@ -233,6 +236,7 @@ bool Syzygy::ProbeWdl(SelfPlayGame& game, bool isSearchRoot)
     }
 
     // Always value from parent's perspective.
+    InstrumentedScope scope(InstrumentedPhase_SyzygyProbe);
     Tablebases::ProbeState result;
     Tablebases::WDLScore wdl = Tablebases::WDLScore(-Tablebases::probe_wdl(position, &result));
     if (result == Tablebases::ProbeState::FAIL)
@@ -0,0 +1,189 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include "Trace.h"
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "Platform.h"
+#include "Config.h"
+
+std::mutex Trace::Mutex;
+std::vector<std::shared_ptr<Trace::ThreadBuffer>> Trace::Buffers;
+int Trace::NextThreadId = 0;
+std::atomic_int Trace::EventsPerThread(0);
+std::atomic<int64_t> Trace::StartNanoseconds(0);
+
+void Trace::Start(int eventsPerThread)
+{
+    if (eventsPerThread <= 0)
+    {
+        throw ChessCoachException("Trace needs a positive number of events per thread");
+    }
+
+    {
+        std::lock_guard lock(Mutex);
+
+        // Forget threads that have exited, and any events from a previous trace. Buffers are (re)sized on next use.
+        Buffers.erase(std::remove_if(Buffers.begin(), Buffers.end(),
+            [](const std::shared_ptr<ThreadBuffer>& buffer) { return (buffer.use_count() == 1); }), Buffers.end());
+        for (std::shared_ptr<ThreadBuffer>& buffer : Buffers)
+        {
+            std::lock_guard bufferLock(buffer->mutex);
+            buffer->eventCount = 0;
+        }
+
+        EventsPerThread.store(eventsPerThread, std::memory_order_relaxed);
+        StartNanoseconds.store(Instrumentation::Now(), std::memory_order_relaxed);
+    }
+
+    Instrumentation::SetTracing(true);
+}
+
+void Trace::Stop()
+{
+    Instrumentation::SetTracing(false);
+}
+
+bool Trace::Active()
+{
+    return Instrumentation::Tracing();
+}
+
+// Only phases coarse enough to keep the ring buffers covering a useful stretch of time.
+bool Trace::Traced(InstrumentedPhase phase)
+{
+    switch (phase)
+    {
+    case InstrumentedPhase_Mcts:
+    case InstrumentedPhase_PredictBatchWait:
+    case InstrumentedPhase_PredictBatch:
+    case InstrumentedPhase_GilAcquire:
+    case InstrumentedPhase_StorageWrite:
+    case InstrumentedPhase_StorageChunk:
+    case InstrumentedPhase_StorageUpload:
+    case InstrumentedPhase_Pruning:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void Trace::SetThreadName(const std::string& name)
+{
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard lock(buffer.mutex);
+    buffer.name = name;
+}
+
+void Trace::Record(InstrumentedPhase phase, int64_t startNanoseconds, int64_t endNanoseconds)
+{
+    ThreadBuffer& buffer = LocalBuffer();
+    const size_t capacity = static_cast<size_t>(EventsPerThread.load(std::memory_order_relaxed));
+
+    std::lock_guard lock(buffer.mutex);
+    if (buffer.events.size() != capacity)
+    {
+        buffer.events.resize(capacity);
+        buffer.eventCount = 0;
+    }
+    buffer.events[buffer.eventCount++ % capacity] = { phase, startNanoseconds, endNanoseconds };
+}
+
+// Writes the Trace Event Format: thread names as metadata events, then phases as complete ("X") events in microseconds.
+int Trace::WriteJson(std::ostream& output)
+{
+    std::lock_guard lock(Mutex);
+    const int64_t traceStart = StartNanoseconds.load(std::memory_order_relaxed);
+
+    const std::ios_base::fmtflags flags = output.flags();
+    output << std::fixed << std::setprecision(3);
+    output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+    output << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"ChessCoach\"}}";
+
+    int eventCount = 0;
+    for (const std::shared_ptr<ThreadBuffer>& buffer : Buffers)
+    {
+        std::lock_guard bufferLock(buffer->mutex);
+        output << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+            << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+
+        // Write the ring buffer oldest first, skipping anything started before the trace.
+        const uint64_t capacity = buffer->events.size();
+        const uint64_t first = ((buffer->eventCount > capacity) ? (buffer->eventCount - capacity) : 0);
+        for (uint64_t i = first; i < buffer->eventCount; i++)
+        {
+            const TraceEvent& event = buffer->events[i % capacity];
+            if (event.startNanoseconds < traceStart)
+            {
+                continue;
+            }
+
+            output << "," << std::endl << "{\"name\":\"" << InstrumentedPhaseNames[event.phase]
+                << "\",\"cat\":\"chesscoach\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                << ",\"ts\":" << ((event.startNanoseconds - traceStart) / 1000.0)
+                << ",\"dur\":" << ((event.endNanoseconds - event.startNanoseconds) / 1000.0) << "}";
+            eventCount++;
+        }
+    }
+
+    output << std::endl << "]}" << std::endl;
+    output.flags(flags);
+    return eventCount;
+}
+
+int Trace::WriteFile(const std::filesystem::path& path)
+{
+    if (path.has_parent_path())
+    {
+        std::filesystem::create_directories(path.parent_path());
+    }
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file)
+    {
+        throw ChessCoachException("Failed to write trace: " + path.string());
+    }
+
+    const int eventCount = WriteJson(file);
+    std::cout << "Wrote " << eventCount << " trace events to " << path.string() << std::endl;
+    return eventCount;
+}
+
+std::filesystem::path Trace::ConfiguredPath()
+{
+    return (Platform::UserDataPath() / Config::Misc.Instrumentation_TracePath);
+}
+
+Trace::ThreadBuffer& Trace::LocalBuffer()
+{
+    // Buffers are shared with the registry so that events outlive their threads until the next trace starts.
+    thread_local static std::shared_ptr<ThreadBuffer> Buffer;
+    if (!Buffer)
+    {
+        Buffer = std::make_shared<ThreadBuffer>();
+        Buffer->eventCount = 0;
+
+        std::lock_guard lock(Mutex);
+        Buffer->threadId = ++NextThreadId;
+        Buffer->name = ("thread " + std::to_string(Buffer->threadId));
+        Buffers.push_back(Buffer);
+    }
+    return *Buffer;
+}
@@ -0,0 +1,90 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "Instrumentation.h"
+
+struct TraceEvent
+{
+    InstrumentedPhase phase;
+    int64_t startNanoseconds;
+    int64_t endNanoseconds;
+};
+
+// Records a short timeline of coarse instrumented phases per thread (MCTS CPU work, prediction waits and batches,
+// GIL acquisition, storage and pruning) for viewing in chrome://tracing or Perfetto, to find pipeline bubbles
+// between CPU and accelerator work.
+//
+// Each thread keeps the most recent "eventsPerThread" events in its own ring buffer, so tracing stays bounded
+// however long it runs. Phases arrive through "Instrumentation::Record" (e.g. "InstrumentedScope") while started,
+// and fine-grained MCTS phases are left to the aggregate counters.
+class Trace
+{
+public:
+
+    static void Start(int eventsPerThread);
+    static void Stop();
+
+    static bool Active();
+    static bool Traced(InstrumentedPhase phase);
+
+    // Names the calling thread in the timeline, e.g. "self-play" or "chunk writer".
+    static void SetThreadName(const std::string& name);
+
+    static void Record(InstrumentedPhase phase, int64_t startNanoseconds, int64_t endNanoseconds);
+
+    // Writes Chrome trace-event JSON, returning the number of events written.
+    static int WriteJson(std::ostream& output);
+    static int WriteFile(const std::filesystem::path& path);
+
+    // The configured "trace_path", under the user data directory unless absolute.
+    static std::filesystem::path ConfiguredPath();
+
+private:
+
+    struct ThreadBuffer
+    {
+        std::mutex mutex;
+        int threadId;
+        std::string name;
+        std::vector<TraceEvent> events;
+        uint64_t eventCount;
+    };
+
+    static ThreadBuffer& LocalBuffer();
+
+private:
+
+    // Guards the list of buffers and the settings below. Each buffer's events are guarded by its own mutex.
+    static std::mutex Mutex;
+    static std::vector<std::shared_ptr<ThreadBuffer>> Buffers;
+    static int NextThreadId;
+    static std::atomic_int EventsPerThread;
+    static std::atomic<int64_t> StartNanoseconds;
+};
+
+#endif // _TRACE_H_
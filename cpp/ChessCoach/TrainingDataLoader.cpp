@@ -0,0 +1,398 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include "TrainingDataLoader.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string_view>
+#include <cstring>
+
+#include "ColumnarChunk.h"
+#include "Storage.h"
+#include "Random.h"
+#include "Platform.h"
+
+constexpr const int ImagePiecesAuxiliaryStride = (INetwork::InputPieceAndRepetitionPlanesPerPosition + INetwork::InputAuxiliaryPlaneCount);
+
+TrainingDataLoader::TrainingDataLoader(const Storage* storage, std::vector<std::vector<std::filesystem::path>> sources, const TrainingDataLoaderOptions& options)
+    : _storage(storage)
+    , _options(options)
+    , _reservoirCapacity(std::max(options.shuffleSize, options.batchSize))
+    , _stopping(false)
+    , _nextSource(0)
+    , _reservoir(new SampledPosition[_reservoirCapacity])
+    , _reservoirSlots(_reservoirCapacity)
+    , _reservoirCount(0)
+    , _reservoirTaking(0)
+{
+    std::iota(_reservoirSlots.begin(), _reservoirSlots.end(), 0);
+
+    if ((_options.batchSize <= 0) || (_options.threadCount <= 0))
+    {
+        throw ChessCoachException("Training data loader needs a positive batch size and thread count");
+    }
+
+    for (std::vector<std::filesystem::path>& chunks : sources)
+    {
+        if (chunks.empty())
+        {
+            throw ChessCoachException("Training data loader source has no chunks");
+        }
+
+        Source& source = _sources.emplace_back();
+        source.chunks = std::move(chunks);
+        source.order.resize(source.chunks.size());
+        source.next = source.chunks.size(); // Shuffle on first use.
+    }
+    if (_sources.empty())
+    {
+        throw ChessCoachException("Training data loader has no sources");
+    }
+
+    for (int i = 0; i < _options.threadCount; i++)
+    {
+        _threads.emplace_back(&TrainingDataLoader::RunGuarded, this, &TrainingDataLoader::ReadLoop);
+    }
+    _threads.emplace_back(&TrainingDataLoader::RunGuarded, this, &TrainingDataLoader::BatchLoop);
+}
+
+TrainingDataLoader::~TrainingDataLoader()
+{
+    {
+        std::lock_guard lock(_mutex);
+        _stopping = true;
+    }
+    _reservoirNotFull.notify_all();
+    _reservoirFull.notify_all();
+    _batchReady.notify_all();
+    _batchTaken.notify_all();
+
+    for (std::thread& thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+std::unique_ptr<TrainingBatch> TrainingDataLoader::NextBatch()
+{
+    std::unique_lock lock(_mutex);
+    _batchReady.wait(lock, [&] { return (!_ready.empty() || _error); });
+    if (_error)
+    {
+        std::rethrow_exception(_error);
+    }
+
+    std::unique_ptr<TrainingBatch> batch = std::move(_ready.front());
+    _ready.pop_front();
+    lock.unlock();
+
+    _batchTaken.notify_one();
+    return batch;
+}
+
+void TrainingDataLoader::RecycleBatch(std::unique_ptr<TrainingBatch> batch)
+{
+    std::lock_guard lock(_mutex);
+    _recycled.emplace_back(std::move(batch));
+}
+
+int TrainingDataLoader::BatchSize() const
+{
+    return _options.batchSize;
+}
+
+// Stop everything on the first error and hand it to "NextBatch".
+void TrainingDataLoader::RunGuarded(void (TrainingDataLoader::*loop)())
+{
+    try
+    {
+        (this->*loop)();
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard lock(_mutex);
+            if (!_error)
+            {
+                _error = std::current_exception();
+            }
+            _stopping = true;
+        }
+        _reservoirNotFull.notify_all();
+        _reservoirFull.notify_all();
+        _batchReady.notify_all();
+        _batchTaken.notify_all();
+    }
+}
+
+void TrainingDataLoader::ReadLoop()
+{
+    std::filesystem::path path;
+    while (NextChunk(path))
+    {
+        SampleChunk(path);
+    }
+}
+
+void TrainingDataLoader::BatchLoop()
+{
+    std::vector<SampledPosition> positions(_options.batchSize);
+    while (true)
+    {
+        std::unique_ptr<TrainingBatch> batch;
+        {
+            std::unique_lock lock(_mutex);
+            _batchTaken.wait(lock, [&] { return (_stopping || (static_cast<int>(_ready.size()) < PrefetchBatches)); });
+            if (_stopping)
+            {
+                return;
+            }
+
+            if (!_recycled.empty())
+            {
+                batch = std::move(_recycled.back());
+                _recycled.pop_back();
+            }
+        }
+
+        if (!batch)
+        {
+            batch.reset(new TrainingBatch());
+            batch->images.resize(_options.batchSize);
+            batch->values.resize(_options.batchSize);
+            batch->mctsValues.resize(_options.batchSize);
+            batch->policies.resize(_options.batchSize);
+        }
+
+        if (!TakePositions(positions))
+        {
+            return;
+        }
+        FillBatch(positions, *batch);
+
+        {
+            std::lock_guard lock(_mutex);
+            _ready.emplace_back(std::move(batch));
+        }
+        _batchReady.notify_one();
+    }
+}
+
+// Alternates between sources, like the interleave in dataset.py, and reshuffles each source's chunks once exhausted.
+bool TrainingDataLoader::NextChunk(std::filesystem::path& pathOut)
+{
+    std::lock_guard lock(_mutex);
+    if (_stopping)
+    {
+        return false;
+    }
+
+    Source& source = _sources[_nextSource];
+    _nextSource = ((_nextSource + 1) % _sources.size());
+
+    if (source.next >= source.order.size())
+    {
+        std::iota(source.order.begin(), source.order.end(), 0);
+        std::shuffle(source.order.begin(), source.order.end(), Random::Engine);
+        source.next = 0;
+    }
+
+    pathOut = source.chunks[source.order[source.next++]];
+    return true;
+}
+
+void TrainingDataLoader::SampleChunk(const std::filesystem::path& path)
+{
+    if (path.extension() == ColumnarChunk::Extension)
+    {
+        const ColumnarChunk chunk(path);
+        SampleColumns(path, chunk);
+    }
+    else
+    {
+        if (!_storage)
+        {
+            throw ChessCoachException("Storage is required to read TFRecord chunks: " + path.string());
+        }
+
+        const MemoryMappedFile mapping(path);
+        ColumnarChunkWriter columns;
+        _storage->ReadChunkColumns(std::string_view(static_cast<const char*>(mapping.Data()), mapping.Size()), &columns);
+        SampleColumns(path, columns);
+    }
+}
+
+template <typename TColumns>
+void TrainingDataLoader::SampleColumns(const std::filesystem::path& path, const TColumns& columns)
+{
+    thread_local std::vector<SampledPosition> positions;
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    const int64_t* gamePositionOffsets = columns.GamePositionOffsets();
+    const float* results = columns.Result();
+    const float* mctsValues = columns.MctsValues();
+    const INetwork::PackedPlane* imagePiecesAuxiliary = columns.ImagePiecesAuxiliary();
+    const int64_t* policyOffsets = columns.PolicyOffsets();
+    const int64_t* policyIndices = columns.PolicyIndices();
+    const float* policyValues = columns.PolicyValues();
+
+    positions.clear();
+    for (int g = 0; g < columns.GameCount(); g++)
+    {
+        // Throw away a proportion of games, then positions, as in dataset.py.
+        if (unit(Random::Engine) >= _options.keepGameProportion)
+        {
+            continue;
+        }
+
+        const int64_t gameStart = gamePositionOffsets[g];
+        const int positionCount = static_cast<int>(gamePositionOffsets[g + 1] - gameStart);
+        for (int i = 0; i < positionCount; i++)
+        {
+            if (unit(Random::Engine) >= _options.keepPositionProportion)
+            {
+                continue;
+            }
+
+            const int64_t position = (gameStart + i);
+            const int64_t policyStart = policyOffsets[position];
+            const int policyCount = static_cast<int>(policyOffsets[position + 1] - policyStart);
+            if ((policyCount < 0) || (policyCount > MAX_MOVES))
+            {
+                throw ChessCoachException("Invalid policy in chunk: " + path.string());
+            }
+
+            SampledPosition& sampled = positions.emplace_back();
+
+            // Take this position's pieces and repetitions plus the previous 7 positions', oldest first, saturating
+            // at the starting position, then this position's auxiliary planes.
+            for (int h = 0; h <= INetwork::InputPreviousPositionCount; h++)
+            {
+                const int historyIndex = std::max(0, i - INetwork::InputPreviousPositionCount + h);
+                std::copy_n(imagePiecesAuxiliary + ((gameStart + historyIndex) * ImagePiecesAuxiliaryStride),
+                    INetwork::InputPieceAndRepetitionPlanesPerPosition,
+                    sampled.image.data() + (h * INetwork::InputPieceAndRepetitionPlanesPerPosition));
+            }
+            std::copy_n(imagePiecesAuxiliary + (position * ImagePiecesAuxiliaryStride) + INetwork::InputPieceAndRepetitionPlanesPerPosition,
+                INetwork::InputAuxiliaryPlaneCount,
+                sampled.image.data() + ((INetwork::InputPreviousPositionCount + 1) * INetwork::InputPieceAndRepetitionPlanesPerPosition));
+
+            // The result is from the first player's POV and flips per position (see "decompress_values" in dataset.py).
+            sampled.value = ((i % 2) == 0) ? results[g] : -results[g];
+            sampled.mctsValue = mctsValues[position];
+
+            sampled.policyCount = policyCount;
+            for (int p = 0; p < policyCount; p++)
+            {
+                const int64_t index = policyIndices[policyStart + p];
+                if ((index < 0) || (index >= INetwork::OutputPlanesFloatCount))
+                {
+                    throw ChessCoachException("Invalid policy in chunk: " + path.string());
+                }
+                sampled.policyIndices[p] = static_cast<uint16_t>(index);
+                sampled.policyValues[p] = policyValues[policyStart + p];
+            }
+        }
+    }
+
+    AddPositions(positions);
+}
+
+// Fills the reservoir as space frees up.
+void TrainingDataLoader::AddPositions(const std::vector<SampledPosition>& positions)
+{
+    size_t added = 0;
+    while (added < positions.size())
+    {
+        {
+            std::unique_lock lock(_mutex);
+            _reservoirNotFull.wait(lock, [&] { return (_stopping || ((_reservoirCount + _reservoirTaking) < _reservoirCapacity)); });
+            if (_stopping)
+            {
+                return;
+            }
+
+            // Fill free slots, moving each in front of any being taken.
+            const size_t count = std::min(positions.size() - added, static_cast<size_t>(_reservoirCapacity - _reservoirCount - _reservoirTaking));
+            for (size_t i = 0; i < count; i++)
+            {
+                std::swap(_reservoirSlots[_reservoirCount], _reservoirSlots[_reservoirCount + _reservoirTaking]);
+                _reservoir[_reservoirSlots[_reservoirCount]] = positions[added];
+                _reservoirCount++;
+                added++;
+            }
+        }
+        _reservoirFull.notify_one();
+    }
+}
+
+// Draws random positions out of the reservoir once full, moving the last filled slot into each gap. Returns false if stopping.
+//
+// Only the batch thread takes positions. It picks slots under the lock but copies them out afterwards, so that
+// readers aren't held up, and only then frees the slots for reuse.
+bool TrainingDataLoader::TakePositions(std::vector<SampledPosition>& positionsOut)
+{
+    std::vector<int> taken(positionsOut.size());
+    {
+        std::unique_lock lock(_mutex);
+        _reservoirFull.wait(lock, [&] { return (_stopping || (_reservoirCount >= _reservoirCapacity)); });
+        if (_stopping)
+        {
+            return false;
+        }
+
+        for (int& slot : taken)
+        {
+            std::uniform_int_distribution<int> distribution(0, _reservoirCount - 1);
+            std::swap(_reservoirSlots[distribution(Random::Engine)], _reservoirSlots[--_reservoirCount]);
+            slot = _reservoirSlots[_reservoirCount];
+        }
+        _reservoirTaking = static_cast<int>(taken.size());
+    }
+
+    for (size_t i = 0; i < taken.size(); i++)
+    {
+        positionsOut[i] = _reservoir[taken[i]];
+    }
+
+    {
+        std::lock_guard lock(_mutex);
+        _reservoirTaking = 0;
+    }
+    _reservoirNotFull.notify_all();
+    return true;
+}
+
+void TrainingDataLoader::FillBatch(const std::vector<SampledPosition>& positions, TrainingBatch& batch) const
+{
+    for (int i = 0; i < _options.batchSize; i++)
+    {
+        const SampledPosition& position = positions[i];
+        batch.images[i] = position.image;
+        batch.values[i] = position.value;
+        batch.mctsValues[i] = position.mctsValue;
+
+        // Reconstruct the dense policy from sparse policy indices/values (see "decompress_policies" in dataset.py).
+        float* policy = reinterpret_cast<float*>(batch.policies[i].data());
+        std::memset(policy, 0, sizeof(INetwork::OutputPlanes));
+        for (int p = 0; p < position.policyCount; p++)
+        {
+            policy[position.policyIndices[p]] = position.policyValues[p];
+        }
+    }
+}
@@ -0,0 +1,141 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _TRAININGDATALOADER_H_
+#define _TRAININGDATALOADER_H_
+
+#include <filesystem>
+#include <vector>
+#include <array>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include <cstdint>
+
+#include <Stockfish/types.h>
+
+#include "Network.h"
+
+class Storage;
+
+struct TrainingDataLoaderOptions
+{
+    int batchSize;
+    int shuffleSize;
+    float keepGameProportion;
+    float keepPositionProportion;
+    int threadCount;
+};
+
+// Decompressed training positions, laid out as the network's training inputs and labels (see "decompress" in dataset.py).
+// Batches are handed to Python as numpy arrays over these buffers, then recycled once Python lets go of them.
+struct TrainingBatch
+{
+    std::vector<INetwork::InputPlanes> images;
+    std::vector<float> values;
+    std::vector<float> mctsValues;
+    std::vector<INetwork::OutputPlanes> policies;
+};
+
+// Natively replaces the tf.data pipeline in dataset.py for local chunks, columnar (".colchunk") or TFRecord (".chunk").
+//
+// Reader threads pick chunks in a shuffled order per source, alternating between sources, keep games and positions
+// with the same proportions as dataset.py, and decompress kept positions into a shuffle reservoir, keeping policies sparse.
+// A batching thread draws random positions out of the full reservoir, like "tf.data.Dataset.shuffle", and scatters
+// dense policies into prefetched batches.
+//
+// Sources repeat indefinitely. Errors on reader or batching threads are rethrown from "NextBatch".
+class TrainingDataLoader
+{
+public:
+
+    static constexpr const int PrefetchBatches = 2;
+
+public:
+
+    TrainingDataLoader(const Storage* storage, std::vector<std::vector<std::filesystem::path>> sources, const TrainingDataLoaderOptions& options);
+    ~TrainingDataLoader();
+
+    TrainingDataLoader(const TrainingDataLoader&) = delete;
+    TrainingDataLoader& operator=(const TrainingDataLoader&) = delete;
+
+    std::unique_ptr<TrainingBatch> NextBatch();
+    void RecycleBatch(std::unique_ptr<TrainingBatch> batch);
+
+    int BatchSize() const;
+
+private:
+
+    struct SampledPosition
+    {
+        INetwork::InputPlanes image;
+        float value;
+        float mctsValue;
+        int policyCount;
+        std::array<uint16_t, MAX_MOVES> policyIndices;
+        std::array<float, MAX_MOVES> policyValues;
+    };
+
+    struct Source
+    {
+        std::vector<std::filesystem::path> chunks;
+        std::vector<int> order;
+        size_t next;
+    };
+
+    void ReadLoop();
+    void BatchLoop();
+    void RunGuarded(void (TrainingDataLoader::*loop)());
+    bool NextChunk(std::filesystem::path& pathOut);
+    void SampleChunk(const std::filesystem::path& path);
+    template <typename TColumns>
+    void SampleColumns(const std::filesystem::path& path, const TColumns& columns);
+    void AddPositions(const std::vector<SampledPosition>& positions);
+    bool TakePositions(std::vector<SampledPosition>& positionsOut);
+    void FillBatch(const std::vector<SampledPosition>& positions, TrainingBatch& batch) const;
+
+private:
+
+    const Storage* _storage;
+    TrainingDataLoaderOptions _options;
+    int _reservoirCapacity;
+
+    // Everything below is guarded by "_mutex".
+    std::mutex _mutex;
+    std::condition_variable _reservoirNotFull;
+    std::condition_variable _reservoirFull;
+    std::condition_variable _batchReady;
+    std::condition_variable _batchTaken;
+    bool _stopping;
+    std::exception_ptr _error;
+    std::vector<Source> _sources;
+    size_t _nextSource;
+    // Positions live in fixed reservoir storage, ordered by "_reservoirSlots": the first "_reservoirCount" slots are filled,
+    // the next "_reservoirTaking" are being copied out by the batch thread, and the rest are free.
+    std::unique_ptr<SampledPosition[]> _reservoir;
+    std::vector<int> _reservoirSlots;
+    int _reservoirCount;
+    int _reservoirTaking;
+    std::deque<std::unique_ptr<TrainingBatch>> _ready;
+    std::vector<std::unique_ptr<TrainingBatch>> _recycled;
+
+    std::vector<std::thread> _threads;
+};
+
+#endif // _TRAININGDATALOADER_H_
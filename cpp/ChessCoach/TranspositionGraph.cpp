@@ -0,0 +1,196 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include "TranspositionGraph.h"
+
+#include <vector>
+#include <cassert>
+
+#include "SelfPlay.h"
+#include "NodeArena.h"
+
+TranspositionGraph TranspositionGraph::Instance;
+
+// Links "node" to the registered children of its position, if any, also taking on proven mates and tablebase
+// bounds. Returns the position's value from the parent's perspective, like "SelfPlayGame::ExpandAndEvaluate".
+bool TranspositionGraph::TryLink(Key key, Node* node, float& valueOut)
+{
+    Shard& shard = ShardFor(key);
+    std::lock_guard lock(shard.mutex);
+
+    const auto match = shard.entries.find(key);
+    if (match == shard.entries.end())
+    {
+        return false;
+    }
+
+    const Entry& entry = match->second;
+    const Node* owner = entry.owner;
+    assert(node != owner);
+    assert(!node->IsExpanded());
+
+    node->children = entry.children;
+    node->childCount = static_cast<uint8_t>(entry.childCount);
+    node->bestIndex.store(owner->bestIndex.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    node->tablebaseRankBound.store(owner->tablebaseRankBound.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    const TerminalValue ownerTerminalValue = owner->terminalValue.load(std::memory_order_relaxed);
+    if (ownerTerminalValue.IsMateInN() || ownerTerminalValue.IsOpponentMateInN())
+    {
+        node->SetTerminalValue(ownerTerminalValue);
+    }
+
+    // Prefer the owner's backpropagated value, but it may not have finished its first visit yet.
+    valueOut = ((owner->valueWeight.load(std::memory_order_relaxed) > 0) ? owner->Value() : entry.value);
+
+    _linkCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Registers the freshly expanded children of "owner" for its position. Returns false if another node
+// already registered the position, in which case the caller should free its children and link instead.
+bool TranspositionGraph::Register(Key key, Node* owner, float value)
+{
+    assert(owner->IsExpanded());
+
+    Shard& shard = ShardFor(key);
+    std::lock_guard lock(shard.mutex);
+
+    return shard.entries.try_emplace(key, Entry{ owner, owner->children, owner->childCount, value }).second;
+}
+
+// Frees the single "oldRoot" node and any children arrays reachable from it but not from "newRoot",
+// forgetting their positions. Surviving positions take on a reachable owner.
+void TranspositionGraph::ReleaseUnreachable(Node* oldRoot, Node* newRoot)
+{
+    ArrayMap reachable;
+    CollectArrays(newRoot, reachable);
+
+    // Collect counts before freeing anything, since linking nodes live inside other arrays.
+    ArrayMap previous;
+    CollectArrays(oldRoot, previous);
+    std::vector<std::pair<Node*, int>> unreachable;
+    for (const auto& [children, node] : previous)
+    {
+        if (reachable.find(children) == reachable.end())
+        {
+            unreachable.emplace_back(children, node->childCount);
+        }
+    }
+
+    for (Shard& shard : _shards)
+    {
+        std::lock_guard lock(shard.mutex);
+        for (auto entry = shard.entries.begin(); entry != shard.entries.end();)
+        {
+            const auto match = reachable.find(entry->second.children);
+            if (match == reachable.end())
+            {
+                entry = shard.entries.erase(entry);
+            }
+            else
+            {
+                entry->second.owner = match->second;
+                ++entry;
+            }
+        }
+    }
+
+    for (const auto& [children, childCount] : unreachable)
+    {
+        NodeArena::Free(children, childCount);
+    }
+    NodeArena::Free(oldRoot, 1);
+}
+
+// Frees the single "root" node and every children array reachable from it, forgetting all positions.
+void TranspositionGraph::ReleaseAll(Node* root)
+{
+    ArrayMap arrays;
+    CollectArrays(root, arrays);
+    std::vector<std::pair<Node*, int>> counts;
+    counts.reserve(arrays.size());
+    for (const auto& [children, node] : arrays)
+    {
+        counts.emplace_back(children, node->childCount);
+    }
+
+    Clear();
+
+    for (const auto& [children, childCount] : counts)
+    {
+        NodeArena::Free(children, childCount);
+    }
+    NodeArena::Free(root, 1);
+}
+
+TranspositionGraphStatistics TranspositionGraph::Statistics() const
+{
+    TranspositionGraphStatistics statistics = {};
+    for (const Shard& shard : _shards)
+    {
+        std::lock_guard lock(shard.mutex);
+        statistics.entryCount += static_cast<int64_t>(shard.entries.size());
+        statistics.tableBytes += static_cast<int64_t>(shard.entries.bucket_count() * sizeof(void*));
+    }
+
+    // Approximate the hash nodes: key, entry and next pointer.
+    statistics.tableBytes += (statistics.entryCount * static_cast<int64_t>(sizeof(Key) + sizeof(Entry) + sizeof(void*)));
+    statistics.linkCount = _linkCount.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+TranspositionGraph::Shard& TranspositionGraph::ShardFor(Key key)
+{
+    // The low bits pick a prediction cache bucket, so use high bits here.
+    return _shards[(key >> 58) % ShardCount];
+}
+
+// Walks the graph once per children array, so shared arrays aren't visited again.
+void TranspositionGraph::CollectArrays(Node* root, ArrayMap& arrays) const
+{
+    if (!root)
+    {
+        return;
+    }
+
+    std::vector<Node*> stack = { root };
+    while (!stack.empty())
+    {
+        Node* node = stack.back();
+        stack.pop_back();
+
+        if (!node->IsExpanded() || !arrays.emplace(node->children, node).second)
+        {
+            continue;
+        }
+
+        for (Node& child : *node)
+        {
+            stack.push_back(&child);
+        }
+    }
+}
+
+void TranspositionGraph::Clear()
+{
+    for (Shard& shard : _shards)
+    {
+        std::lock_guard lock(shard.mutex);
+        shard.entries.clear();
+    }
+    _linkCount.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,97 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _TRANSPOSITIONGRAPH_H_
+#define _TRANSPOSITIONGRAPH_H_
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+
+#include <Stockfish/types.h>
+
+struct Node;
+
+struct TranspositionGraphStatistics
+{
+    int64_t entryCount;
+    int64_t linkCount;
+    int64_t tableBytes;
+};
+
+// In graph ("transpositions") search mode, expanded positions are registered here by their search key
+// (see "Game::GenerateImageKey" with "tryHard"), and other nodes reaching the same position link to the
+// registered children array instead of expanding again. Visits, values and proven mates below a position
+// are then shared between its transpositions, rather than just network predictions via the prediction cache.
+//
+// Linked arrays make the tree a directed acyclic graph, so it can't be released a subtree at a time
+// (see "NodeArena::Release"). Instead, "ReleaseUnreachable" walks the graph when the search root advances,
+// and "ReleaseAll" frees everything for a new position. Like releasing trees, this requires that no other
+// thread can still reach the graph.
+//
+// Linking ignores the path to a position, like the prediction cache, so 2-repetitions are judged by the
+// path that first expanded each position (graph history interaction). Search stops at repetitions
+// on the current path before descending into shared children, which also rules out cycles.
+class TranspositionGraph
+{
+public:
+
+    static TranspositionGraph Instance;
+
+    static constexpr const int ShardCount = 64;
+
+public:
+
+    bool TryLink(Key key, Node* node, float& valueOut);
+    bool Register(Key key, Node* owner, float value);
+    void ReleaseUnreachable(Node* oldRoot, Node* newRoot);
+    void ReleaseAll(Node* root);
+    TranspositionGraphStatistics Statistics() const;
+
+private:
+
+    struct Entry
+    {
+        Node* owner;
+        Node* children;
+        int childCount;
+        float value;
+    };
+
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<Key, Entry> entries;
+    };
+
+    // Children arrays reachable from a root, each with the first node found linking to it.
+    using ArrayMap = std::unordered_map<Node*, Node*>;
+
+private:
+
+    Shard& ShardFor(Key key);
+    void CollectArrays(Node* root, ArrayMap& arrays) const;
+    void Clear();
+
+private:
+
+    std::array<Shard, ShardCount> _shards;
+    std::atomic<int64_t> _linkCount;
+};
+
+#endif // _TRANSPOSITIONGRAPH_H_
@@ -26,7 +26,7 @@ class ChessCoachStrengthTest : public ChessCoach
 public:
 
     ChessCoachStrengthTest(const std::filesystem::path& epdPath,
-        int moveTimeMs, int nodes, int failureNodes, int positionLimit, float slopeArg, float interceptArg);
+        int moveTimeMs, int nodes, int failureNodes, int positionLimit, int concurrency, float slopeArg, float interceptArg);
 
     void Initialize();
 
@@ -39,6 +39,7 @@ private:
     int _nodes;
     int _failureNodes;
     int _positionLimit;
+    int _concurrency;
     float _slope;
     float _intercept;
 };
@@ -50,6 +51,7 @@ int main(int argc, char* argv[])
     int nodes;
     int failureNodes;
     int positionLimit;
+    int concurrency;
     float slope;
     float intercept;
 
@@ -62,12 +64,14 @@ int main(int argc, char* argv[])
         TCLAP::ValueArg<int> nodesArg("o", "nodes", "Nodes per position", false /* req */, 0, "whole number");
         TCLAP::ValueArg<int> failureNodesArg("u", "failure", "Failure nodes per position", false /* req */, 0, "whole number");
         TCLAP::ValueArg<int> positionLimitArg("l", "limit", "Number of positions in the EPD to run", false /* req */, 0, "whole number");
+        TCLAP::ValueArg<int> concurrencyArg("c", "concurrency", "Number of positions to search at once with a node budget (0 = config)", false /* req */, 0, "whole number");
         TCLAP::ValueArg<float> slopeArg("s", "slope", "Slope for linear rating calculation based on score", false /* req */, 0.f, "decimal");
         TCLAP::ValueArg<float> interceptArg("i", "intercept", "Intercept for linear rating calculation based on score", false /* req */, 0.f, "decimal");
 
         // Usage/help seems to reverse this order.
         cmd.add(interceptArg);
         cmd.add(slopeArg);
+        cmd.add(concurrencyArg);
         cmd.add(positionLimitArg);
         cmd.add(failureNodesArg);
         cmd.add(nodesArg);
@@ -81,6 +85,7 @@ int main(int argc, char* argv[])
         nodes = nodesArg.getValue();
         failureNodes = failureNodesArg.getValue();
         positionLimit = positionLimitArg.getValue();
+        concurrency = concurrencyArg.getValue();
         slope = slopeArg.getValue();
         intercept = interceptArg.getValue();
     }
@@ -90,7 +95,7 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    ChessCoachStrengthTest strengthTest(epdPath, moveTimeMs, nodes, failureNodes, positionLimit, slope, intercept);
+    ChessCoachStrengthTest strengthTest(epdPath, moveTimeMs, nodes, failureNodes, positionLimit, concurrency, slope, intercept);
 
     strengthTest.PrintExceptions();
     strengthTest.Initialize();
@@ -103,12 +108,13 @@ int main(int argc, char* argv[])
 }
 
 ChessCoachStrengthTest::ChessCoachStrengthTest(const std::filesystem::path& epdPath,
-    int moveTimeMs, int nodes, int failureNodes, int positionLimit, float slope, float intercept)
+    int moveTimeMs, int nodes, int failureNodes, int positionLimit, int concurrency, float slope, float intercept)
     : _epdPath(epdPath)
     , _moveTimeMs(moveTimeMs)
     , _nodes(nodes)
     , _failureNodes(failureNodes)
     , _positionLimit(positionLimit)
+    , _concurrency(concurrency)
     , _slope(slope)
     , _intercept(intercept)
 {
@@ -145,7 +151,7 @@ void ChessCoachStrengthTest::StrengthTest()
     const auto start = std::chrono::high_resolution_clock::now();
 
     const auto [score, total, positions, totalNodesRequired] = workerGroup.controllerWorker->StrengthTestEpd(workerGroup.workCoordinator.get(), _epdPath,
-        _moveTimeMs, _nodes, _failureNodes, _positionLimit, PrintProgress);
+        _moveTimeMs, _nodes, _failureNodes, _positionLimit, ((_concurrency > 0) ? _concurrency : Config::Misc.Search_StrengthTestConcurrency), PrintProgress);
 
     const float secondsTaken = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
 
@@ -0,0 +1,55 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include <ChessCoach/ChessCoach.h>
+#include <ChessCoach/Bench.h>
+
+TEST(Bench, Uniform)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    const int nodes = 200;
+    const BenchResult result = Bench::Run(nullptr /* network */, "uniform", nodes, 2 /* threadCount */, 32 /* parallelism */);
+
+    // Every position reaches its node count (slightly overshooting with slots in flight), from an empty cache.
+    EXPECT_EQ(result.positionCount, Bench::Positions.size());
+    EXPECT_GE(result.nodeCount, static_cast<int64_t>(nodes) * result.positionCount);
+    EXPECT_GE(result.failedNodeCount, 0);
+    EXPECT_GT(result.seconds, 0.f);
+    EXPECT_GT(result.maxTreeBytes, 0);
+    EXPECT_GE(result.predictionCacheHitPermille, 0);
+    EXPECT_LE(result.predictionCacheHitPermille, 1000);
+
+    std::stringstream json;
+    Bench::WriteJson(json, result);
+    EXPECT_EQ(json.str().front(), '{');
+    EXPECT_NE(json.str().find("\"nps\":"), std::string::npos);
+    EXPECT_NE(json.str().find("\"cache_hit_permille\":"), std::string::npos);
+    EXPECT_NE(json.str().find("\"max_tree_bytes\":"), std::string::npos);
+
+    // Fake predictions need no network either.
+    const BenchResult fakeResult = Bench::Run(nullptr /* network */, "fake", nodes, 2 /* threadCount */, 32 /* parallelism */);
+    EXPECT_GE(fakeResult.nodeCount, static_cast<int64_t>(nodes) * fakeResult.positionCount);
+
+    // Only "uniform", "fake" and "network" (with a network) predictions are supported.
+    EXPECT_THROW(Bench::Run(nullptr /* network */, "network", nodes, 2 /* threadCount */, 32 /* parallelism */), ChessCoachException);
+    EXPECT_THROW(Bench::Run(nullptr /* network */, "random", nodes, 2 /* threadCount */, 32 /* parallelism */), ChessCoachException);
+}
@@ -0,0 +1,152 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <filesystem>
+
+#include <ChessCoach/ChessCoach.h>
+#include <ChessCoach/FakeNetwork.h>
+#include <ChessCoach/Config.h>
+
+TEST(FakeNetwork, Deterministic)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    FakeNetwork network(nullptr /* fallback */, FakeNetworkOptions{});
+
+    // Predict the starting position twice and the position after 1.e4 once, in one batch.
+    Game game;
+    std::vector<INetwork::InputPlanes> images(3);
+    std::vector<float> values(3);
+    std::vector<INetwork::OutputPlanes> policies(3);
+    game.GenerateImage(images[0]);
+    game.GenerateImage(images[1]);
+    game.ApplyMove(make_move(SQ_E2, SQ_E4));
+    game.GenerateImage(images[2]);
+    network.PredictBatch(NetworkType_Teacher, 3, images.data(), values.data(), policies.data());
+
+    // The same image gives the same prediction, and different images (almost surely) give different predictions.
+    EXPECT_EQ(values[0], values[1]);
+    EXPECT_EQ(policies[0], policies[1]);
+    EXPECT_NE(values[0], values[2]);
+    EXPECT_NE(policies[0], policies[2]);
+
+    // Predictions are also the same across networks and calls.
+    float value;
+    std::unique_ptr<INetwork::OutputPlanes> policy(std::make_unique<INetwork::OutputPlanes>());
+    FakeNetwork::Predict(images[2], value, *policy);
+    EXPECT_EQ(value, values[2]);
+    EXPECT_EQ(*policy, policies[2]);
+
+    // Values are probabilities and logits are modest.
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_GT(values[i], 0.f);
+        EXPECT_LT(values[i], 1.f);
+        const float* logits = reinterpret_cast<const float*>(policies[i].data());
+        for (int j = 0; j < INetwork::OutputPlanesFloatCount; j++)
+        {
+            EXPECT_GE(logits[j], -2.f);
+            EXPECT_LE(logits[j], 2.f);
+        }
+    }
+}
+
+TEST(FakeNetwork, Latency)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    FakeNetworkOptions options;
+    options.latencyMicroseconds = 2000;
+    options.microsecondsPerPosition = 500;
+    FakeNetwork network(nullptr /* fallback */, options);
+
+    const int batchSize = 8;
+    std::vector<INetwork::InputPlanes> images(batchSize);
+    std::vector<float> values(batchSize);
+    std::vector<INetwork::OutputPlanes> policies(batchSize);
+
+    const auto start = std::chrono::steady_clock::now();
+    network.PredictBatch(NetworkType_Teacher, batchSize, images.data(), values.data(), policies.data());
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    EXPECT_GE(elapsed.count(), options.latencyMicroseconds + batchSize * options.microsecondsPerPosition);
+}
+
+TEST(FakeNetwork, WithoutFallback)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    FakeNetwork network(nullptr /* fallback */, FakeNetworkOptions{});
+
+    // Files are local, and saved chunks count as training chunks.
+    const std::filesystem::path directory = (std::filesystem::temp_directory_path() / "ChessCoachTest" / "FakeNetwork");
+    std::filesystem::remove_all(directory);
+    const std::string chunkPath = (directory / "games_000000001.chunk").string();
+    EXPECT_FALSE(network.FileExists(chunkPath));
+    network.SaveFile(chunkPath, std::string("chunk\0data", 10));
+    EXPECT_TRUE(network.FileExists(chunkPath));
+    EXPECT_EQ(network.LoadFile(chunkPath), std::string("chunk\0data", 10));
+    EXPECT_THROW(network.LoadFile((directory / "missing").string()), ChessCoachException);
+
+    // Saving networks advances step counts and gives a path for artifacts like strength test markers.
+    int stepCount = -1;
+    int swaStepCount = -1;
+    int trainingChunkCount = -1;
+    std::string relativePath = "unset";
+    network.GetNetworkInfo(NetworkType_Teacher, &stepCount, &swaStepCount, &trainingChunkCount, &relativePath);
+    EXPECT_EQ(stepCount, 0);
+    EXPECT_EQ(swaStepCount, 0);
+    EXPECT_EQ(trainingChunkCount, 1);
+    EXPECT_TRUE(relativePath.empty());
+
+    network.Train(NetworkType_Teacher, 1, 1000);
+    network.SaveNetwork(NetworkType_Teacher, 1000);
+    network.SaveSwaNetwork(NetworkType_Teacher, 1000);
+    network.GetNetworkInfo(NetworkType_Teacher, &stepCount, &swaStepCount, nullptr, &relativePath);
+    EXPECT_EQ(stepCount, 1000);
+    EXPECT_EQ(swaStepCount, 1000);
+    EXPECT_EQ(relativePath, Config::Misc.Paths_Networks + "/" + Config::Network.Name + "_000001000");
+    network.GetNetworkInfo(NetworkType_Student, &stepCount, nullptr, nullptr, nullptr);
+    EXPECT_EQ(stepCount, 0);
+
+    // Anything needing Python isn't supported.
+    EXPECT_THROW(network.LaunchGui("push"), ChessCoachException);
+    EXPECT_THROW(network.RunBot(), ChessCoachException);
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(FakeNetwork, Config)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    const MiscConfig original = Config::Misc;
+    Config::Misc.Inference_Backend = "fake";
+    Config::Misc.Inference_BatchingServer = false;
+    Config::Misc.Inference_FakePython = false;
+
+    std::unique_ptr<INetwork> network(chessCoach.CreateNetwork());
+    EXPECT_NE(dynamic_cast<FakeNetwork*>(network.get()), nullptr);
+
+    Config::Misc = original;
+}
@@ -16,6 +16,10 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <random>
+#include <iostream>
+
 #include <ChessCoach/SelfPlay.h>
 #include <ChessCoach/ChessCoach.h>
 #include <ChessCoach/Random.h>
@@ -113,4 +117,160 @@ TEST(Game, FlipSpecialMoves)
         EXPECT_EQ(move, Game::FlipMove(WHITE, Game::FlipMove(WHITE, move)));
         EXPECT_EQ(move, Game::FlipMove(BLACK, Game::FlipMove(BLACK, move)));
     }
-}
\ No newline at end of file
+}
+// Plays random legal moves (and a null move every "nullMovePeriod" plies, if non-zero),
+// keeping a copy of the game after each move.
+void PlayRandomGame(Game& game, std::vector<Game>& snapshots, int maxMoves, int nullMovePeriod)
+{
+    snapshots.push_back(game);
+    for (int i = 0; i < maxMoves; i++)
+    {
+        const MoveList<LEGAL> legalMoves(game.GetPosition());
+        if ((legalMoves.size() == 0) || game.IsDrawByNoProgressOrThreefoldRepetition())
+        {
+            break;
+        }
+
+        // Null moves are only applied outside of check, like during commentary/search prep.
+        const bool nullMove = ((nullMovePeriod > 0) && ((i % nullMovePeriod) == (nullMovePeriod - 1)) && !game.GetPosition().checkers());
+        std::uniform_int_distribution<int> moveDistribution(0, static_cast<int>(legalMoves.size()) - 1);
+        game.ApplyMoveMaybeNull(nullMove ? MOVE_NULL : legalMoves.begin()[moveDistribution(Random::Engine)].move);
+        snapshots.push_back(game);
+    }
+}
+
+// The recorded history positions should produce exactly what undoing/redoing moves does.
+void ExpectImagesMatchReplay(Game& game)
+{
+    INetwork::InputPlanes image;
+    INetwork::InputPlanes imageReplay;
+    game.GenerateImage(image);
+    game.GenerateImageReplay(imageReplay.data());
+    EXPECT_EQ(image, imageReplay);
+    EXPECT_EQ(game.GenerateImageKey(false /* tryHard */), game.GenerateImageKeyReplay(false /* tryHard */));
+}
+
+TEST(Game, HistoryMatchesReplay)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    // Random games from the starting position, with some null moves and copies/moves of games in between.
+    for (int i = 0; i < 20; i++)
+    {
+        Game game;
+        std::vector<Game> snapshots;
+        PlayRandomGame(game, snapshots, 150, ((i % 2) ? 5 : 0));
+        for (Game& snapshot : snapshots)
+        {
+            ExpectImagesMatchReplay(snapshot);
+        }
+
+        Game moved(std::move(game));
+        ExpectImagesMatchReplay(moved);
+        Game assigned;
+        assigned = snapshots[snapshots.size() / 2];
+        ExpectImagesMatchReplay(assigned);
+    }
+
+    // Start from a FEN with moves, shuffling pieces back and forth to repeat positions.
+    const std::string fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+    const std::vector<Move> moves = {
+        make_move(SQ_E1, SQ_F1), make_move(SQ_E8, SQ_F8),
+        make_move(SQ_F1, SQ_E1), make_move(SQ_F8, SQ_E8),
+        make_move(SQ_E1, SQ_F1), make_move(SQ_E8, SQ_F8),
+    };
+    Game repetitions(fen, moves);
+    EXPECT_NE(repetitions.GetPosition().state_info()->repetition, 0);
+    ExpectImagesMatchReplay(repetitions);
+    for (int i = 0; i < 10; i++)
+    {
+        std::vector<Game> snapshots;
+        Game game = repetitions;
+        PlayRandomGame(game, snapshots, 20, 0);
+        for (Game& snapshot : snapshots)
+        {
+            ExpectImagesMatchReplay(snapshot);
+        }
+    }
+}
+
+// Timing only (images and keys are checked against replay by "HistoryMatchesReplay"), so disabled
+// in the unit suite: run with "meson test --benchmark" (see "MicroBenchmarks").
+TEST(Game, DISABLED_HistoryBenchmark)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    // Compare image and key generation per leaf between the recorded history positions and
+    // undoing/redoing moves on the Position, at a typical mid-game ply.
+    Game game;
+    std::vector<Game> snapshots;
+    PlayRandomGame(game, snapshots, 40, 0);
+    Game& leaf = snapshots.back();
+
+    const int repeatCount = 200000;
+    const auto seconds = [](auto start) { return std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count(); };
+    INetwork::InputPlanes image;
+    Key keys = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < repeatCount; i++)
+    {
+        keys ^= leaf.GenerateImageKeyReplay(false /* tryHard */);
+        leaf.GenerateImageReplay(image.data());
+    }
+    const float replaySeconds = seconds(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < repeatCount; i++)
+    {
+        keys ^= leaf.GenerateImageKey(false /* tryHard */);
+        leaf.GenerateImage(image);
+    }
+    const float historySeconds = seconds(start);
+
+    std::cout << "replay: ns/leaf=" << (replaySeconds * 1e9f / repeatCount) << std::endl;
+    std::cout << "history: ns/leaf=" << (historySeconds * 1e9f / repeatCount) << std::endl;
+
+    // Keys cancel out across the two loops.
+    EXPECT_EQ(keys, 0);
+    EXPECT_LT(historySeconds, replaySeconds);
+}
+
+TEST(Game, UndoMove)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    // Play a real game, then walk a copy down random lines and back, comparing against fresh copies.
+    for (int i = 0; i < 10; i++)
+    {
+        Game game;
+        std::vector<Game> snapshots;
+        PlayRandomGame(game, snapshots, 30, 0);
+        Game& root = snapshots.back();
+
+        Game scratch = root;
+        for (int line = 0; line < 10; line++)
+        {
+            std::vector<Game> lineSnapshots;
+            PlayRandomGame(scratch, lineSnapshots, 20, ((line % 2) ? 3 : 0));
+
+            // Undo partway, checking each position against the copy taken on the way down.
+            const int undoCount = ((line == 9) ? static_cast<int>(lineSnapshots.size() - 1) : static_cast<int>(lineSnapshots.size() / 2));
+            for (int u = 0; u < undoCount; u++)
+            {
+                scratch.UndoMove();
+                Game& expected = lineSnapshots[lineSnapshots.size() - 2 - u];
+                EXPECT_EQ(scratch.Ply(), expected.Ply());
+                EXPECT_EQ(scratch.GetPosition().key(), expected.GetPosition().key());
+                EXPECT_EQ(scratch.GetPosition().fen(), expected.GetPosition().fen());
+                EXPECT_EQ(scratch.GetPosition().state_info()->repetition, expected.GetPosition().state_info()->repetition);
+                EXPECT_EQ(scratch.Moves(), expected.Moves());
+                EXPECT_EQ(scratch.GenerateImageKey(false /* tryHard */), expected.GenerateImageKey(false /* tryHard */));
+                ExpectImagesMatchReplay(scratch);
+            }
+        }
+    }
+}
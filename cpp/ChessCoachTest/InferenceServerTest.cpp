@@ -0,0 +1,159 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <numeric>
+#include <cmath>
+
+#include <ChessCoach/InferenceServer.h>
+#include <ChessCoach/NativeNetwork.h>
+#include <ChessCoach/ChessCoach.h>
+#include <ChessCoach/Game.h>
+
+// Defined in NativeNetworkTest.cpp.
+std::unique_ptr<NativeWeights> BiasOnlyWeights(int residualCount, int filterCount, int denseCount, float valueBias);
+
+TEST(InferenceServer, QueueOrder)
+{
+    const int producerCount = 4;
+    const int chainCount = 1000;
+    const int chainLength = 3;
+
+    // Each producer publishes chains, waiting for the consumer to pop a chain before reusing its requests.
+    std::vector<std::vector<InferenceRequest>> requests(producerCount);
+    std::vector<std::atomic_int> popped(producerCount);
+    for (int p = 0; p < producerCount; p++)
+    {
+        requests[p] = std::vector<InferenceRequest>(chainLength);
+        popped[p] = 0;
+    }
+
+    InferenceQueue queue;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producerCount; p++)
+    {
+        producers.emplace_back([&, p]()
+            {
+                for (int c = 0; c < chainCount; c++)
+                {
+                    while (popped[p].load() < (c * chainLength))
+                    {
+                        std::this_thread::yield();
+                    }
+                    for (int i = 0; i < chainLength; i++)
+                    {
+                        requests[p][i].next.store(((i + 1) < chainLength) ? &requests[p][i + 1] : nullptr, std::memory_order_relaxed);
+                        requests[p][i].value = reinterpret_cast<float*>(static_cast<intptr_t>((p * chainLength) + i + 1)); // Tag only, not dereferenced.
+                    }
+                    queue.Push(&requests[p][0], &requests[p][chainLength - 1]);
+                }
+            });
+    }
+
+    // Requests from each producer should come out in order, with chains intact.
+    int total = 0;
+    std::vector<int> expected(producerCount, 0);
+    while (total < (producerCount * chainCount * chainLength))
+    {
+        InferenceRequest* request = queue.Pop();
+        if (!request)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        const int tag = static_cast<int>(reinterpret_cast<intptr_t>(request->value));
+        const int p = ((tag - 1) / chainLength);
+        ASSERT_LT(p, producerCount);
+        EXPECT_EQ(((tag - 1) % chainLength), expected[p]);
+        expected[p] = ((expected[p] + 1) % chainLength);
+        popped[p]++;
+        total++;
+    }
+
+    for (std::thread& producer : producers)
+    {
+        producer.join();
+    }
+    EXPECT_EQ(queue.Pop(), nullptr);
+}
+
+TEST(InferenceServer, DynamicBatching)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    const float valueBias = 0.75f;
+    const int maxBatchSize = 16;
+    InferenceServer server(new NativeNetwork(nullptr /* fallback */, NetworkType_Teacher, BiasOnlyWeights(1 /* residualCount */, 4 /* filterCount */, 2 /* denseCount */, valueBias)),
+        1 /* threadCount */, maxBatchSize, 1000 /* maxLatencyMicroseconds */);
+
+    // Callers predict odd-sized batches that the server needs to combine and split.
+    const int callerCount = 4;
+    const int callCount = 10;
+    const int batchSize = 7;
+    std::vector<std::thread> callers;
+    std::vector<int> updatedCounts(callerCount);
+    std::vector<std::vector<float>> callerValues(callerCount);
+    for (int c = 0; c < callerCount; c++)
+    {
+        callers.emplace_back([&, c]()
+            {
+                Game game;
+                std::vector<INetwork::InputPlanes> images(batchSize);
+                std::vector<float> values(batchSize);
+                std::vector<INetwork::OutputPlanes> policies(batchSize);
+                for (INetwork::InputPlanes& image : images)
+                {
+                    game.GenerateImage(image);
+                }
+                for (int i = 0; i < callCount; i++)
+                {
+                    std::fill(values.begin(), values.end(), -1.f);
+                    const PredictionStatus status = server.PredictBatch(NetworkType_Teacher, batchSize, images.data(), values.data(), policies.data());
+                    updatedCounts[c] += ((status & PredictionStatus_UpdatedNetwork) ? 1 : 0);
+                    callerValues[c].insert(callerValues[c].end(), values.begin(), values.end());
+                }
+            });
+    }
+    for (std::thread& caller : callers)
+    {
+        caller.join();
+    }
+
+    // Every position should have been predicted.
+    for (int c = 0; c < callerCount; c++)
+    {
+        for (float value : callerValues[c])
+        {
+            EXPECT_NEAR(value, INetwork::MapProbability11To01(std::tanh(valueBias)), 1e-6f);
+        }
+    }
+
+    // The wrapped network's first-prediction status should reach at least one caller.
+    EXPECT_GE(std::accumulate(updatedCounts.begin(), updatedCounts.end(), 0), 1);
+
+    const InferenceStatistics statistics = server.Statistics();
+    EXPECT_EQ(statistics.predictionCount, (callerCount * callCount * batchSize));
+    EXPECT_GE(statistics.batchCount, (statistics.predictionCount + maxBatchSize - 1) / maxBatchSize);
+    EXPECT_LE(statistics.fullBatchCount, statistics.batchCount);
+    EXPECT_LE(statistics.queueLatencyNanosecondsTotal, (statistics.predictionCount * statistics.queueLatencyNanosecondsMax));
+
+    server.ResetStatistics();
+    EXPECT_EQ(server.Statistics().batchCount, 0);
+}
@@ -0,0 +1,141 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <ChessCoach/ChessCoach.h>
+#include <ChessCoach/Config.h>
+#include <ChessCoach/Instrumentation.h>
+#include <ChessCoach/Bench.h>
+
+TEST(Instrumentation, Histograms)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    Instrumentation::SetEnabled(true);
+    Instrumentation::SetPerNode(true);
+    Instrumentation::ResetStatistics();
+
+    // 99 fast probes and one slow one.
+    for (int i = 0; i < 99; i++)
+    {
+        Instrumentation::RecordDuration(InstrumentedPhase_SyzygyProbe, 1000);
+    }
+    Instrumentation::RecordDuration(InstrumentedPhase_SyzygyProbe, 1000000);
+    Instrumentation::RecordSelectionDepth(3);
+    Instrumentation::RecordSelectionDepth(5);
+    Instrumentation::RecordSelectionDepth(1000);
+
+    InstrumentationStatistics statistics = Instrumentation::Statistics();
+    const PhaseStatistics& syzygy = statistics.phases[InstrumentedPhase_SyzygyProbe];
+    EXPECT_EQ(syzygy.count, 100);
+    EXPECT_EQ(syzygy.totalNanoseconds, (99 * 1000) + 1000000);
+    EXPECT_EQ(syzygy.maxNanoseconds, 1000000);
+    EXPECT_EQ(syzygy.histogram[9], 99); // [512, 1024)
+    EXPECT_EQ(syzygy.histogram[19], 1); // [524288, 1048576)
+    EXPECT_FLOAT_EQ(syzygy.AverageMicroseconds(), 10.99f);
+
+    // Percentiles are bucket upper bounds, capped at the max.
+    EXPECT_FLOAT_EQ(syzygy.PercentileMicroseconds(0.5f), 1.024f);
+    EXPECT_FLOAT_EQ(syzygy.PercentileMicroseconds(0.98f), 1.024f);
+    EXPECT_FLOAT_EQ(syzygy.PercentileMicroseconds(0.995f), 1000.f);
+
+    EXPECT_EQ(statistics.selectionDepthTotal, 1008);
+    EXPECT_EQ(statistics.maxSelectionDepth, 1000);
+    EXPECT_EQ(statistics.selectionDepthHistogram[3], 1);
+    EXPECT_EQ(statistics.selectionDepthHistogram[5], 1);
+    EXPECT_EQ(statistics.selectionDepthHistogram[Instrumentation::DepthBucketCount - 1], 1);
+
+    // Nothing is recorded while disabled.
+    Instrumentation::SetEnabled(false);
+    {
+        InstrumentedScope scope(InstrumentedPhase_StorageWrite);
+    }
+    Instrumentation::RecordSelectionDepth(1);
+    statistics = Instrumentation::Statistics();
+    EXPECT_EQ(statistics.phases[InstrumentedPhase_StorageWrite].count, 0);
+    EXPECT_EQ(statistics.selectionDepthTotal, 1008);
+
+    // Per-node phases are only recorded when switched on separately.
+    Instrumentation::SetEnabled(true);
+    Instrumentation::SetPerNode(false);
+    {
+        InstrumentedScope scope(InstrumentedPhase_Selection);
+    }
+    Instrumentation::RecordSelectionDepth(1);
+    statistics = Instrumentation::Statistics();
+    EXPECT_EQ(statistics.phases[InstrumentedPhase_Selection].count, 0);
+    EXPECT_EQ(statistics.selectionDepthTotal, 1008);
+
+    {
+        InstrumentedScope scope(InstrumentedPhase_StorageWrite);
+    }
+    EXPECT_EQ(Instrumentation::Statistics().phases[InstrumentedPhase_StorageWrite].count, 1);
+
+    Instrumentation::ResetStatistics();
+    statistics = Instrumentation::Statistics();
+    EXPECT_EQ(statistics.phases[InstrumentedPhase_SyzygyProbe].count, 0);
+    EXPECT_EQ(statistics.phases[InstrumentedPhase_SyzygyProbe].maxNanoseconds, 0);
+    EXPECT_EQ(statistics.selectionDepthTotal, 0);
+
+    Instrumentation::SetPerNode(Config::Misc.Instrumentation_PerNode);
+}
+
+TEST(Instrumentation, Search)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    Instrumentation::SetEnabled(true);
+    Instrumentation::SetPerNode(false);
+    Instrumentation::ResetStatistics();
+
+    // By default only coarse phases are counted.
+    Bench::Run(nullptr /* network */, "fake", 200 /* nodes */, 2 /* threadCount */, 32 /* parallelism */);
+    const InstrumentationStatistics coarse = Instrumentation::Statistics();
+    EXPECT_GT(coarse.phases[InstrumentedPhase_Mcts].count, 0);
+    EXPECT_GT(coarse.phases[InstrumentedPhase_PredictBatchWait].count, 0);
+    for (InstrumentedPhase phase : { InstrumentedPhase_Selection, InstrumentedPhase_ExpandAndEvaluate, InstrumentedPhase_MoveGeneration,
+        InstrumentedPhase_CacheProbe, InstrumentedPhase_ImageGeneration, InstrumentedPhase_Softmax, InstrumentedPhase_Backpropagation })
+    {
+        EXPECT_EQ(coarse.phases[phase].count, 0) << InstrumentedPhaseNames[phase];
+    }
+    EXPECT_EQ(coarse.maxSelectionDepth, 0);
+
+    Instrumentation::SetPerNode(true);
+    Instrumentation::ResetStatistics();
+    Bench::Run(nullptr /* network */, "fake", 200 /* nodes */, 2 /* threadCount */, 32 /* parallelism */);
+
+    // Searching covers each MCTS phase and waits on predictions.
+    const InstrumentationStatistics statistics = Instrumentation::Statistics();
+    for (InstrumentedPhase phase : { InstrumentedPhase_Selection, InstrumentedPhase_ExpandAndEvaluate, InstrumentedPhase_MoveGeneration,
+        InstrumentedPhase_CacheProbe, InstrumentedPhase_ImageGeneration, InstrumentedPhase_Softmax, InstrumentedPhase_Backpropagation,
+        InstrumentedPhase_PredictBatchWait })
+    {
+        EXPECT_GT(statistics.phases[phase].count, 0) << InstrumentedPhaseNames[phase];
+        EXPECT_GT(statistics.phases[phase].totalNanoseconds, 0) << InstrumentedPhaseNames[phase];
+    }
+    EXPECT_GT(statistics.maxSelectionDepth, 0);
+
+    // Expansion includes its sub-phases.
+    EXPECT_GE(statistics.phases[InstrumentedPhase_ExpandAndEvaluate].totalNanoseconds,
+        statistics.phases[InstrumentedPhase_MoveGeneration].totalNanoseconds);
+
+    Instrumentation::PrintDebugInfo();
+    Instrumentation::ResetStatistics();
+    Instrumentation::SetPerNode(Config::Misc.Instrumentation_PerNode);
+}
@@ -17,10 +17,22 @@
 #include <gtest/gtest.h>
 
 #include <functional>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
 
 #include <ChessCoach/SelfPlay.h>
+#include <ChessCoach/NodeArena.h>
+#include <ChessCoach/TranspositionGraph.h>
+#include <ChessCoach/WorkerGroup.h>
+#include <ChessCoach/NativeNetwork.h>
 #include <ChessCoach/ChessCoach.h>
 
+// Defined in NativeNetworkTest.cpp.
+std::unique_ptr<NativeWeights> BiasOnlyWeights(int residualCount, int filterCount, int denseCount, float valueBias);
+
 SelfPlayGame& PlayGame(SelfPlayWorker& selfPlayWorker, std::function<void (SelfPlayGame&)> tickCallback)
 {
     const int index = 0;
@@ -84,7 +96,7 @@ void MockExpand(Node* node, int count)
 {
     const float prior = (1.f / count);
 
-    node->children = new Node[count]{};
+    node->children = NodeArena::AllocateChildren(count);
     node->childCount = static_cast<uint8_t>(count);
     for (int i = 0; i < count; i++)
     {
@@ -344,7 +356,7 @@ TEST(Mcts, TwofoldRepetition)
     for (Move move : moves)
     {
         node->childCount = 1;
-        node->children = new Node[1]{};
+        node->children = NodeArena::AllocateChildren(1);
         node = &node->children[0];
         node->move = static_cast<uint16_t>(move);
         node->quantizedPrior = INetwork::QuantizeProbabilityNoZero(1.f);
@@ -361,7 +373,7 @@ TEST(Mcts, TwofoldRepetition)
         }
 
         SelfPlayState state = SelfPlayState::Working;
-        PredictionCacheChunk* cacheStore = nullptr;
+        PredictionCacheChunk cacheStore;
         const float value = searchRoot.ExpandAndEvaluate(state, cacheStore, &searchState, true /* isSearchRoot */, false /* generateUniformPredictions */);
         EXPECT_EQ(value, CHESSCOACH_VALUE_DRAW);
     }
@@ -383,7 +395,7 @@ TEST(Mcts, TwofoldRepetition)
         }
 
         SelfPlayState state = SelfPlayState::Working;
-        PredictionCacheChunk* cacheStore = nullptr;
+        PredictionCacheChunk cacheStore;
         const float value = searchRoot.ExpandAndEvaluate(state, cacheStore, &searchState, true /* isSearchRoot */, false /* generateUniformPredictions */);
         EXPECT_NE(value, CHESSCOACH_VALUE_DRAW);
         EXPECT_TRUE(std::isnan(value)); // A non-terminal position requires a network evaluation.
@@ -406,7 +418,7 @@ TEST(Mcts, SamplingSelfPlay)
 
     // Set up visit counts for four moves.
     game->Root()->childCount = 4;
-    game->Root()->children = new Node[4]{};
+    game->Root()->children = NodeArena::AllocateChildren(4);
     game->Root()->children[0].move = static_cast<uint16_t>(make_move(SQ_E2, SQ_E4));
     game->Root()->children[0].quantizedPrior = INetwork::QuantizeProbabilityNoZero(0.25f);
     game->Root()->children[0].visitCount = 350;
@@ -452,7 +464,7 @@ TEST(Mcts, SamplingUci)
 
     // Set up visit counts for four moves.
     game->Root()->childCount = 4;
-    game->Root()->children = new Node[4]{};
+    game->Root()->children = NodeArena::AllocateChildren(4);
     game->Root()->children[0].move = static_cast<uint16_t>(make_move(SQ_E2, SQ_E4));
     game->Root()->children[0].quantizedPrior = INetwork::QuantizeProbabilityNoZero(0.25f);
     game->Root()->children[0].visitCount = 350;
@@ -492,6 +504,52 @@ TEST(Mcts, SamplingUci)
     game->PruneAll();
 }
 
+TEST(Mcts, MultiPrincipalVariation)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    SearchState searchState{};
+    SelfPlayWorker selfPlayWorker(nullptr /* storage */, &searchState, 1 /* gameCount */);
+    selfPlayWorker.Initialize();
+    SelfPlayGame* game;
+    selfPlayWorker.SetUpGame(0, std::chrono::high_resolution_clock::now(), Game::StartingPosition, {}, true /* tryHard */);
+    selfPlayWorker.DebugGame(0, &game, nullptr, nullptr, nullptr);
+
+    // Set up visit counts for four moves, one unvisited, with a continuation under the second-best.
+    Node* root = game->Root();
+    root->childCount = 4;
+    root->children = NodeArena::AllocateChildren(4);
+    root->children[0].move = static_cast<uint16_t>(make_move(SQ_D2, SQ_D4));
+    root->children[0].visitCount = 250;
+    root->children[1].move = static_cast<uint16_t>(make_move(SQ_E2, SQ_E4));
+    root->children[1].visitCount = 350;
+    root->children[2].move = static_cast<uint16_t>(make_move(SQ_C2, SQ_C4));
+    root->children[3].move = static_cast<uint16_t>(make_move(SQ_E2, SQ_E3));
+    root->children[3].visitCount = 50;
+    root->SetBestChild(&root->children[1]);
+    Node* reply = &root->children[0];
+    reply->childCount = 1;
+    reply->children = NodeArena::AllocateChildren(1);
+    reply->children[0].move = static_cast<uint16_t>(make_move(SQ_D7, SQ_D5));
+    reply->children[0].visitCount = 249;
+    reply->SetBestChild(&reply->children[0]);
+
+    // Lines follow the best child first, then rank visited children, and stop when out of visited children.
+    const std::vector<PrincipalVariationLine> lines = selfPlayWorker.CollectPrincipalVariations(root, 4);
+    ASSERT_EQ(lines.size(), 3);
+    EXPECT_EQ(lines[0].moves, std::vector<Move>({ make_move(SQ_E2, SQ_E4) }));
+    EXPECT_EQ(lines[0].visitCount, 350);
+    EXPECT_EQ(lines[1].moves, std::vector<Move>({ make_move(SQ_D2, SQ_D4), make_move(SQ_D7, SQ_D5) }));
+    EXPECT_EQ(lines[1].visitCount, 250);
+    EXPECT_EQ(lines[2].moves, std::vector<Move>({ make_move(SQ_E2, SQ_E3) }));
+
+    // A single line matches the principal variation.
+    EXPECT_EQ(selfPlayWorker.CollectPrincipalVariations(root, 1).size(), 1);
+
+    game->PruneAll();
+}
+
 TEST(Mcts, PrepareExpandedRoot)
 {
     ChessCoach chessCoach;
@@ -564,4 +622,497 @@ TEST(Mcts, PrepareExpandedRoot)
     EXPECT_TRUE(coverageA);
     EXPECT_TRUE(coverageB);
     EXPECT_TRUE(coverageC);
-}
\ No newline at end of file
+}
+
+TEST(Mcts, TreeEviction)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    // Keep released arrays pending so that they can be counted.
+    NodeArena::StopReclaimer();
+
+    SearchState searchState{};
+    SelfPlayWorker selfPlayWorker(nullptr /* storage */, &searchState, 1 /* gameCount */);
+
+    // Set up a root with 4 expanded children, each with 10 leaves, with the last child on the principal variation.
+    const int childCount = 4;
+    const int grandchildCount = 10;
+    Node* root = NodeArena::AllocateRoot();
+    root->children = NodeArena::AllocateChildren(childCount);
+    root->childCount = childCount;
+    root->visitCount = 1000;
+    for (int i = 0; i < childCount; i++)
+    {
+        Node& child = root->children[i];
+        child.children = NodeArena::AllocateChildren(grandchildCount);
+        child.childCount = grandchildCount;
+        child.expansion = Expansion::Expanded;
+        child.visitCount = (100 * (i + 1));
+        child.valueAverage = (0.1f * (i + 1));
+        child.valueWeight = child.visitCount.load();
+    }
+    root->SetBestChild(&root->children[childCount - 1]);
+    const int64_t arrayBytes = static_cast<int64_t>(NodeArena::ArrayBytes(grandchildCount));
+
+    // With no history, collapse the fewest visits first, keeping visits and values.
+    const int64_t pendingBefore = NodeArena::PendingCount();
+    EXPECT_EQ(selfPlayWorker.EvictTree(root, arrayBytes), arrayBytes);
+    EXPECT_FALSE(root->children[0].IsExpanded());
+    EXPECT_EQ(root->children[0].childCount, 0);
+    EXPECT_EQ(root->children[0].expansion, Expansion::None);
+    EXPECT_EQ(root->children[0].visitCount, 100);
+    EXPECT_EQ(root->children[0].valueAverage, 0.1f);
+    EXPECT_TRUE(root->children[1].IsExpanded());
+    EXPECT_TRUE(root->children[2].IsExpanded());
+    EXPECT_TRUE(root->children[3].IsExpanded());
+    EXPECT_EQ(NodeArena::PendingCount() - pendingBefore, 1);
+
+    // Next time, prefer subtrees that haven't been visited since, even with more visits.
+    root->children[1].visitCount += 50;
+    EXPECT_EQ(selfPlayWorker.EvictTree(root, arrayBytes), arrayBytes);
+    EXPECT_TRUE(root->children[1].IsExpanded());
+    EXPECT_FALSE(root->children[2].IsExpanded());
+    EXPECT_EQ(root->children[2].visitCount, 300);
+
+    // Never collapse the principal variation, even when asking for everything.
+    EXPECT_EQ(selfPlayWorker.EvictTree(root, std::numeric_limits<int64_t>::max()), arrayBytes);
+    EXPECT_FALSE(root->children[1].IsExpanded());
+    EXPECT_TRUE(root->children[3].IsExpanded());
+    EXPECT_TRUE(root->IsExpanded());
+
+    NodeArena::Release(root);
+}
+
+// Fills children with random priors, visits and values like a mid-search node, including
+// some terminals, tablebase bounds and children being expanded by other threads.
+static void RandomizeChildren(Node* parent, std::mt19937& engine)
+{
+    std::uniform_int_distribution<int> priorDistribution(0, 65535);
+    std::uniform_int_distribution<int> visitDistribution(0, 5000);
+    std::uniform_int_distribution<int> visitingDistribution(0, 3);
+    std::uniform_real_distribution<float> valueDistribution(0.f, 1.f);
+    std::uniform_int_distribution<int> specialDistribution(0, 19);
+
+    int visitCount = 0;
+    for (Node& child : *parent)
+    {
+        child.quantizedPrior = static_cast<uint16_t>(priorDistribution(engine));
+        child.visitCount = visitDistribution(engine);
+        child.visitingCount = static_cast<uint16_t>(visitingDistribution(engine));
+        child.valueAverage = valueDistribution(engine);
+        child.valueWeight = child.visitCount.load();
+        child.terminalValue = TerminalValue();
+        child.tablebaseRankBound = 0;
+        child.expansion = Expansion::Expanded;
+        switch (specialDistribution(engine))
+        {
+        case 0:
+            child.terminalValue = TerminalValue::MateIn(static_cast<int8_t>(1 + (child.visitCount % 3)));
+            break;
+        case 1:
+            child.terminalValue = TerminalValue::OpponentMateIn(2);
+            break;
+        case 2:
+            child.SetTablebaseRankBound(0, BOUND_EXACT);
+            break;
+        case 3:
+            child.expansion = Expansion::Expanding;
+            break;
+        default:
+            break;
+        }
+        visitCount += child.visitCount;
+    }
+    parent->visitCount = (visitCount + 1);
+}
+
+TEST(Mcts, SelectChildSimd)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    SearchState searchState{};
+    std::mt19937 engine(1234);
+    Node* parent = NodeArena::AllocateRoot();
+
+    // Vectorized selection should pick the same child, with the same weight, as the scalar reference,
+    // across child counts that don't fill whole vectors, and both early and late in the search (elimination).
+    for (int childCount = 1; childCount <= 64; childCount++)
+    {
+        parent->children = NodeArena::AllocateChildren(childCount);
+        parent->childCount = static_cast<uint8_t>(childCount);
+        for (int i = 0; i < 50; i++)
+        {
+            RandomizeChildren(parent, engine);
+            searchState.timeControl.eliminationFraction = ((i % 2) ? 0.f : 0.9f);
+            searchState.timeControl.eliminationRootVisitCount = (parent->visitCount * (1 + (i % 5)));
+
+            const PuctContext context(&searchState, parent);
+            const WeightedNode simd = context.SelectChild();
+            const WeightedNode scalar = context.SelectChildScalar();
+            EXPECT_EQ(simd.node, scalar.node);
+            EXPECT_EQ(simd.weight, scalar.weight);
+        }
+        NodeArena::Free(parent->children, childCount);
+    }
+
+    NodeArena::Free(parent, 1);
+}
+
+// Timing only (selection agreement is covered by "SelectChildSimd"), so disabled in the unit suite:
+// run with "meson test --benchmark" (see "MicroBenchmarks").
+TEST(Mcts, DISABLED_SelectChildBenchmark)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    SearchState searchState{};
+    std::mt19937 engine(1234);
+    Node* parent = NodeArena::AllocateRoot();
+
+    // Compare selections per second at realistic child counts.
+    const int selectionCount = 200000;
+    const auto seconds = [](auto start) { return std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count(); };
+    for (int childCount : { 20, 30, 40, 60 })
+    {
+        parent->children = NodeArena::AllocateChildren(childCount);
+        parent->childCount = static_cast<uint8_t>(childCount);
+        RandomizeChildren(parent, engine);
+        searchState.timeControl.eliminationRootVisitCount = (parent->visitCount * 4);
+        const PuctContext context(&searchState, parent);
+
+        // Accumulate selected indices so that the work can't be optimized away.
+        int64_t scalarChecksum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < selectionCount; i++)
+        {
+            scalarChecksum += (context.SelectChildScalar().node - parent->children);
+        }
+        const float scalarSeconds = seconds(start);
+
+        int64_t simdChecksum = 0;
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < selectionCount; i++)
+        {
+            simdChecksum += (context.SelectChild().node - parent->children);
+        }
+        const float simdSeconds = seconds(start);
+
+        std::cout << "children=" << childCount
+            << " scalar: selections/sec=" << static_cast<int64_t>(selectionCount / scalarSeconds)
+            << " simd: selections/sec=" << static_cast<int64_t>(selectionCount / simdSeconds)
+            << " speedup=" << (scalarSeconds / simdSeconds) << std::endl;
+        EXPECT_EQ(simdChecksum, scalarChecksum);
+
+        NodeArena::Free(parent->children, childCount);
+    }
+
+    NodeArena::Free(parent, 1);
+}
+
+// Timing only, so disabled in the unit suite: run with "meson test --benchmark" (see "MicroBenchmarks").
+TEST(Mcts, DISABLED_ScratchGameBenchmark)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    // Compare simulations per second when copying the real game into the scratch game for every simulation
+    // versus undoing back to the shared path, using uniform predictions so that search is CPU-bound.
+    const int simulationCount = 50000;
+    const auto seconds = [](auto start) { return std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count(); };
+    float simulationsPerSecond[2] = {};
+    for (const bool reuse : { false, true })
+    {
+        SearchState searchState{};
+        SelfPlayWorker selfPlayWorker(nullptr /* storage */, &searchState, 1 /* gameCount */);
+        selfPlayWorker.Initialize();
+        selfPlayWorker.DebugReuseScratchGames(reuse);
+
+        SelfPlayGame* game;
+        SelfPlayState* state;
+        float* values;
+        INetwork::OutputPlanes* policies;
+        selfPlayWorker.DebugGame(0, &game, &state, &values, &policies);
+        selfPlayWorker.SetUpGame(0, std::chrono::high_resolution_clock::now());
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        int gamesPlayed = 1;
+        while (searchState.nodeCount < simulationCount)
+        {
+            // Restart from the same starting position if the game finishes early so that
+            // both modes always search the full node budget.
+            if (*state == SelfPlayState::Finished)
+            {
+                game->PruneAll();
+                selfPlayWorker.SetUpGame(0, std::chrono::high_resolution_clock::now());
+                gamesPlayed++;
+            }
+
+            selfPlayWorker.Play(0);
+            *values = CHESSCOACH_VALUE_DRAW;
+            INetwork::PlanesPointerFlat policiesPtr = reinterpret_cast<INetwork::PlanesPointerFlat>(policies);
+            std::fill(policiesPtr, policiesPtr + INetwork::OutputPlanesFloatCount, 0.f);
+        }
+        EXPECT_GE(searchState.nodeCount, simulationCount);
+        simulationsPerSecond[reuse] = (searchState.nodeCount / seconds(start));
+        std::cout << (reuse ? "reuse" : "copy") << ": simulations/sec=" << static_cast<int64_t>(simulationsPerSecond[reuse])
+            << " games=" << gamesPlayed << " ply=" << game->Ply() << std::endl;
+
+        game->PruneAll();
+        selfPlayWorker.DebugResetGame(0);
+    }
+    std::cout << "speedup=" << (simulationsPerSecond[true] / simulationsPerSecond[false]) << std::endl;
+}
+
+// Expands the game's current root with uniform priors, the same as receiving a uniform prediction.
+float ExpandUniform(SelfPlayGame& game, SearchState& searchState, bool isSearchRoot, float* values, INetwork::OutputPlanes* policies)
+{
+    *values = CHESSCOACH_VALUE_DRAW;
+    INetwork::PlanesPointerFlat policiesPtr = reinterpret_cast<INetwork::PlanesPointerFlat>(policies);
+    std::fill(policiesPtr, policiesPtr + INetwork::OutputPlanesFloatCount, 0.f);
+
+    SelfPlayState state = SelfPlayState::Working;
+    PredictionCacheChunk cacheStore;
+    return game.ExpandAndEvaluate(state, cacheStore, &searchState, isSearchRoot, true /* generateUniformPredictions */);
+}
+
+TEST(Mcts, Transpositions)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    SearchState searchState{};
+    SelfPlayWorker selfPlayWorker(nullptr /* storage */, &searchState, 1 /* gameCount */);
+    selfPlayWorker.Initialize();
+    SelfPlayGame* game;
+    float* values;
+    INetwork::OutputPlanes* policies;
+    selfPlayWorker.SetUpGame(0, std::chrono::high_resolution_clock::now(), Game::StartingPosition, {}, true /* tryHard */);
+    selfPlayWorker.DebugGame(0, &game, nullptr, &values, &policies);
+    game->SetTranspositions(true);
+    ExpandUniform(*game, searchState, true /* isSearchRoot */, values, policies);
+
+    // Reach the same position via 1. Nf3 Nf6 2. Nc3 and 1. Nc3 Nf6 2. Nf3, expanding along the way.
+    const auto play = [&](const std::vector<Move>& moves)
+    {
+        SelfPlayGame line = *game;
+        for (const Move move : moves)
+        {
+            Node* child = line.Root()->Child(move);
+            EXPECT_NE(child, nullptr);
+            line.ApplyMoveWithRoot(move, child);
+            if (!child->IsExpanded())
+            {
+                ExpandUniform(line, searchState, false /* isSearchRoot */, values, policies);
+                child->expansion.store(Expansion::Expanded, std::memory_order_relaxed);
+            }
+        }
+        return line.Root();
+    };
+    const TranspositionGraphStatistics before = TranspositionGraph::Instance.Statistics();
+    Node* first = play({ make_move(SQ_G1, SQ_F3), make_move(SQ_G8, SQ_F6), make_move(SQ_B1, SQ_C3) });
+    Node* second = play({ make_move(SQ_B1, SQ_C3), make_move(SQ_G8, SQ_F6), make_move(SQ_G1, SQ_F3) });
+
+    // The second arrival links to the first arrival's children rather than expanding again.
+    EXPECT_NE(first, second);
+    EXPECT_TRUE(first->IsExpanded());
+    EXPECT_EQ(second->children, first->children);
+    EXPECT_EQ(second->childCount, first->childCount);
+    const TranspositionGraphStatistics after = TranspositionGraph::Instance.Statistics();
+    EXPECT_EQ(after.entryCount - before.entryCount, 5);
+    EXPECT_EQ(after.linkCount - before.linkCount, 1);
+    EXPECT_GT(after.tableBytes, 0);
+
+    // Playing 1. Nc3 keeps the shared children, reachable through the second line, and forgets the first line.
+    // The new root's own children, 1. Nc3 Nf6's, and the shared children all stay registered.
+    Node* oldRoot = game->Root();
+    Node* newRoot = oldRoot->Child(make_move(SQ_B1, SQ_C3));
+    game->ApplyMoveWithRoot(make_move(SQ_B1, SQ_C3), newRoot);
+    game->PruneExcept(oldRoot, newRoot);
+    EXPECT_EQ(TranspositionGraph::Instance.Statistics().entryCount, 3);
+    Node* reached = newRoot->Child(make_move(SQ_G8, SQ_F6))->Child(make_move(SQ_G1, SQ_F3));
+    EXPECT_EQ(reached, second);
+    for (const Node& child : *reached)
+    {
+        EXPECT_NE(reached->Child(Move(child.move)), nullptr);
+    }
+
+    // A new position releases the whole graph.
+    game->PruneAll();
+    EXPECT_EQ(TranspositionGraph::Instance.Statistics().entryCount, 0);
+}
+
+TEST(Mcts, TranspositionsSelfPlay)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    SearchState searchState{};
+    SelfPlayWorker selfPlayWorker(nullptr /* storage */, &searchState, 1 /* gameCount */);
+    selfPlayWorker.Initialize();
+
+    // Exercise graph-mode selection, linking and releasing over a whole game. Self-play keys include history,
+    // so links are rare, but repetitions and releases happen throughout.
+    SelfPlayGame* game;
+    SelfPlayState* state;
+    float* values;
+    INetwork::OutputPlanes* policies;
+    selfPlayWorker.DebugGame(0, &game, &state, &values, &policies);
+    selfPlayWorker.SetUpGame(0, std::chrono::high_resolution_clock::now());
+    game->SetTranspositions(true);
+    while (true)
+    {
+        selfPlayWorker.Play(0);
+        if (*state == SelfPlayState::Finished)
+        {
+            break;
+        }
+
+        *values = CHESSCOACH_VALUE_DRAW;
+        INetwork::PlanesPointerFlat policiesPtr = reinterpret_cast<INetwork::PlanesPointerFlat>(policies);
+        std::fill(policiesPtr, policiesPtr + INetwork::OutputPlanesFloatCount, 0.f);
+    }
+    EXPECT_TRUE(game->Transpositions());
+    EXPECT_GT(game->Ply(), 0);
+    game->PruneAll();
+    EXPECT_EQ(TranspositionGraph::Instance.Statistics().entryCount, 0);
+}
+
+TEST(Mcts, SearchRequests)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    // Search several positions at once on a small worker group with a cheap bias-only network.
+    NativeNetwork network(nullptr /* fallback */, NetworkType_Teacher, BiasOnlyWeights(1 /* residualCount */, 4 /* filterCount */, 2 /* denseCount */, 0.5f /* valueBias */));
+    WorkerGroup workerGroup;
+    workerGroup.Initialize(&network, nullptr /* storage */, NetworkType_Teacher, 2 /* workerCount */, 32 /* workerParallelism */, &SelfPlayWorker::LoopSearch);
+
+    const std::vector<std::string> fens =
+    {
+        Game::StartingPosition,
+        "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+        "rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3", // Checkmated
+        "8/8/4k3/8/8/4K3/4P3/8 w - - 0 1",
+        "r3k2r/ppp2ppp/8/8/8/8/PPP2PPP/R3K2R b KQkq - 0 1",
+    };
+    std::vector<int> callbackCounts(fens.size());
+    std::vector<SearchResult> results(fens.size());
+    std::vector<SearchRequest> requests;
+    for (int i = 0; i < fens.size(); i++)
+    {
+        SearchRequest& request = requests.emplace_back();
+        request.fen = fens[i];
+        request.timeControl.nodes = (100 + 100 * i);
+        request.callback = [&, i](const SearchResult& result)
+        {
+            callbackCounts[i]++;
+            results[i] = result;
+        };
+    }
+    workerGroup.controllerWorker->SearchRequests(workerGroup.workCoordinator.get(), requests);
+
+    // Each request is called back exactly once with its own results.
+    for (int i = 0; i < fens.size(); i++)
+    {
+        EXPECT_EQ(callbackCounts[i], 1);
+        if (i == 2)
+        {
+            EXPECT_EQ(results[i].bestMove, MOVE_NONE);
+            EXPECT_TRUE(results[i].lines.empty());
+            continue;
+        }
+
+        const Game game(fens[i], {});
+        EXPECT_GE(results[i].nodeCount, requests[i].timeControl.nodes);
+        EXPECT_TRUE(game.GetPosition().pseudo_legal(results[i].bestMove) && game.GetPosition().legal(results[i].bestMove));
+        ASSERT_FALSE(results[i].lines.empty());
+        EXPECT_EQ(results[i].lines[0].moves[0], results[i].bestMove);
+    }
+
+    // More requests than slots still all finish, with slots moving on to unstarted requests as theirs finish.
+    // Time-limited requests finish even if they never got a slot.
+    const int slotCount = (2 * 32);
+    std::vector<int> manyCallbackCounts(3 * slotCount);
+    std::vector<SearchRequest> many(manyCallbackCounts.size());
+    for (int i = 0; i < many.size(); i++)
+    {
+        many[i].fen = fens[i % 2];
+        if (i % 3)
+        {
+            many[i].timeControl.nodes = 50;
+        }
+        else
+        {
+            many[i].timeControl.moveTimeMs = 10;
+        }
+        many[i].callback = [&, i](const SearchResult& result)
+        {
+            manyCallbackCounts[i]++;
+            const Game game(many[i].fen, {});
+            EXPECT_TRUE(game.GetPosition().pseudo_legal(result.bestMove) && game.GetPosition().legal(result.bestMove));
+        };
+    }
+    workerGroup.controllerWorker->SearchRequests(workerGroup.workCoordinator.get(), many);
+    EXPECT_EQ(manyCallbackCounts, std::vector<int>(many.size(), 1));
+
+    // Requests without a limit are rejected.
+    std::vector<SearchRequest> unlimited(1);
+    unlimited[0].fen = Game::StartingPosition;
+    EXPECT_THROW(workerGroup.controllerWorker->SearchRequests(workerGroup.workCoordinator.get(), unlimited), ChessCoachException);
+
+    workerGroup.ShutDown();
+}
+
+TEST(Mcts, StrengthTestConcurrency)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    NativeNetwork network(nullptr /* fallback */, NetworkType_Teacher, BiasOnlyWeights(1 /* residualCount */, 4 /* filterCount */, 2 /* denseCount */, 0.5f /* valueBias */));
+    WorkerGroup workerGroup;
+    workerGroup.Initialize(&network, nullptr /* storage */, NetworkType_Teacher, 2 /* workerCount */, 32 /* workerParallelism */, &SelfPlayWorker::LoopStrengthTest);
+
+    // Mix points, best-move and avoid-move positions, with a mate-in-one that any search should find.
+    const std::filesystem::path epdPath = (std::filesystem::temp_directory_path() / "ChessCoachTest" / "StrengthTestConcurrency.epd");
+    std::filesystem::create_directories(epdPath.parent_path());
+    {
+        std::ofstream epd(epdPath, std::ios::out | std::ios::trunc);
+        epd << "1kr5/3n4/q3p2p/p2n2p1/PppB1P2/5BP1/1P2Q2P/3R2K1 w - - bm f5; id \"STS(v1.0) Undermine.001\"; c0 \"f5=10, Be5+=2, Bf2=3, Bg4=2\"; c7 \"f5 Be5+ Bf2 Bg4\"; c8 \"10 2 3 2\"; c9 \"f4f5 d4e5 d4f2 f3g4\";\n";
+        epd << "6k1/5ppp/8/8/8/8/8/R5K1 w - - bm Ra8#; id \"Mate\";\n";
+        epd << "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - am Ng5; id \"Avoid\";\n";
+        epd << "1n5k/3q3p/pp1p2pB/5r2/1PP1Qp2/P6P/6P1/2R3K1 w - - bm c5; id \"STS(v1.0) Undermine.002\"; c0 \"c5=10, Qd4+=4, b5=4, g4=3\"; c7 \"c5 Qd4+ b5 g4\"; c8 \"10 4 4 3\"; c9 \"c4c5 e4d4 b4b5 g2g4\";\n";
+    }
+
+    // Concurrent groups (including a partial last group) report every position in order, scored the same way as one at a time.
+    // Groups larger than the worker group's game slots wait for slots to free up (here 4 positions on 2 slots).
+    WorkerGroup smallWorkerGroup;
+    smallWorkerGroup.Initialize(&network, nullptr /* storage */, NetworkType_Teacher, 1 /* workerCount */, 2 /* workerParallelism */, &SelfPlayWorker::LoopStrengthTest);
+    const int failureNodes = 100000;
+    for (const auto& [group, concurrency] : { std::pair(&workerGroup, 1), std::pair(&workerGroup, 3), std::pair(&smallWorkerGroup, 4) })
+    {
+        std::vector<std::string> fens;
+        std::vector<int> nodesRequired;
+        const auto [score, total, positions, totalNodesRequired] = group->controllerWorker->StrengthTestEpd(group->workCoordinator.get(),
+            epdPath, 0 /* moveTimeMs */, 300 /* nodes */, failureNodes, 0 /* positionLimit */, concurrency,
+            [&](const std::string& fen, const std::string&, const std::string&, int, int, int nodes)
+            {
+                fens.push_back(fen);
+                nodesRequired.push_back(nodes);
+            });
+
+        EXPECT_EQ(positions, 4);
+        EXPECT_EQ(total, 10 + 1 + 1 + 10);
+        EXPECT_GE(score, 1);
+        ASSERT_EQ(fens.size(), 4);
+        EXPECT_EQ(fens[1], "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+        EXPECT_GT(nodesRequired[1], 0);
+        EXPECT_LT(nodesRequired[1], failureNodes);
+        EXPECT_GE(totalNodesRequired, nodesRequired[1]);
+    }
+
+    smallWorkerGroup.ShutDown();
+    workerGroup.ShutDown();
+    std::filesystem::remove(epdPath);
+}
@@ -0,0 +1,251 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <filesystem>
+#include <iostream>
+#include <cstring>
+
+#include <ChessCoach/NativeNetwork.h>
+#include <ChessCoach/PythonNetwork.h>
+#include <ChessCoach/Platform.h>
+#include <ChessCoach/ChessCoach.h>
+#include <ChessCoach/Game.h>
+
+std::unique_ptr<NativeWeights> BiasOnlyWeights(int residualCount, int filterCount, int denseCount, float valueBias)
+{
+    // Zero all multiplicative weights so that outputs reduce to biases.
+    const size_t towerConvCount = (static_cast<size_t>(filterCount) * filterCount * 9);
+    const NativeWeights::BatchNorm identity{ std::vector<float>(filterCount, 1.f), std::vector<float>(filterCount, 0.f) };
+
+    std::unique_ptr<NativeWeights> weights(new NativeWeights());
+    weights->residualCount = residualCount;
+    weights->filterCount = filterCount;
+    weights->denseCount = denseCount;
+
+    weights->stemConv.resize(static_cast<size_t>(filterCount) * INetwork::InputPlaneCount * 9);
+    weights->stemBatchNorm = identity;
+    for (int i = 0; i < residualCount; i++)
+    {
+        weights->residualBlocks.push_back({ (i != 0), ((i != 0) ? identity : NativeWeights::BatchNorm{}),
+            std::vector<float>(towerConvCount), identity, std::vector<float>(towerConvCount) });
+    }
+    weights->towerBatchNorm = identity;
+
+    weights->valueConv.resize(filterCount);
+    weights->valueBatchNorm = { { 1.f }, { 0.f } };
+    weights->valueDense.resize(static_cast<size_t>(denseCount) * INetwork::PlaneFloatCount);
+    weights->valueDenseBias.resize(denseCount);
+    weights->valueOutput.resize(denseCount);
+    weights->valueOutputBias = valueBias;
+
+    weights->policyConv.resize(towerConvCount);
+    weights->policyBatchNorm = identity;
+    weights->policyOutput.resize(static_cast<size_t>(INetwork::OutputPlaneCount) * filterCount);
+    weights->policyOutputBias.resize(INetwork::OutputPlaneCount);
+    for (int i = 0; i < INetwork::OutputPlaneCount; i++)
+    {
+        weights->policyOutputBias[i] = (i / 10.f);
+    }
+
+    return weights;
+}
+
+TEST(NativeNetwork, ConvolutionMatchesScalar)
+{
+    const int inputChannels = 13;
+    const int outputChannels = 7;
+
+    std::mt19937 engine(12345);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+
+    std::vector<float> weights(static_cast<size_t>(outputChannels) * inputChannels * 9);
+    std::vector<float> input(static_cast<size_t>(inputChannels) * INetwork::PlaneFloatCount);
+    for (float& weight : weights)
+    {
+        weight = distribution(engine);
+    }
+    for (float& activation : input)
+    {
+        activation = distribution(engine);
+    }
+
+    std::vector<float> output(static_cast<size_t>(outputChannels) * INetwork::PlaneFloatCount);
+    std::vector<float> expected(output.size());
+    std::vector<float> scratch(static_cast<size_t>(inputChannels) * 3 * 10 * 8);
+    NativeNetwork::Convolve3x3(inputChannels, outputChannels, weights.data(), input.data(), output.data(), scratch.data());
+    NativeNetwork::Convolve3x3Scalar(inputChannels, outputChannels, weights.data(), input.data(), expected.data());
+
+    for (int i = 0; i < output.size(); i++)
+    {
+        EXPECT_NEAR(output[i], expected[i], 1e-4f);
+    }
+}
+
+TEST(NativeNetwork, SaveLoadPredict)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    const float valueBias = 0.5f;
+    const std::filesystem::path path = (std::filesystem::temp_directory_path() / "ChessCoachTest_NativeWeights.bin");
+    BiasOnlyWeights(2 /* residualCount */, 8 /* filterCount */, 4 /* denseCount */, valueBias)->Save(path);
+
+    NativeNetwork network(nullptr /* fallback */, NetworkType_Teacher, NativeWeights::Load(path));
+    std::filesystem::remove(path);
+
+    const int batchSize = 2;
+    Game game;
+    std::vector<INetwork::InputPlanes> images(batchSize);
+    std::vector<float> values(batchSize);
+    std::vector<INetwork::OutputPlanes> policies(batchSize);
+    game.GenerateImage(images[0]);
+    game.ApplyMove(make_move(SQ_E2, SQ_E4));
+    game.GenerateImage(images[1]);
+
+    // Expect an initial "updated" status so that any stale cache contents are cleared, like PythonNetwork.
+    EXPECT_EQ(network.PredictBatch(NetworkType_Teacher, batchSize, images.data(), values.data(), policies.data()), PredictionStatus_UpdatedNetwork);
+    EXPECT_EQ(network.PredictBatch(NetworkType_Teacher, batchSize, images.data(), values.data(), policies.data()), PredictionStatus_None);
+
+    for (int i = 0; i < batchSize; i++)
+    {
+        EXPECT_NEAR(values[i], INetwork::MapProbability11To01(std::tanh(valueBias)), 1e-6f);
+        for (int plane = 0; plane < INetwork::OutputPlaneCount; plane++)
+        {
+            EXPECT_FLOAT_EQ(policies[i][plane][3][5], (plane / 10.f));
+        }
+    }
+
+    // Everything other than prediction needs a fallback network.
+    EXPECT_THROW(network.FileExists("anything"), ChessCoachException);
+
+    // Switching weights can't reach the native forward pass, so it's rejected rather than ignored,
+    // and so is predicting for a network type that the weights weren't exported for.
+    EXPECT_THROW(network.UpdateNetworkWeights("other"), ChessCoachException);
+    EXPECT_THROW(network.PredictBatch(NetworkType_Student, batchSize, images.data(), values.data(), policies.data()), ChessCoachException);
+}
+
+// Builds a small Keras model with "model.py", randomizes its batchnorm statistics so that folding is exercised,
+// exports it with "ModelBuilder.export_native", then checks that "NativeWeights::Load" and "NativeNetwork"
+// reproduce the model's own predictions. Needs TensorFlow, so only runs where it's installed.
+TEST(NativeNetwork, ExportFromModel)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    const int batchSize = 2;
+    Game game;
+    std::vector<INetwork::InputPlanes> images(batchSize);
+    game.ApplyMove(make_move(SQ_E2, SQ_E4));
+    game.GenerateImage(images[0]);
+    game.ApplyMove(make_move(SQ_E7, SQ_E5));
+    game.ApplyMove(make_move(SQ_G1, SQ_F3));
+    game.GenerateImage(images[1]);
+
+    const std::filesystem::path path = (std::filesystem::temp_directory_path() / "ChessCoachTest_ExportedWeights.ccnw");
+    std::vector<float> expectedValues(batchSize);
+    std::vector<INetwork::OutputPlanes> expectedPolicies(batchSize);
+    {
+        PythonContext context;
+
+        // Skip without numpy and TensorFlow (e.g. in a build-only environment). The Windows googletest
+        // package predates GTEST_SKIP, so just return there.
+        for (const char* requiredModule : { "numpy", "tensorflow" })
+        {
+            PyObject* imported = PyImport_ImportModule(requiredModule);
+            if (!imported)
+            {
+                PyErr_Clear();
+#ifdef GTEST_SKIP
+                GTEST_SKIP() << requiredModule << " is unavailable";
+#else
+                std::cout << "Skipping native weights export: " << requiredModule << " is unavailable" << std::endl;
+                return;
+#endif
+            }
+            Py_DECREF(imported);
+        }
+
+        PyObject* module = PyImport_AddModule("__main__");
+        PythonNetwork::PyAssert(module);
+        PyObject* globals = PyModule_GetDict(module);
+        PyObject* locals = PyDict_New();
+        PythonNetwork::PyAssert(locals);
+
+        PyObject* scriptPath = PyUnicode_FromString(Platform::InstallationScriptPath().string().c_str());
+        PyObject* exportPath = PyUnicode_FromString(path.string().c_str());
+        PyObject* imageBytes = PyBytes_FromStringAndSize(reinterpret_cast<const char*>(images.data()), (batchSize * sizeof(INetwork::InputPlanes)));
+        PythonNetwork::PyAssert(scriptPath && exportPath && imageBytes);
+        PyDict_SetItemString(locals, "script_path", scriptPath);
+        PyDict_SetItemString(locals, "export_path", exportPath);
+        PyDict_SetItemString(locals, "image_bytes", imageBytes);
+        Py_DECREF(scriptPath);
+        Py_DECREF(exportPath);
+        Py_DECREF(imageBytes);
+
+        const char* script =
+            "import sys\n"
+            "import numpy as np\n"
+            "import tensorflow as tf\n"
+            "sys.path.insert(0, script_path)\n"
+            "from model import ModelBuilder\n"
+            "builder = ModelBuilder()\n"
+            "model = builder.build(None, residual_count=2, filter_count=8, dense_count=4)\n"
+            "rng = np.random.default_rng(12345)\n"
+            "for layer in model.layers:\n"
+            "  if isinstance(layer, tf.keras.layers.BatchNormalization):\n"
+            "    shape = layer.weights[0].shape\n"
+            "    layer.set_weights([rng.uniform(0.5, 1.5, shape), rng.uniform(-0.5, 0.5, shape),\n"
+            "      rng.uniform(-0.5, 0.5, shape), rng.uniform(0.5, 1.5, shape)])\n"
+            "builder.export_native(model, export_path)\n"
+            "images = np.frombuffer(image_bytes, dtype=np.int64).reshape(-1, builder.input_planes_count)\n"
+            "value, _, policy, _ = model(images, training=False)\n"
+            "value_bytes = np.ascontiguousarray(value.numpy(), dtype='<f4').tobytes()\n"
+            "policy_bytes = np.ascontiguousarray(policy.numpy(), dtype='<f4').tobytes()\n";
+        PyObject* result = PyRun_String(script, Py_file_input, globals, locals);
+        PythonNetwork::PyAssert(result);
+        Py_DECREF(result);
+
+        PyObject* valueBytes = PyDict_GetItemString(locals, "value_bytes");
+        PyObject* policyBytes = PyDict_GetItemString(locals, "policy_bytes");
+        PythonNetwork::PyAssert(valueBytes && policyBytes);
+        ASSERT_EQ(PyBytes_Size(valueBytes), batchSize * sizeof(float));
+        ASSERT_EQ(PyBytes_Size(policyBytes), batchSize * sizeof(INetwork::OutputPlanes));
+        std::memcpy(expectedValues.data(), PyBytes_AsString(valueBytes), batchSize * sizeof(float));
+        std::memcpy(expectedPolicies.data(), PyBytes_AsString(policyBytes), batchSize * sizeof(INetwork::OutputPlanes));
+        Py_DECREF(locals);
+    }
+
+    NativeNetwork network(nullptr /* fallback */, NetworkType_Teacher, NativeWeights::Load(path));
+    std::filesystem::remove(path);
+
+    std::vector<float> values(batchSize);
+    std::vector<INetwork::OutputPlanes> policies(batchSize);
+    network.PredictBatch(NetworkType_Teacher, batchSize, images.data(), values.data(), policies.data());
+
+    for (int i = 0; i < batchSize; i++)
+    {
+        EXPECT_NEAR(values[i], INetwork::MapProbability11To01(expectedValues[i]), 1e-4f);
+        const float* logits = reinterpret_cast<const float*>(policies[i].data());
+        const float* expectedLogits = reinterpret_cast<const float*>(expectedPolicies[i].data());
+        for (int j = 0; j < INetwork::OutputPlanesFloatCount; j++)
+        {
+            EXPECT_NEAR(logits[j], expectedLogits[j], 1e-3f);
+        }
+    }
+}
@@ -25,6 +25,7 @@
 #pragma warning(default:4100) // Ignore unused args in generated code
 
 #include <ChessCoach/SelfPlay.h>
+#include <ChessCoach/NodeArena.h>
 #include <ChessCoach/ChessCoach.h>
 
 void ApplyMoveExpandWithPattern(SelfPlayWorker& selfPlayWorker, SelfPlayGame& game, Move move, int patternIndex)
@@ -35,7 +36,7 @@ void ApplyMoveExpandWithPattern(SelfPlayWorker& selfPlayWorker, SelfPlayGame& ga
     int moveIndex = 0;
     Node* moveNode = nullptr;
     game.Root()->childCount = static_cast<uint8_t>(legalMoveCount);
-    game.Root()->children = new Node[game.Root()->childCount]{};
+    game.Root()->children = NodeArena::AllocateChildren(game.Root()->childCount);
     for (Move legalMove : legalMoves)
     {
         Node* child = &game.Root()->children[moveIndex];
@@ -83,7 +84,7 @@ TEST(Network, Policy)
 
     // Give 5 visits evenly across legal moves, then the rest to the first move.
     game.Root()->childCount = static_cast<uint8_t>(legalMoves.size());
-    game.Root()->children = new Node[game.Root()->childCount]{};
+    game.Root()->children = NodeArena::AllocateChildren(game.Root()->childCount);
     const int evenCount = 5;
     int moveIndex = 0;
     for (Move move : legalMoves)
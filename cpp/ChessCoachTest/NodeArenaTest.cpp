@@ -0,0 +1,278 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <iostream>
+
+#include <ChessCoach/SelfPlay.h>
+#include <ChessCoach/NodeArena.h>
+#include <ChessCoach/ChessCoach.h>
+
+// Expands breadth-first with 20-40 children per node until reaching "nodeCount" nodes,
+// roughly the shape of a search tree, using the given allocator.
+void BuildTree(Node* root, int nodeCount, std::function<Node*(int)> allocateChildren)
+{
+    std::mt19937 engine(1234);
+    std::uniform_int_distribution<int> childCountDistribution(20, 40);
+    std::vector<Node*> frontier = { root };
+    int built = 1;
+    for (size_t i = 0; (i < frontier.size()) && (built < nodeCount); i++)
+    {
+        Node* node = frontier[i];
+        const int childCount = childCountDistribution(engine);
+        node->children = allocateChildren(childCount);
+        node->childCount = static_cast<uint8_t>(childCount);
+        for (Node& child : *node)
+        {
+            frontier.push_back(&child);
+        }
+        built += childCount;
+    }
+}
+
+void DeleteTree(Node* node)
+{
+    for (Node& child : *node)
+    {
+        DeleteTree(&child);
+    }
+    delete[] node->children;
+    node->children = nullptr;
+    node->childCount = 0;
+}
+
+// Allocate until all released trees are reclaimed, then free the extra allocations again.
+void ReclaimAll()
+{
+    std::vector<Node*> allocated;
+    while (NodeArena::Statistics().pendingReclaimCount > 0)
+    {
+        allocated.push_back(NodeArena::AllocateChildren(1));
+    }
+    for (Node* nodes : allocated)
+    {
+        NodeArena::Free(nodes, 1);
+    }
+}
+
+TEST(NodeArena, Reuse)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+    NodeArena::StopReclaimer();
+
+    // Freed arrays are reused for any count in the same size class.
+    const NodeArenaStatistics before = NodeArena::Statistics();
+    Node* first = NodeArena::AllocateChildren(30);
+    first[29].visitCount = 5;
+    NodeArena::Free(first, 30);
+    Node* second = NodeArena::AllocateChildren(29);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(second[28].visitCount, 0);
+    EXPECT_EQ(second[0].children, nullptr);
+
+    // A different size class doesn't reuse.
+    Node* third = NodeArena::AllocateChildren(40);
+    EXPECT_NE(third, second);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(third) % alignof(Node), 0);
+
+    NodeArena::Free(second, 29);
+    NodeArena::Free(third, 40);
+    const NodeArenaStatistics after = NodeArena::Statistics();
+    EXPECT_EQ(after.allocationCount - before.allocationCount, 3);
+    EXPECT_EQ(after.freeCount - before.freeCount, 3);
+}
+
+TEST(NodeArena, ReleaseAndReclaim)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+    NodeArena::StopReclaimer();
+    ReclaimAll();
+
+    // Releasing a whole tree is a single queue entry, reclaimed gradually by later allocations.
+    const NodeArenaStatistics before = NodeArena::Statistics();
+    Node* root = NodeArena::AllocateRoot();
+    BuildTree(root, 10000, NodeArena::AllocateChildren);
+    const NodeArenaStatistics built = NodeArena::Statistics();
+    const int64_t arrayCount = (built.allocationCount - before.allocationCount);
+    EXPECT_GT(arrayCount, 250);
+
+    NodeArena::Release(root);
+    const NodeArenaStatistics released = NodeArena::Statistics();
+    EXPECT_EQ(released.releaseCount - before.releaseCount, 1);
+    EXPECT_EQ(released.pendingReclaimCount, 1);
+    EXPECT_EQ(released.freeCount, built.freeCount);
+
+    // Rebuilding the same tree reuses the reclaimed memory instead of growing.
+    ReclaimAll();
+    const NodeArenaStatistics reclaimed = NodeArena::Statistics();
+    EXPECT_EQ(reclaimed.reclaimCount - before.reclaimCount, arrayCount);
+    EXPECT_EQ((reclaimed.allocationCount - reclaimed.freeCount), (before.allocationCount - before.freeCount));
+
+    root = NodeArena::AllocateRoot();
+    BuildTree(root, 10000, NodeArena::AllocateChildren);
+    EXPECT_EQ(NodeArena::Statistics().blockCount, reclaimed.blockCount);
+    NodeArena::Release(root);
+    ReclaimAll();
+}
+
+TEST(NodeArena, BackgroundReclaim)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+    NodeArena::StopReclaimer();
+    ReclaimAll();
+
+    // Release a tree with the reclaimer running and make sure that it's all reclaimed without this thread's help.
+    const NodeArenaStatistics before = NodeArena::Statistics();
+    NodeArena::StartReclaimer(256);
+    Node* root = NodeArena::AllocateRoot();
+    BuildTree(root, 100000, NodeArena::AllocateChildren);
+    const int64_t arrayCount = (NodeArena::Statistics().allocationCount - before.allocationCount);
+    NodeArena::Release(root);
+
+    const auto deadline = (std::chrono::steady_clock::now() + std::chrono::seconds(10));
+    while ((NodeArena::Statistics().reclaimCount - before.reclaimCount) < arrayCount)
+    {
+        ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(NodeArena::Statistics().pendingReclaimCount, 0);
+
+    // Reclaimed memory comes back to this thread (as the owner), so rebuilding doesn't grow.
+    const int64_t blockCount = NodeArena::Statistics().blockCount;
+    root = NodeArena::AllocateRoot();
+    BuildTree(root, 100000, NodeArena::AllocateChildren);
+    EXPECT_EQ(NodeArena::Statistics().blockCount, blockCount);
+
+    NodeArena::StopReclaimer();
+    NodeArena::Release(root);
+    ReclaimAll();
+}
+
+TEST(NodeArena, CrossThreadFree)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+    NodeArena::StopReclaimer();
+
+    // Allocate on a worker thread, free here, and make sure that the worker gets the memory back.
+    std::vector<Node*> allocated;
+    Node* reused = nullptr;
+    const int64_t blocksBefore = NodeArena::Statistics().blockCount;
+    const int64_t arenasBefore = NodeArena::Statistics().arenaCount;
+    std::thread allocator([&]()
+        {
+            for (int i = 0; i < 100; i++)
+            {
+                allocated.push_back(NodeArena::AllocateChildren(8));
+            }
+        });
+    allocator.join();
+
+    const NodeArenaStatistics before = NodeArena::Statistics();
+    for (Node* nodes : allocated)
+    {
+        NodeArena::Free(nodes, 8);
+    }
+
+    // The thread has exited with live nodes, so its arena is orphaned but stays alive to take the frees,
+    // which count straight away, before the owner drains them.
+    EXPECT_EQ(NodeArena::Statistics().freeCount - before.freeCount, 100);
+    EXPECT_EQ(NodeArena::Statistics().liveBytes - before.liveBytes, -100 * static_cast<int64_t>(NodeArena::ArrayBytes(8)));
+
+    // The last free emptied the orphaned arena, so its blocks are gone too, and it's no longer scanned for statistics.
+    EXPECT_GT(before.blockCount, blocksBefore);
+    EXPECT_EQ(NodeArena::Statistics().blockCount, blocksBefore);
+    EXPECT_EQ(before.arenaCount, arenasBefore + 1);
+    EXPECT_EQ(NodeArena::Statistics().arenaCount, arenasBefore);
+
+    // Another thread's frees only land back with the owner, so this thread allocates fresh memory.
+    reused = NodeArena::AllocateChildren(8);
+    EXPECT_EQ(std::find(allocated.begin(), allocated.end(), reused), allocated.end());
+    NodeArena::Free(reused, 8);
+}
+
+// Timing only, so disabled in the unit suite: run with "meson test --benchmark" (see "MicroBenchmarks").
+TEST(NodeArena, DISABLED_Benchmark)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+    NodeArena::StopReclaimer();
+    ReclaimAll();
+
+    // Compare building trees (node arrays allocated per second) and move transitions (time to discard
+    // all but one child's subtree) between "new Node[]"/"delete[]" and the arena.
+    const int nodeCount = 1000000;
+    const int repeatCount = 5;
+    const auto seconds = [](auto start) { return std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count(); };
+
+    float newBuildSeconds = 0.f;
+    float newTransitionSeconds = 0.f;
+    for (int r = 0; r < repeatCount; r++)
+    {
+        Node* root = new Node();
+        auto start = std::chrono::high_resolution_clock::now();
+        BuildTree(root, nodeCount, [](int count) { return new Node[count]{}; });
+        newBuildSeconds += seconds(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        Node* kept = new Node(root->children[0]);
+        root->children[0].children = nullptr;
+        root->children[0].childCount = 0;
+        DeleteTree(root);
+        delete root;
+        newTransitionSeconds += seconds(start);
+
+        DeleteTree(kept);
+        delete kept;
+    }
+
+    float arenaBuildSeconds = 0.f;
+    float arenaTransitionSeconds = 0.f;
+    for (int r = 0; r < repeatCount; r++)
+    {
+        Node* root = NodeArena::AllocateRoot();
+        auto start = std::chrono::high_resolution_clock::now();
+        BuildTree(root, nodeCount, NodeArena::AllocateChildren);
+        arenaBuildSeconds += seconds(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        Node* kept = NodeArena::AllocateRoot(root->children[0]);
+        root->children[0].children = nullptr;
+        root->children[0].childCount = 0;
+        NodeArena::Release(root);
+        arenaTransitionSeconds += seconds(start);
+
+        NodeArena::Release(kept);
+    }
+    ReclaimAll();
+
+    const float nodesBuilt = (static_cast<float>(nodeCount) * repeatCount);
+    std::cout << "new/delete: nodes/sec=" << static_cast<int64_t>(nodesBuilt / newBuildSeconds)
+        << " transition_ms=" << (newTransitionSeconds * 1000.f / repeatCount) << std::endl;
+    std::cout << "arena: nodes/sec=" << static_cast<int64_t>(nodesBuilt / arenaBuildSeconds)
+        << " transition_ms=" << (arenaTransitionSeconds * 1000.f / repeatCount) << std::endl;
+    NodeArena::PrintDebugInfo();
+
+    EXPECT_LT(arenaTransitionSeconds, newTransitionSeconds);
+}
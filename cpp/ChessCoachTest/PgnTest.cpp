@@ -16,6 +16,12 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <random>
+#include <iostream>
+
+#include <Stockfish/movegen.h>
+
 #include <ChessCoach/ChessCoach.h>
 #include <ChessCoach/Game.h>
 #include <ChessCoach/Pgn.h>
@@ -55,6 +61,7 @@ const SanTestCase SanTestCases[] =
     // Tricky disambiguations
     { "rnbqk2r/ppp2ppp/4pn2/3p4/1bPP4/2N1P3/PP3PPP/R1BQKBNR w KQkq - 0 5", make_move(SQ_G1, SQ_E2), "Ne2" },
     { "3Rr2k/6rp/8/8/3Q4/8/8/3K4 b - - 0 1", make_move(SQ_E8, SQ_G8), "Rg8" },
+    { "5r2/3k4/2n2n1p/r5pP/4P1b1/2b5/1B4R1/1K2R2q w - - 27 68", make_move(SQ_G2, SQ_E2), "Re2" },
     { "3k4/1Q3Q2/8/1Q6/8/8/8/3K4 w - - 0 0", make_move(SQ_B7, SQ_D7), "Qb7d7#" },
 
     // Castling check/checkmate
@@ -101,4 +108,134 @@ TEST(Pgn, ParseSan)
     {
         TestParseSan(testCase.fen, testCase.san, testCase.move);
     }
+
+    // Pawns can't move to their own first rank, and there's no square behind it to look for one.
+    const std::string blackToPlay = "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1";
+    TestParseSan(Game::StartingPosition, "e1", MOVE_NONE);
+    TestParseSan(Game::StartingPosition, "exd1", MOVE_NONE);
+    TestParseSan(Game::StartingPosition, "h1+", MOVE_NONE);
+    TestParseSan(blackToPlay, "e8", MOVE_NONE);
+    TestParseSan(blackToPlay, "fxe8", MOVE_NONE);
+}
+
+// Plays random games from a fixed seed, recording each position (copies share their game's states,
+// so "games" needs to stay alive), the move played and its SAN. Random games cover promotions, castling,
+// en passant, checks and disambiguation more densely than real games.
+static void GenerateRandomSans(int gameCount, std::vector<Game>& games, std::vector<Game>& positions,
+    std::vector<Move>& moves, std::vector<std::string>& sans)
+{
+    std::mt19937 engine(1234);
+    games.reserve(gameCount);
+    for (int i = 0; i < gameCount; i++)
+    {
+        Game& game = games.emplace_back();
+        for (int ply = 0; ply < 200; ply++)
+        {
+            const MoveList<LEGAL> legalMoves(game.GetPosition());
+            if (legalMoves.size() == 0)
+            {
+                break;
+            }
+
+            std::uniform_int_distribution<int> moveDistribution(0, static_cast<int>(legalMoves.size()) - 1);
+            const Move move = legalMoves.begin()[moveDistribution(engine)].move;
+            positions.push_back(game);
+            moves.push_back(move);
+            sans.push_back(Pgn::San(game.GetPosition(), move, true /* showCheckmate */));
+            game.ApplyMove(move);
+        }
+    }
+}
+
+TEST(Pgn, ParseSanRoundTrip)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    std::vector<Game> games;
+    std::vector<Game> positions;
+    std::vector<Move> moves;
+    std::vector<std::string> sans;
+    GenerateRandomSans(40, games, positions, moves, sans);
+
+    for (int i = 0; i < positions.size(); i++)
+    {
+        EXPECT_EQ(Pgn::ParseSan(positions[i].GetPosition(), sans[i]), moves[i]) << sans[i];
+    }
+}
+
+// Timing only, so disabled in the unit suite: run with "meson test --benchmark" (see "MicroBenchmarks").
+TEST(Pgn, DISABLED_ParseSanSpeed)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    std::vector<Game> games;
+    std::vector<Game> positions;
+    std::vector<Move> moves;
+    std::vector<std::string> sans;
+    GenerateRandomSans(40, games, positions, moves, sans);
+
+    const int repeatCount = 100;
+    int mismatchCount = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < repeatCount; i++)
+    {
+        for (int j = 0; j < positions.size(); j++)
+        {
+            mismatchCount += (Pgn::ParseSan(positions[j].GetPosition(), sans[j]) != moves[j]);
+        }
+    }
+    const float seconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::cout << "ParseSan: moves/second=" << (repeatCount * positions.size() / seconds) << std::endl;
+    EXPECT_EQ(mismatchCount, 0);
+}
+
+TEST(Pgn, SplitPgn)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    const std::string game =
+        "[Event \"Paris\"]\n"
+        "[Result \"1-0\"]\n"
+        "\n"
+        "1. e4 e5 2. Nf3 d6 3. d4 Bg4 4. dxe5 Bxf3 5. Qxf3 dxe5 6. Bc4 Nf6 7. Qb3 Qe7\n"
+        "8. Nc3 c6 9. Bg5 b5 10. Nxb5 cxb5 11. Bxb5+ Nbd7 12. O-O-O Rd8 13. Rxd7 Rxd7\n"
+        "14. Rd1 Qe6 15. Bxd7+ Nxd7 16. Qb8+ Nxb8 17. Rd8# 1-0\n"
+        "\n";
+    const int gameCount = 10;
+    std::string content;
+    for (int i = 0; i < gameCount; i++)
+    {
+        content += game;
+    }
+
+    // Segments hold whole games and cover all of the content.
+    const std::vector<std::string_view> segments = Pgn::SplitPgn(content, 2 * game.size() + 1);
+    EXPECT_EQ(segments.size(), 4);
+    size_t segmentBytes = 0;
+    for (const std::string_view& segment : segments)
+    {
+        EXPECT_EQ(segment.front(), '[');
+        segmentBytes += segment.size();
+    }
+    EXPECT_EQ(segmentBytes, content.size());
+
+    // Parsing segments in place finds the same games as parsing everything.
+    int segmentGameCount = 0;
+    for (const std::string_view& segment : segments)
+    {
+        Pgn::ParsePgn(segment, false /* allowNoResult */, [&](SavedGame&& savedGame, SavedCommentary&&)
+            {
+                EXPECT_EQ(savedGame.moveCount, 33);
+                EXPECT_EQ(savedGame.result, CHESSCOACH_VALUE_WIN);
+                segmentGameCount++;
+            });
+    }
+    EXPECT_EQ(segmentGameCount, gameCount);
+
+    // Content smaller than the target isn't split.
+    EXPECT_EQ(Pgn::SplitPgn(content, content.size()).size(), 1);
 }
\ No newline at end of file
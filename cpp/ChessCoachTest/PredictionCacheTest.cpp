@@ -17,6 +17,9 @@
 #include <gtest/gtest.h>
 
 #include <array>
+#include <thread>
+#include <random>
+#include <filesystem>
 
 #include <ChessCoach/SelfPlay.h>
 #include <ChessCoach/PredictionCache.h>
@@ -34,7 +37,7 @@ std::vector<uint16_t> Quantize(const std::vector<float>& priors)
 
 bool TryGetPrediction(Key key, bool putOnFailedGet = true, std::vector<float> priors = { 0.1f, 0.2f, 0.3f, 0.4f })
 {
-    PredictionCacheChunk* chunk;
+    PredictionCacheChunk chunk;
     float value;
 
     std::vector<uint16_t> quantizedPriors = Quantize(priors);
@@ -42,7 +45,7 @@ bool TryGetPrediction(Key key, bool putOnFailedGet = true, std::vector<float> pr
     bool hit = PredictionCache::Instance.TryGetPrediction(key, static_cast<int>(trashablePriors.size()), &chunk, &value, trashablePriors.data());
     if (!hit && putOnFailedGet)
     {
-        chunk->Put(key, 0.33f, static_cast<int>(priors.size()), quantizedPriors.data());
+        chunk.Put(key, 0.33f, static_cast<int>(priors.size()), quantizedPriors.data());
     }
     return hit;
 }
@@ -197,13 +200,13 @@ TEST(PredictionCache, Quantization)
     }
 
     // Put into the cache.
-    PredictionCacheChunk* chunk;
+    PredictionCacheChunk chunk;
     float value;
     std::vector<uint16_t> quantizedPriors1 = Quantize(priors1);
     std::vector<uint16_t> trashablePriors1(quantizedPriors1);
     const bool hit1 = PredictionCache::Instance.TryGetPrediction(game1_key, moveCount, &chunk, &value, trashablePriors1.data());
     EXPECT_FALSE(hit1);
-    chunk->Put(game1_key, value, moveCount, quantizedPriors1.data());
+    chunk.Put(game1_key, value, moveCount, quantizedPriors1.data());
 
     // Get from the cache.
     std::vector<uint16_t> quantizedPriors2(moveCount);
@@ -215,4 +218,170 @@ TEST(PredictionCache, Quantization)
     {
         EXPECT_NEAR(INetwork::DequantizeProbabilityNoZero(quantizedPriors1[i]), INetwork::DequantizeProbabilityNoZero(quantizedPriors2[i]), 1.f / std::numeric_limits<uint8_t>::max());
     }
-}
\ No newline at end of file
+}
+
+TEST(PredictionCache, LargeMoveCounts)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    // Cover one, two and four entries' worth of priors, at and around the boundaries.
+    const int entryMoveCount = PredictionCacheEntry::MaxMoveCountForEntryBytes(Config::Misc.PredictionCache_EntryBytes);
+    ASSERT_EQ(PredictionCache::Instance.MaxMoveCount(), std::min(MAX_MOVES, 4 * entryMoveCount));
+    for (int moveCount : { entryMoveCount, (entryMoveCount + 1), (2 * entryMoveCount), 100, 218 })
+    {
+        const Key key = (0x123456789ABCDEF0ULL + moveCount);
+        // Use non-uniform priors so that quantization errors mostly cancel (see "PredictionCacheTable::TryGet").
+        std::vector<float> priors(moveCount);
+        for (int i = 0; i < moveCount; i++)
+        {
+            priors[i] = (static_cast<float>(i + 1) / (moveCount * (moveCount + 1) / 2));
+        }
+
+        // Miss and put, then hit with the exact priors.
+        const std::vector<uint16_t> quantizedPriors = Quantize(priors);
+        std::vector<uint16_t> gotPriors(MAX_MOVES);
+        PredictionCacheChunk chunk;
+        float value;
+        EXPECT_FALSE(PredictionCache::Instance.TryGetPrediction(key, moveCount, &chunk, &value, gotPriors.data()));
+        ASSERT_TRUE(chunk);
+        chunk.Put(key, 0.25f, moveCount, quantizedPriors.data());
+
+        EXPECT_TRUE(PredictionCache::Instance.TryGetPrediction(key, moveCount, &chunk, &value, gotPriors.data()));
+        EXPECT_EQ(value, 0.25f);
+        EXPECT_TRUE(std::equal(quantizedPriors.begin(), quantizedPriors.end(), gotPriors.begin()));
+
+        // A different move count shouldn't match.
+        EXPECT_FALSE(PredictionCache::Instance.TryGetPrediction(key, moveCount - 1, &chunk, &value, gotPriors.data()));
+        EXPECT_FALSE(PredictionCache::Instance.TryGetPrediction(key, moveCount + 1, &chunk, &value, gotPriors.data()));
+    }
+}
+
+TEST(PredictionCache, Contention)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    // Hammer a shared pool of keys from many threads, mixing probes and stores, and make sure that every hit
+    // returns exactly what was stored for that key (no torn or spliced reads).
+    const int threadCount = 64;
+    const int operationsPerThread = 20000;
+    const int keyCount = (1 << 16);
+    const int maxMoveCount = PredictionCache::Instance.MaxMoveCount();
+
+    const auto moveCountForKey = [&](Key key) { return (2 + static_cast<int>(key % (maxMoveCount - 1))); };
+    const auto valueForKey = [](Key key) { return (static_cast<float>(key % 1000) / 1000.f); };
+    const auto priorsForKey = [&](Key key, uint16_t* priors)
+    {
+        // Two large priors that depend on the key, then the remainder spread evenly.
+        const int moveCount = moveCountForKey(key);
+        std::vector<float> floatPriors(moveCount, 0.2f / (moveCount - 2));
+        const float first = (0.1f + (static_cast<float>((key >> 8) % 64) / 100.f));
+        floatPriors[0] = first;
+        floatPriors[1] = (0.8f - first);
+        for (int m = 0; m < moveCount; m++)
+        {
+            priors[m] = INetwork::QuantizeProbabilityNoZero(floatPriors[m]);
+        }
+    };
+
+    PredictionCache::Instance.Clear();
+    std::atomic_int hitCount(0);
+    std::atomic_int mismatchCount(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&, t]()
+            {
+                std::mt19937_64 engine(t);
+                std::uniform_int_distribution<int> keyDistribution(1, keyCount);
+                std::array<uint16_t, MAX_MOVES> priors;
+                std::array<uint16_t, MAX_MOVES> expectedPriors;
+                for (int i = 0; i < operationsPerThread; i++)
+                {
+                    // Spread keys over all bits so that tables/buckets are chosen realistically.
+                    const Key key = (static_cast<Key>(keyDistribution(engine)) * 0x9E3779B97F4A7C15ULL);
+                    const int moveCount = moveCountForKey(key);
+                    priorsForKey(key, expectedPriors.data());
+
+                    PredictionCacheChunk chunk;
+                    float value;
+                    if (PredictionCache::Instance.TryGetPrediction(key, moveCount, &chunk, &value, priors.data()))
+                    {
+                        hitCount++;
+                        if ((value != valueForKey(key)) || !std::equal(priors.begin(), priors.begin() + moveCount, expectedPriors.begin()))
+                        {
+                            mismatchCount++;
+                        }
+                    }
+                    else if (chunk)
+                    {
+                        chunk.Put(key, valueForKey(key), moveCount, expectedPriors.data());
+                    }
+                }
+            });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_GT(hitCount, 0);
+    EXPECT_EQ(mismatchCount, 0);
+    PredictionCache::Instance.Clear();
+}
+
+TEST(PredictionCache, Persistence)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    // Use a small separate cache so that the shared instance is left alone.
+    const std::filesystem::path path = (std::filesystem::temp_directory_path() / "ChessCoachTest" / "PredictionCache.cache");
+    const std::string identity = "network|1000";
+    const std::vector<uint16_t> priors = Quantize({ 0.1f, 0.2f, 0.3f, 0.4f });
+    const Key savedKey = 0x0123456789ABCDEF;
+    const Key unsavedKey = 0x1123456789ABCDEF;
+    std::vector<uint16_t> gotPriors(MAX_MOVES);
+    PredictionCacheChunk chunk;
+    float value;
+
+    PredictionCache cache;
+    cache.Allocate(1, 8, 128);
+    EXPECT_FALSE(cache.TryGetPrediction(savedKey, 4, &chunk, &value, gotPriors.data()));
+    chunk.Put(savedKey, 0.75f, 4, priors.data());
+    cache.Save(path, identity);
+
+    // Load into a fresh allocation with the same geometry and identity.
+    PredictionCache loaded;
+    loaded.Allocate(1, 8, 128);
+    EXPECT_FALSE(loaded.TryGetPrediction(savedKey, 4, &chunk, &value, gotPriors.data()));
+    ASSERT_TRUE(loaded.Load(path, identity));
+    EXPECT_EQ(loaded.PermilleFull(), cache.PermilleFull());
+    EXPECT_TRUE(loaded.TryGetPrediction(savedKey, 4, &chunk, &value, gotPriors.data()));
+    EXPECT_EQ(value, 0.75f);
+    EXPECT_TRUE(std::equal(priors.begin(), priors.end(), gotPriors.begin()));
+
+    // Stores after loading are private to the process and never reach the file.
+    EXPECT_FALSE(loaded.TryGetPrediction(unsavedKey, 4, &chunk, &value, gotPriors.data()));
+    chunk.Put(unsavedKey, 0.5f, 4, priors.data());
+    EXPECT_TRUE(loaded.TryGetPrediction(unsavedKey, 4, &chunk, &value, gotPriors.data()));
+    PredictionCache reloaded;
+    reloaded.Allocate(1, 8, 128);
+    ASSERT_TRUE(reloaded.Load(path, identity));
+    EXPECT_TRUE(reloaded.TryGetPrediction(savedKey, 4, &chunk, &value, gotPriors.data()));
+    EXPECT_FALSE(reloaded.TryGetPrediction(unsavedKey, 4, &chunk, &value, gotPriors.data()));
+
+    // A different network or geometry doesn't load, leaving the current allocation intact.
+    PredictionCache mismatched;
+    mismatched.Allocate(1, 8, 128);
+    EXPECT_FALSE(mismatched.Load(path, "network|2000"));
+    mismatched.Allocate(1, 4, 128);
+    EXPECT_FALSE(mismatched.Load(path, identity));
+    mismatched.Allocate(2, 8, 128);
+    EXPECT_FALSE(mismatched.Load(path, identity));
+    EXPECT_FALSE(mismatched.Load(path.parent_path() / "Missing.cache", identity));
+    EXPECT_FALSE(mismatched.TryGetPrediction(savedKey, 4, &chunk, &value, gotPriors.data()));
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,98 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+#include <memory>
+
+#include <ChessCoach/PredictionPipeline.h>
+#include <ChessCoach/FakeNetwork.h>
+#include <ChessCoach/ChessCoach.h>
+#include <ChessCoach/Game.h>
+
+// Predicts like "FakeNetwork" but returns a scripted status per batch and records how each batch was run.
+class ScriptedNetwork : public FakeNetwork
+{
+public:
+
+    ScriptedNetwork(const std::vector<PredictionStatus>& statuses)
+        : FakeNetwork(nullptr /* fallback */, FakeNetworkOptions{})
+        , statuses(statuses)
+    {
+    }
+
+    virtual PredictionStatus PredictBatch(NetworkType networkType, int batchSize, InputPlanes* images, float* values, OutputPlanes* policies)
+    {
+        FakeNetwork::PredictBatch(networkType, batchSize, images, values, policies);
+        batchSizes.push_back(batchSize);
+        threadIds.push_back(std::this_thread::get_id());
+        return statuses[batchSizes.size() - 1];
+    }
+
+    std::vector<PredictionStatus> statuses;
+    std::vector<int> batchSizes;
+    std::vector<std::thread::id> threadIds;
+};
+
+TEST(PredictionPipeline, SubmitWait)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    ScriptedNetwork network({ PredictionStatus_UpdatedNetwork, PredictionStatus_None });
+    PredictionPipeline pipeline(&network, NetworkType_Teacher);
+
+    const int batchSize = 3;
+    Game game;
+    std::vector<INetwork::InputPlanes> images(batchSize);
+    std::vector<float> values(batchSize);
+    std::vector<INetwork::OutputPlanes> policies(batchSize);
+    std::vector<float> expectedValues(batchSize);
+    std::unique_ptr<INetwork::OutputPlanes> policy(std::make_unique<INetwork::OutputPlanes>());
+    for (int i = 0; i < batchSize; i++)
+    {
+        game.GenerateImage(images[i]);
+        FakeNetwork::Predict(images[i], expectedValues[i], *policy);
+        game.ApplyMove(MoveList<LEGAL>(game.GetPosition()).begin()->move);
+    }
+
+    // Nothing in flight yet.
+    EXPECT_EQ(pipeline.Wait(), PredictionStatus_None);
+    EXPECT_TRUE(network.batchSizes.empty());
+
+    // Statuses come back through "Wait", one per submitted batch.
+    pipeline.Submit(batchSize, images.data(), values.data(), policies.data());
+    EXPECT_EQ(pipeline.Wait(), PredictionStatus_UpdatedNetwork);
+    EXPECT_EQ(pipeline.Wait(), PredictionStatus_None);
+    EXPECT_EQ(values, expectedValues);
+
+    // Predict only the tail of the slots, like a second pipeline group.
+    std::fill(values.begin(), values.end(), 0.f);
+    pipeline.Submit(batchSize - 1, &images[1], &values[1], &policies[1]);
+    EXPECT_EQ(pipeline.Wait(), PredictionStatus_None);
+    EXPECT_EQ(values[0], 0.f);
+    for (int i = 1; i < batchSize; i++)
+    {
+        EXPECT_EQ(values[i], expectedValues[i]);
+    }
+
+    // Both batches ran on the pipeline's own thread.
+    ASSERT_EQ(network.batchSizes, (std::vector<int>{ batchSize, batchSize - 1 }));
+    EXPECT_EQ(network.threadIds[0], network.threadIds[1]);
+    EXPECT_NE(network.threadIds[0], std::this_thread::get_id());
+}
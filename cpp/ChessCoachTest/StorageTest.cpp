@@ -0,0 +1,219 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <mutex>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+
+#include <ChessCoach/ChessCoach.h>
+#include <ChessCoach/Storage.h>
+#include <ChessCoach/Config.h>
+
+// See ColumnarChunkTest.cpp.
+std::vector<SavedGame> GenerateRandomSavedGames(int gameCount, int maxMoves);
+std::string ReadFileContents(const std::filesystem::path& path);
+void ExpectSameGame(const SavedGame& expected, const SavedGame& actual);
+
+// Only records saved files, optionally failing the first few saves.
+class RecordingNetwork : public INetwork
+{
+public:
+
+    virtual PredictionStatus PredictBatch(NetworkType, int, InputPlanes*, float*, OutputPlanes*) { return PredictionStatus_None; }
+    virtual std::vector<std::string> PredictCommentaryBatch(int, CommentaryInputPlanes*) { return {}; }
+    virtual void Train(NetworkType, int, int) {}
+    virtual void TrainCommentary(int, int) {}
+    virtual void LogScalars(NetworkType, int, const std::vector<std::string>, float*) {}
+    virtual void SaveNetwork(NetworkType, int) {}
+    virtual void SaveSwaNetwork(NetworkType, int) {}
+    virtual void UpdateNetworkWeights(const std::string&) {}
+    virtual void GetNetworkInfo(NetworkType, int*, int*, int*, std::string*) {}
+    virtual std::string LoadFile(const std::string&) { return {}; }
+    virtual bool FileExists(const std::string&) { return false; }
+    virtual void LaunchGui(const std::string&) {}
+    virtual void UpdateGui(const std::string&, const std::string&, int, const std::string&, const std::string&,
+        const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, std::vector<float>&,
+        std::vector<float>&, std::vector<float>&, std::vector<float>&, std::vector<int>&, std::vector<int>&) {}
+    virtual void DebugDecompress(int, int, float*, int64_t*, int64_t*, int64_t*, float*, int, InputPlanes*, float*, OutputPlanes*) {}
+    virtual void OptimizeParameters() {}
+    virtual void RunBot() {}
+    virtual void PlayBotMove(const std::string&, const std::string&) {}
+
+    virtual void SaveFile(const std::string& relativePath, const std::string& data)
+    {
+        std::lock_guard lock(mutex);
+        if (failSaveCount > 0)
+        {
+            failSaveCount--;
+            throw ChessCoachException("Failed to save " + relativePath);
+        }
+        files[relativePath] = data;
+    }
+
+public:
+
+    std::mutex mutex;
+    std::map<std::string, std::string> files;
+    int failSaveCount = 0;
+};
+
+TEST(Storage, BackgroundChunking)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    // Chunk into a temporary directory, in small chunks, compressing in parallel.
+    const std::filesystem::path directory = (std::filesystem::temp_directory_path() / "ChessCoachTest" / "BackgroundChunking");
+    const std::filesystem::path reference = (std::filesystem::temp_directory_path() / "ChessCoachTest" / "BackgroundChunking.chunk");
+    std::filesystem::remove_all(directory);
+    const TrainingConfig originalTraining = Config::Network.Training;
+    const int originalGamesPerChunk = Config::Misc.Storage_GamesPerChunk;
+    const int originalCompressionThreads = Config::Misc.Storage_ChunkCompressionThreads;
+    Config::Network.Training.GamesPathTraining = directory.string();
+    Config::Network.Training.PgnInterval = 1000000;
+    Config::Misc.Storage_GamesPerChunk = (2 * Storage::ChunkBlockGames + 10);
+    Config::Misc.Storage_ChunkCompressionThreads = 3;
+
+    const int gamesPerChunk = Config::Misc.Storage_GamesPerChunk;
+    const std::vector<SavedGame> games = GenerateRandomSavedGames((2 * gamesPerChunk) + 5, 30);
+
+    RecordingNetwork network;
+    {
+        Storage storage;
+        storage.InitializeLocalGamesChunks(&network);
+        for (const SavedGame& game : games)
+        {
+            storage.AddTrainingGame(&network, SavedGame(game));
+        }
+        storage.FlushChunks();
+
+        const ChunkWriterStatistics statistics = storage.ChunkStatistics();
+        EXPECT_EQ(statistics.chunkCount, 2);
+        EXPECT_EQ(statistics.failedChunkCount, 0);
+        EXPECT_EQ(statistics.pendingGameCount, 5);
+        EXPECT_EQ(storage.TrainingGamesToPlay(2 /* trainingChunkCount */, (2 * gamesPerChunk) + 5, false /* ignoreLocalGames */), gamesPerChunk - 5);
+
+        // Chunks hold games in the order played, readable as a single zlib stream, just like a serially written chunk.
+        std::lock_guard lock(network.mutex);
+        ASSERT_EQ(network.files.size(), 2);
+        int chunkIndex = 0;
+        for (const auto& [path, contents] : network.files)
+        {
+            const std::vector<SavedGame> chunkGames(games.begin() + (chunkIndex * gamesPerChunk), games.begin() + ((chunkIndex + 1) * gamesPerChunk));
+            storage.SaveChunk(reference, chunkGames);
+            const std::string referenceContents = ReadFileContents(reference);
+
+            for (int i = 0; i < gamesPerChunk; i++)
+            {
+                SavedGame expected;
+                SavedGame actual;
+                storage.LoadGameFromChunk(referenceContents, i, &expected);
+                storage.LoadGameFromChunk(contents, i, &actual);
+                ExpectSameGame(expected, actual);
+            }
+            chunkIndex++;
+        }
+    }
+
+    // Chunked games are deleted, and leftovers wait for next time.
+    int leftoverCount = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(directory))
+    {
+        leftoverCount += (entry.path().extension() == ".game");
+    }
+    EXPECT_EQ(leftoverCount, 5);
+
+    Config::Network.Training = originalTraining;
+    Config::Misc.Storage_GamesPerChunk = originalGamesPerChunk;
+    Config::Misc.Storage_ChunkCompressionThreads = originalCompressionThreads;
+    std::filesystem::remove_all(directory);
+    std::filesystem::remove(reference);
+}
+
+TEST(Storage, ChunkingRetriesFailures)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    const std::filesystem::path directory = (std::filesystem::temp_directory_path() / "ChessCoachTest" / "ChunkingRetriesFailures");
+    const std::filesystem::path reference = (std::filesystem::temp_directory_path() / "ChessCoachTest" / "ChunkingRetriesFailures.chunk");
+    std::filesystem::remove_all(directory);
+    const TrainingConfig originalTraining = Config::Network.Training;
+    const int originalGamesPerChunk = Config::Misc.Storage_GamesPerChunk;
+    Config::Network.Training.GamesPathTraining = directory.string();
+    Config::Network.Training.PgnInterval = 1000000;
+    Config::Misc.Storage_GamesPerChunk = 10;
+
+    const int gamesPerChunk = Config::Misc.Storage_GamesPerChunk;
+    const std::vector<SavedGame> games = GenerateRandomSavedGames(gamesPerChunk, 30);
+
+    RecordingNetwork network;
+    network.failSaveCount = 1;
+    {
+        Storage storage;
+        storage.InitializeLocalGamesChunks(&network);
+        for (const SavedGame& game : games)
+        {
+            storage.AddTrainingGame(&network, SavedGame(game));
+        }
+
+        // Flushing gives up on a failed upload, but the games are queued again rather than dropped.
+        storage.FlushChunks();
+        ChunkWriterStatistics statistics = storage.ChunkStatistics();
+        EXPECT_EQ(statistics.chunkCount, 0);
+        EXPECT_EQ(statistics.failedChunkCount, 1);
+        EXPECT_EQ(statistics.pendingGameCount, gamesPerChunk);
+
+        // The chunk is retried after backing off.
+        const auto deadline = (std::chrono::steady_clock::now() + std::chrono::milliseconds(10 * Storage::ChunkRetryInitialMilliseconds));
+        while ((storage.ChunkStatistics().chunkCount == 0) && (std::chrono::steady_clock::now() < deadline))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        storage.FlushChunks();
+        statistics = storage.ChunkStatistics();
+        EXPECT_EQ(statistics.chunkCount, 1);
+        EXPECT_EQ(statistics.failedChunkCount, 1);
+        EXPECT_EQ(statistics.pendingGameCount, 0);
+        EXPECT_EQ(storage.TrainingGamesToPlay(1 /* trainingChunkCount */, gamesPerChunk, false /* ignoreLocalGames */), 0);
+
+        // The retried chunk holds the games in the order played.
+        std::lock_guard lock(network.mutex);
+        ASSERT_EQ(network.files.size(), 1);
+        storage.SaveChunk(reference, games);
+        const std::string referenceContents = ReadFileContents(reference);
+        for (int i = 0; i < gamesPerChunk; i++)
+        {
+            SavedGame expected;
+            SavedGame actual;
+            storage.LoadGameFromChunk(referenceContents, i, &expected);
+            storage.LoadGameFromChunk(network.files.begin()->second, i, &actual);
+            ExpectSameGame(expected, actual);
+        }
+    }
+
+    // All games made it into the chunk and were deleted.
+    EXPECT_TRUE(std::filesystem::is_empty(directory));
+
+    Config::Network.Training = originalTraining;
+    Config::Misc.Storage_GamesPerChunk = originalGamesPerChunk;
+    std::filesystem::remove_all(directory);
+    std::filesystem::remove(reference);
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include <ChessCoach/ChessCoach.h>
+#include <ChessCoach/Trace.h>
+#include <ChessCoach/Bench.h>
+
+int CountOccurrences(const std::string& text, const std::string& pattern)
+{
+    int count = 0;
+    for (size_t position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1))
+    {
+        count++;
+    }
+    return count;
+}
+
+TEST(Trace, RingBuffer)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    // Record more events than fit, on a fresh thread.
+    Trace::Start(4 /* eventsPerThread */);
+    std::thread thread([]()
+        {
+            Trace::SetThreadName("ring buffer test");
+            const int64_t start = Instrumentation::Now();
+            for (int i = 0; i < 10; i++)
+            {
+                Trace::Record(InstrumentedPhase_Pruning, start + (i * 1000000), start + (i * 1000000) + 500000);
+            }
+
+            // Fine-grained phases go to counters only.
+            Instrumentation::Record(InstrumentedPhase_Selection, Instrumentation::Start(InstrumentedPhase_Selection));
+        });
+    thread.join();
+    Trace::Stop();
+
+    // Only the most recent 4 are kept, oldest first, in microseconds.
+    std::stringstream json;
+    EXPECT_EQ(Trace::WriteJson(json), 4);
+    const std::string text = json.str();
+    EXPECT_EQ(text.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0);
+    EXPECT_NE(text.find("\"args\":{\"name\":\"ring buffer test\"}"), std::string::npos);
+    EXPECT_EQ(CountOccurrences(text, "\"name\":\"pruning\""), 4);
+    EXPECT_EQ(CountOccurrences(text, "\"name\":\"selection\""), 0);
+    EXPECT_EQ(CountOccurrences(text, "\"dur\":500.000}"), 4);
+    std::vector<double> timestamps;
+    for (size_t position = text.find(",\"ts\":"); position != std::string::npos; position = text.find(",\"ts\":", position + 1))
+    {
+        timestamps.push_back(std::stod(text.substr(position + 6)));
+    }
+    ASSERT_EQ(timestamps.size(), 4);
+    for (int i = 1; i < 4; i++)
+    {
+        EXPECT_NEAR(timestamps[i] - timestamps[i - 1], 1000.0, 0.01);
+    }
+
+    // Nothing more is recorded once stopped, and starting again forgets old events.
+    {
+        InstrumentedScope scope(InstrumentedPhase_Pruning);
+    }
+    Trace::Start(4 /* eventsPerThread */);
+    Trace::Stop();
+    std::stringstream empty;
+    EXPECT_EQ(Trace::WriteJson(empty), 0);
+
+    EXPECT_THROW(Trace::Start(0 /* eventsPerThread */), ChessCoachException);
+}
+
+TEST(Trace, Search)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    Trace::Start(1024 /* eventsPerThread */);
+    Bench::Run(nullptr /* network */, "fake", 200 /* nodes */, 2 /* threadCount */, 32 /* parallelism */);
+    Trace::Stop();
+
+    // Search threads show CPU work interleaved with waits on predictions.
+    std::stringstream json;
+    EXPECT_GT(Trace::WriteJson(json), 0);
+    const std::string text = json.str();
+    EXPECT_NE(text.find("\"args\":{\"name\":\"search\"}"), std::string::npos);
+    EXPECT_NE(text.find("\"name\":\"mcts\""), std::string::npos);
+    EXPECT_NE(text.find("\"name\":\"predict_wait\""), std::string::npos);
+    EXPECT_EQ(text.substr(text.size() - 3), "]}\n");
+}
@@ -0,0 +1,164 @@
+// ChessCoach, a neural network-based chess engine capable of natural-language commentary
+// Copyright 2021 Chris Butner
+//
+// ChessCoach is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ChessCoach is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+#include <ChessCoach/ChessCoach.h>
+#include <ChessCoach/TrainingDataLoader.h>
+#include <ChessCoach/Storage.h>
+
+// See ColumnarChunkTest.cpp.
+std::vector<SavedGame> GenerateRandomSavedGames(int gameCount, int maxMoves);
+
+struct ExpectedPosition
+{
+    INetwork::InputPlanes image;
+    float value;
+    float mctsValue;
+    INetwork::OutputPlanes policy;
+};
+
+std::vector<ExpectedPosition> ExpectedPositions(const std::vector<SavedGame>& games)
+{
+    std::vector<ExpectedPosition> expected;
+    for (const SavedGame& savedGame : games)
+    {
+        Game game;
+        for (int m = 0; m < savedGame.moveCount; m++)
+        {
+            ExpectedPosition& position = expected.emplace_back();
+            game.GenerateImage(position.image);
+            position.value = INetwork::MapProbability01To11(Game::FlipValue(game.ToPlay(), savedGame.result));
+            position.mctsValue = INetwork::MapProbability01To11(savedGame.mctsValues[m]);
+            position.policy = {};
+            game.GeneratePolicy(savedGame.childVisits[m], position.policy);
+            game.ApplyMove(Move(savedGame.moves[m]));
+        }
+    }
+    return expected;
+}
+
+TEST(TrainingDataLoader, AllPositions)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    const std::filesystem::path directory = (std::filesystem::temp_directory_path() / "ChessCoachTest");
+    const std::filesystem::path chunkPath = (directory / "Loader.chunk");
+    const std::filesystem::path columnarPath = (directory / "Loader.colchunk");
+    std::filesystem::create_directories(directory);
+
+    Storage storage;
+    const std::vector<SavedGame> games = GenerateRandomSavedGames(6, 40);
+    storage.SaveChunk(chunkPath, games);
+    storage.SaveColumnarChunk(columnarPath, games, true /* compress */);
+    const std::vector<ExpectedPosition> expected = ExpectedPositions(games);
+
+    // Keeping everything, with a single reader and a reservoir and batch the size of the chunk, the first batch
+    // holds each position exactly once, decompressed just like dataset.py.
+    TrainingDataLoaderOptions options;
+    options.batchSize = static_cast<int>(expected.size());
+    options.shuffleSize = options.batchSize;
+    options.keepGameProportion = 1.f;
+    options.keepPositionProportion = 1.f;
+    options.threadCount = 1;
+
+    for (const std::filesystem::path& path : { chunkPath, columnarPath })
+    {
+        TrainingDataLoader loader(&storage, { { path } }, options);
+        std::unique_ptr<TrainingBatch> batch = loader.NextBatch();
+
+        std::vector<bool> matched(expected.size());
+        int matchedCount = 0;
+        for (int i = 0; i < options.batchSize; i++)
+        {
+            for (int j = 0; j < expected.size(); j++)
+            {
+                if (!matched[j]
+                    && (batch->images[i] == expected[j].image)
+                    && (batch->values[i] == expected[j].value)
+                    && (batch->mctsValues[i] == expected[j].mctsValue)
+                    && (batch->policies[i] == expected[j].policy))
+                {
+                    matched[j] = true;
+                    matchedCount++;
+                    break;
+                }
+            }
+        }
+        EXPECT_EQ(matchedCount, expected.size());
+
+        loader.RecycleBatch(std::move(batch));
+    }
+
+    // Reader errors surface on the caller's thread.
+    std::ofstream(columnarPath, std::ios::out | std::ios::binary | std::ios::trunc) << std::string(8192, 'x');
+    {
+        TrainingDataLoader loader(&storage, { { columnarPath } }, options);
+        EXPECT_THROW(loader.NextBatch(), ChessCoachException);
+    }
+    EXPECT_THROW(TrainingDataLoader(&storage, { {} }, options), ChessCoachException);
+
+    std::filesystem::remove(chunkPath);
+    std::filesystem::remove(columnarPath);
+}
+
+// Timing only, so disabled in the unit suite: run with "meson test --benchmark" (see "MicroBenchmarks").
+TEST(TrainingDataLoader, DISABLED_Throughput)
+{
+    ChessCoach chessCoach;
+    chessCoach.Initialize();
+
+    const std::filesystem::path directory = (std::filesystem::temp_directory_path() / "ChessCoachTest");
+    const std::filesystem::path chunkPath = (directory / "LoaderThroughput.chunk");
+    const std::filesystem::path columnarPath = (directory / "LoaderThroughput.colchunk");
+    std::filesystem::create_directories(directory);
+
+    Storage storage;
+    const std::vector<SavedGame> games = GenerateRandomSavedGames(200, 100);
+    storage.SaveChunk(chunkPath, games);
+    storage.SaveColumnarChunk(columnarPath, games, false /* compress */);
+
+    TrainingDataLoaderOptions options;
+    options.batchSize = 256;
+    options.shuffleSize = 4096;
+    options.keepGameProportion = 1.f;
+    options.keepPositionProportion = 0.5f;
+    options.threadCount = 2;
+
+    const int batchCount = 40;
+    for (const std::filesystem::path& path : { chunkPath, columnarPath })
+    {
+        TrainingDataLoader loader(&storage, { { path } }, options);
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < batchCount; i++)
+        {
+            loader.RecycleBatch(loader.NextBatch());
+        }
+        const float seconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::cout << path.extension().string() << " loader: positions/second=" << (batchCount * options.batchSize / seconds) << std::endl;
+    }
+
+    std::filesystem::remove(chunkPath);
+    std::filesystem::remove(columnarPath);
+}
@@ -16,6 +16,7 @@
 
 #include <iostream>
 #include <thread>
+#include <chrono>
 #include <algorithm>
 #include <functional>
 #include <numeric>
@@ -24,6 +25,10 @@
 #include <ChessCoach/Threading.h>
 #include <ChessCoach/WorkerGroup.h>
 #include <ChessCoach/Syzygy.h>
+#include <ChessCoach/InferenceServer.h>
+#include <ChessCoach/NodeArena.h>
+#include <ChessCoach/Instrumentation.h>
+#include <ChessCoach/Trace.h>
 
 struct TrainingState
 {
@@ -93,6 +98,9 @@ void ChessCoachTrain::TrainChessCoach()
     // Initialize storage for training and take care of any game/chunk housekeeping from previous runs.
     storage.InitializeLocalGamesChunks(network.get());
 
+    // Let the native training data loader read TFRecord chunks (see "dataset_native_loader" in dataset.py).
+    InitializePythonModule(&storage, nullptr /* network */, nullptr /* workerGroup */);
+
     // Start self-play worker threads.
     WorkerGroup workerGroup;
     workerGroup.Initialize(network.get(), &storage, Config::Network.SelfPlay.PredictionNetworkType, Config::Network.SelfPlay.NumWorkers,
@@ -198,11 +206,21 @@ void ChessCoachTrain::StagePlay(const TrainingState& state)
     // Need to play enough games to reach the training window maximum (skip if already enough).
     // Loop and check in case of distributed scenarios where other machines are generating games/chunks,
     // or to avoid generating too few games/chunks after unexpected failures or outside intervention.
+    auto lastInstrumentationLog = std::chrono::high_resolution_clock::now();
     while (true)
     {
         // Check every "wait_milliseconds" to see whether other machines have generated enough games/chunks.
         const bool workersReady = state.workerGroup->workCoordinator->WaitForWorkers(Config::Network.Training.WaitMilliseconds);
 
+        // Periodically log where self-play time is going.
+        const auto now = std::chrono::high_resolution_clock::now();
+        if (Instrumentation::Enabled() && (Config::Misc.Instrumentation_LogIntervalSeconds > 0) &&
+            (std::chrono::duration<float>(now - lastInstrumentationLog).count() >= Config::Misc.Instrumentation_LogIntervalSeconds))
+        {
+            Instrumentation::PrintDebugInfo();
+            lastInstrumentationLog = now;
+        }
+
         // We need to reach into Python for network info in case it's coming from cloud storage.
         int trainingChunkCount;
         state.network->GetNetworkInfo(NetworkType_Teacher, nullptr, nullptr, &trainingChunkCount, nullptr);
@@ -213,6 +231,9 @@ void ChessCoachTrain::StagePlay(const TrainingState& state)
             // Stop workers in case we finished because of other machines, in a distributed scenario.
             std::cout << "Finished playing games" << std::endl;
             state.workerGroup->workCoordinator->ResetWorkItemsRemaining(0);
+
+            // Chunks are written in the background, so make sure the last ones are stored before training on them.
+            state.storage->FlushChunks();
             break;
         }
 
@@ -233,8 +254,30 @@ void ChessCoachTrain::StagePlay(const TrainingState& state)
         }
     }
 
-    // Print prediction cache stats after finishing self-play.
+    // Print prediction cache and node allocation stats after finishing self-play.
     PredictionCache::Instance.PrintDebugInfo();
+    NodeArena::PrintDebugInfo();
+
+    // Print hot-path timings for the stage, starting afresh for the next one.
+    if (Instrumentation::Enabled())
+    {
+        Instrumentation::PrintDebugInfo();
+        Instrumentation::ResetStatistics();
+    }
+
+    // Save the latest stretch of the timeline when tracing, replacing the previous stage's.
+    if (Trace::Active())
+    {
+        Trace::WriteFile(Trace::ConfiguredPath());
+    }
+
+    // Print batching stats too, if predictions are going through the inference server.
+    InferenceServer* inferenceServer = dynamic_cast<InferenceServer*>(state.network);
+    if (inferenceServer)
+    {
+        inferenceServer->PrintDebugInfo();
+        inferenceServer->ResetStatistics();
+    }
 }
 
 void ChessCoachTrain::StageTrain(const TrainingState& state)
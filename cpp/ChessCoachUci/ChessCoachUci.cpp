@@ -33,6 +33,10 @@
 #include <ChessCoach/WorkerGroup.h>
 #include <ChessCoach/Pgn.h>
 #include <ChessCoach/Syzygy.h>
+#include <ChessCoach/InferenceServer.h>
+#include <ChessCoach/Bench.h>
+#include <ChessCoach/Instrumentation.h>
+#include <ChessCoach/Trace.h>
 
 using CommandHandler = std::function<void(std::stringstream&)>;
 using CommandHandlerEntry = std::pair<std::string, CommandHandler>;
@@ -49,6 +53,7 @@ public:
     void Initialize();
     void Finalize();
     void Work();
+    void RunBench(std::stringstream& commands);
 
 private:
 
@@ -94,14 +99,27 @@ private:
     WorkerGroup _workerGroup;
 };
 
-int main()
+int main(int argc, char* argv[])
 {
     ChessCoachUci chessCoachUci;
 
     chessCoachUci.PrintExceptions();
     chessCoachUci.Initialize();
 
-    chessCoachUci.Work();
+    // Like Stockfish, "ChessCoachUci bench [nodes] [predictions] [output.json]" runs the benchmark and exits.
+    if ((argc > 1) && (std::string(argv[1]) == "bench"))
+    {
+        std::stringstream commands;
+        for (int i = 2; i < argc; i++)
+        {
+            commands << argv[i] << " ";
+        }
+        chessCoachUci.RunBench(commands);
+    }
+    else
+    {
+        chessCoachUci.Work();
+    }
 
     chessCoachUci.Finalize();
 
@@ -179,6 +197,12 @@ void ChessCoachUci::Work()
     if (_workerGroup.IsInitialized())
     {
         _workerGroup.ShutDown();
+
+        // Keep evaluations for next time. The network is only initialized along with workers.
+        if (Config::Misc.PredictionCache_Persistent)
+        {
+            SavePredictionCache(_network.get());
+        }
     }
 
     _network.reset();
@@ -399,6 +423,10 @@ void ChessCoachUci::HandleSetOption(std::stringstream& commands)
     {
         throw ChessCoachException("Threads, parallelism, and weights need to be set before readying/searching");
     }
+    else if (((name == "inference_backend") || (name == "native_weights")) && _network)
+    {
+        throw ChessCoachException("The inference backend and native weights need to be set before setting weights or readying/searching");
+    }
     else if (name == "network_weights")
     {
         InitializeNetwork();
@@ -412,6 +440,10 @@ void ChessCoachUci::HandleSetOption(std::stringstream& commands)
     else if (name == "Hash")
     {
         InitializePredictionCache();
+        if (_workerGroup.IsInitialized())
+        {
+            LoadPredictionCache(_network.get());
+        }
     }
 }
 
@@ -427,8 +459,12 @@ void ChessCoachUci::HandleUciNewGame(std::stringstream& /*commands*/)
     _positionFen = Game::StartingPosition;
     _positionMoves.clear();
 
-    // Also clear the prediction cache, for repeatability/consistency during analysis.
-    PredictionCache::Instance.Clear();
+    // Also clear the prediction cache, for repeatability/consistency during analysis,
+    // unless it's deliberately kept warm across games and sessions.
+    if (!Config::Misc.PredictionCache_Persistent)
+    {
+        PredictionCache::Instance.Clear();
+    }
 
     // Work around problems with swapping out memory-mapped pages by reinitializing tablebases each game.
     Syzygy::Reload();
@@ -599,6 +635,13 @@ void ChessCoachUci::HandleQuit(std::stringstream& /*commands*/)
     {
         StopAndReadyWorkers();
     }
+
+    // Save any timeline being traced via config.
+    if (Trace::Active())
+    {
+        Trace::Stop();
+        Trace::WriteFile(Trace::ConfiguredPath());
+    }
     _quit = true;
 }
 
@@ -694,6 +737,280 @@ void ChessCoachUci::HandleConsole(std::stringstream& commands)
         const std::string fen = Game(_positionFen, _positionMoves).GetPosition().fen();
         std::cout << fen << std::endl;
     }
+    else if (token == "cache")
+    {
+        // Save the prediction cache for this network, or warm it up by predicting positions from
+        // a file of FENs (one per line), plus their successors up to "plies" deep.
+        InitializeWorkers();
+        StopAndReadyWorkers();
+
+        std::string action;
+        commands >> action;
+        if (action == "save")
+        {
+            SavePredictionCache(_network.get());
+            PredictionCache::Instance.PrintDebugInfo();
+        }
+        else if (action == "populate")
+        {
+            std::string filename;
+            int plies = 0;
+            commands >> filename >> plies;
+
+            std::vector<std::string> fens;
+            std::ifstream file(filename);
+            std::string line;
+            while (std::getline(file, line))
+            {
+                if (!line.empty() && (line[0] != '#'))
+                {
+                    fens.push_back(line);
+                }
+            }
+            if (fens.empty())
+            {
+                std::cout << "No positions found in: " << filename << std::endl;
+                return;
+            }
+
+            SearchState searchState{};
+            SelfPlayWorker worker(nullptr /* storage */, &searchState, Config::Misc.Search_SearchParallelism);
+            const auto start = std::chrono::high_resolution_clock::now();
+            const int predictionCount = worker.PopulatePredictionCache(_network.get(), Config::Network.SelfPlay.PredictionNetworkType, fens, plies);
+            const std::chrono::duration<float> elapsed = (std::chrono::high_resolution_clock::now() - start);
+
+            std::cout << "fens=" << fens.size()
+                << " plies=" << plies
+                << " predictions=" << predictionCount
+                << " seconds=" << elapsed.count()
+                << std::endl;
+            PredictionCache::Instance.PrintDebugInfo();
+        }
+    }
+    else if (token == "analyse")
+    {
+        // Search each position from a file of FENs (one per line) to a node budget on the warmed-up search workers
+        // and prediction cache, writing results (including "MultiPV" lines) as JSON lines. Optionally search
+        // "concurrency" positions at once to fill prediction batches at small node budgets.
+        std::string filename;
+        int nodes = 0;
+        std::string outputFilename;
+        int concurrency = 1;
+        commands >> filename >> nodes >> outputFilename;
+        if (!(commands >> concurrency))
+        {
+            concurrency = 1;
+        }
+        if ((nodes <= 0) || outputFilename.empty() || (concurrency <= 0))
+        {
+            std::cout << "Usage: console analyse <fens> <nodes> <output.jsonl> [concurrency]" << std::endl;
+            return;
+        }
+
+        std::vector<std::string> fens;
+        std::ifstream file(filename);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (!line.empty() && (line[0] != '#'))
+            {
+                fens.push_back(line);
+            }
+        }
+        if (fens.empty())
+        {
+            std::cout << "No positions found in: " << filename << std::endl;
+            return;
+        }
+
+        InitializeWorkers();
+        StopAndReadyWorkers();
+
+        std::ofstream output(outputFilename, std::ios::out | std::ios::trunc);
+        if (!output)
+        {
+            std::cout << "Failed to open: " << outputFilename << std::endl;
+            return;
+        }
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        const int analysedCount = _workerGroup.controllerWorker->AnalysePositions(_workerGroup.workCoordinator.get(), fens, nodes, concurrency, output);
+        const std::chrono::duration<float> elapsed = (std::chrono::high_resolution_clock::now() - start);
+
+        // The controller worker's position was replaced, so propagate the last "position" again on the next search.
+        _isNewGame = true;
+        _positionUpdated = true;
+
+        std::cout << "fens=" << fens.size()
+            << " analysed=" << analysedCount
+            << " nodes=" << nodes
+            << " concurrency=" << concurrency
+            << " seconds=" << elapsed.count()
+            << " positions/sec=" << (analysedCount / elapsed.count())
+            << std::endl;
+        PredictionCache::Instance.PrintDebugInfo();
+    }
+    else if (token == "bench")
+    {
+        RunBench(commands);
+    }
+    else if (token == "instrumentation")
+    {
+        // Print hot-path timing counters since startup or the last reset, then "reset" them, switch them "on"/"off",
+        // or switch per-node phases "pernode" on/off.
+        std::string action;
+        commands >> action;
+
+        Instrumentation::PrintDebugInfo();
+        if (action == "reset")
+        {
+            Instrumentation::ResetStatistics();
+        }
+        else if ((action == "on") || (action == "off"))
+        {
+            Instrumentation::SetEnabled(action == "on");
+        }
+        else if (action == "pernode")
+        {
+            std::string toggle;
+            commands >> toggle;
+            Instrumentation::SetPerNode(toggle != "off");
+        }
+    }
+    else if (token == "trace")
+    {
+        // Start recording a timeline of each thread, optionally with a different ring buffer size,
+        // then stop and write it as a Chrome trace (defaulting to the configured "trace_path").
+        std::string action;
+        commands >> action;
+        if (action == "start")
+        {
+            int eventsPerThread = Config::Misc.Instrumentation_TraceEventsPerThread;
+            commands >> eventsPerThread;
+            Trace::Start(eventsPerThread);
+            std::cout << "Tracing " << eventsPerThread << " events per thread" << std::endl;
+        }
+        else if (action == "stop")
+        {
+            std::string filename;
+            commands >> filename;
+            Trace::Stop();
+            Trace::WriteFile(filename.empty() ? Trace::ConfiguredPath() : std::filesystem::path(filename));
+        }
+        else
+        {
+            std::cout << "Usage: console trace start [events_per_thread] | console trace stop [output.json]" << std::endl;
+        }
+    }
+    else if (token == "predict")
+    {
+        // Measure raw prediction throughput for the configured inference backend, with "search_threads" threads
+        // each predicting batches of "search_parallelism", so that backends can be compared at the same settings.
+        int batchCount = 10;
+        commands >> batchCount;
+
+        InitializeNetwork();
+        const int threadCount = Config::Misc.Search_SearchThreads;
+        const int batchSize = Config::Misc.Search_SearchParallelism;
+        const NetworkType networkType = Config::Network.SelfPlay.PredictionNetworkType;
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; t++)
+        {
+            threads.emplace_back([&]()
+                {
+                    Game game(_positionFen, _positionMoves);
+                    std::vector<INetwork::InputPlanes> images(batchSize);
+                    std::vector<float> values(batchSize);
+                    std::vector<INetwork::OutputPlanes> policies(batchSize);
+                    for (INetwork::InputPlanes& image : images)
+                    {
+                        game.GenerateImage(image);
+                    }
+                    for (int i = 0; i < batchCount; i++)
+                    {
+                        _network->PredictBatch(networkType, batchSize, images.data(), values.data(), policies.data());
+                    }
+                });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        const std::chrono::duration<float> elapsed = (std::chrono::high_resolution_clock::now() - start);
+
+        const int64_t positionCount = (static_cast<int64_t>(threadCount) * batchSize * batchCount);
+        std::cout << "backend=" << Config::Misc.Inference_Backend
+            << " threads=" << threadCount
+            << " batch=" << batchSize
+            << " positions=" << positionCount
+            << " seconds=" << elapsed.count()
+            << " positions/sec=" << static_cast<int64_t>(positionCount / elapsed.count())
+            << std::endl;
+
+        InferenceServer* inferenceServer = dynamic_cast<InferenceServer*>(_network.get());
+        if (inferenceServer)
+        {
+            inferenceServer->PrintDebugInfo();
+            inferenceServer->ResetStatistics();
+        }
+    }
+}
+
+// Search a fixed set of positions to a fixed node count with "uniform" (default), "fake" or "network" predictions,
+// printing results as JSON and optionally writing them to a file, for comparing performance between commits.
+void ChessCoachUci::RunBench(std::stringstream& commands)
+{
+    int nodes = Bench::DefaultNodes;
+    std::string predictions = "uniform";
+    std::string outputFilename;
+    if (!(commands >> nodes))
+    {
+        nodes = Bench::DefaultNodes;
+    }
+    else
+    {
+        commands >> predictions >> outputFilename;
+    }
+    if ((nodes <= 0) || ((predictions != "uniform") && (predictions != "fake") && (predictions != "network")))
+    {
+        std::cout << "Usage: console bench [nodes] [uniform|fake|network] [output.json]" << std::endl;
+        return;
+    }
+
+    // Set up the prediction cache and tablebases as for searching, but only create a network if needed.
+    if (predictions == "network")
+    {
+        InitializeWorkers();
+    }
+    if (_workerGroup.IsInitialized())
+    {
+        StopAndReadyWorkers();
+    }
+    else
+    {
+        InitializePredictionCache();
+    }
+    if (!_syzygyLoaded)
+    {
+        Syzygy::Reload();
+        _syzygyLoaded = true;
+    }
+
+    const BenchResult result = Bench::Run(_network.get(), predictions, nodes,
+        Config::Misc.Search_SearchThreads, Config::Misc.Search_SearchParallelism);
+
+    Bench::WriteJson(std::cout, result);
+    if (!outputFilename.empty())
+    {
+        std::ofstream output(outputFilename, std::ios::out | std::ios::trunc);
+        Bench::WriteJson(output, result);
+        if (!output)
+        {
+            std::cout << "Failed to write: " << outputFilename << std::endl;
+        }
+    }
 }
 
 void ChessCoachUci::InitializeNetwork()
@@ -716,7 +1033,9 @@ void ChessCoachUci::InitializeWorkers()
         Config::Misc.Search_SearchThreads, Config::Misc.Search_SearchParallelism, &SelfPlayWorker::LoopSearch);
 
     // Delay initializing the prediction cache until the Hash option is set or isready/go/comment, to keep input responsive early.
+    // A saved cache needs the network's identity, so it's also loaded here at the earliest.
     InitializePredictionCache();
+    LoadPredictionCache(_network.get());
 
     // Let the GUI call back in to show requested lines.
     InitializePythonModule(nullptr /* storage */, _network.get(), &_workerGroup);
@@ -0,0 +1,106 @@
+# ChessCoach, a neural network-based chess engine capable of natural-language commentary
+# Copyright 2021 Chris Butner
+#
+# ChessCoach is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# ChessCoach is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
+
+import mmap
+import zlib
+import numpy as np
+
+# Reads columnar chunks (see ColumnarChunk.h) as numpy arrays. Raw columns are zero-copy views over a read-only
+# mapping of the file, and zlib-compressed columns are inflated on first use.
+class ColumnarChunk:
+
+  magic = 0x4C4F4343 # "CCOL"
+  version = 1
+  column_count = 8
+
+  column_info_dtype = np.dtype([
+    ("offset", "<u8"),
+    ("stored_bytes", "<u8"),
+    ("raw_bytes", "<u8"),
+    ("compression", "<u4"),
+    ("reserved", "<u4"),
+  ])
+
+  header_dtype = np.dtype([
+    ("magic", "<u4"),
+    ("version", "<u4"),
+    ("column_count", "<i4"),
+    ("image_pieces_auxiliary_stride", "<i4"),
+    ("game_count", "<i8"),
+    ("position_count", "<i8"),
+    ("policy_count", "<i8"),
+    ("columns", column_info_dtype, (column_count,)),
+  ])
+
+  # Same order as "ColumnarColumn".
+  column_dtypes = [
+    ("game_position_offsets", "<i8"),
+    ("result", "<f4"),
+    ("mcts_values", "<f4"),
+    ("image_pieces_auxiliary", "<i8"),
+    ("policy_row_lengths", "<i8"),
+    ("policy_offsets", "<i8"),
+    ("policy_indices", "<i8"),
+    ("policy_values", "<f4"),
+  ]
+
+  compression_none = 0
+  compression_zlib = 1
+
+  def __init__(self, filename):
+    with open(filename, "rb") as file:
+      self.mapping = mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ)
+    header = np.frombuffer(self.mapping, dtype=self.header_dtype, count=1)[0]
+    if (header["magic"] != self.magic) or (header["version"] != self.version) or (header["column_count"] != self.column_count):
+      raise ValueError(f"Invalid columnar chunk: {filename}")
+    self.header = header
+    self.game_count = int(header["game_count"])
+    self.position_count = int(header["position_count"])
+    self.policy_count = int(header["policy_count"])
+    self.image_pieces_auxiliary_stride = int(header["image_pieces_auxiliary_stride"])
+    self.columns = {}
+
+  def column(self, name):
+    array = self.columns.get(name)
+    if array is None:
+      index = next(i for i, (column_name, _) in enumerate(self.column_dtypes) if column_name == name)
+      dtype = np.dtype(self.column_dtypes[index][1])
+      info = self.header["columns"][index]
+      offset, stored_bytes, raw_bytes = int(info["offset"]), int(info["stored_bytes"]), int(info["raw_bytes"])
+      if info["compression"] == self.compression_none:
+        array = np.frombuffer(self.mapping, dtype=dtype, count=raw_bytes // dtype.itemsize, offset=offset)
+      elif info["compression"] == self.compression_zlib:
+        array = np.frombuffer(zlib.decompress(self.mapping[offset:offset + stored_bytes]), dtype=dtype)
+      else:
+        raise ValueError(f"Unknown columnar chunk compression: {info['compression']}")
+      if name == "image_pieces_auxiliary":
+        array = array.reshape(-1, self.image_pieces_auxiliary_stride)
+      self.columns[name] = array
+    return array
+
+  # Returns a dict of this game's features, in the same shapes as parsed from a TFRecord chunk's tf.train.Example.
+  def game(self, index):
+    position_start, position_end = self.column("game_position_offsets")[index:index + 2]
+    policy_offsets = self.column("policy_offsets")
+    policy_start, policy_end = policy_offsets[position_start], policy_offsets[position_end]
+    return {
+      "result": self.column("result")[index],
+      "mcts_values": self.column("mcts_values")[position_start:position_end],
+      "image_pieces_auxiliary": self.column("image_pieces_auxiliary")[position_start:position_end],
+      "policy_row_lengths": self.column("policy_row_lengths")[position_start:position_end],
+      "policy_indices": self.column("policy_indices")[policy_start:policy_end],
+      "policy_values": self.column("policy_values")[policy_start:policy_end],
+    }
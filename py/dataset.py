@@ -14,6 +14,7 @@
 # You should have received a copy of the GNU General Public License
 # along with ChessCoach. If not, see <https://www.gnu.org/licenses/>.
 
+import os
 import tensorflow as tf
 from model import ModelBuilder
 from config import ChessCoachException
@@ -193,7 +194,7 @@ class DatasetBuilder:
     dataset = dataset.prefetch(tf.data.experimental.AUTOTUNE)
     return dataset
 
-  def build_dataset_source(self, glob, window, options):
+  def chunk_filenames(self, glob, window):
     # Grab chunk filenames (they need to be ordered here).
     filenames = tf.io.gfile.glob(glob)
 
@@ -208,6 +209,11 @@ class DatasetBuilder:
         games_expected = chunks_expected * self.games_per_chunk
         raise ChessCoachException(f"Not enough games found - {games_found} vs. {games_expected} - add a matching 'play' stage before training")
 
+    return filenames
+
+  def build_dataset_source(self, glob, window, options):
+    filenames = self.chunk_filenames(glob, window)
+
     # Pick chunk order randomly over the full span of the window.
     dataset = tf.data.Dataset.from_tensor_slices(filenames)
     dataset = dataset.shuffle(len(filenames), reshuffle_each_iteration=True)
@@ -276,6 +282,40 @@ class DatasetBuilder:
     dataset = dataset.prefetch(tf.data.experimental.AUTOTUNE)
     return dataset
   
+  # The native loader only reads local chunks, so cloud training sticks with tf.data.
+  def use_native_loader(self):
+    return self.config.training["dataset_native_loader"] and not self.config.is_cloud
+
+  # Decompress, sample and shuffle positions in C++ (see TrainingDataLoader.cpp) rather than in tf.data ops,
+  # reading the same chunks with the same options. Batches arrive as numpy arrays over the loader's buffers.
+  def build_native_dataset(self, sources, options):
+    import chesscoach # See PythonModule.cpp
+
+    thread_count = min(options.cycle_length, os.cpu_count())
+    loader = chesscoach.create_training_loader([[os.fsencode(filename) for filename in filenames] for filenames in sources],
+      options.global_batch_size, options.position_shuffle_size, float(options.keep_game_proportion),
+      float(options.keep_position_proportion), thread_count)
+
+    def generate():
+      while True:
+        images, values, mcts_values, policies = chesscoach.next_training_batch(loader)
+        yield (images, (values, mcts_values, policies))
+
+    batch_size = options.global_batch_size
+    output_signature = (
+      tf.TensorSpec([batch_size, ModelBuilder.input_planes_count], tf.int64),
+      (
+        tf.TensorSpec([batch_size], tf.float32),
+        tf.TensorSpec([batch_size], tf.float32),
+        tf.TensorSpec([batch_size] + ModelBuilder.output_planes_shape, tf.float32),
+      ))
+    dataset = tf.data.Dataset.from_generator(generate, output_signature=output_signature)
+
+    # Prefetch batches and disable sharding.
+    dataset = dataset.prefetch(tf.data.experimental.AUTOTUNE)
+    dataset = self.disable_sharding(dataset)
+    return dataset
+
   def build_training_dataset(self, globs, windows, global_batch_size):
     options = DatasetOptions(
       global_batch_size=global_batch_size,
@@ -284,6 +324,8 @@ class DatasetBuilder:
       keep_position_proportion=self.config.training["dataset_keep_position_proportion"],
       cycle_length=self.config.training["dataset_parallel_reads"],
       )
+    if self.use_native_loader():
+      return self.build_native_dataset([self.chunk_filenames(glob, window) for glob, window in zip(globs, windows)], options)
     sources = [self.build_dataset_source(glob, window, options) for glob, window in zip(globs, windows)]
     return self.build_dataset(sources, options)
 
@@ -301,6 +343,8 @@ class DatasetBuilder:
       keep_position_proportion=self.config.training["dataset_keep_position_proportion"],
       cycle_length=self.config.training["dataset_parallel_reads"],
       )
+    if self.use_native_loader():
+      return self.build_native_dataset([self.chunk_filenames(glob, window=None) for glob in globs], options)
     sources = [self.build_dataset_source(glob, window=None, options=options) for glob in globs]
     return self.build_dataset(sources, options)
 
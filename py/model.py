@@ -17,7 +17,9 @@
 import tensorflow as tf
 from tensorflow.keras import backend as K
 K.set_image_data_format("channels_first")
+import numpy as np
 import os
+import struct
 
 class ModelBuilder:
   
@@ -185,6 +187,53 @@ class ModelBuilder:
   def subset_commentary_encoder(self, model):
     return type(model)(model.input, model.outputs[3:])
 
+  # Write the prediction subset (value, policy) for the C++ "NativeNetwork", folding batchnorms into
+  # per-channel scale/shift. The layout must stay in sync with "NativeWeights::Load" in "NativeNetwork.cpp".
+  def export_native(self, model, path):
+    native_magic = 0x574E4343 # "CCNW"
+    native_version = 1
+
+    def layer_weights(name):
+      return [w.numpy() for w in model.get_layer(name).weights]
+
+    def conv(name):
+      # Keras kernels are [height][width][in][out]; C++ expects [out][in][height][width].
+      return np.transpose(layer_weights(name)[0], (3, 2, 0, 1))
+
+    def batchnorm(name):
+      layer = model.get_layer(name)
+      gamma, beta, mean, variance = layer_weights(name)
+      scale = gamma / np.sqrt(variance + layer.epsilon)
+      return [scale, beta - mean * scale]
+
+    filter_count = model.get_layer("tower/batchnorm").weights[0].shape[0]
+    residual_count = sum(1 for layer in model.layers if layer.name.startswith("residual_") and layer.name.endswith("/add"))
+    value_dense = next(layer for layer in model.layers if layer.name.startswith("value/dense_"))
+    dense_count = value_dense.weights[0].shape[1]
+
+    tensors = [conv(f"initial/conv2d_{filter_count}"), *batchnorm("initial/batchnorm")]
+    for block in range(residual_count):
+      if block != 0:
+        tensors += batchnorm(f"residual_{block}/batchnorm_0")
+      tensors.append(conv(f"residual_{block}/conv2d_0_{filter_count}"))
+      tensors += batchnorm(f"residual_{block}/batchnorm_1")
+      tensors.append(conv(f"residual_{block}/conv2d_1_{filter_count}"))
+    tensors += batchnorm("tower/batchnorm")
+
+    dense_kernel, dense_bias = layer_weights(value_dense.name)
+    output_kernel, output_bias = layer_weights(self.output_value_name)
+    tensors += [conv(f"value/conv2d_{self.value_filter_count}"), *batchnorm("value/batchnorm"),
+      dense_kernel.T, dense_bias, output_kernel.T, output_bias]
+
+    policy_kernel, policy_bias = layer_weights(self.output_policy_name)
+    tensors += [conv(f"policy/conv2d_{filter_count}"), *batchnorm("policy/batchnorm"),
+      np.transpose(policy_kernel, (3, 2, 0, 1)), policy_bias]
+
+    with open(path, "wb") as file:
+      file.write(struct.pack("<IIiii", native_magic, native_version, residual_count, filter_count, dense_count))
+      for tensor in tensors:
+        file.write(np.ascontiguousarray(tensor, dtype="<f4").tobytes())
+
   def build_commentary(self, config, tokenizer, model_full, is_tpu, strategy):
     import transformer
     from official.nlp.modeling import models
@@ -623,6 +623,14 @@ def debug_decompress(result, image_pieces_auxiliary, policy_row_lengths, policy_
     policy_row_lengths, policy_indices, policy_values, indices)
   return np.array(memoryview(images)), np.array(memoryview(values)), np.array(memoryview(policies))
 
+def export_native_weights(network_type, path):
+  # Export the latest prediction weights for the C++ native inference backend, e.g.:
+  # python -c "import network; network.export_native_weights('teacher', 'teacher.ccnw')"
+  network = getattr(networks, network_type)
+  full, model_path = network.build_full("export", network.prediction_model_type, allow_fresh=False)
+  log(f"Exporting native weights ({network_type}/{model_path.model_type()}): {model_path.log_name()} -> {path}")
+  ModelBuilder().export_native(full, path)
+
 def optimize_parameters():
   import optimization
   optimization.optimize_parameters(config)